@@ -48,9 +48,14 @@
 #ifndef INC_AL_DECORRELATION_HPP
 #define INC_AL_DECORRELATION_HPP
 
+#include <memory>
+#include <vector>
+
 #include <allocore/io/al_AudioIO.hpp>
 #include <alloaudio/al_Convolver.hpp>
 
+struct fftwf_plan_s;
+
 namespace al {
 
 /**
@@ -103,26 +108,122 @@ public:
 
 	virtual void onAudioCB(AudioIOData &io);
 
-	float *getIR(int index);
+	/** IRs may be shared with other instances through the cache, read only */
+	const float *getIR(int index);
 	int getSize();
 
+	/**
+	 * @brief Set the number of threads used to generate the IRs
+	 *
+	 * IRs for different outputs are computed concurrently. The random
+	 * phases are always drawn in the same order, so the IRs for a seed do
+	 * not depend on the number of threads.
+	 *
+	 * @param numThreads number of threads. 0 uses one per hardware thread.
+	 */
+	void setNumThreads(int numThreads);
+
+	/**
+	 * @brief Discard all cached IR sets
+	 *
+	 * Generated IR sets are kept in a process wide cache keyed by the seed and
+	 * the other generation parameters, so configuring again with a seed that
+	 * was used before does not require any FFTs.
+	 */
+	static void clearCache();
+
 //	void processAudio(float *inputBuffer, float* outputBuffer, int index, int numSamples);
 
 private:
 
+	typedef std::vector<std::vector<float> > IRSet;
+
 	void freeIRs();
 	void generateIRs(long seed = -1, float maxjump = -1.0, float phaseFactor = 1.0);
 	void generateDeterministicIRs(long seed = -1, float deltaFreq = 30, float maxFreqDev = 10, float maxTau = 1.0);
+	void setIRs(std::shared_ptr<const IRSet> irs);
 
-	vector<float *>mIRs;
+	vector<float *>mIRs; // for the Convolver, which only copies them
+	std::shared_ptr<const IRSet> mIRSet;
 	int mSize;
 	int mInChannel;
 	int mNumOuts;
 	bool mInputsAreBuses;
+	int mNumThreads;
 	Convolver mConv;
 	unsigned long mSeed;
 };
 
+
+/**
+ * @brief One to many decorrelation and panning in the frequency domain
+ *
+ * Applies a set of decorrelation IRs (e.g. from Decorrelation::getIR()) to a
+ * single input using uniformly partitioned overlap-save convolution. The
+ * input block is transformed once and its spectrum is shared by all
+ * outputs, so the cost per output is one complex multiply-accumulate per
+ * partition and one inverse FFT. A gain per output (e.g. computed by a
+ * panner) is applied to each output, ramped over one block when it changes.
+ *
+ * @ingroup alloaudio
+ */
+class DecorrelationSpatializer : public AudioCallback
+{
+public:
+	DecorrelationSpatializer();
+	~DecorrelationSpatializer();
+
+	/**
+	 * @brief Set up the IRs and buffers. Must be called before processing.
+	 * @param blockSize frames per audio block (the partition size)
+	 * @param IRs one IR per output
+	 * @param IRlength length of every IR
+	 * @param inChannel the input (or bus) channel to decorrelate
+	 * @param inputIsBus read the input from a bus instead of an input channel
+	 * @param outChannels the output channel for each IR. If empty, IR i goes to output i.
+	 */
+	void configure(int blockSize, const vector<const float *> &IRs, int IRlength,
+				   int inChannel = 0, bool inputIsBus = false,
+				   const vector<int> &outChannels = vector<int>());
+
+	/** Set the gain for output index (index into the IR list) */
+	void setGain(int index, float gain);
+
+	int numOutputs() const { return mNumOuts; }
+
+	/** Process one block of audio. io.framesPerBuffer() must equal the
+	 * configured block size. */
+	virtual void onAudioCB(AudioIOData &io);
+
+	/** Process one block from a buffer into separate output buffers */
+	void process(const float *input, float **outputs);
+
+private:
+	void release();
+
+	int mBlockSize;
+	int mNumBins;
+	int mNumParts;
+	int mNumOuts;
+	int mInChannel;
+	bool mInputIsBus;
+	vector<int> mOutChannels;
+	vector<float> mGains, mPrevGains;
+	vector<float *> mOutPtrs;
+
+	// Split complex spectra. IR spectra are [output][partition][bin], the
+	// input delay line is [partition][bin] indexed circularly from mCurPart.
+	vector<float> mIRre, mIRim;
+	vector<float> mFDLre, mFDLim;
+	vector<float> mAccre, mAccim;
+	int mCurPart;
+
+	float *mTimeBuf;  // 2 * blockSize, last two input blocks
+	float *mOutBuf;   // 2 * blockSize, inverse FFT output
+	float *mSpecBuf;  // blockSize + 1 interleaved complex bins
+	fftwf_plan_s *mForwardPlan, *mInversePlan;
+};
+
 } // al::
 
 #endif
@@ -46,17 +46,12 @@
 
 #include <vector>
 
-#include <pthread.h>
-
 #include "allocore/io/al_AudioIO.hpp"
 #include "allocore/types/al_SingleRWRingBuffer.hpp"
 #include "allocore/types/al_MsgQueue.hpp"
 #include "allocore/protocol/al_OSC.hpp"
 #include "allocore/system/al_Thread.hpp"
 
-
-typedef struct BUTTER_ BUTTER;
-
 namespace al {
 
 typedef enum {
@@ -135,7 +130,8 @@ class OutputMaster : public osc::Recv, public al::AudioCallback
     /** Set the frequency at which peak meter data is updated. During the update period,
      * a single value (maximum sample peak) is stored, and will only be avialable once
      * the period is completed, as this is passed to the non-audio context through a
-     * lock-free ring buffer.
+     * lock-free ring buffer. The OSC meter thread polls this buffer at a fraction of
+     * the update period, so the audio thread never has to wake it up.
      */
     void setMeterUpdateFreq(double freq);
 
@@ -169,7 +165,11 @@ class OutputMaster : public osc::Recv, public al::AudioCallback
     int getNumChnls();
 
 	/** Process a block of audio data. This can be called by itself passing an AudioIOData
-	 * object or the OutputMaster object can be appended to the
+	 * object or the OutputMaster object can be appended to the AudioIO object.
+	 *
+	 * Channels are processed in groups of four (one SIMD register per group) in
+	 * single precision. No memory is allocated or lock taken, except for
+	 * the first block after the block size has grown.
 	 * \code
 	al::AudioIO io(4, 44100.0, NULL, NULL, 2, 2, 0, al::AudioIO::DUMMY);
 	al::OutputMaster outmaster(io.channelsOut(), io.framesperSecond());
@@ -223,23 +223,36 @@ private:
 
     /* output data */
     std::vector<float> m_meters;
+    std::vector<float> m_blockPeaks; /* peaks for the current block, padded to groups of 4 */
     SingleRWRingBuffer m_meterBuffer;
     int m_meterCounter; /* count samples for level updates */
     std::string m_sendAddress;
     int m_sendPort;
-    int m_runMeterThread;
+    volatile int m_runMeterThread;
     al::Thread m_meterThread;
-    pthread_mutex_t m_meterMutex;
-    pthread_cond_t m_meterCond;
 
-    /* bass management filters */
-    std::vector<BUTTER *> m_lopass1, m_lopass2, m_hipass1, m_hipass2;
+    /* bass management filters. Biquad state is interleaved by groups of four
+       channels so that each state variable of a group fits one SIMD register */
+    struct BiquadState {
+        float x1[4], x2[4], y1[4], y2[4];
+    };
+    struct ChannelGroup {
+        BiquadState lopass1, lopass2, hipass1, hipass2;
+    };
+    std::vector<ChannelGroup> m_groups;
+    float m_lopassCoeffs[5]; /* a0, a1, a2, b1, b2 */
+    float m_hipassCoeffs[5];
+
+    /* scratch buffers, grown only when the block size increases */
+    std::vector<float> m_bassBuffer;
+    std::vector<float> m_padBuffer; /* silent channel for incomplete groups */
 
     double m_framesPerSec; // Sample rate
 
     int chanIsSubwoofer(int index);
     void initializeData();
     void allocateChannels(int numChnls);
+    void reserveFrames(int nframes);
     static void *meterThreadFunc(void *arg);
 
     struct OSCHandler : public osc::PacketHandler{
@@ -8,10 +8,11 @@
 #define _GLIBCXX_USE_CLOCK_REALTIME
 #endif
 
+#include <atomic>
 #include <mutex>
 #include <thread>
-#include <condition_variable>
 #include <memory>
+#include <vector>
 
 #include "Gamma/SoundFile.h"
 #include "allocore/types/al_SingleRWRingBuffer.hpp"
@@ -21,6 +22,51 @@
 namespace al
 {
 
+class SoundFileBuffered;
+
+///
+/// \brief Pool of low priority threads that stream sound files from disk
+///
+/// SoundFileBuffered objects register with an engine when they are created.
+/// Each I/O thread sweeps the registered streams and tops up every ring
+/// buffer whose fill level has dropped below its low watermark, so refills do
+/// not depend on the audio thread waking a reader. A fixed number of threads
+/// serves any number of streams. Unless told otherwise, streams use the
+/// process wide engine returned by global().
+///
+class SoundFileStreamEngine
+{
+public:
+	///
+	/// \param numThreads number of I/O threads in the pool
+	/// \param pollPeriod time in seconds an I/O thread sleeps when no stream needs data
+	///
+	SoundFileStreamEngine(int numThreads = 2, double pollPeriod = 0.002);
+	~SoundFileStreamEngine();
+
+	/// Get the engine shared by all streams not given an engine explicitly
+	static SoundFileStreamEngine& global();
+
+	int numThreads() const { return mThreads.size(); }	///< Number of I/O threads
+	int numStreams();									///< Number of registered streams
+	unsigned refills() const { return mRefills; }		///< Ring buffer refills performed so far
+
+private:
+	friend class SoundFileBuffered;
+
+	void add(SoundFileBuffered *stream);
+	void remove(SoundFileBuffered *stream);
+
+	static void threadFunction(SoundFileStreamEngine *engine);
+
+	std::vector<SoundFileBuffered *> mStreams;
+	std::mutex mLock;
+	std::vector<std::thread *> mThreads;
+	std::atomic<bool> mRunning;
+	double mPollPeriod;
+	std::atomic<unsigned> mRefills;
+};
+
 ///
 /// \brief Read a soundfile with buffering on a low priority thread
 ///
@@ -30,6 +76,10 @@ namespace al
 /// within an audio callback as it will provide the most efficient mechanism
 /// for low latency, high efficiency and drop-out free soundfile access.
 ///
+/// Disk access is done by the threads of a SoundFileStreamEngine shared by
+/// all streams. The first bufferFrames frames of the file are kept in memory,
+/// so playback can start, loop and seek back to the start without waiting
+/// for the disk.
 ///
 class SoundFileBuffered
 {
@@ -37,9 +87,11 @@ public:
 	///
 	/// \param fullPath The full path to the audio file
 	/// \param loop set to true if you want the sound file to start over when finished
-	/// \param bufferFrames the size of the ring buffer. Set to larger if experiencing dropouts or if planning to read more samples, e.g. the audio buffer size is large.
+	/// \param bufferFrames the size of the ring buffer and of the head cache. Set to larger if experiencing dropouts or if planning to read more samples, e.g. the audio buffer size is large.
+	/// \param engine the streaming engine that will read the file. If NULL, SoundFileStreamEngine::global() is used.
 	///
-	SoundFileBuffered(std::string fullPath, bool loop = false, int bufferFrames = 1024);
+	SoundFileBuffered(std::string fullPath, bool loop = false, int bufferFrames = 1024,
+					  SoundFileStreamEngine *engine = NULL);
 	~SoundFileBuffered();
 
 	///
@@ -50,6 +102,15 @@ public:
 	///
 	int read(float *buffer, int numFrames);
 
+	///
+	/// \brief Move the read position to frame
+	///
+	/// This function can be called from the audio thread. Positions inside the
+	/// head cache are available immediately, other positions become available
+	/// once an I/O thread has refilled the ring buffer.
+	///
+	void seek(int frame);
+
 	bool opened() const;								///< Returns whether the sound file is open
 	gam::SoundFile::EncodingType encoding() const;	///< Get encoding type
 	gam::SoundFile::Format format() const;			///< Get format
@@ -58,6 +119,13 @@ public:
 	int channels() const;								///< Get number of channels
 	int samples() const;								///< Get number of samples ( = frames x channels)
 
+	/// Number of calls to read() that could not be completely served because
+	/// the ring buffer was not refilled in time.
+	unsigned underruns() const { return mUnderruns; }
+	/// Total number of frames missing in underruns
+	unsigned underrunFrames() const { return mUnderrunFrames; }
+	void resetUnderruns() { mUnderruns = 0; mUnderrunFrames = 0; }
+
 	typedef void (*CallbackFunc)(float *buffer, int numChannels,
 								 int numFrames, void * userData);
 
@@ -72,7 +140,8 @@ public:
 	/// the process taking place in the callback function is too intensive it
 	/// might produce an underrun in the ring buffer resulting in audio dropouts.
 	/// If this is the case, use the callback to copy the data to a separate
-	/// thread for processing.
+	/// thread for processing. Note that the callback is called from the
+	/// engine's I/O threads, which are shared by all streams.
 	///
 	/// \param func the callback function
 	/// \param userData the data to be passed to the callback
@@ -80,19 +149,47 @@ public:
 	void setReadCallback(CallbackFunc func, void *userData);
 
 private:
-	bool mRunning;
+	friend class SoundFileStreamEngine;
+
+	// Seek handshake between the audio thread (reader) and the I/O thread
+	// (writer). Only the reader may empty the ring buffer, so the writer stops
+	// first, then the reader drains and the writer restarts at the new position.
+	enum {
+		SEEK_NONE = 0,
+		SEEK_REQUESTED, // set by reader
+		SEEK_STOPPED,   // set by writer, will not write until drained
+		SEEK_DRAINED    // set by reader, writer can reposition
+	};
+
+	bool service(); // called from an I/O thread, returns true if data was written
+	void fill();
+	void writeFrames(const float *buf, int numFrames);
+
 	bool mLoop;
-	std::mutex mLock;
-	std::condition_variable mCondVar;
-	std::thread *mReaderThread;
 	SingleRWRingBuffer *mRingBuffer;
 	int mBufferFrames;
+	int mLowWatermark; // in bytes
 
 	gam::SoundFile mSf;
 	CallbackFunc mReadCallback;
 	void *mCallbackData;
-
-	static void readFunction(SoundFileBuffered *obj);
+	SoundFileStreamEngine *mEngine;
+
+	// I/O thread state
+	std::vector<float> mReadBuffer;
+	int mFilePos;       // next frame to be written into the ring buffer
+	std::atomic<bool> mBusy; // claimed by an I/O thread
+	std::atomic<bool> mEndOfFile;
+
+	// head cache, shared read-only after construction
+	std::vector<float> mHeadCache;
+	int mCacheFrames;
+	int mCachePos;      // reader position inside the head cache
+
+	std::atomic<int> mSeekState;
+	std::atomic<int> mSeekFrame;
+	std::atomic<unsigned> mUnderruns;
+	std::atomic<unsigned> mUnderrunFrames;
 };
 
 } // namespace al
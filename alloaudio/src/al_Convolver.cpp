@@ -5,6 +5,7 @@
 #include <string.h>
 #include <assert.h>
 #include "alloaudio/al_Convolver.hpp"
+#include "allocore/io/al_AudioProfiler.hpp"
 
 using namespace al;
 
@@ -78,6 +79,7 @@ int Convolver::configure(al::AudioIO &io, vector<float *> IRs, int IRlength,
 
 void Convolver::onAudioCB(al::AudioIOData &io)
 {
+	AL_PROFILE_AUDIO("Convolver");
 	int blockSize = io.framesPerBuffer();
 
 	//fill the input buffers
@@ -46,10 +46,18 @@
 */
 
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
 #include <cmath>
 #include <cassert>
+#include <algorithm>
+#include <map>
+#include <list>
+#include <mutex>
+#include <thread>
+
+#include <fftw3.h>
 
 #include "alloaudio/al_Decorrelation.hpp"
 #include <Gamma/FFT.h>
@@ -61,10 +69,112 @@ using namespace std;
 #define M_PI		3.14159265358979323846
 #endif
 
+namespace {
+
+// Generation parameters identifying a set of IRs in the cache
+struct IRKey {
+	int method;
+	long seed;
+	int size, numOuts;
+	float p1, p2, p3;
+
+	bool operator<(const IRKey &k) const {
+		if (method != k.method) return method < k.method;
+		if (seed != k.seed) return seed < k.seed;
+		if (size != k.size) return size < k.size;
+		if (numOuts != k.numOuts) return numOuts < k.numOuts;
+		if (p1 != k.p1) return p1 < k.p1;
+		if (p2 != k.p2) return p2 < k.p2;
+		return p3 < k.p3;
+	}
+};
+
+typedef vector<vector<float> > IRSet;
+
+const size_t maxCachedSets = 32;
+std::mutex cacheLock;
+std::map<IRKey, shared_ptr<const IRSet> > irCache;
+std::list<IRKey> cacheOrder; // oldest first
+
+shared_ptr<const IRSet> findCached(const IRKey &key)
+{
+	std::lock_guard<std::mutex> lk(cacheLock);
+	std::map<IRKey, shared_ptr<const IRSet> >::iterator it = irCache.find(key);
+	if (it == irCache.end()) {
+		return shared_ptr<const IRSet>();
+	}
+	return it->second;
+}
+
+void addCached(const IRKey &key, shared_ptr<const IRSet> irs)
+{
+	std::lock_guard<std::mutex> lk(cacheLock);
+	if (irCache.insert(std::make_pair(key, irs)).second) {
+		cacheOrder.push_back(key);
+		if (cacheOrder.size() > maxCachedSets) {
+			irCache.erase(cacheOrder.front());
+			cacheOrder.pop_front();
+		}
+	}
+}
+
+int workerCount(int count, int numThreads)
+{
+	if (numThreads <= 0) {
+		numThreads = std::thread::hardware_concurrency();
+	}
+	return std::max(1, std::min(numThreads, count));
+}
+
+// Run func(i, thread) for i in [0, count) distributed over numThreads threads
+template<class Func>
+void parallelFor(int count, int numThreads, Func func)
+{
+	if (numThreads == 1) {
+		for (int i = 0; i < count; i++) func(i, 0);
+		return;
+	}
+	vector<std::thread> threads;
+	for (int t = 0; t < numThreads; t++) {
+		threads.push_back(std::thread([=]() {
+			for (int i = t; i < count; i += numThreads) func(i, t);
+		}));
+	}
+	for (unsigned t = 0; t < threads.size(); t++) {
+		threads[t].join();
+	}
+}
+
+// Per thread FFT and buffer. The transforms are created and destroyed on
+// the calling thread as FFT planning is not necessarily thread safe.
+struct IRWorkspace {
+	IRWorkspace(int size) : fft(size), spectrum(size * 2, 0.0f) {}
+	gam::RFFT<float> fft;
+	vector<float> spectrum;
+};
+
+// Inverse transform of a unit magnitude spectrum with the given phases
+// (bins 0 to size/2) into ir
+void phaseToIR(const float *phsSpectrum, IRWorkspace &ws, float *ir, int size)
+{
+	float *complexSpectrum = ws.spectrum.data();
+	int n = size/2;
+	for (int i = 0; i <= n; i++) {
+		complexSpectrum[i*2] = cos(phsSpectrum[i]); // Real part
+		complexSpectrum[i*2 + 1] = sin(phsSpectrum[i]); // Imaginary
+	}
+	ws.fft.inverse(complexSpectrum, true);
+	for (int i=1; i <= size; i++) {
+		ir[i - 1] = complexSpectrum[i]/size;
+	}
+}
+
+} // ::
+
 Decorrelation::Decorrelation(int size, int inChannel, int numOuts,
 							 bool inputsAreBuses) :
 	mSize(size), mInChannel(inChannel), mNumOuts(numOuts),
-	mInputsAreBuses(inputsAreBuses)
+	mInputsAreBuses(inputsAreBuses), mNumThreads(0)
 {
 }
 
@@ -80,9 +190,6 @@ long al::Decorrelation::getCurrentSeed()
 
 void Decorrelation::generateIRs(long seed, float maxjump, float phaseFactor)
 {
-	float *ampSpectrum = (float *) calloc(mSize, sizeof(float));
-	float *phsSpectrum = (float *) calloc(mSize, sizeof(float));
-	float *complexSpectrum = (float *) calloc(mSize * 2, sizeof(float));;
 	//	#    max_jump -  is the maximum phase difference (in radians) between bins
 	//	#             if -1, the random numbers are used directly (no jumping).
 
@@ -96,61 +203,51 @@ void Decorrelation::generateIRs(long seed, float maxjump, float phaseFactor)
 	} else {
 		mSeed = time(0);
 	}
+	IRKey key = {0, (long) mSeed, mSize, mNumOuts, maxjump, phaseFactor, 0};
+	shared_ptr<const IRSet> cached = findCached(key);
+	if (cached) {
+		setIRs(cached);
+		return;
+	}
+
+	// Draw all random phases first, in the same order as a sequential
+	// generation, then do the inverse FFTs in parallel.
+	vector<vector<float> > phases(mNumOuts, vector<float>(n + 1, 0.0f));
 	srand(mSeed);
 	for (int irIndex = 0; irIndex < mNumOuts; irIndex++) {
-		// Fill in DC and Nyquist
-		ampSpectrum[0] = 1.0;
-		phsSpectrum[0] = 0.0;
-		complexSpectrum[0] = ampSpectrum[0] * cos(phsSpectrum[0]);
-		complexSpectrum[1] = ampSpectrum[0] * sin(phsSpectrum[0]);
-		complexSpectrum[(n*2)] = ampSpectrum[0] * cos(phsSpectrum[0]);
-		complexSpectrum[(n*2) + 1] = ampSpectrum[0] * sin(phsSpectrum[0]);
-
+		float *phsSpectrum = phases[irIndex].data();
+		// DC and Nyquist have zero phase
 		float old_phase = 0;
 		for (int i=1; i < n; i++) {
-			ampSpectrum[i] = 1.0;
 			if (maxjump == -1.0) {
 				phsSpectrum[i] = ((rand() / (float) RAND_MAX) * M_PI)- (M_PI/2.0);
 			} else {
 				// make phase only move +- limit
 				float delta = ((rand() / ((float) RAND_MAX)) * 2.0 * maxjump) - maxjump;
-//				std::cout << "delta " << delta << std::endl;
 				float new_phase = old_phase + delta;
 				phsSpectrum[i] = new_phase * phaseFactor;
 				old_phase = new_phase;
 			}
-			
-			complexSpectrum[i*2] = ampSpectrum[i] * cos(phsSpectrum[i]); // Real part
-			complexSpectrum[i*2 + 1] = ampSpectrum[i] * sin(phsSpectrum[i]); // Imaginary
-//			std::cout << complexSpectrum[i*2] << ", " << complexSpectrum[i*2 + 1] << ",";
 		}
+	}
 
-//		std::cout << ".... " <<std::endl;
-		gam::RFFT<float> fftObj(mSize);
-
-		fftObj.inverse(complexSpectrum, true);
-		float *irdata = (float *) calloc(mSize, sizeof(float));
-
-		for (int i=1; i <= mSize; i++) {
-			irdata[i - 1] = complexSpectrum[i]/mSize;
-//			std::cout << complexSpectrum[i]/mSize << "," << std::endl;
-		}
-		mIRs.push_back(irdata);
+	shared_ptr<IRSet> irs(new IRSet(mNumOuts, vector<float>(mSize)));
+	int size = mSize;
+	int numThreads = workerCount(mNumOuts, mNumThreads);
+	vector<shared_ptr<IRWorkspace> > workspaces;
+	for (int t = 0; t < numThreads; t++) {
+		workspaces.push_back(make_shared<IRWorkspace>(size));
 	}
-	free(ampSpectrum);
-	free(phsSpectrum);
-	free(complexSpectrum);
+	parallelFor(mNumOuts, numThreads, [&](int irIndex, int t) {
+		phaseToIR(phases[irIndex].data(), *workspaces[t], (*irs)[irIndex].data(), size);
+	});
+	addCached(key, irs);
+	setIRs(irs);
 }
 
 void Decorrelation::generateDeterministicIRs(long seed, float deltaFreq, float maxFreqDev,
 											 float maxTau)
 {
-	float *ampSpectrum = (float *) calloc(mSize, sizeof(float));
-	float *phsSpectrum = (float *) calloc(mSize, sizeof(float));
-	float *complexSpectrum = (float *) calloc(mSize * 2, sizeof(float));;
-	//	#    max_jump -  is the maximum phase difference (in radians) between bins
-	//	#             if -1, the random numbers are used directly (no jumping).
-
 	freeIRs();
 
 	int n = mSize/2; // before mirroring
@@ -161,35 +258,44 @@ void Decorrelation::generateDeterministicIRs(long seed, float deltaFreq, float m
 	} else {
 		mSeed = time(0);
 	}
-	srand(mSeed);
+	IRKey key = {1, (long) mSeed, mSize, mNumOuts, deltaFreq, maxFreqDev, maxTau};
+	shared_ptr<const IRSet> cached = findCached(key);
+	if (cached) {
+		setIRs(cached);
+		return;
+	}
 
+	srand(mSeed);
+	vector<float> freqs(mNumOuts);
 	for (int irIndex = 0; irIndex < mNumOuts; irIndex++) {
-		float freq = deltaFreq + ((2.0 * maxFreqDev * rand() / (float) RAND_MAX) - maxFreqDev);
-		std::cout << "freq " << irIndex << ":" << freq << std::endl;
-		for (int i=0; i < n + 1; i++) {
-			ampSpectrum[i] = 1.0;
-			phsSpectrum[i] = maxTau * sin(2 * M_PI * i * freq / n);
+		freqs[irIndex] = deltaFreq + ((2.0 * maxFreqDev * rand() / (float) RAND_MAX) - maxFreqDev);
+	}
 
-			complexSpectrum[i*2] = ampSpectrum[i] * cos(phsSpectrum[i]); // Real part
-			complexSpectrum[i*2 + 1] = ampSpectrum[i] * sin(phsSpectrum[i]); // Imaginary
-//			std::cout << complexSpectrum[i*2] << ", " << complexSpectrum[i*2 + 1] << ",";
+	shared_ptr<IRSet> irs(new IRSet(mNumOuts, vector<float>(mSize)));
+	int size = mSize;
+	int numThreads = workerCount(mNumOuts, mNumThreads);
+	vector<shared_ptr<IRWorkspace> > workspaces;
+	for (int t = 0; t < numThreads; t++) {
+		workspaces.push_back(make_shared<IRWorkspace>(size));
+	}
+	parallelFor(mNumOuts, numThreads, [&](int irIndex, int t) {
+		vector<float> phsSpectrum(n + 1);
+		for (int i=0; i < n + 1; i++) {
+			phsSpectrum[i] = maxTau * sin(2 * M_PI * i * freqs[irIndex] / n);
 		}
+		phaseToIR(phsSpectrum.data(), *workspaces[t], (*irs)[irIndex].data(), size);
+	});
+	addCached(key, irs);
+	setIRs(irs);
+}
 
-//		std::cout << ".... " <<std::endl;
-		gam::RFFT<float> fftObj(mSize);
-
-		fftObj.inverse(complexSpectrum, true);
-		float *irdata = (float *) calloc(mSize, sizeof(float));
-
-		for (int i=1; i <= mSize; i++) {
-			irdata[i - 1] = complexSpectrum[i]/mSize;
-//			std::cout << complexSpectrum[i]/mSize << "," << std::endl;
-		}
-		mIRs.push_back(irdata);
+void Decorrelation::setIRs(shared_ptr<const IRSet> irs)
+{
+	mIRSet = irs;
+	mIRs.clear();
+	for (unsigned i = 0; i < irs->size(); i++) {
+		mIRs.push_back(const_cast<float *>((*irs)[i].data()));
 	}
-	free(ampSpectrum);
-	free(phsSpectrum);
-	free(complexSpectrum);
 }
 
 void Decorrelation::onAudioCB(al::AudioIOData &io)
@@ -197,9 +303,9 @@ void Decorrelation::onAudioCB(al::AudioIOData &io)
 	mConv.onAudioCB(io);
 }
 
-float *al::Decorrelation::getIR(int index)
+const float *al::Decorrelation::getIR(int index)
 {
-	if (index < 0 || index >= mSize) {
+	if (index < 0 || index >= (int) mIRs.size()) {
 		return NULL;
 	}
 	return mIRs[index];
@@ -210,14 +316,23 @@ int al::Decorrelation::getSize()
 	return mSize;
 }
 
+void Decorrelation::setNumThreads(int numThreads)
+{
+	mNumThreads = numThreads;
+}
+
+void Decorrelation::clearCache()
+{
+	std::lock_guard<std::mutex> lk(cacheLock);
+	irCache.clear();
+	cacheOrder.clear();
+}
+
 void al::Decorrelation::freeIRs()
 {
-	for (unsigned int i = 0; i < mIRs.size(); i++){
-		free(mIRs[i]);
-	}
 	mIRs.clear();
+	mIRSet.reset();
 }
-
 void Decorrelation::configure(al::AudioIO &io, long seed, float maxjump, float phaseFactor)
 {
 	mSeed = seed;
@@ -245,3 +360,172 @@ void Decorrelation::configureDeterministic(AudioIO &io, long seed, float deltaFr
 						io.framesPerBuffer(), options);
 	}
 }
+
+
+DecorrelationSpatializer::DecorrelationSpatializer() :
+	mBlockSize(0), mNumBins(0), mNumParts(0), mNumOuts(0),
+	mInChannel(0), mInputIsBus(false), mCurPart(0),
+	mTimeBuf(NULL), mOutBuf(NULL), mSpecBuf(NULL),
+	mForwardPlan(NULL), mInversePlan(NULL)
+{
+}
+
+DecorrelationSpatializer::~DecorrelationSpatializer()
+{
+	release();
+}
+
+void DecorrelationSpatializer::release()
+{
+	if (mForwardPlan) {
+		fftwf_destroy_plan(mForwardPlan);
+		fftwf_destroy_plan(mInversePlan);
+		mForwardPlan = mInversePlan = NULL;
+	}
+	fftwf_free(mTimeBuf);
+	fftwf_free(mOutBuf);
+	fftwf_free(mSpecBuf);
+	mTimeBuf = mOutBuf = mSpecBuf = NULL;
+	mNumOuts = 0;
+}
+
+void DecorrelationSpatializer::configure(int blockSize, const vector<const float *> &IRs,
+										 int IRlength, int inChannel, bool inputIsBus,
+										 const vector<int> &outChannels)
+{
+	release();
+	assert(blockSize > 0 && IRlength > 0);
+	assert(outChannels.size() == 0 || outChannels.size() == IRs.size());
+
+	mBlockSize = blockSize;
+	mNumBins = blockSize + 1;
+	mNumParts = (IRlength + blockSize - 1) / blockSize;
+	mNumOuts = IRs.size();
+	mInChannel = inChannel;
+	mInputIsBus = inputIsBus;
+	mOutChannels = outChannels;
+	if (mOutChannels.size() == 0) {
+		for (int i = 0; i < mNumOuts; i++) {
+			mOutChannels.push_back(i);
+		}
+	}
+	mGains.assign(mNumOuts, 1.0f);
+	mPrevGains.assign(mNumOuts, 1.0f);
+	mOutPtrs.assign(mNumOuts, (float *) NULL);
+
+	int fftSize = 2 * blockSize;
+	mTimeBuf = (float *) fftwf_malloc(sizeof(float) * fftSize);
+	mOutBuf = (float *) fftwf_malloc(sizeof(float) * fftSize);
+	mSpecBuf = (float *) fftwf_malloc(sizeof(fftwf_complex) * mNumBins);
+	mForwardPlan = fftwf_plan_dft_r2c_1d(fftSize, mTimeBuf, (fftwf_complex *) mSpecBuf,
+										 FFTW_ESTIMATE);
+	mInversePlan = fftwf_plan_dft_c2r_1d(fftSize, (fftwf_complex *) mSpecBuf, mOutBuf,
+										 FFTW_ESTIMATE);
+
+	// Transform the IR partitions. Each partition is zero padded to the FFT
+	// size for overlap-save.
+	int partSize = mNumParts * mNumBins;
+	mIRre.assign(mNumOuts * partSize, 0.0f);
+	mIRim.assign(mNumOuts * partSize, 0.0f);
+	for (int o = 0; o < mNumOuts; o++) {
+		for (int p = 0; p < mNumParts; p++) {
+			memset(mTimeBuf, 0, sizeof(float) * fftSize);
+			int n = std::min(blockSize, IRlength - p * blockSize);
+			memcpy(mTimeBuf, IRs[o] + p * blockSize, sizeof(float) * n);
+			fftwf_execute(mForwardPlan);
+			float *re = &mIRre[o * partSize + p * mNumBins];
+			float *im = &mIRim[o * partSize + p * mNumBins];
+			for (int k = 0; k < mNumBins; k++) {
+				re[k] = mSpecBuf[2 * k];
+				im[k] = mSpecBuf[2 * k + 1];
+			}
+		}
+	}
+	memset(mTimeBuf, 0, sizeof(float) * fftSize);
+	mFDLre.assign(partSize, 0.0f);
+	mFDLim.assign(partSize, 0.0f);
+	mAccre.assign(mNumBins, 0.0f);
+	mAccim.assign(mNumBins, 0.0f);
+	mCurPart = 0;
+}
+
+void DecorrelationSpatializer::setGain(int index, float gain)
+{
+	if (index >= 0 && index < mNumOuts) {
+		mGains[index] = gain;
+	}
+}
+
+void DecorrelationSpatializer::onAudioCB(AudioIOData &io)
+{
+	assert(io.framesPerBuffer() == mBlockSize);
+	const float *input = mInputIsBus ? io.busBuffer(mInChannel) : io.inBuffer(mInChannel);
+	for (int o = 0; o < mNumOuts; o++) {
+		mOutPtrs[o] = io.outBuffer(mOutChannels[o]);
+	}
+	process(input, mOutPtrs.data());
+}
+
+void DecorrelationSpatializer::process(const float *input, float **outputs)
+{
+	const int B = mBlockSize;
+	const int bins = mNumBins;
+	const int partSize = mNumParts * bins;
+	const float norm = 1.0f / (2 * B);
+
+	// Slide the input window and transform it once for all outputs
+	memmove(mTimeBuf, mTimeBuf + B, sizeof(float) * B);
+	memcpy(mTimeBuf + B, input, sizeof(float) * B);
+	fftwf_execute(mForwardPlan);
+	mCurPart = mCurPart == 0 ? mNumParts - 1 : mCurPart - 1;
+	float *fdlRe = &mFDLre[mCurPart * bins];
+	float *fdlIm = &mFDLim[mCurPart * bins];
+	for (int k = 0; k < bins; k++) {
+		fdlRe[k] = mSpecBuf[2 * k];
+		fdlIm[k] = mSpecBuf[2 * k + 1];
+	}
+
+	float *accRe = mAccre.data();
+	float *accIm = mAccim.data();
+	for (int o = 0; o < mNumOuts; o++) {
+		const float gain = mGains[o];
+		float *out = outputs[o];
+		if (gain == 0.0f && mPrevGains[o] == 0.0f) {
+			memset(out, 0, sizeof(float) * B);
+			continue;
+		}
+		// Multiply-accumulate the delay line against the IR partitions.
+		// Partition p pairs with the input spectrum from p blocks ago.
+		memset(accRe, 0, sizeof(float) * bins);
+		memset(accIm, 0, sizeof(float) * bins);
+		const float *irRe = &mIRre[o * partSize];
+		const float *irIm = &mIRim[o * partSize];
+		int slot = mCurPart;
+		for (int p = 0; p < mNumParts; p++) {
+			const float *xRe = &mFDLre[slot * bins];
+			const float *xIm = &mFDLim[slot * bins];
+			const float *hRe = irRe + p * bins;
+			const float *hIm = irIm + p * bins;
+			for (int k = 0; k < bins; k++) {
+				accRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+				accIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+			}
+			if (++slot == mNumParts) slot = 0;
+		}
+		for (int k = 0; k < bins; k++) {
+			mSpecBuf[2 * k] = accRe[k];
+			mSpecBuf[2 * k + 1] = accIm[k];
+		}
+		fftwf_execute(mInversePlan);
+
+		// The second half is the valid (non circular) part of the result
+		const float *y = mOutBuf + B;
+		float g = mPrevGains[o];
+		const float inc = (gain - g) / B;
+		for (int i = 0; i < B; i++) {
+			g += inc;
+			out[i] = y[i] * norm * g;
+		}
+		mPrevGains[o] = gain;
+	}
+}
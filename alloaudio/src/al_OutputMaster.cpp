@@ -1,25 +1,179 @@
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AL_OUTPUTMASTER_SSE
+#endif
+
 #include "alloaudio/al_OutputMaster.hpp"
+#include "allocore/io/al_AudioProfiler.hpp"
 #include "allocore/system/al_Time.hpp"
 
-#include "alloaudio/butter.h"
+using namespace al;
+
+namespace {
+
+// Four lanes of floats, one lane per channel of a group. The SSE version maps
+// each operation to one instruction, the fallback is plain loops the compiler
+// is free to vectorize.
+#ifdef AL_OUTPUTMASTER_SSE
+struct Float4 {
+	__m128 v;
+	Float4(){}
+	Float4(__m128 v_): v(v_){}
+	explicit Float4(float x): v(_mm_set1_ps(x)){}
+	static Float4 load(const float * p){ return _mm_loadu_ps(p); }
+	void store(float * p) const { _mm_storeu_ps(p, v); }
+	static Float4 gather(float * const * ptrs, int i){
+		return _mm_setr_ps(ptrs[0][i], ptrs[1][i], ptrs[2][i], ptrs[3][i]);
+	}
+	void scatter(float * const * ptrs, int i) const {
+		float t[4]; store(t);
+		ptrs[0][i] = t[0]; ptrs[1][i] = t[1]; ptrs[2][i] = t[2]; ptrs[3][i] = t[3];
+	}
+	float sum() const {
+		float t[4]; store(t);
+		return (t[0] + t[1]) + (t[2] + t[3]);
+	}
+	Float4 operator+(const Float4& o) const { return _mm_add_ps(v, o.v); }
+	Float4 operator-(const Float4& o) const { return _mm_sub_ps(v, o.v); }
+	Float4 operator*(const Float4& o) const { return _mm_mul_ps(v, o.v); }
+	static Float4 min(const Float4& a, const Float4& b){ return _mm_min_ps(a.v, b.v); }
+	static Float4 max(const Float4& a, const Float4& b){ return _mm_max_ps(a.v, b.v); }
+};
+#else
+struct Float4 {
+	float v[4];
+	Float4(){}
+	explicit Float4(float x){ for(int k=0;k<4;++k) v[k] = x; }
+	static Float4 load(const float * p){ Float4 r; for(int k=0;k<4;++k) r.v[k] = p[k]; return r; }
+	void store(float * p) const { for(int k=0;k<4;++k) p[k] = v[k]; }
+	static Float4 gather(float * const * ptrs, int i){
+		Float4 r; for(int k=0;k<4;++k) r.v[k] = ptrs[k][i]; return r;
+	}
+	void scatter(float * const * ptrs, int i) const { for(int k=0;k<4;++k) ptrs[k][i] = v[k]; }
+	float sum() const { return (v[0] + v[1]) + (v[2] + v[3]); }
+	Float4 operator+(const Float4& o) const { Float4 r; for(int k=0;k<4;++k) r.v[k] = v[k] + o.v[k]; return r; }
+	Float4 operator-(const Float4& o) const { Float4 r; for(int k=0;k<4;++k) r.v[k] = v[k] - o.v[k]; return r; }
+	Float4 operator*(const Float4& o) const { Float4 r; for(int k=0;k<4;++k) r.v[k] = v[k] * o.v[k]; return r; }
+	static Float4 min(const Float4& a, const Float4& b){ Float4 r; for(int k=0;k<4;++k) r.v[k] = a.v[k] < b.v[k] ? a.v[k] : b.v[k]; return r; }
+	static Float4 max(const Float4& a, const Float4& b){ Float4 r; for(int k=0;k<4;++k) r.v[k] = a.v[k] > b.v[k] ? a.v[k] : b.v[k]; return r; }
+};
+#endif
+
+// Second order Butterworth section running on a group of four channels.
+// State is held in registers for the duration of a block.
+struct Biquad4 {
+	Float4 a0, a1, a2, b1, b2;
+	Float4 x1, x2, y1, y2;
+	float * state;
+
+	Biquad4(const float * coeffs, float * state_)
+	:	a0(coeffs[0]), a1(coeffs[1]), a2(coeffs[2]), b1(coeffs[3]), b2(coeffs[4]),
+		state(state_)
+	{
+		x1 = Float4::load(state);
+		x2 = Float4::load(state + 4);
+		y1 = Float4::load(state + 8);
+		y2 = Float4::load(state + 12);
+	}
 
-//#include "firfilter.h"
+	~Biquad4(){
+		x1.store(state);
+		x2.store(state + 4);
+		y1.store(state + 8);
+		y2.store(state + 12);
+	}
 
-using namespace al;
+	Float4 operator()(const Float4& in){
+		Float4 out = a0*in + a1*x1 + a2*x2 - b1*y1 - b2*y2;
+		x2 = x1; x1 = in;
+		y2 = y1; y1 = out;
+		return out;
+	}
+};
+
+// Calculated from table 6.1 in the Audio Programming Book, page 484
+// (see butter.cpp)
+void butterCoeffs(float * c, double fc, double sampleRate, bool lowpass)
+{
+	double lambda = std::tan(fc * M_PI / sampleRate);
+	if (lowpass) lambda = 1./lambda;
+	double lambda_2 = lambda * lambda;
+	double a0 = 1.0/(1.0 + (std::sqrt(2.0)*lambda) + lambda_2);
+	c[0] = a0;
+	c[2] = a0;
+	c[4] = a0 * (1.0 - (std::sqrt(2.0)*lambda) + lambda_2);
+	if (lowpass) {
+		c[1] = 2.0 * a0;
+		c[3] = 2.0 * a0 * (1.0 - lambda_2);
+	} else {
+		c[1] = -2.0 * a0;
+		c[3] = 2.0 * a0 * (lambda_2 - 1.0);
+	}
+}
+
+// Process one group of channels for a whole block. The bass management mode
+// is a template parameter so the per-sample loop carries no branches.
+template <int Mode>
+void processGroup(float * const * bufs, int nframes,
+				  const float * lpCoeffs, const float * hpCoeffs,
+				  float * lp1, float * lp2, float * hp1, float * hp2,
+				  const Float4& gain, const Float4& clip, bool clipperOn,
+				  float * bass, float * peaks)
+{
+	Biquad4 lopass1(lpCoeffs, lp1), lopass2(lpCoeffs, lp2);
+	Biquad4 hipass1(hpCoeffs, hp1), hipass2(hpCoeffs, hp2);
+	Float4 peak = Float4::load(peaks);
+
+	for (int i = 0; i < nframes; i++) {
+		Float4 in = Float4::gather(bufs, i);
+		Float4 low;
+		switch (Mode) {
+		case BASSMODE_MIX:
+			low = in;
+			break;
+		case BASSMODE_LOWPASS:
+			low = lopass2(lopass1(in));
+			break;
+		case BASSMODE_HIGHPASS:
+			low = in;
+			in = hipass2(hipass1(in));
+			break;
+		case BASSMODE_FULL:
+			low = lopass2(lopass1(in));
+			in = hipass2(hipass1(in));
+			break;
+		default:
+			break;
+		}
+		if (Mode != BASSMODE_NONE) {
+			bass[i] += low.sum();
+		}
+		Float4 out = in * gain;
+		if (clipperOn) {
+			out = Float4::min(out, clip);
+		}
+		peak = Float4::max(peak, out);
+		out.scatter(bufs, i);
+	}
+	peak.store(peaks);
+}
+
+} // ::
 
 OutputMaster::OutputMaster(int num_chnls, double sampleRate, const char *address, int port,
 						   const char *sendAddress, int sendPort, al_sec msg_timeout):
 	m_numChnls(num_chnls),
 	m_meterBuffer(1024 * sizeof(float)), m_framesPerSec(sampleRate),
 	osc::Recv(port, address, msg_timeout),
-	m_sendAddress(sendAddress), m_sendPort(sendPort)
+	m_sendAddress(sendAddress), m_sendPort(sendPort), m_runMeterThread(0)
 {
-	pthread_mutex_init(&m_meterMutex, NULL);
-	pthread_cond_init(&m_meterCond, NULL);
 	allocateChannels(m_numChnls);
 	initializeData();
 
@@ -44,15 +198,8 @@ OutputMaster::OutputMaster(int num_chnls, double sampleRate, const char *address
 
 OutputMaster::~OutputMaster()
 {
-	for (int i = 0; i < m_numChnls; i++) {
-		butter_free(m_lopass1[i]);
-		butter_free(m_lopass2[i]);
-		butter_free(m_hipass1[i]);
-		butter_free(m_hipass2[i]);
-	}
 	stop(); /* Stops OSC listener */
 	m_runMeterThread = 0;
-	pthread_cond_signal(&m_meterCond);
 	m_meterThread.join();
 }
 
@@ -88,14 +235,9 @@ void OutputMaster::setMeterUpdateFreq(double freq)
 
 void OutputMaster::setBassManagementFreq(double frequency)
 {
-	int i;
 	if (frequency > 0) {
-		for (i = 0; i < m_numChnls; i++) {
-			butter_set_fc(m_lopass1[i], frequency);
-			butter_set_fc(m_lopass2[i], frequency);
-			butter_set_fc(m_hipass1[i], frequency);
-			butter_set_fc(m_hipass2[i], frequency);
-		}
+		butterCoeffs(m_lopassCoeffs, frequency, m_framesPerSec, true);
+		butterCoeffs(m_hipassCoeffs, frequency, m_framesPerSec, false);
 	}
 }
 
@@ -109,9 +251,9 @@ void OutputMaster::setBassManagementMode(bass_mgmt_mode_t mode)
 void OutputMaster::setSwIndeces(int i1, int i2, int i3, int i4)
 {
 	swIndex[0] = i1;
-	swIndex[1] = i1;
-	swIndex[2] = i1;
-	swIndex[3] = i1;
+	swIndex[1] = i2;
+	swIndex[2] = i3;
+	swIndex[3] = i4;
 }
 
 void OutputMaster::setMeterOn(bool meterOn)
@@ -131,91 +273,73 @@ int OutputMaster::getNumChnls()
 
 void OutputMaster::onAudioCB(AudioIOData &io)
 {
-	int i, chan = 0;
+	AL_PROFILE_AUDIO("OutputMaster");
+	int i, chan;
 	int nframes = io.framesPerBuffer();
-	double bass_buf[nframes];
-	double filt_out[nframes];
-	double filt_low[nframes];
-	double in_buf[nframes];
-	double master_gain;
+	float master_gain;
 
 	m_parameterQueue.update(0);
+	reserveFrames(nframes);
 	master_gain = m_masterGain * (m_muteAll ? 0.0 : 1.0);
-	memset(bass_buf, 0, nframes * sizeof(double));
-	for (chan = 0; chan < m_numChnls; chan++) {
-		double gain = master_gain * m_gains[chan];
-		const float *in = io.outBuffer(chan);  // Yes, the input here is the output from previous runs for the io object
-		float *out = io.outBuffer(chan);
-		double filt_temp[nframes];
-		double *buf = bass_buf;
-
-		for (i = 0; i < nframes; i++) {
-			in_buf[i] = *in++;
-		}
-		switch (m_BassManagementMode) {
-		case BASSMODE_NONE:
-			break;
-		case BASSMODE_MIX:
-			for (i = 0; i < nframes; i++) {
-				filt_low[i] = in_buf[i];
-			}
-			break;
-		case BASSMODE_LOWPASS:
-			butter_next(m_lopass1[chan], in_buf, filt_temp, nframes);
-			butter_next(m_lopass2[chan], filt_temp, filt_low, nframes);
-			break;
-		case BASSMODE_HIGHPASS:
-			for (i = 0; i < nframes; i++) {
-				filt_low[i] = in_buf[i];
-			}
-			butter_next(m_hipass1[chan], in_buf, filt_temp, nframes);
-			butter_next(m_hipass2[chan], filt_temp, filt_out, nframes);
-			for (i = 0; i < nframes; i++) {
-				in_buf[i] = filt_out[i];
-			}
-			break;
-		case BASSMODE_FULL:
-			butter_next(m_lopass1[chan], in_buf, filt_temp, nframes);
-			butter_next(m_lopass2[chan], filt_temp, filt_low, nframes);
-			butter_next(m_hipass1[chan], in_buf, filt_temp, nframes);
-			butter_next(m_hipass2[chan], filt_temp, filt_out, nframes);
-			for (i = 0; i < nframes; i++) {
-				in_buf[i] = filt_out[i]; /* a bit inefficient to copy here, but makes code simpler below */
+
+	float *bass_buf = &m_bassBuffer[0];
+	if (m_BassManagementMode != BASSMODE_NONE) {
+		memset(bass_buf, 0, nframes * sizeof(float));
+	}
+	std::fill(m_blockPeaks.begin(), m_blockPeaks.end(), 0.0f);
+	const Float4 clip(master_gain);
+
+	for (int g = 0; g < (int) m_groups.size(); g++) {
+		float *bufs[4];
+		float gains[4];
+		for (int k = 0; k < 4; k++) {
+			chan = g * 4 + k;
+			if (chan < m_numChnls) {
+				// Yes, the input here is the output from previous runs for the io object
+				bufs[k] = io.outBuffer(chan);
+				gains[k] = master_gain * m_gains[chan];
+			} else {
+				bufs[k] = &m_padBuffer[0];
+				gains[k] = 0.0f;
 			}
-			break;
-		default:
-			break;
 		}
-		for (i = 0; i < nframes; i++) { /* accumulate SW signal */
-			*buf++ += filt_low[i];
-		}
-		for (i = 0; i < nframes; i++) {
-			*out = in_buf[i] * gain;
-			if (m_clipperOn && *out > master_gain) {
-				*out = master_gain;
-			}
-			out++;
+		const Float4 gain = Float4::load(gains);
+		ChannelGroup &grp = m_groups[g];
+		float *peaks = &m_blockPeaks[g * 4];
+
+#define PROCESS_GROUP(mode) \
+		processGroup<mode>(bufs, nframes, m_lopassCoeffs, m_hipassCoeffs, \
+			(float *) &grp.lopass1, (float *) &grp.lopass2, \
+			(float *) &grp.hipass1, (float *) &grp.hipass2, \
+			gain, clip, m_clipperOn, bass_buf, peaks)
+		switch (m_BassManagementMode) {
+		case BASSMODE_MIX:      PROCESS_GROUP(BASSMODE_MIX); break;
+		case BASSMODE_LOWPASS:  PROCESS_GROUP(BASSMODE_LOWPASS); break;
+		case BASSMODE_HIGHPASS: PROCESS_GROUP(BASSMODE_HIGHPASS); break;
+		case BASSMODE_FULL:     PROCESS_GROUP(BASSMODE_FULL); break;
+		default:                PROCESS_GROUP(BASSMODE_NONE); break;
 		}
+#undef PROCESS_GROUP
 	}
 	if (m_BassManagementMode != BASSMODE_NONE) {
 		int sw;
 		for(sw = 0; sw < 4; sw++) {
-			if (swIndex[sw] < 0) continue;
+			if (swIndex[sw] < 0 || swIndex[sw] >= m_numChnls) continue;
 			float *out = io.outBuffer(swIndex[sw]);
-			memset(out, 0, nframes * sizeof(float));
+			float peak = 0.0f;
 			for (i = 0; i < nframes; i++) {
-				*out++ = bass_buf[i];
+				out[i] = bass_buf[i];
+				if (peak < out[i]) {
+					peak = out[i];
+				}
 			}
+			m_blockPeaks[swIndex[sw]] = peak;
 		}
 	}
 	if (m_meterOn) {
 		for (chan = 0; chan < m_numChnls; chan++) {
-			float *out = io.outBuffer(chan);
-			for (i = 0; i < nframes; i++) {
-				if (m_meters[chan] < *out) {
-					m_meters[chan] = *out;
-				}
-				out++;
+			if (m_meters[chan] < m_blockPeaks[chan]) {
+				m_meters[chan] = m_blockPeaks[chan];
 			}
 		}
 		m_meterCounter += nframes;
@@ -223,7 +347,6 @@ void OutputMaster::onAudioCB(AudioIOData &io)
 			m_meterBuffer.write( (char *) m_meters.data(), sizeof(float) * m_numChnls);
 			memset(m_meters.data(), 0, sizeof(float) * m_numChnls);
 			m_meterCounter = 0; // A little jitter but efficient
-			pthread_cond_signal(&m_meterCond);
 		}
 	}
 }
@@ -314,57 +437,66 @@ void OutputMaster::initializeData()
 
 void OutputMaster::allocateChannels(int numChnls)
 {
+	int numGroups = (numChnls + 3) / 4;
 	m_gains.resize(numChnls);
 	m_meters.resize(numChnls);
-	m_lopass1.resize(numChnls);
-	m_lopass2.resize(numChnls);
-	m_hipass1.resize(numChnls);
-	m_hipass2.resize(numChnls);
+	m_blockPeaks.resize(numGroups * 4);
+	m_groups.resize(numGroups);
 	swIndex[0] = numChnls - 1;
 	swIndex[1] =  swIndex[2] = swIndex[3] = -1;
 
 	for (int i = 0; i < numChnls; i++) {
 		m_gains[i] = 1.0;
 		m_meters[i] = 0;
-		m_lopass1[i] = butter_create(m_framesPerSec, BUTTER_LP);
-		m_lopass2[i] = butter_create(m_framesPerSec, BUTTER_LP);
-		m_hipass1[i] = butter_create(m_framesPerSec, BUTTER_HP);
-		m_hipass2[i] = butter_create(m_framesPerSec, BUTTER_HP);
+	}
+	if (numGroups > 0) {
+		memset(&m_groups[0], 0, numGroups * sizeof(ChannelGroup));
+	}
+	reserveFrames(1024);
+}
+
+void OutputMaster::reserveFrames(int nframes)
+{
+	if ((int) m_bassBuffer.size() < nframes) {
+		m_bassBuffer.resize(nframes);
+		m_padBuffer.assign(nframes, 0.0f);
 	}
 }
 
 void *OutputMaster::meterThreadFunc(void *arg) {
 	int chanindex = 0;
 	OutputMaster *om = static_cast<OutputMaster *>(arg);
-	float meter_levels[om->m_numChnls];
+	std::vector<float> meter_levels(om->m_numChnls);
 
 	al::osc::Send s(om->m_sendPort, om->m_sendAddress.c_str());
 	while(om->m_runMeterThread) {
-		pthread_mutex_lock(&om->m_meterMutex);
-		pthread_cond_wait(&om->m_meterCond, &om->m_meterMutex);
-		int bytes_read = om->m_meterBuffer.read((char *) meter_levels, om->m_numChnls * sizeof(float));
-		if (bytes_read) {
-			if (bytes_read !=  om->m_numChnls * sizeof(float)) {
-				std::cerr << "Alloaudio: Warning. Meter values underrun." << std::endl;
+		int bytes_read = om->m_meterBuffer.read((char *) meter_levels.data(), om->m_numChnls * sizeof(float));
+		if (!bytes_read) {
+			// Nothing new from the audio thread; poll again within a fraction
+			// of the meter period instead of being signalled from the callback.
+			al_sec period = om->m_meterUpdateSamples / om->m_framesPerSec;
+			al_sleep(std::min(std::max(period * 0.25, 0.00025), 0.01));
+			continue;
+		}
+		if (bytes_read !=  om->m_numChnls * sizeof(float)) {
+			std::cerr << "Alloaudio: Warning. Meter values underrun." << std::endl;
+		}
+		for (int i = 0; i < bytes_read/sizeof(float); i++) {
+			if (om->m_meterAddrHasChannel) {
+				std::stringstream addr;
+				addr << om->m_addressPrefix << "/meterdb/" <<  chanindex + 1;
+				s.send(addr.str(),
+					   (float) (20.0 * log10(meter_levels[i])));
+			} else {
+				s.send(om->m_addressPrefix + "/meterdb", chanindex,
+					   (float) (20.0 * log10(meter_levels[i])));
 			}
-			for (int i = 0; i < bytes_read/sizeof(float); i++) {
-				if (om->m_meterAddrHasChannel) {
-					std::stringstream addr;
-					addr << om->m_addressPrefix << "/meterdb/" <<  chanindex + 1;
-					s.send(addr.str(),
-						   (float) (20.0 * log10(meter_levels[i])));
-				} else {
-					s.send(om->m_addressPrefix + "/meterdb", chanindex,
-						   (float) (20.0 * log10(meter_levels[i])));
-				}
 
-				chanindex++;
-				if (chanindex == om->m_numChnls) {
-					chanindex = 0;
-				}
+			chanindex++;
+			if (chanindex == om->m_numChnls) {
+				chanindex = 0;
 			}
 		}
-		pthread_mutex_unlock(&om->m_meterMutex);
 	}
 	return NULL;
 }
@@ -1,28 +1,127 @@
+#include <algorithm>
+#include <cstring>
+
 #include "alloaudio/al_SoundfileBuffered.hpp"
+#include "allocore/system/al_Time.hpp"
 
 using namespace al;
 
-SoundFileBuffered::SoundFileBuffered(std::string fullPath, bool loop, int bufferFrames) :
+SoundFileStreamEngine::SoundFileStreamEngine(int numThreads, double pollPeriod) :
     mRunning(true),
+    mPollPeriod(pollPeriod),
+    mRefills(0)
+{
+	for (int i = 0; i < numThreads; i++) {
+		mThreads.push_back(new std::thread(threadFunction, this));
+	}
+}
+
+SoundFileStreamEngine::~SoundFileStreamEngine()
+{
+	mRunning = false;
+	for (unsigned i = 0; i < mThreads.size(); i++) {
+		mThreads[i]->join();
+		delete mThreads[i];
+	}
+}
+
+SoundFileStreamEngine &SoundFileStreamEngine::global()
+{
+	static SoundFileStreamEngine engine;
+	return engine;
+}
+
+int SoundFileStreamEngine::numStreams()
+{
+	std::lock_guard<std::mutex> lk(mLock);
+	return mStreams.size();
+}
+
+void SoundFileStreamEngine::add(SoundFileBuffered *stream)
+{
+	std::lock_guard<std::mutex> lk(mLock);
+	mStreams.push_back(stream);
+}
+
+void SoundFileStreamEngine::remove(SoundFileBuffered *stream)
+{
+	{
+		std::lock_guard<std::mutex> lk(mLock);
+		mStreams.erase(std::remove(mStreams.begin(), mStreams.end(), stream), mStreams.end());
+	}
+	// Streams are only claimed while holding the lock, so once removed the
+	// stream can only be busy if a thread is still servicing it.
+	while (stream->mBusy) {
+		al_sleep(mPollPeriod * 0.5);
+	}
+}
+
+void SoundFileStreamEngine::threadFunction(SoundFileStreamEngine *engine)
+{
+	while (engine->mRunning) {
+		bool didWork = false;
+		for (unsigned i = 0; ; i++) {
+			SoundFileBuffered *stream;
+			{
+				std::lock_guard<std::mutex> lk(engine->mLock);
+				if (i >= engine->mStreams.size()) break;
+				stream = engine->mStreams[i];
+				if (stream->mBusy.exchange(true)) continue; // Another thread has it
+			}
+			if (stream->service()) {
+				engine->mRefills++;
+				didWork = true;
+			}
+			stream->mBusy = false;
+		}
+		if (!didWork) {
+			al_sleep(engine->mPollPeriod);
+		}
+	}
+}
+
+SoundFileBuffered::SoundFileBuffered(std::string fullPath, bool loop, int bufferFrames,
+                                     SoundFileStreamEngine *engine) :
     mLoop(loop),
+    mRingBuffer(0),
     mBufferFrames(bufferFrames),
-    mReadCallback(0)
+    mReadCallback(0),
+    mEngine(engine ? engine : &SoundFileStreamEngine::global()),
+    mFilePos(0),
+    mBusy(false),
+    mEndOfFile(false),
+    mCacheFrames(0),
+    mCachePos(0),
+    mSeekState(SEEK_NONE),
+    mSeekFrame(0),
+    mUnderruns(0),
+    mUnderrunFrames(0)
 {
 	mSf.path(fullPath);
 	mSf.openRead();
 	if (mSf.opened()) {
-		mRingBuffer = new SingleRWRingBuffer(mBufferFrames * channels() * sizeof(float));
-		mReaderThread = new std::thread(readFunction, this);
+		int frameBytes = channels() * sizeof(float);
+		mRingBuffer = new SingleRWRingBuffer(mBufferFrames * frameBytes);
+		mLowWatermark = (mRingBuffer->writeSpace() / 2) / frameBytes * frameBytes;
+		mReadBuffer.resize(mBufferFrames * channels());
+
+		// Preload the head of the file. The reader plays it while the first
+		// refill happens and the writer reuses it when looping.
+		mCacheFrames = std::min(mBufferFrames, mSf.frames());
+		mHeadCache.resize(mCacheFrames * channels());
+		if (mCacheFrames > 0) {
+			mCacheFrames = std::max(0, mSf.read(&mHeadCache[0], mCacheFrames));
+		}
+		mFilePos = mCacheFrames;
+		mEndOfFile = !mLoop && mFilePos >= mSf.frames();
+		mEngine->add(this);
 	}
 }
 
 SoundFileBuffered::~SoundFileBuffered()
 {
 	if (mSf.opened()) {
-		mRunning = false;
-		mCondVar.notify_one();
-		mReaderThread->join();
-		delete mReaderThread;
+		mEngine->remove(this);
 		delete mRingBuffer;
 	}
 	mSf.close();
@@ -30,12 +129,46 @@ SoundFileBuffered::~SoundFileBuffered()
 
 int SoundFileBuffered::read(float *buffer, int numFrames)
 {
-	int bytesRead = mRingBuffer->read((char *) buffer, numFrames * channels() * sizeof(float));
-	if (bytesRead != numFrames * channels() * sizeof(float)) {
-		// TODO handle underrun
+	if (!opened()) {
+		return 0;
+	}
+	const int chans = channels();
+	int state = mSeekState;
+	if (state == SEEK_STOPPED) {
+		// The writer has stopped, discard what it wrote before the seek
+		mRingBuffer->skip(mRingBuffer->readSpace());
+		mSeekState = state = SEEK_DRAINED;
+	}
+
+	int framesRead = 0;
+	if (mCachePos < mCacheFrames) {
+		framesRead = std::min(numFrames, mCacheFrames - mCachePos);
+		memcpy(buffer, &mHeadCache[mCachePos * chans], framesRead * chans * sizeof(float));
+		mCachePos += framesRead;
+	}
+	if (framesRead < numFrames && state == SEEK_NONE) {
+		int bytesRead = mRingBuffer->read((char *) (buffer + framesRead * chans),
+		                                  (numFrames - framesRead) * chans * sizeof(float));
+		framesRead += bytesRead / (chans * sizeof(float));
+		if (framesRead < numFrames && !mEndOfFile) {
+			mUnderruns++;
+			mUnderrunFrames += numFrames - framesRead;
+		}
+	}
+	return framesRead;
+}
+
+void SoundFileBuffered::seek(int frame)
+{
+	if (!opened()) {
+		return;
+	}
+	frame = std::max(0, std::min(frame, frames()));
+	mCachePos = frame < mCacheFrames ? frame : mCacheFrames;
+	mSeekFrame = frame;
+	if (mSeekState != SEEK_STOPPED) {
+		mSeekState = SEEK_REQUESTED;
 	}
-	mCondVar.notify_one();
-	return bytesRead / (channels() * sizeof(float));
 }
 
 bool SoundFileBuffered::opened() const
@@ -43,26 +176,79 @@ bool SoundFileBuffered::opened() const
 	return mSf.opened();
 }
 
-void SoundFileBuffered::readFunction(SoundFileBuffered  *obj)
+bool SoundFileBuffered::service()
 {
-	float buf[obj->mBufferFrames * obj->channels()];
-	while (obj->mRunning) {
-		std::unique_lock<std::mutex> lk(obj->mLock);
-		obj->mCondVar.wait(lk);
-		int framesToRead = obj->mRingBuffer->writeSpace() / (obj->channels() * sizeof(float));
-		int framesRead = obj->mSf.read(buf, framesToRead);
-		if (framesRead != framesToRead && obj->mLoop) {
-			obj->mSf.seek(0, SEEK_SET);
-			// FIXME: Fill rest of unfinished buffer
+	int state = mSeekState;
+	switch (state) {
+	case SEEK_REQUESTED:
+		mSeekState.compare_exchange_strong(state, SEEK_STOPPED);
+		return false;
+	case SEEK_STOPPED:
+		return false;
+	case SEEK_DRAINED:
+		// Positions inside the head cache are played by the reader from memory
+		mFilePos = std::max((int) mSeekFrame, mCacheFrames);
+		mSf.seek(mFilePos, SEEK_SET);
+		mEndOfFile = false;
+		if (!mSeekState.compare_exchange_strong(state, SEEK_NONE)) {
+			return false; // Seeked again in the meantime, start over
 		}
-		int written = obj->mRingBuffer->write((const char*) buf, framesRead * sizeof(float) * obj->channels());
-//		if (written != framesRead * sizeof(float) * obj->channels()) {
-//			// TODO handle overrun
-//		}
-		if (obj->mReadCallback) {
-			obj->mReadCallback(buf, obj->mSf.channels(), framesRead, obj->mCallbackData);
+		break;
+	default:
+		break;
+	}
+	if (mEndOfFile || mRingBuffer->readSpace() >= (size_t) mLowWatermark) {
+		return false;
+	}
+	fill();
+	return true;
+}
+
+void SoundFileBuffered::fill()
+{
+	const int chans = channels();
+	const int totalFrames = frames();
+	int framesToWrite = mRingBuffer->writeSpace() / (chans * sizeof(float));
+
+	if (totalFrames <= 0) {
+		mEndOfFile = true;
+		return;
+	}
+	while (framesToWrite > 0) {
+		int n;
+		if (mFilePos >= totalFrames) {
+			if (!mLoop) {
+				mEndOfFile = true;
+				break;
+			}
+			mFilePos = 0; // Continue from the head cache, no gap
+		}
+		if (mFilePos < mCacheFrames) {
+			n = std::min(framesToWrite, mCacheFrames - mFilePos);
+			writeFrames(&mHeadCache[mFilePos * chans], n);
+			mFilePos += n;
+			if (mFilePos == mCacheFrames) {
+				mSf.seek(mCacheFrames, SEEK_SET);
+			}
+		} else {
+			n = std::min(std::min(framesToWrite, mBufferFrames), totalFrames - mFilePos);
+			n = mSf.read(&mReadBuffer[0], n);
+			if (n <= 0) { // Read error or file shorter than reported
+				mFilePos = totalFrames;
+				continue;
+			}
+			writeFrames(&mReadBuffer[0], n);
+			mFilePos += n;
 		}
-		lk.unlock();
+		framesToWrite -= n;
+	}
+}
+
+void SoundFileBuffered::writeFrames(const float *buf, int numFrames)
+{
+	mRingBuffer->write((const char*) buf, numFrames * sizeof(float) * channels());
+	if (mReadCallback) {
+		mReadCallback(const_cast<float *>(buf), channels(), numFrames, mCallbackData);
 	}
 }
 
@@ -3,9 +3,11 @@
 #include <string>
 #include <sstream>
 #include <cassert>
+#include <cmath>
 //#include <iostream>
 
 #include "alloaudio/al_OutputMaster.hpp"
+#include "alloaudio/butter.h"
 #include "allocore/system/al_Time.hpp"
 
 
@@ -185,6 +187,68 @@ void ut_osc_gain(void)
 	}
 }
 
+void ut_bass_management(void)
+{
+	// Compare the grouped single precision filters against the double precision
+	// butter.c reference. Use a channel count that leaves an incomplete group.
+	const int nframes = 64, nchnls = 7, sw = nchnls - 1;
+	al::AudioIO io(nframes, 44100.0, NULL, NULL, nchnls, 2, al::AudioIO::DUMMY);
+	al::OutputMaster outmaster(io.channelsOut(), io.framesPerSecond(), "", -1);
+	outmaster.setClipperOn(false);
+	outmaster.setMasterGain(0.8);
+	outmaster.setBassManagementMode(al::BASSMODE_FULL);
+	outmaster.setSwIndeces(sw, -1, -1, -1);
+	for (int chan = 0; chan < nchnls; chan++) {
+		outmaster.setGain(chan, 0.5 + 0.1 * chan);
+	}
+	io.append(outmaster);
+
+	BUTTER *lp1[nchnls], *lp2[nchnls], *hp1[nchnls], *hp2[nchnls];
+	for (int chan = 0; chan < nchnls; chan++) {
+		lp1[chan] = butter_create(44100, BUTTER_LP);
+		lp2[chan] = butter_create(44100, BUTTER_LP);
+		hp1[chan] = butter_create(44100, BUTTER_HP);
+		hp2[chan] = butter_create(44100, BUTTER_HP);
+	}
+
+	for (int block = 0; block < 32; block++) {
+		double ref[nchnls][nframes];
+		double bass[nframes];
+		memset(bass, 0, sizeof(bass));
+		for (int chan = 0; chan < nchnls; chan++) {
+			double in[nframes], temp[nframes], low[nframes], high[nframes];
+			float *buf = io.outBuffer(chan);
+			for (int i = 0; i < nframes; i++) {
+				int n = block * nframes + i;
+				buf[i] = sin(0.01 * (chan + 1) * n) + 0.3 * sin(0.3 * n);
+				in[i] = buf[i];
+			}
+			butter_next(lp1[chan], in, temp, nframes);
+			butter_next(lp2[chan], temp, low, nframes);
+			butter_next(hp1[chan], in, temp, nframes);
+			butter_next(hp2[chan], temp, high, nframes);
+			for (int i = 0; i < nframes; i++) {
+				bass[i] += low[i];
+				ref[chan][i] = high[i] * 0.8 * (0.5 + 0.1 * chan);
+			}
+		}
+		memcpy(ref[sw], bass, sizeof(bass));
+		io.processAudio();
+		for (int chan = 0; chan < nchnls; chan++) {
+			float *out = io.outBuffer(chan);
+			for (int i = 0; i < nframes; i++) {
+				assert(fabs(out[i] - ref[chan][i]) < 1e-3);
+			}
+		}
+	}
+	for (int chan = 0; chan < nchnls; chan++) {
+		butter_free(lp1[chan]);
+		butter_free(lp2[chan]);
+		butter_free(hp1[chan]);
+		butter_free(hp2[chan]);
+	}
+}
+
 float meterValues[2] = {1.0f, 1.0f};
 float meterValues2[2] = {1.0f, 1.0f};
 struct OSCHandler : public al::osc::PacketHandler{
@@ -283,6 +347,7 @@ int main()
 	RUNTEST(gains);
 	RUNTEST(meter_values);
 	RUNTEST(clipper);
+	RUNTEST(bass_management);
 	RUNTEST(osc_gain);
 	RUNTEST(osc_meters);
 
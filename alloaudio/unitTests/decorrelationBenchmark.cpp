@@ -0,0 +1,101 @@
+/*
+ * Cost of decorrelating one source to 60 outputs.
+ *
+ * Times IR generation with one thread, with all hardware threads and from
+ * the IR cache, then compares per block CPU cost of the time domain
+ * Convolver followed by per output gains (decorrelate, then pan) against
+ * DecorrelationSpatializer, which shares one forward FFT between all
+ * outputs and applies the gains in the same pass.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#include "alloaudio/al_Decorrelation.hpp"
+#include "allocore/system/al_Time.hpp"
+
+static const int NUM_OUTS = 60;
+static const int IR_SIZE = 1024;
+static const int NUM_FRAMES = 256;
+static const int NUM_BLOCKS = 1000;
+
+static void fillInput(al::AudioIOData &io, int block) {
+	float *in = io.busBuffer(0);
+	for (int i = 0; i < io.framesPerBuffer(); i++) {
+		in[i] = 0.5f * sinf(0.01f * (block * io.framesPerBuffer() + i));
+	}
+}
+
+static void report(const char *name, al_sec elapsed) {
+	double perBlock = elapsed / NUM_BLOCKS;
+	double blockDuration = NUM_FRAMES / 44100.0;
+	printf("%-28s %8.2f us/block  %6.2f%% CPU\n", name,
+		   perBlock * 1e6, 100.0 * perBlock / blockDuration);
+}
+
+int main()
+{
+	al::AudioIO io(NUM_FRAMES, 44100.0, NULL, NULL, NUM_OUTS, 0, al::AudioIO::DUMMY);
+	io.channelsBus(1);
+
+	printf("Decorrelation, %d outputs, IR size %d, %d frames per block\n",
+		   NUM_OUTS, IR_SIZE, NUM_FRAMES);
+
+	al::Decorrelation::clearCache();
+	al::Decorrelation single(IR_SIZE, 0, NUM_OUTS, true);
+	single.setNumThreads(1);
+	al_sec t0 = al_steady_time();
+	single.configure(io, 1000);
+	printf("%-28s %8.2f ms\n", "configure, 1 thread", (al_steady_time() - t0) * 1e3);
+
+	al::Decorrelation::clearCache();
+	al::Decorrelation dec(IR_SIZE, 0, NUM_OUTS, true);
+	t0 = al_steady_time();
+	dec.configure(io, 1000);
+	printf("%-28s %8.2f ms\n", "configure, all threads", (al_steady_time() - t0) * 1e3);
+
+	al::Decorrelation cached(IR_SIZE, 0, NUM_OUTS, true);
+	t0 = al_steady_time();
+	cached.configure(io, 1000);
+	printf("%-28s %8.2f ms\n", "configure, cached IRs", (al_steady_time() - t0) * 1e3);
+
+	std::vector<float> gains(NUM_OUTS);
+	std::vector<const float *> irs;
+	for (int i = 0; i < NUM_OUTS; i++) {
+		gains[i] = 0.5f + 0.5f * cosf(i * 0.3f);
+		irs.push_back(dec.getIR(i));
+	}
+
+	al_sec elapsed = 0;
+	for (int block = 0; block < NUM_BLOCKS; block++) {
+		fillInput(io, block);
+		t0 = al_steady_time();
+		dec.onAudioCB(io);
+		for (int chan = 0; chan < NUM_OUTS; chan++) {
+			float *out = io.outBuffer(chan);
+			for (int i = 0; i < NUM_FRAMES; i++) {
+				out[i] *= gains[chan];
+			}
+		}
+		elapsed += al_steady_time() - t0;
+	}
+	report("Convolver + gains", elapsed);
+
+	al::DecorrelationSpatializer spat;
+	spat.configure(NUM_FRAMES, irs, IR_SIZE, 0, true);
+	for (int i = 0; i < NUM_OUTS; i++) {
+		spat.setGain(i, gains[i]);
+	}
+	elapsed = 0;
+	for (int block = 0; block < NUM_BLOCKS; block++) {
+		fillInput(io, block);
+		t0 = al_steady_time();
+		spat.onAudioCB(io);
+		elapsed += al_steady_time() - t0;
+	}
+	report("DecorrelationSpatializer", elapsed);
+
+	return 0;
+}
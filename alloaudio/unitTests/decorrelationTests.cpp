@@ -6,6 +6,8 @@
 #include <cassert>
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
+#include <vector>
 
 #include "alloaudio/al_Decorrelation.hpp"
 #include "allocore/system/al_Time.hpp"
@@ -21,7 +23,7 @@ void ut_class_test(void)
 	assert(dec.getCurrentSeed() == 1000);
 	assert(dec.getSize() == 32);
 
-	float *ir = dec.getIR(0);
+	const float *ir = dec.getIR(0);
 	double expected[] = {0.65027274, -0.16738815,  0.1617437 ,  0.18901241,  0.01768662,
 						 -0.0802799 , -0.12612745,  0.09564361,  0.00803435,  0.07643685,
 						 -0.030273  ,  0.26991193, -0.03412993, -0.05709789,  0.05474607,
@@ -177,7 +179,7 @@ void ut_max_jump_test(void)
 	al::Decorrelation dec(1024, 1, 1, false);
 	for (int i = 0 ; i < 10; i++) {
 		dec.configure(io, -1, 0.1);
-		float *ir = dec.getIR(0);
+		const float *ir = dec.getIR(0);
 		float data[1026];
 		memcpy(data + 1, ir, 1024*sizeof(float));
 
@@ -207,7 +209,120 @@ void ut_deterministic_test(void)
 	al::Decorrelation dec(32, 0, 8, false);
 	dec.configureDeterministic(io, 1000, 30, 10, 1.0);
 
-	float *ir = dec.getIR(0);
+	const float *ir = dec.getIR(0);
+}
+
+void ut_threads_test(void)
+{
+	// IRs must not depend on how many threads generate them
+	al::AudioIO io(64, 44100, 0, 0, 2, 2, al::AudioIO::DUMMY); // Dummy Audio Backend
+	al::Decorrelation::clearCache();
+	al::Decorrelation dec1(1024, 0, 24, false);
+	dec1.setNumThreads(1);
+	dec1.configure(io, 2000, 0.2);
+	al::Decorrelation::clearCache();
+	al::Decorrelation dec4(1024, 0, 24, false);
+	dec4.setNumThreads(4);
+	dec4.configure(io, 2000, 0.2);
+	for (int i = 0; i < 24; i++) {
+		assert(dec1.getIR(i) != dec4.getIR(i));
+		assert(memcmp(dec1.getIR(i), dec4.getIR(i), 1024 * sizeof(float)) == 0);
+	}
+	assert(dec4.getIR(24) == NULL);
+
+	al::Decorrelation::clearCache();
+	al::Decorrelation det1(512, 0, 8, false);
+	det1.setNumThreads(1);
+	det1.configureDeterministic(io, 1000, 30, 10, 1.0);
+	al::Decorrelation::clearCache();
+	al::Decorrelation det3(512, 0, 8, false);
+	det3.setNumThreads(3);
+	det3.configureDeterministic(io, 1000, 30, 10, 1.0);
+	for (int i = 0; i < 8; i++) {
+		assert(memcmp(det1.getIR(i), det3.getIR(i), 512 * sizeof(float)) == 0);
+	}
+}
+
+void ut_cache_test(void)
+{
+	al::AudioIO io(64, 44100, 0, 0, 2, 2, al::AudioIO::DUMMY); // Dummy Audio Backend
+	al::Decorrelation::clearCache();
+	al::Decorrelation dec(256, 0, 4, false);
+	dec.configure(io, 3000);
+	// Same parameters share the cached IRs
+	al::Decorrelation same(256, 0, 4, false);
+	same.configure(io, 3000);
+	assert(same.getIR(0) == dec.getIR(0));
+	// Different parameters don't
+	al::Decorrelation other(256, 0, 4, false);
+	other.configure(io, 3000, 0.5);
+	assert(other.getIR(0) != dec.getIR(0));
+	al::Decorrelation otherSeed(256, 0, 4, false);
+	otherSeed.configure(io, 3001);
+	assert(otherSeed.getIR(0) != dec.getIR(0));
+
+	// Cached IRs stay valid after the cache is cleared
+	std::vector<float> copy(dec.getIR(3), dec.getIR(3) + 256);
+	al::Decorrelation::clearCache();
+	al::Decorrelation regen(256, 0, 4, false);
+	regen.configure(io, 3000);
+	assert(regen.getIR(3) != dec.getIR(3));
+	assert(memcmp(regen.getIR(3), &copy[0], 256 * sizeof(float)) == 0);
+	assert(memcmp(dec.getIR(3), &copy[0], 256 * sizeof(float)) == 0);
+}
+
+void ut_spatializer_test(void)
+{
+	// Partitioned processing against direct convolution
+	const int blockSize = 64, irLen = 200, numOuts = 3, numBlocks = 8;
+	srand(5);
+	std::vector<std::vector<float> > irs(numOuts, std::vector<float>(irLen));
+	std::vector<const float *> irPtrs;
+	for (int o = 0; o < numOuts; o++) {
+		for (int i = 0; i < irLen; i++) {
+			irs[o][i] = rand() / (float) RAND_MAX - 0.5f;
+		}
+		irPtrs.push_back(&irs[o][0]);
+	}
+	std::vector<float> input(blockSize * numBlocks);
+	for (unsigned i = 0; i < input.size(); i++) {
+		input[i] = rand() / (float) RAND_MAX - 0.5f;
+	}
+
+	al::DecorrelationSpatializer spat;
+	spat.configure(blockSize, irPtrs, irLen);
+	assert(spat.numOutputs() == numOuts);
+	std::vector<std::vector<float> > out(numOuts, std::vector<float>(blockSize));
+	float *outPtrs[numOuts];
+	for (int o = 0; o < numOuts; o++) {
+		outPtrs[o] = &out[o][0];
+	}
+	for (int b = 0; b < numBlocks; b++) {
+		if (b == 4) {
+			spat.setGain(1, 0.5f);
+			spat.setGain(2, 0.0f);
+		}
+		spat.process(&input[b * blockSize], outPtrs);
+		for (int o = 0; o < numOuts; o++) {
+			for (int i = 0; i < blockSize; i++) {
+				int n = b * blockSize + i;
+				double expected = 0;
+				for (int k = 0; k < irLen && k <= n; k++) {
+					expected += irs[o][k] * input[n - k];
+				}
+				float gain = 1.0f;
+				if (b == 4 && o > 0) { // Ramp over one block
+					float target = o == 1 ? 0.5f : 0.0f;
+					gain = 1.0f + (target - 1.0f) * (i + 1) / blockSize;
+				} else if (b > 4 && o == 1) {
+					gain = 0.5f;
+				} else if (b > 4 && o == 2) {
+					gain = 0.0f;
+				}
+				assert(fabs(out[o][i] - expected * gain) < 0.0001);
+			}
+		}
+	}
 }
 
 #define RUNTEST(Name)\
@@ -223,6 +338,9 @@ int main()
 	RUNTEST(parallel_test);
 	RUNTEST(max_jump_test);
 	RUNTEST(deterministic_test);
+	RUNTEST(threads_test);
+	RUNTEST(cache_test);
+	RUNTEST(spatializer_test);
 
 	return 0;
 }
@@ -0,0 +1,127 @@
+/*
+ * Per-channel CPU cost of OutputMaster processing.
+ *
+ * Runs the OutputMaster chain (gains, full bass management, clipper and
+ * meters) on 64 channels and compares it with the previous implementation,
+ * which converted every channel to double and ran the butter.c filters one
+ * channel at a time.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#include "alloaudio/al_OutputMaster.hpp"
+#include "alloaudio/butter.h"
+#include "allocore/system/al_Time.hpp"
+
+static const int NUM_CHNLS = 64;
+static const int NUM_FRAMES = 256;
+static const int NUM_BLOCKS = 2000;
+
+// Reference: per channel double precision processing as done before grouping
+struct LegacyOutputMaster {
+	std::vector<BUTTER *> lp1, lp2, hp1, hp2;
+	std::vector<double> gains;
+	std::vector<float> meters;
+	std::vector<double> bass, inbuf, temp, low, high;
+
+	LegacyOutputMaster(int nchnls, int nframes, double sr)
+	:	lp1(nchnls), lp2(nchnls), hp1(nchnls), hp2(nchnls),
+		gains(nchnls, 1.0), meters(nchnls, 0.0f),
+		bass(nframes), inbuf(nframes), temp(nframes), low(nframes), high(nframes)
+	{
+		for (int i = 0; i < nchnls; i++) {
+			lp1[i] = butter_create(sr, BUTTER_LP);
+			lp2[i] = butter_create(sr, BUTTER_LP);
+			hp1[i] = butter_create(sr, BUTTER_HP);
+			hp2[i] = butter_create(sr, BUTTER_HP);
+		}
+	}
+
+	~LegacyOutputMaster() {
+		for (unsigned i = 0; i < lp1.size(); i++) {
+			butter_free(lp1[i]); butter_free(lp2[i]);
+			butter_free(hp1[i]); butter_free(hp2[i]);
+		}
+	}
+
+	void process(al::AudioIOData &io, double masterGain) {
+		int nframes = io.framesPerBuffer();
+		int nchnls = lp1.size();
+		memset(&bass[0], 0, nframes * sizeof(double));
+		for (int chan = 0; chan < nchnls; chan++) {
+			float *out = io.outBuffer(chan);
+			double gain = masterGain * gains[chan];
+			for (int i = 0; i < nframes; i++) inbuf[i] = out[i];
+			butter_next(lp1[chan], &inbuf[0], &temp[0], nframes);
+			butter_next(lp2[chan], &temp[0], &low[0], nframes);
+			butter_next(hp1[chan], &inbuf[0], &temp[0], nframes);
+			butter_next(hp2[chan], &temp[0], &high[0], nframes);
+			for (int i = 0; i < nframes; i++) {
+				bass[i] += low[i];
+				out[i] = high[i] * gain;
+				if (out[i] > masterGain) out[i] = masterGain;
+			}
+		}
+		float *sw = io.outBuffer(nchnls - 1);
+		for (int i = 0; i < nframes; i++) sw[i] = bass[i];
+		for (int chan = 0; chan < nchnls; chan++) {
+			float *out = io.outBuffer(chan);
+			for (int i = 0; i < nframes; i++) {
+				if (meters[chan] < out[i]) meters[chan] = out[i];
+			}
+		}
+	}
+};
+
+static void fillInput(al::AudioIOData &io, int block) {
+	for (int chan = 0; chan < io.channelsOut(); chan++) {
+		float *out = io.outBuffer(chan);
+		for (int i = 0; i < io.framesPerBuffer(); i++) {
+			out[i] = 0.5f * sinf(0.001f * (chan + 1) * (block * io.framesPerBuffer() + i));
+		}
+	}
+}
+
+static void report(const char *name, al_sec elapsed) {
+	double perChannelBlock = elapsed / (double(NUM_BLOCKS) * NUM_CHNLS);
+	double blockDuration = NUM_FRAMES / 44100.0;
+	printf("%-22s %8.3f us/channel/block  %6.3f%% CPU/channel\n", name,
+		   perChannelBlock * 1e6, 100.0 * perChannelBlock / blockDuration);
+}
+
+int main()
+{
+	al::AudioIO io(NUM_FRAMES, 44100.0, NULL, NULL, NUM_CHNLS, 0, al::AudioIO::DUMMY);
+
+	al::OutputMaster outmaster(NUM_CHNLS, 44100.0, "", -1);
+	outmaster.setMasterGain(1.0);
+	outmaster.setBassManagementMode(al::BASSMODE_FULL);
+	outmaster.setMeterOn(true);
+
+	LegacyOutputMaster legacy(NUM_CHNLS, NUM_FRAMES, 44100.0);
+
+	printf("OutputMaster, %d channels, %d frames per block\n", NUM_CHNLS, NUM_FRAMES);
+
+	al_sec elapsed = 0;
+	for (int block = 0; block < NUM_BLOCKS; block++) {
+		fillInput(io, block);
+		al_sec t0 = al_steady_time();
+		legacy.process(io, 1.0);
+		elapsed += al_steady_time() - t0;
+	}
+	report("per channel (double)", elapsed);
+
+	elapsed = 0;
+	for (int block = 0; block < NUM_BLOCKS; block++) {
+		fillInput(io, block);
+		al_sec t0 = al_steady_time();
+		outmaster.onAudioCB(io);
+		elapsed += al_steady_time() - t0;
+	}
+	report("grouped (float x4)", elapsed);
+
+	return 0;
+}
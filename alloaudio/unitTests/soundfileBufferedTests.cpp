@@ -0,0 +1,178 @@
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cassert>
+#include <cstring>
+
+#include "alloaudio/al_SoundfileBuffered.hpp"
+#include "allocore/system/al_Time.hpp"
+
+// Write a file where every sample holds its frame index plus channel/10
+static std::string writeRampFile(std::string name, int frames, int channels)
+{
+	std::vector<float> data(frames * channels);
+	for (int i = 0; i < frames; i++) {
+		for (int c = 0; c < channels; c++) {
+			data[i * channels + c] = i + c/10.0f;
+		}
+	}
+	gam::SoundFile sf(name);
+	sf.format(gam::SoundFile::WAV);
+	sf.encoding(gam::SoundFile::FLOAT);
+	sf.channels(channels);
+	sf.frameRate(44100);
+	sf.openWrite();
+	sf.write(data.data(), frames);
+	sf.close();
+	return name;
+}
+
+// Read numFrames, waiting for the I/O threads if the ring buffer runs dry.
+static void readBlocking(al::SoundFileBuffered &sfb, float *buf, int numFrames)
+{
+	int done = 0;
+	for (int tries = 0; done < numFrames && tries < 1000; tries++) {
+		done += sfb.read(buf + done * sfb.channels(), numFrames - done);
+		if (done < numFrames) {
+			al_sleep(0.001);
+		}
+	}
+	assert(done == numFrames);
+}
+
+void ut_head_cache(void)
+{
+	std::string name = writeRampFile("sfb_head.wav", 10000, 2);
+	al::SoundFileBuffered sfb(name, false, 2048);
+	assert(sfb.opened());
+	assert(sfb.channels() == 2);
+	assert(sfb.frames() == 10000);
+
+	// The head of the file is available immediately
+	float buf[512 * 2];
+	assert(sfb.read(buf, 512) == 512);
+	for (int i = 0; i < 512; i++) {
+		assert(buf[i * 2] == i);
+		assert(buf[i * 2 + 1] == i + 0.1f);
+	}
+	std::vector<float> rest((10000 - 512) * 2);
+	readBlocking(sfb, rest.data(), 10000 - 512);
+	for (int i = 0; i < 10000 - 512; i++) {
+		assert(rest[i * 2] == i + 512);
+	}
+	// End of file is not an underrun
+	unsigned underruns = sfb.underruns();
+	assert(sfb.read(buf, 512) == 0);
+	assert(sfb.underruns() == underruns);
+	remove(name.c_str());
+}
+
+void ut_seamless_loop(void)
+{
+	const int frames = 3001;
+	std::string name = writeRampFile("sfb_loop.wav", frames, 1);
+	al::SoundFileBuffered sfb(name, true, 1024);
+	float buf[64];
+	int expected = 0;
+	for (int block = 0; block < 200; block++) {
+		readBlocking(sfb, buf, 64);
+		for (int i = 0; i < 64; i++) {
+			assert(buf[i] == expected);
+			expected = (expected + 1) % frames;
+		}
+	}
+	remove(name.c_str());
+}
+
+void ut_seek(void)
+{
+	std::string name = writeRampFile("sfb_seek.wav", 20000, 1);
+	al::SoundFileBuffered sfb(name, false, 1024);
+	float buf[64];
+	readBlocking(sfb, buf, 64);
+
+	// Inside the head cache: served right away
+	sfb.seek(100);
+	assert(sfb.read(buf, 64) == 64);
+	assert(buf[0] == 100 && buf[63] == 163);
+	// Continue past the end of the cache
+	std::vector<float> more(2000);
+	readBlocking(sfb, more.data(), 2000);
+	for (int i = 0; i < 2000; i++) {
+		assert(more[i] == 164 + i);
+	}
+
+	// Outside the cache: data arrives once the I/O thread has repositioned
+	sfb.seek(15000);
+	readBlocking(sfb, buf, 64);
+	assert(buf[0] == 15000 && buf[63] == 15063);
+
+	// Seek twice before the I/O thread gets to it
+	sfb.seek(5000);
+	sfb.seek(7000);
+	readBlocking(sfb, buf, 64);
+	assert(buf[0] == 7000);
+	remove(name.c_str());
+}
+
+// Timing dependent and writes ~270 MB of audio, only run with --stress
+void ut_stress(void)
+{
+	// Stream 256 stereo files at real time rate from the shared engine
+	const int numFiles = 256, frames = 44100 * 3, blockSize = 512;
+	std::vector<std::string> names;
+	std::vector<al::SoundFileBuffered *> streams;
+	for (int i = 0; i < numFiles; i++) {
+		std::stringstream name;
+		name << "sfb_stress_" << i << ".wav";
+		names.push_back(writeRampFile(name.str(), frames, 2));
+	}
+	for (int i = 0; i < numFiles; i++) {
+		streams.push_back(new al::SoundFileBuffered(names[i], true, 8192));
+		assert(streams.back()->opened());
+	}
+	assert(al::SoundFileStreamEngine::global().numStreams() == numFiles);
+
+	std::vector<float> buf(blockSize * 2);
+	al_sec blockTime = blockSize / 44100.0;
+	al_sec start = al_steady_time();
+	for (int block = 0; block < 150; block++) {
+		for (int i = 0; i < numFiles; i++) {
+			streams[i]->read(buf.data(), blockSize);
+		}
+		al_sec wait = start + (block + 1) * blockTime - al_steady_time();
+		if (wait > 0) {
+			al_sleep(wait);
+		}
+	}
+	unsigned underruns = 0;
+	for (int i = 0; i < numFiles; i++) {
+		underruns += streams[i]->underruns();
+		delete streams[i];
+		remove(names[i].c_str());
+	}
+	assert(underruns == 0);
+	assert(al::SoundFileStreamEngine::global().numStreams() == 0);
+}
+
+
+#define RUNTEST(Name)\
+	printf("%s ", #Name);\
+	ut_##Name();\
+	for(size_t i=0; i<32-strlen(#Name); ++i) printf(".");\
+	printf(" pass\n")
+
+int main(int argc, char *argv[])
+{
+	RUNTEST(head_cache);
+	RUNTEST(seamless_loop);
+	RUNTEST(seek);
+	if (argc > 1 && strcmp(argv[1], "--stress") == 0) {
+		RUNTEST(stress);
+	}
+
+	return 0;
+}
@@ -55,6 +55,7 @@
 #include "allocore/graphics/al_Texture.hpp"
 #include "allocore/io/al_App.hpp"
 #include "allocore/io/al_AudioIO.hpp"
+#include "allocore/io/al_AudioProfiler.hpp"
 #include "allocore/io/al_ControlNav.hpp"
 #include "allocore/io/al_File.hpp"
 #include "allocore/io/al_Socket.hpp"
@@ -69,13 +70,16 @@
 #include "allocore/math/al_Mat.hpp"
 #include "allocore/math/al_Plane.hpp"
 #include "allocore/math/al_Quat.hpp"
+#include "allocore/math/al_QuatArray.hpp"
 #include "allocore/math/al_Random.hpp"
 #include "allocore/math/al_Ray.hpp"
 #include "allocore/math/al_Spherical.hpp"
 #include "allocore/math/al_Vec.hpp"
 #include "allocore/protocol/al_OSC.hpp"
 #include "allocore/protocol/al_Serialize.hpp"
+#include "allocore/protocol/al_StateReplication.hpp"
 #include "allocore/sound/al_Reverb.hpp"
+#include "allocore/sound/al_FDNReverb.hpp"
 #include "allocore/sound/al_Speaker.hpp"
 #include "allocore/sound/al_AudioScene.hpp"
 #include "allocore/sound/al_Ambisonics.hpp"
@@ -88,9 +92,12 @@
 #include "allocore/system/al_Info.hpp"
 #include "allocore/system/al_MainLoop.hpp"
 #include "allocore/system/al_Printing.hpp"
+#include "allocore/system/al_RTAllocator.hpp"
 #include "allocore/system/al_Thread.hpp"
+#include "allocore/system/al_ThreadPool.hpp"
 #include "allocore/system/al_Time.hpp"
 #include "allocore/types/al_Buffer.hpp"
 #include "allocore/types/al_Conversion.hpp"
 #include "allocore/types/al_Array.hpp"
+#include "allocore/types/al_ColorArray.hpp"
 #include "allocore/types/al_SingleRWRingBuffer.hpp"
@@ -137,8 +137,23 @@ public:
 
 
 	/// Import an asset
+
+	/// If caching is enabled (see cache()), the converted scene is loaded
+	/// from a binary cache file next to the asset when the cache matches the
+	/// contents of the asset, its material libraries and textures and the
+	/// import preset. Otherwise, the asset is imported, its meshes converted
+	/// in parallel and the cache rewritten.
 	static Scene * import(const std::string& path, ImportPreset preset = MAX_QUALITY);
 
+	/// Set whether import() uses a binary cache of converted scenes
+	static void cache(bool enable);
+
+	/// Get path of the binary cache file of an asset
+	static std::string cachePath(const std::string& path);
+
+	/// Whether the scene was loaded from the binary cache
+	bool cached() const;
+
 
 	/// Return number of meshes in scene
 	unsigned int meshes() const;
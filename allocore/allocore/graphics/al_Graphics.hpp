@@ -224,8 +224,15 @@ public:
 
 
 	Graphics();
+
+	/// Copy state; the copy has its own, initially empty, mesh cache
+	Graphics(const Graphics& cpy);
+
 	virtual ~Graphics();
 
+	/// Copy state; the mesh cache is kept
+	Graphics& operator= (const Graphics& cpy);
+
 
 	/// Get the temporary mesh
 	Mesh& mesh(){ return mMesh; }
@@ -507,12 +514,39 @@ public:
 	/// @param[in] m		Vertex data to draw
 	/// @param[in] count	Number of vertices or indices to draw
 	/// @param[in] begin	Begin index of vertices or indices to draw (inclusive)
+	///
+	/// If the mesh is retained (see Mesh::retained), it is drawn from GPU
+	/// buffers that are only updated when its attributes change.
 	void draw(const Mesh& m, int count=-1, int begin=0);
 
 	/// Draw internal vertex data
 	void draw(){ draw(mMesh); }
 
 
+	/// Statistics of retained mesh drawing
+	struct MeshCacheStats{
+		unsigned meshes;		///< Meshes currently with GPU buffers
+		uint64_t draws;			///< Draws of retained meshes
+		uint64_t uploads;		///< Attribute buffer uploads
+		uint64_t bytesUploaded;	///< Bytes uploaded to attribute buffers
+	};
+
+	/// Get statistics of retained mesh drawing
+	const MeshCacheStats& meshCacheStats() const;
+
+	/// Set maximum number of retained meshes with GPU buffers
+
+	/// When exceeded, the buffers of the least recently drawn mesh are released.
+	/// Buffers of destroyed meshes are released on the next retained draw.
+	Graphics& meshCacheSize(unsigned n);
+
+	/// Release GPU buffers of a retained mesh
+	void releaseMesh(const Mesh& m);
+
+	/// Release GPU buffers of all retained meshes
+	void releaseMeshes();
+
+
 	// Utility functions: converting, reporting, etc.
 
 	/// Print current GPU error state
@@ -548,9 +582,12 @@ public:
 	void draw(int numVertices, const Mesh& v);
 
 protected:
+	class MeshCache;
+
 	Mesh mMesh;				// used for immediate mode style rendering
 	int mRescaleNormal;
 	bool mInImmediateMode;	// flag for whether or not in immediate mode
+	MeshCache * mMeshCache;	// GPU buffers of retained meshes
 
 	virtual void onCreate(); // GPUObject
 	virtual void onDestroy(); // GPUObject
@@ -79,12 +79,26 @@ public:
 	typedef Buffer<TexCoord3>	TexCoord3s;
 	typedef Buffer<Index>		Indices;
 
+	/// Vertex attributes, as flags
+	enum Attribute{
+		VERTICES		= 1<<0,
+		NORMALS			= 1<<1,
+		COLORS			= 1<<2,	/**< Both float and integer colors */
+		TEXCOORDS		= 1<<3,	/**< All texture coordinate dimensions */
+		INDICES			= 1<<4,
+		ALL_ATTRIBUTES	= (1<<5)-1
+	};
+
 
 	/// @param[in] primitive	renderer-dependent primitive number
 	Mesh(int primitive=0);
 
 	Mesh(const Mesh& cpy);
 
+	~Mesh();
+
+	Mesh& operator= (const Mesh& cpy);
+
 
 	/// Get corners of bounding box of vertices
 
@@ -193,6 +207,36 @@ public:
 	void ribbonize(float * widths, int widthsStride=1, bool faceBinormal=false);
 
 
+	/// Set whether the mesh is drawn from buffers kept on the GPU
+
+	/// A retained mesh is uploaded once by Graphics::draw() and afterwards
+	/// only attributes that changed are uploaded again. The editing members
+	/// of the mesh (e.g., vertex(), color(), translate() or reset()) flag
+	/// the attributes they change. Changes made directly to the buffers,
+	/// e.g. through vertices()[i], must be flagged with changed(). The GPU
+	/// buffers are released on the next retained draw after the mesh is
+	/// destroyed.
+	Mesh& retained(bool v){ mRetained=v; return *this; }
+
+	/// Get whether the mesh is drawn from buffers kept on the GPU
+	bool retained() const { return mRetained; }
+
+	/// Flag attributes as changed
+
+	/// @param[in] attributes	bitwise-or of Attribute flags
+	///
+	Mesh& changed(int attributes = ALL_ATTRIBUTES);
+
+	/// Get change count of an attribute
+
+	/// This differs from an earlier value if the attribute was edited by a
+	/// member of the mesh or flagged with changed() since then.
+	unsigned generation(Attribute attribute) const;
+
+	/// Get identifier unique to this mesh (copies get a new identifier)
+	unsigned id() const { return mID; }
+
+
 	int primitive() const { return mPrimitive; }
 	const Buffer<Vertex>& vertices() const { return mVertices; }
 	const Buffer<Normal>& normals() const { return mNormals; }
@@ -211,7 +255,7 @@ public:
 	Mesh& repeatLast();
 
 	/// Append index to index buffer
-	void index(unsigned int i){ indices().append(i); }
+	void index(unsigned int i){ indices().append(i); ++mGenerations[4]; }
 
 	/// Append indices to index buffer
 	template <class Tindex>
@@ -220,16 +264,16 @@ public:
 
 
 	/// Append color to color buffer
-	void color(const Color& v) { colors().append(v); }
+	void color(const Color& v) { colors().append(v); ++mGenerations[2]; }
 
 	/// Append color to color buffer
-	void color(const Colori& v) { coloris().append(v); }
+	void color(const Colori& v) { coloris().append(v); ++mGenerations[2]; }
 
 	/// Append color to color buffer
-	void color(const HSV& v) { colors().append(v); }
+	void color(const HSV& v) { colors().append(v); ++mGenerations[2]; }
 
 	/// Append color to color buffer
-	void color(const RGB& v) { colors().append(v); }
+	void color(const RGB& v) { colors().append(v); ++mGenerations[2]; }
 
 	/// Append color to color buffer
 	void color(float r, float g, float b, float a=1){ color(Color(r,g,b,a)); }
@@ -239,14 +283,14 @@ public:
 	void color(const Vec<4,T>& v) { color(v[0], v[1], v[2], v[3]); }
 
 	/// Append floating-point color to integer color buffer
-	void colori(const Color& v) { coloris().append(Colori(v)); }
+	void colori(const Color& v) { coloris().append(Colori(v)); ++mGenerations[2]; }
 
 
 	/// Append normal to normal buffer
 	void normal(float x, float y, float z=0){ normal(Normal(x,y,z)); }
 
 	/// Append normal to normal buffer
-	void normal(const Normal& v) { normals().append(v); }
+	void normal(const Normal& v) { normals().append(v); ++mGenerations[1]; }
 
 	/// Append normal to normal buffer
 	template <class T>
@@ -254,17 +298,17 @@ public:
 
 
 	/// Append texture coordinate to 1D texture coordinate buffer
-	void texCoord(float u){ texCoord1s().append(TexCoord1(u)); }
+	void texCoord(float u){ texCoord1s().append(TexCoord1(u)); ++mGenerations[3]; }
 
 	/// Append texture coordinate to 2D texture coordinate buffer
-	void texCoord(float u, float v){ texCoord2s().append(TexCoord2(u,v)); }
+	void texCoord(float u, float v){ texCoord2s().append(TexCoord2(u,v)); ++mGenerations[3]; }
 
 	/// Append texture coordinate to 2D texture coordinate buffer
 	template <class T>
 	void texCoord(const Vec<2,T>& v){ texCoord(v[0], v[1]); }
 
 	/// Append texture coordinate to 3D texture coordinate buffer
-	void texCoord(float u, float v, float w){ texCoord3s().append(TexCoord3(u,v,w)); }
+	void texCoord(float u, float v, float w){ texCoord3s().append(TexCoord3(u,v,w)); ++mGenerations[3]; }
 
 	/// Append texture coordinate to 3D texture coordinate buffer
 	template <class T>
@@ -275,7 +319,7 @@ public:
 	void vertex(float x, float y, float z=0){ vertex(Vertex(x,y,z)); }
 
 	/// Append vertex to vertex buffer
-	void vertex(const Vertex& v){ vertices().append(v); }
+	void vertex(const Vertex& v){ vertices().append(v); ++mGenerations[0]; }
 
 	/// Append vertex to vertex buffer
 	template <class T>
@@ -333,6 +377,19 @@ protected:
 	Indices mIndices;
 
 	int mPrimitive;
+	unsigned mID;
+	unsigned mGenerations[5];	// change counts of each Attribute, by bit
+	bool mRetained;
+	mutable bool mRegistered;	// whether GPU buffers may exist
+
+	void initID();
+
+	// Registry of retained meshes that may have GPU buffers, so that the
+	// buffers can be released after the mesh is destroyed
+	friend class Graphics;
+	void registerRetained() const;
+	static bool alive(unsigned id);
+	static unsigned deaths();
 };
 
 
@@ -340,6 +397,7 @@ protected:
 
 template <class T>
 Mesh& Mesh::transform(const Mat<4,T>& m, int begin, int end){
+	changed(VERTICES);
 	if(end<0) end += vertices().size()+1; // negative index wraps to end of array
 	for(int i=begin; i<end; ++i){
 		Vertex& v = vertices()[i];
@@ -49,9 +49,11 @@
 #include "allocore/types/al_Color.hpp"
 #include "allocore/graphics/al_Graphics.hpp"
 #include "allocore/graphics/al_GPUObject.hpp"
+#include "allocore/graphics/al_TextureUpload.hpp"
 
 namespace al{
 
+class PBO;
 
 /// A simple wrapper around an OpenGL Texture
 /// @ingroup allocore
@@ -279,6 +281,36 @@ public:
 	///internal array
 	Texture& dirty(){ mPixelsUpdated=true; return *this; }
 
+	/// Flags resubmission of a region of 1D pixel data upon next bind
+
+	/// Only the changed regions of the internal array are sent. Regions
+	/// flagged before the next bind are merged as needed.
+	Texture& dirty(unsigned x, unsigned w){
+		return dirty(x,0,0, w,1,1); }
+
+	/// Flags resubmission of a region of 2D pixel data upon next bind
+	Texture& dirty(unsigned x, unsigned y, unsigned w, unsigned h){
+		return dirty(x,y,0, w,h,1); }
+
+	/// Flags resubmission of a region of 3D pixel data upon next bind
+	Texture& dirty(unsigned x, unsigned y, unsigned z, unsigned w, unsigned h, unsigned d);
+
+	/// Get regions of pixel data to be submitted upon next bind
+	const TextureUpload& upload(){ syncUpload(); return mUpload; }
+
+	/// Set whether to submit pixel data through staging buffers
+
+	/// Changed pixels are copied into one of two pixel buffer objects, which
+	/// are used in turn, and sent from there. The copy returns as soon as it
+	/// is made, so the internal array can be changed for the next frame
+	/// while the transfer to the texture proceeds. This requires OpenGL (not
+	/// OpenGL ES). The buffers belong to the texture; a copy of a staged
+	/// texture is not staged.
+	Texture& staged(bool v);
+
+	/// Whether pixel data is submitted through staging buffers
+	bool staged() const { return mStaging.pbo[0] != NULL; }
+
 	/// Submit the texture to GPU using an Array as source
 
 	/// NOTE: the graphics context (e.g. Window) must have been created.
@@ -348,6 +380,16 @@ protected:
 	bool mPixelsUpdated;		// Flags change in pixel data
 	bool mShapeUpdated;			// Flags change in size, format, type, etc.
 	bool mArrayDirty;
+	TextureUpload mUpload;		// Changed regions of pixel data
+
+	// Staging buffers, if used. They are not shared with copies, so copying
+	// starts without them and assigning keeps the target's own.
+	struct Staging{
+		PBO * pbo[2];
+		Staging(){ pbo[0] = pbo[1] = NULL; }
+		Staging(const Staging&){ pbo[0] = pbo[1] = NULL; }
+		Staging& operator= (const Staging&){ return *this; }
+	} mStaging;
 
 	virtual void onCreate();
 	virtual void onDestroy();
@@ -362,6 +404,13 @@ protected:
 	void sendPixels(bool force=true);
 	void sendPixels(const void * pixels, unsigned align);
 
+	// send pending regions of internal array to GPU
+	void sendRegions();
+	void sendRegion(const TextureUpload::Region& r, const void * pixels);
+
+	// match shape of upload to texture and add any flagged full update
+	void syncUpload();
+
 	// send any pending shape updates to GPU or do immediately if forced
 	void sendShape(bool force=true);
 
@@ -0,0 +1,157 @@
+#ifndef INCLUDE_AL_GRAPHICS_TEXTURE_UPLOAD_HPP
+#define INCLUDE_AL_GRAPHICS_TEXTURE_UPLOAD_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+
+	File description:
+	Tracking of changed texture regions and packing of their pixels for upload
+
+	This holds the client side of partial texture uploads. It makes no
+	OpenGL calls, so the bytes an upload transfers are known without a
+	graphics context.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace al{
+
+/// Regions of a texture whose pixels changed since the last upload
+///
+/// Regions are boxes of texels. A region that overlaps or borders another,
+/// such that both fit in their bounding box with no more texels than the
+/// two have separately, is merged with it. If there are MAX_REGIONS regions
+/// already, a new region is merged with the one adding the fewest texels.
+///
+/// For an upload through a staging buffer, the regions are packed one after
+/// the other, with tightly packed rows. Two staging buffers are used in
+/// turn, so that packing an upload does not wait for the previous one to
+/// finish.
+///
+/// @ingroup allocore
+class TextureUpload{
+public:
+
+	/// Box of texels
+	struct Region{
+		unsigned x, y, z;		///< Offset, in texels
+		unsigned w, h, d;		///< Size, in texels
+
+		Region(unsigned x=0, unsigned y=0, unsigned z=0, unsigned w=0, unsigned h=1, unsigned d=1)
+		:	x(x), y(y), z(z), w(w), h(h), d(d){}
+
+		/// Get number of texels
+		uint64_t texels() const { return uint64_t(w)*h*d; }
+
+		bool operator== (const Region& r) const {
+			return x==r.x && y==r.y && z==r.z && w==r.w && h==r.h && d==r.d;
+		}
+	};
+
+	/// Maximum number of regions; more are merged
+	enum{ MAX_REGIONS = 8 };
+
+
+	TextureUpload();
+
+
+	/// Set size of texture
+
+	/// If the size changes, the whole texture is marked as changed.
+	/// @param[in] texelBytes	size of a texel, in bytes
+	/// @param[in] w			width, in texels
+	/// @param[in] h			height, in texels
+	/// @param[in] d			depth, in texels
+	TextureUpload& shape(unsigned texelBytes, unsigned w, unsigned h=1, unsigned d=1);
+
+	/// Mark the whole texture as changed
+	TextureUpload& dirty();
+
+	/// Mark a region as changed; it is clipped to the texture
+	TextureUpload& dirty(const Region& r);
+
+	/// Mark the pending regions as uploaded and switch staging buffers
+	TextureUpload& uploaded();
+
+
+	/// Whether any pixels are to be uploaded
+	bool pending() const { return !mRegions.empty(); }
+
+	/// Whether the whole texture is to be uploaded
+	bool whole() const;
+
+	/// Get number of regions to upload
+	int numRegions() const { return mRegions.size(); }
+
+	/// Get a region to upload
+	const Region& region(int i) const { return mRegions[i]; }
+
+	/// Get number of bytes to upload
+	uint64_t bytes() const;
+
+	/// Get offset of a region in packed pixels, in bytes
+	uint64_t offset(int i) const;
+
+	/// Copy the pixels of the regions to upload one after the other
+
+	/// @param[out] dst			memory of at least bytes() bytes
+	/// @param[in] pixels		pixels of whole texture
+	/// @param[in] rowStride	distance between rows of pixels, in bytes
+	/// @param[in] sliceStride	distance between slices of pixels, in bytes
+	void pack(char * dst, const char * pixels, size_t rowStride, size_t sliceStride) const;
+
+	/// Get index of staging buffer, 0 or 1, for the next upload
+	int stage() const { return mStage; }
+
+
+	/// Get number of uploads
+	uint64_t uploads() const { return mUploads; }
+
+	/// Get number of bytes uploaded
+	uint64_t bytesUploaded() const { return mBytesUploaded; }
+
+protected:
+	std::vector<Region> mRegions;
+	unsigned mTexelBytes, mW, mH, mD;
+	int mStage;
+	uint64_t mUploads, mBytesUploaded;
+
+	void merge(Region r);
+};
+
+} // al::
+
+#endif
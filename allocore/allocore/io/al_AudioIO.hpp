@@ -50,6 +50,9 @@
 
 namespace al{
 
+class AudioProfiler;
+class RTAllocator;
+
 /// Audio callback type
 typedef void (* audioCallback)(AudioIOData& io);
 
@@ -121,6 +124,26 @@ public:
 
 	virtual ~AudioIO();
 
+
+	/// Statistics of an offline stream
+	struct OfflineStats{
+		OfflineStats(): blocks(0), audioTime(0), wallTime(0){}
+
+		unsigned long blocks;	///< Number of blocks processed
+		double audioTime;		///< Duration of processed audio, in seconds
+		double wallTime;		///< Time spent processing, in seconds
+
+		/// Ratio of audio time to wall time
+		double speedup() const { return wallTime > 0 ? audioTime / wallTime : 0; }
+	};
+
+	/// Offline input generator
+
+	/// This fills the non-interleaved input buffer before each block is
+	/// processed.
+	typedef void (* OfflineInput)(float * buffer, int frames, int channels, void * userData);
+
+
 	audioCallback callback;						///< User specified callback function.
 
 	/// Add an AudioCallback handler (internal callback is always called first)
@@ -140,6 +163,10 @@ public:
 	double cpu() const;							///< Returns current CPU usage of audio thread
 	bool supportsFPS(double fps) const;			///< Return true if fps supported, otherwise false
 	bool zeroNANs() const;						///< Returns whether to zero NANs in output buffer going to DAC
+	Backend backend() const { return mBackend; }	///< Get audio backend
+	AudioProfiler * profiler() const { return mProfiler; }	///< Get profiler of blocks or NULL
+	RTAllocator * allocator() const { return mAllocator; }	///< Get real-time allocator or NULL
+	OfflineStats offlineStats() const;			///< Get statistics of offline stream
 
 	void processAudio();						///< Call callback manually
 	bool open();								///< Opens audio device.
@@ -147,6 +174,56 @@ public:
 	bool start();								///< Starts the audio IO.  Will open audio device if necessary.
 	bool stop();								///< Stops the audio IO.
 
+	/// Process blocks of an offline stream on the calling thread
+
+	/// This runs the same processing as the threaded stream started with
+	/// start(), but returns when the blocks are done. It is only available
+	/// with the OFFLINE backend and when the stream is not running.
+	/// \returns number of blocks processed
+	int processOffline(int numBlocks);
+
+	/// Set input of offline stream from interleaved samples
+
+	/// The samples are not copied and must persist while the stream runs.
+	/// Once the end is reached, the input is either zero or starts over.
+	/// @param[in] samples		interleaved input samples
+	/// @param[in] frames		number of frames of input
+	/// @param[in] channels		number of channels of input
+	/// @param[in] loop			whether to loop input
+	AudioIO& offlineInput(const float * samples, int frames, int channels, bool loop=false);
+
+	/// Set input of offline stream from a generator
+	AudioIO& offlineInput(OfflineInput func, void * userData=0);
+
+	/// Set buffer to capture output of offline stream
+
+	/// Interleaved output samples of each block are appended to the buffer.
+	/// Pass in NULL to stop capturing.
+	AudioIO& offlineOutput(std::vector<float> * samples);
+
+	/// Set speed of offline stream run by start() relative to real-time
+
+	/// A rate of 1 runs at the stream's frame rate and a rate of 0 runs as
+	/// fast as possible.
+	AudioIO& offlineRate(double v);
+
+	/// Rewind offline input and reset offline statistics
+	void offlineReset();
+
+	/// Set profiler to time every block against its deadline
+
+	/// The profiler is current on the audio thread while a block is
+	/// processed, so callbacks can time their stages with AL_PROFILE_AUDIO.
+	/// Pass in NULL to stop profiling.
+	AudioIO& profiler(AudioProfiler * v){ mProfiler=v; return *this; }
+
+	/// Set real-time allocator of the audio thread
+
+	/// The allocator is current on the audio thread while a block is
+	/// processed and its scratch arena is reset at the start of every block.
+	/// Pass in NULL to use none.
+	AudioIO& allocator(RTAllocator * v){ mAllocator=v; return *this; }
+
 	void autoZeroOut(bool v){ mAutoZeroOut=v; }
 
 	/// Sets number of effective channels on input or output device depending on 'forOutput' flag.
@@ -179,6 +256,9 @@ public:
 
 private:
 	AudioDevice mInDevice, mOutDevice;
+	Backend mBackend;
+	AudioProfiler * mProfiler;
+	RTAllocator * mAllocator;
 	bool mZeroNANs;			// whether to zero NANs
 	bool mClipOut;			// whether to clip output between -1 and 1
 	bool mAutoZeroOut;		// whether to automatically zero output buffers each block
@@ -205,7 +205,8 @@ public:
 
 	typedef enum {
 		PORTAUDIO,
-		DUMMY
+		DUMMY,
+		OFFLINE
 	} Backend;
 
 	/// Iterate frame counter, returning true while more frames
@@ -0,0 +1,221 @@
+#ifndef INCLUDE_AL_AUDIO_PROFILER_HPP
+#define INCLUDE_AL_AUDIO_PROFILER_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+
+	File description:
+	Timing of audio callbacks against their deadline and of the stages within
+
+	Timers write events into lock-free rings, one per thread, so recording
+	from the audio thread never blocks or allocates. The events are drained
+	into histograms by update(), usually called periodically from a
+	background thread started with start().
+*/
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "allocore/system/al_Time.h"
+
+namespace al{
+
+/// Profiler of audio callbacks and of named stages within them
+
+/// When a profiler is set on an AudioIO, every block is timed and compared
+/// with the block period, which is its deadline. Code called from the audio
+/// callback can time stages with AL_PROFILE_AUDIO, e.g.
+/// \code
+///	void MyProcessor::onAudioCB(AudioIOData& io){
+///		AL_PROFILE_AUDIO("MyProcessor");
+///		...
+///	}
+/// \endcode
+/// Stages are only recorded on threads where a profiler is current. The
+/// audio thread has the profiler of its AudioIO current while processing a
+/// block; other threads can call makeCurrent().
+///
+/// @ingroup allocore
+class AudioProfiler{
+public:
+
+	/// Timing statistics of the whole block or of a stage
+	struct Stats{
+		Stats(): count(0), mean(0), p50(0), p90(0), p99(0), max(0), load(0){}
+
+		std::string name;
+		unsigned long count;	///< Number of timings
+		double mean;			///< Mean time, in seconds
+		double p50;				///< Median time, in seconds
+		double p90;				///< 90th percentile time, in seconds
+		double p99;				///< 99th percentile time, in seconds
+		double max;				///< Maximum time, in seconds
+		double load;			///< Mean time per block as a fraction of the block period
+	};
+
+	/// Times a scope
+	class Scope{
+	public:
+		/// Time a stage with the current profiler, if any
+		Scope(int stage)
+		:	mProfiler(current()), mStage(stage){ if(mProfiler) mStart = al_steady_time_nsec(); }
+
+		/// Time a stage with a specific profiler
+		Scope(AudioProfiler& p, int stage)
+		:	mProfiler(&p), mStage(stage){ mStart = al_steady_time_nsec(); }
+
+		~Scope(){ if(mProfiler) mProfiler->record(mStage, mStart, al_steady_time_nsec()); }
+
+	private:
+		AudioProfiler * mProfiler;
+		int mStage;
+		al_nsec mStart;
+	};
+
+	enum{
+		MAX_STAGES = 64	///< Maximum number of stage names
+	};
+
+
+	/// @param[in] maxThreads		maximum number of threads recording at once
+	/// @param[in] eventsPerThread	capacity of the ring of each thread,
+	///								rounded up to a power of two
+	AudioProfiler(unsigned maxThreads = 8, unsigned eventsPerThread = 4096);
+
+	~AudioProfiler();
+
+
+	/// Get the stage id of a name, registering the name if new
+
+	/// Stage ids are shared by all profilers. This locks and may allocate,
+	/// so it should be called once per stage, e.g. as AL_PROFILE_AUDIO does.
+	/// \returns stage id or -1 if the maximum number of stages was reached
+	static int stage(const char * name);
+
+	/// Get the name of a stage
+	static std::string stageName(int stage);
+
+	/// Get the profiler current on the calling thread
+	static AudioProfiler * current();
+
+	/// Make this the current profiler of the calling thread
+	void makeCurrent();
+
+	/// Make no profiler current on the calling thread
+	static void clearCurrent();
+
+
+	/// Set whether to record timings
+	AudioProfiler& enabled(bool v){ mEnabled = v; return *this; }
+
+	/// Get whether timings are recorded
+	bool enabled() const { return mEnabled; }
+
+
+	/// Start timing a block
+
+	/// This is called by AudioIO from the audio thread and makes this the
+	/// current profiler of the thread until endBlock().
+	/// @param[in] period	duration of the block, in seconds
+	void beginBlock(double period);
+
+	/// Finish timing a block started with beginBlock
+
+	/// This restores the profiler that was current before beginBlock().
+	/// @param[in] xrun		whether the backend reported an under- or overflow
+	void endBlock(bool xrun = false);
+
+	/// Record a timing of a stage between two al_steady_time_nsec() times
+	void record(int stage, al_nsec start, al_nsec end);
+
+
+	/// Drain recorded timings into the statistics
+
+	/// This is called periodically by the thread started with start(), but
+	/// can also be called directly, e.g. after offline processing.
+	void update();
+
+	/// Start a thread calling update() periodically
+	void start(double period = 0.25);
+
+	/// Stop the thread started with start()
+	void stop();
+
+	/// Clear all statistics
+	void reset();
+
+
+	/// Get statistics of whole blocks
+	Stats blockStats() const;
+
+	/// Get statistics of all stages that were recorded
+	std::vector<Stats> stageStats() const;
+
+	/// Get number of blocks that took longer than their period
+	unsigned long deadlineMisses() const;
+
+	/// Get number of blocks during which the backend reported an xrun
+	unsigned long xruns() const;
+
+	/// Get number of timings dropped because a ring was full
+	unsigned long dropped() const;
+
+	/// Print statistics
+	void print(FILE * fp = stdout) const;
+
+private:
+	class Impl;
+	Impl * mImpl;
+	std::atomic<bool> mEnabled;
+	al_nsec mBlockStart;
+	double mBlockPeriod;
+	AudioProfiler * mPrevCurrent;	// current before beginBlock
+
+	AudioProfiler(const AudioProfiler&);
+	AudioProfiler& operator=(const AudioProfiler&);
+};
+
+
+#define AL_PROFILE_CAT_(a, b) a##b
+#define AL_PROFILE_CAT(a, b) AL_PROFILE_CAT_(a, b)
+
+/// Time the rest of the enclosing scope as the named stage
+#define AL_PROFILE_AUDIO(name)\
+	static const int AL_PROFILE_CAT(alProfileStage, __LINE__) = al::AudioProfiler::stage(name);\
+	al::AudioProfiler::Scope AL_PROFILE_CAT(alProfileScope, __LINE__)(AL_PROFILE_CAT(alProfileStage, __LINE__))
+
+} // al::
+
+#endif
@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <queue>
+#include <atomic>
 
 /**********************************************************************/
 /* \class MIDI
@@ -47,6 +48,7 @@
 namespace al{
 
 class MIDIIn;
+class AudioIOData;
 
 /// Convert note number to Hz value
 ///
@@ -216,6 +218,117 @@ protected:
 
 
 
+/// Fixed size lock-free queue of MIDI messages
+
+/// Messages are stored inline, so pushing and popping never allocate and
+/// are safe with one producer thread (e.g., the MIDI backend) and one
+/// consumer thread (e.g., the audio thread). Sysex data is not carried.
+///
+/// @ingroup allocore
+class MIDIMessageQueue{
+public:
+
+	/// @param[in] capacity		maximum number of messages, rounded up to a power of two
+	MIDIMessageQueue(unsigned capacity = 1024);
+
+	/// Add a message to the end of the queue
+
+	/// \returns false and drops the message if the queue is full
+	///
+	bool push(const MIDIMessage& m);
+
+	/// Remove the message at the front of the queue
+	bool pop(MIDIMessage& m);
+
+	/// Get the message at the front of the queue or NULL if empty
+	const MIDIMessage * front() const;
+
+	/// Remove the message at the front of the queue
+	void pop();
+
+	/// Number of messages in the queue
+	unsigned size() const { return mWrite.load() - mRead.load(); }
+
+	unsigned capacity() const { return mMask + 1; }
+
+	/// Number of messages dropped because the queue was full
+	unsigned overflows() const { return mOverflows.load(); }
+
+private:
+	std::vector<MIDIMessage> mMessages;
+	unsigned mMask;
+	std::atomic<unsigned> mWrite, mRead, mOverflows;
+};
+
+
+/// Delivers MIDI messages to an audio callback at frame offsets
+
+/// Messages are time stamped on arrival with a steady clock and queued
+/// without locks. At the start of each audio block, beginBlock() maps the
+/// time elapsed since the previous block onto the frames of the current
+/// block, so the messages keep their relative timing with a constant
+/// latency of one block.
+///
+/// Typical use in an audio callback:
+/// \code
+///	midi.beginBlock(io);
+///	MIDIMessage m(0, 0, 0);
+///	while(io()){
+///		while(midi.nextAt(m, io.frame())){ /* handle m */ }
+///		...
+///	}
+/// \endcode
+///
+/// @ingroup allocore
+class MIDIAudioDispatcher : public MIDIMessageHandler{
+public:
+
+	/// @param[in] capacity		maximum number of queued messages
+	MIDIAudioDispatcher(unsigned capacity = 1024);
+
+	/// Queue a message, time stamping it with the current time
+	virtual void onMIDIMessage(const MIDIMessage& m);
+
+	/// Queue a message with a time stamp in seconds of clock()
+	bool push(const MIDIMessage& m, double time);
+
+
+	/// Prepare the messages for an audio block, using the current time
+	void beginBlock(const AudioIOData& io);
+
+	/// Prepare the messages for an audio block, given the current clock() time
+	void beginBlock(int framesPerBuffer, double framesPerSecond, double time);
+
+
+	/// Get the next message of the block and its frame offset
+
+	/// The time stamp of the returned message is the time it was queued.
+	/// \returns false when there are no more messages in this block
+	bool next(MIDIMessage& m, int& frame);
+
+	/// Get the next message of the block due at or before a frame
+
+	/// This is meant to be called once per frame from a sample loop.
+	///
+	bool nextAt(MIDIMessage& m, int frame);
+
+
+	/// Time in seconds of the clock used to time stamp messages
+	static double clock();
+
+	/// The message queue
+	MIDIMessageQueue& queue(){ return mQueue; }
+
+private:
+	int frameOf(double time) const;
+
+	MIDIMessageQueue mQueue;
+	double mWindowStart, mWindowEnd;
+	double mFramesPerSec;	// frames per second of the window
+	int mFrames;
+};
+
+
 
 /// MIDI error reporting
 ///
@@ -99,7 +99,8 @@ public:
 	/// audio and graphics settings will determine whether the rendering can
 	/// keep up with real-time. If NON_REAL_TIME, then the graphics and audio
 	/// i/o are taken over and the entire rendering process occurs as fast as 
-	/// possible.
+	/// possible. Non-real-time rendering of audio only requires an AudioIO
+	/// using the OFFLINE backend; its blocks are written as they are processed.
 	RenderToDisk& mode(Mode v);
 
 	/// Set format of image files
@@ -207,6 +208,7 @@ private:
 	void writeAudio(); // Write next block of audio to sound file
 	void writeImage(); // Write current frame buffer to image file
 	void resetPBOQueue();
+	bool offlineAudio() const { return NON_REAL_TIME == mMode && mAudioIO && !mWindow; } // Audio-only non-real-time?
 	void saveImage(unsigned w, unsigned h, unsigned l=0, unsigned b=0, bool usePBO=true);
 };
 
@@ -106,6 +106,12 @@ public:
 	/// Get timeout duration, in seconds
 	al_sec timeout() const;
 
+	/// Get native socket descriptor or -1 if the socket is not open
+
+	/// The descriptor changes when open() is called again, so a socket
+	/// watched by osc::Recv::start(Main&) must then be started again.
+	int fileDescriptor() const;
+
 
 	/// Open socket (reopening if currently open)
 	bool open(uint16_t port, const char * address, al_sec timeout, int type);
@@ -167,6 +173,30 @@ public:
 	/// socket address pair of this connection.
 	bool accept(Socket& sock);
 
+	/// Join a multicast group
+
+	/// Called on a bound datagram (server) socket. Server sockets opened on a
+	/// multicast address allow other sockets on the same host to bind the
+	/// same group and port.
+	/// @param[in] group	multicast group address. If null, joins the
+	///						socket's own address.
+	bool joinMulticast(const char * group = 0);
+
+	/// Set maximum number of router hops for outgoing multicast datagrams
+	bool multicastHops(int hops);
+
+	/// Set whether outgoing multicast datagrams are delivered to this host
+	bool multicastLoopback(bool v);
+
+	/// Set size of the operating system receive buffer, in bytes
+
+	/// A larger buffer avoids dropping datagrams that arrive in bursts.
+	///
+	bool receiveBufferSize(int bytes);
+
+	/// Returns whether address is an IPv4 multicast address (224.0.0.0/4)
+	static bool isMulticast(const char * address);
+
 protected:
 	// Called after a successful call to open
 	virtual bool onOpen(){ return true; }
@@ -784,15 +784,15 @@ Quat<T> Quat<T> :: slerp(const Quat& input, const Quat& target, T amt){
 
 		a = sin(cos_angle*(1.-amt)) * inv_sine;
 		b = sin(cos_angle*amt) * inv_sine;
-
-		if (bflip) { b = -b; }
 	} else {
 		// nearly the same;
 		// approximate without trigonometry
-		a = amt;
-		b = 1.-amt;
+		a = 1.-amt;
+		b = amt;
 	}
 
+	if (bflip) { b = -b; }
+
 	result.w = a*input.w + b*target.w;
 	result.x = a*input.x + b*target.x;
 	result.y = a*input.y + b*target.y;
@@ -47,6 +47,7 @@
 #include <string>
 #include <vector>
 #include "allocore/io/al_Socket.hpp"
+#include "allocore/system/al_MainLoop.hpp"
 #include "allocore/system/al_Thread.hpp"
 
 namespace al{
@@ -313,7 +314,8 @@ public:
 
 /// Socket for receiving OSC packets
 
-/// Supports explicit polling or implicit background thread polling
+/// Supports explicit polling, implicit background thread polling or
+/// receiving in the main loop when packets arrive
 ///
 /// @ingroup allocore
 class Recv : public SocketServer{
@@ -350,14 +352,30 @@ public:
 	/// Returns whether the thread was started successfully.
 	bool start();
 
-	/// Stop the background polling
+	/// Receive packets in a main loop as they arrive
+
+	/// The socket is watched by the main loop, which calls the handler from
+	/// its thread and does not poll while no packets arrive. Since the
+	/// descriptor changes when the socket is opened again, this must be
+	/// called again after that.
+	/// Returns whether the socket could be watched.
+	bool start(Main& main);
+
+	/// Stop the background polling and receiving in a main loop
 	void stop();
 
 protected:
+	struct MainHandler : public Main::FDHandler{
+		Recv * recv;
+		void onReadable(int /*fd*/){ recv->recv(); }
+	};
+
 	PacketHandler * mHandler;
 	std::vector<char> mBuffer;
 	al::Thread mThread;
 	bool mBackground;
+	MainHandler mMainHandler;
+	Main * mMain;
 };
 
 
@@ -204,17 +204,32 @@ static inline uint32_t serCopy##B(void * d, const void * s, uint32_t n){\
 	return n;\
 }
 
-#define DEF_BE(p, B, S)\
+/* Elements are swapped in registers with shifts, which compilers turn into
+   byte swap or vector shuffle instructions */
+static inline uint16_t serSwap16(uint16_t v){ return (uint16_t)((v>>8) | (v<<8)); }
+static inline uint32_t serSwap32(uint32_t v){
+	return (v>>24) | ((v>>8) & 0xff00) | ((v<<8) & 0xff0000) | (v<<24);
+}
+static inline uint64_t serSwap64(uint64_t v){
+	return ((uint64_t)serSwap32((uint32_t)v) << 32) | serSwap32((uint32_t)(v>>32));
+}
+
+#define DEF_BE(B, S, T)\
 static inline uint32_t serCopy##B(void * d, const void * s, uint32_t n){\
-	n = n<<S;\
-	memcpy(d,s,n);\
-	char * t = (char *)d;\
-	for(uint32_t i=0; i<n; i+=B) swapBytes##B(t+i);\
-	return n;\
+	char * dc = (char *)d;\
+	const char * sc = (const char *)s;\
+	uint32_t i;\
+	for(i=0; i<n; ++i){\
+		uint##T##_t v;\
+		memcpy(&v, sc + i*B, B);\
+		v = serSwap##T(v);\
+		memcpy(dc + i*B, &v, B);\
+	}\
+	return n<<S;\
 }
 
 #ifdef SER_IS_BIG_ENDIAN
-DEF_BE(2,1) DEF_BE(4,2) DEF_BE(8,3)
+DEF_BE(2,1,16) DEF_BE(4,2,32) DEF_BE(8,3,64)
 #else
 DEF_LE(2,1) DEF_LE(4,2) DEF_LE(8,3)
 #endif
@@ -46,6 +46,7 @@
 #include "al_Serialize.h"
 #include <vector>
 #include <string>
+#include <type_traits>
 
 namespace al{
 
@@ -68,9 +69,20 @@ template<> inline uint32_t encode(char * b, const uint32_t * v, uint32_t n){ ret
 template<> inline uint32_t encode(char * b, const uint64_t * v, uint32_t n){ return serEncodeUInt64(b, v, n); }
 
 
+template<class T> inline uint32_t decode(T * v, const char * b, uint32_t n){
+	switch(sizeof(T)){
+	case 1: return serCopy1(v, b, n);
+	case 2: return serCopy2(v, b, n);
+	case 4: return serCopy4(v, b, n);
+	default:return serCopy8(v, b, n);
+	}
+}
+
+
 template<class T> uint8_t getType();
 template<> inline uint8_t getType<float   >(){ return 'f'; }
 template<> inline uint8_t getType<double  >(){ return 'd'; }
+template<> inline uint8_t getType<char    >(){ return 'h'; }
 template<> inline uint8_t getType<bool    >(){ return 't'; }
 template<> inline uint8_t getType<uint8_t >(){ return 't'; }
 template<> inline uint8_t getType<uint16_t>(){ return 'T'; }
@@ -87,9 +99,24 @@ template<> inline uint8_t getType<int64_t >(){ return 'I'; }
 ///
 /// \brief The Serializer struct
 ///
+/// Elements are encoded straight into the output, which is either an
+/// internal buffer that grows as needed or external memory of fixed size.
+/// Arrays added with add() have a single header for all their elements.
+///
 /// @ingroup allocore
 struct Serializer{
 
+	/// Serialize into an internal buffer
+	Serializer();
+
+	/// Serialize into external memory
+
+	/// Nothing is written past the capacity; a group of elements that does
+	/// not fit is dropped and overflowed() returns true.
+	/// @param[in] buf			memory to write to
+	/// @param[in] capacity		size of memory, in bytes
+	Serializer(char * buf, uint32_t capacity);
+
 	template <class T>
 	Serializer& operator<< (T v);
 
@@ -99,36 +126,104 @@ struct Serializer{
 	template <class T>
 	Serializer& add(const T * v, uint32_t num);
 
+	/// Reserve memory of internal buffer, in bytes
+	Serializer& reserve(uint32_t bytes);
+
+	/// Start over, keeping the memory
+	Serializer& clear();
+
+	/// Get serialized data
+	const char * data() const { return mExt ? mExt : mBuf.data(); }
+
+	/// Get size of serialized data, in bytes
+	uint32_t size() const { return mSize; }
+
+	/// Whether anything did not fit into external memory
+	bool overflowed() const { return mOverflow; }
+
+	/// Get internal buffer; empty when serializing into external memory
 	const std::vector<char>& buf() const;
 
 private:
-	std::vector<char> mBuf, mTemp;
+	std::vector<char> mBuf;
+	char * mExt;
+	uint32_t mSize, mCapacity;
+	bool mOverflow;
 
-	template <class T> void checkSize(uint32_t n=1);
+	char * grow(uint32_t bytes);
 };
 
 
 ///
 /// \brief The Deserializer struct
 ///
+/// The serialized data is read where it is, so it must outlive the
+/// deserializer.
+///
 /// @ingroup allocore
 struct Deserializer{
 
 	Deserializer(const std::vector<char>& b);
 
+	/// A temporary buffer would be destroyed before it is read
+	Deserializer(std::vector<char>&&) = delete;
+
 	Deserializer(const char * b, uint32_t n);
 
+	/// Decode an element, or all elements of a fixed size array
+
+	/// Nothing is read if the next group does not have the type of v and
+	/// exactly as many elements.
 	template <class T>
 	Deserializer& operator>> (T& v);
+
+	/// Decode a string into a buffer
+
+	/// The buffer must hold the whole string, including its terminator; call
+	/// peek() first to get its size or use get() to decode at most a given
+	/// number of characters. Nothing is read if the next group is not a
+	/// string.
 	Deserializer& operator>> (char * v);
+
+	/// Decode a string
+
+	/// Nothing is read if the next group is not a string.
 	Deserializer& operator>> (std::string& v);
 
-	const std::vector<char>& buf() const;
+	/// Decode an array
+
+	/// This reads the next group of elements if it has the type of the
+	/// array. At most num elements are decoded and any others are skipped.
+	/// @param[out] v		array to decode into
+	/// @param[in] num		size of array
+	/// \returns number of elements decoded
+	template <class T>
+	uint32_t get(T * v, uint32_t num);
+
+	/// Get header of next group of elements
+
+	/// \returns false if there is no complete group left
+	///
+	bool peek(SerHeader& h) const;
+
+	/// Get serialized data
+	const char * data() const { return mData; }
+
+	/// Get size of serialized data, in bytes
+	uint32_t size() const { return mSize; }
+
+	/// Get number of bytes not yet read
+	uint32_t remaining() const { return mSize - mStart; }
+
+	/// Whether a read went past the end of the data
+	bool overflowed() const { return mOverflow; }
 
 private:
-	int mStart;
-	std::vector<char> mBuf;
-	char * bufDec();
+	const char * mData;
+	uint32_t mSize, mStart;
+	bool mOverflow;
+	const char * bufDec() const { return mData + mStart; }
+	bool next(SerHeader& h);
 };
 
 
@@ -144,29 +239,61 @@ template <class T> Serializer& Serializer::operator<< (T v){
 }
 
 template <class T> Serializer& Serializer::add(const T * v, uint32_t num){
-	checkSize<T>(num);
-	uint32_t n = ser::encode(&mTemp[0], v, num);
-	mBuf.insert(mBuf.end(), mTemp.begin(), mTemp.begin()+n);
+	char * b = grow(serHeaderSize() + num*sizeof(T));
+	if(b) ser::encode(b, v, num);
 	return *this;
 }
 
-template <class T> void Serializer::checkSize(uint32_t n){
-	uint32_t need = n*sizeof(T) + serHeaderSize();
-	if(mTemp.size() < need) mTemp.resize(need);
+inline char * Serializer::grow(uint32_t bytes){
+	uint32_t end = mSize + bytes;
+	char * b;
+	if(mExt){
+		if(end > mCapacity){
+			mOverflow = true;
+			return NULL;
+		}
+		b = mExt + mSize;
+	}
+	else{
+		mBuf.resize(end);
+		b = &mBuf[mSize];
+	}
+	mSize = end;
+	return b;
+}
+
+
+inline bool Deserializer::peek(SerHeader& h) const {
+	const uint32_t SOH = serHeaderSize();
+	if(remaining() < SOH) return false;
+	h.type = bufDec()[0];
+	serCopy4(&h.num, bufDec()+1, 1);
+	return uint64_t(serTypeSize(h.type)) * h.num <= remaining() - SOH;
 }
 
+inline bool Deserializer::next(SerHeader& h){
+	if(peek(h)) return true;
+	mOverflow = true;
+	return false;
+}
 
 template <class T> Deserializer& Deserializer::operator>> (T& v){
-	uint32_t n = serDecode(bufDec(), &v);
-	mStart += n;
+	typedef typename std::remove_all_extents<T>::type E;
+	SerHeader h;
+	if(next(h) && h.type == ser::getType<E>() && h.num == sizeof(T)/sizeof(E)){
+		get(reinterpret_cast<E *>(&v), h.num);
+	}
 	return *this;
 }
 
-//template <class T>
-//Deserializer& decode(const T * v, uint32_t num){
-//	uint32_t n = decode(bufDec(), v);
-//	return *this;
-//}
+template <class T> uint32_t Deserializer::get(T * v, uint32_t num){
+	SerHeader h;
+	if(!next(h) || h.type != ser::getType<T>()) return 0;
+	uint32_t n = h.num < num ? h.num : num;
+	ser::decode(v, bufDec() + serHeaderSize(), n);
+	mStart += serHeaderSize() + serElementsSize(&h);
+	return n;
+}
 
 } // al::
 
@@ -0,0 +1,210 @@
+#ifndef INCLUDE_AL_STATE_REPLICATION_HPP
+#define INCLUDE_AL_STATE_REPLICATION_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+
+	File description:
+	Replication of a plain-old-data state from one simulator to many renderers
+
+	Each frame of state is encoded as the XOR against the previously sent frame
+	with the runs of unchanged (zero) bytes removed, so only the bytes that
+	changed use bandwidth. The encoded frame is split into datagrams that fit
+	the network MTU, each carrying the frame sequence number and its position
+	in the frame. A full (key) frame is sent periodically so receivers that
+	join late or lose a datagram can resynchronize.
+
+	Receivers rebuild the newest complete frame and publish it through a
+	triple buffer, so a render thread can always read a consistent state
+	without locking while a network thread receives the next one.
+*/
+
+#include <string>
+#include "allocore/system/al_Config.h"
+
+namespace al{
+
+/// Sends frames of a plain-old-data state to a multicast group
+
+/// The state must be a contiguous block of memory without pointers, e.g. a
+/// struct of Pose, Vec and fixed size arrays. Receivers must use the same
+/// state size and the same byte order.
+///
+/// @ingroup allocore
+class StateSender{
+public:
+
+	/// @param[in] stateSize	size of the state, in bytes
+	/// @param[in] port			destination port
+	/// @param[in] address		destination address. A multicast group
+	///							(224.0.0.0 to 239.255.255.255) reaches all
+	///							receivers that joined it.
+	/// @param[in] hops			maximum router hops for multicast datagrams
+	StateSender(
+		size_t stateSize, uint16_t port = 12100,
+		const char * address = "239.255.0.1", int hops = 1
+	);
+
+	~StateSender();
+
+
+	/// Whether the socket was opened
+	bool opened() const;
+
+	/// Size of the state, in bytes
+	size_t stateSize() const;
+
+	/// Set maximum size of a datagram, including the header. Default is 1472
+	/// (the UDP payload of a 1500 byte Ethernet frame).
+	StateSender& mtu(unsigned bytes);
+
+	/// Set number of frames between full frames (0 for full frames only).
+	/// Default is 60.
+	StateSender& keyframeInterval(unsigned frames);
+
+	/// Make the next frame a full frame
+	StateSender& requestKeyframe();
+
+
+	/// Encode and send a frame
+
+	/// @param[in] state	pointer to stateSize() bytes of state
+	/// \returns number of bytes sent
+	size_t send(const void * state);
+
+
+	/// Sequence number of the last frame sent
+	uint32_t frame() const;
+
+	/// Total bytes sent, including headers
+	uint64_t bytesSent() const;
+
+	/// Total bytes of state sent, before encoding
+	uint64_t stateBytes() const;
+
+	/// Total datagrams sent
+	uint64_t packetsSent() const;
+
+private:
+	class Impl; Impl * mImpl;
+	StateSender(const StateSender&);
+	StateSender& operator=(const StateSender&);
+};
+
+
+
+/// Receives frames of a plain-old-data state sent by a StateSender
+
+/// Datagrams can either be received on a background thread (start()) or on
+/// the calling thread (poll()). In both cases, the newest complete frame is
+/// read through newFrame()/state() which never block.
+///
+/// @ingroup allocore
+class StateReceiver{
+public:
+
+	/// @param[in] stateSize	size of the state, in bytes
+	/// @param[in] port			port to listen on
+	/// @param[in] address		multicast group to join. If it is not a
+	///							multicast address, datagrams sent to any
+	///							address of this host are received.
+	StateReceiver(
+		size_t stateSize, uint16_t port = 12100,
+		const char * address = "239.255.0.1"
+	);
+
+	~StateReceiver();
+
+
+	/// Whether the socket was opened
+	bool opened() const;
+
+	/// Size of the state, in bytes
+	size_t stateSize() const;
+
+
+	/// Start receiving on a background thread
+	bool start();
+
+	/// Stop the background thread
+	void stop();
+
+	/// Receive pending datagrams on the calling thread
+
+	/// @param[in] timeout	seconds to wait for the first datagram
+	/// \returns number of frames completed
+	int poll(al_sec timeout = 0);
+
+
+	/// Acquire the newest complete frame, if any arrived since the last call
+
+	/// After this returns true, state() points to the new frame until the
+	/// next call. Must always be called from the same thread.
+	bool newFrame();
+
+	/// Pointer to the last acquired frame, or NULL if none has been acquired
+	const void * state() const;
+
+	/// Copy the newest complete frame into state, if there is a new one.
+	/// \returns whether state was updated
+	template <class T>
+	bool update(T& state){
+		if(sizeof(T) != stateSize() || !newFrame()) return false;
+		state = *(const T *)this->state();
+		return true;
+	}
+
+
+	/// Sequence number of the last acquired frame
+	uint32_t frame() const;
+
+	/// Number of frames completed
+	uint64_t framesReceived() const;
+
+	/// Number of frames that could not be decoded because a datagram of
+	/// that frame or of a previous frame was lost
+	uint64_t framesDropped() const;
+
+	/// Total datagrams received
+	uint64_t packetsReceived() const;
+
+private:
+	class Impl; Impl * mImpl;
+	StateReceiver(const StateReceiver&);
+	StateReceiver& operator=(const StateReceiver&);
+};
+
+} // al::
+
+#endif
@@ -54,6 +54,7 @@
 #include "allocore/spatial/al_DistAtten.hpp"
 #include "allocore/spatial/al_Pose.hpp"
 #include "allocore/io/al_AudioIO.hpp"
+#include "allocore/system/al_RTAllocator.hpp"
 #include "allocore/sound/al_Speaker.hpp"
 #include "allocore/sound/al_Reverb.hpp"
 #include "allocore/sound/al_Biquad.hpp"
@@ -229,6 +230,10 @@ enum DopplerType{
 class SoundSource : public AudioSceneObject, public DistAtten<double> {
 public:
 
+	enum{
+		MIRROR_SIZE = 4096	///< Maximum number of samples copied after end of delay-line
+	};
+
 	/// @param[in] nearClip		Distance below which amplitude is clamped to 1
 	/// @param[in] farClip		Distance above which amplitude reaches its mimumum
 	/// @param[in] law			Attenuation law
@@ -256,7 +261,7 @@ public:
 	}
 
 	/// Get size of delay in samples
-	int delaySize() const { return mSound.size(); }
+	int delaySize() const { return mSoundSize; }
 
 	/// Convert delay, in seconds, to an index
 	double delayToIndex(double delay, double sampleRate) const {
@@ -272,22 +277,42 @@ public:
 	/// Returns maximum index that can be used for reading samples
 	int maxIndex() const { return delaySize()-2; }
 
-	/// Read sample from delay-line using linear interpolation
+	/// Read sample from delay-line using cubic interpolation
 	/// The index specifies how many samples ago by which to read back from
 	/// the buffer. The index must be less than or equal to bufferSize()-2.
 	float readSample(double index) const {
 		int index0 = index;
-		float a = mSound.read(index0);
-		float b = mSound.read(index0+1);
+		float a = read(index0);
+		float b = read(index0+1);
 		float frac = index - index0;
 		//return ipl::linear(frac, a, b);
 
-		float a0 = mSound.read(index0-1);
-		float b1 = mSound.read(index0+2);
+		float a0 = read(index0-1);
+		float b1 = read(index0+2);
 		return ipl::cubic(frac, a0, a, b, b1);
 
 	}
 
+	/// Read a block of samples ending at the newest sample
+
+	/// Sample i of the block is read delay(i) + n-1-i samples ago, as with
+	/// readSample, where delay(i) goes linearly from delayStart at the first
+	/// to delayEnd at the last sample. With a constant delay, this is what
+	/// AudioScene renders per buffer. Unless the delays are out of range or
+	/// change by more than MIRROR_SIZE samples, the block is interpolated
+	/// over a contiguous part of the delay line without wrapping indices.
+	/// Indices beyond maxIndex() are clamped.
+	/// @param[out] dst			output buffer of n samples
+	/// @param[in]  n			number of samples
+	/// @param[in]  delayStart	delay of first sample, in samples
+	/// @param[in]  delayEnd	delay of last sample, in samples
+	void readBlock(float * dst, int n, double delayStart, double delayEnd) const;
+
+	/// Read a block of samples with a constant delay
+	void readBlock(float * dst, int n, double delay) const {
+		readBlock(dst, n, delay, delay);
+	}
+
 	/// Enable/disable distance-based gain attenuation
 	void useAttenuation(bool enable){ mUseAtten = enable; }
 
@@ -295,7 +320,11 @@ public:
 	void dopplerType(DopplerType type){ mDopplerType = type; }
 
 	/// Write sample to internal delay-line
-	void writeSample(float v){ mSound.write(v); }
+	void writeSample(float v){
+		if(++mSoundPos == mSoundSize) mSoundPos = 0;
+		mSound[mSoundPos] = v;
+		if(mSoundPos < mMirrorSize) mSound[mSoundSize + mSoundPos] = v;
+	}
 
 	/// optional onProcessSample for sample rate processing of sound sources
 	virtual void onProcessSample(int frame){}
@@ -315,13 +344,184 @@ public:
 	BiQuadNX presenceFilter; //used for presence filtering and spatial modulation BW control
 
 protected:
-	RingBuffer<float> mSound;		// spherical wave around position
+	// Spherical wave around position. The first samples of the delay-line are
+	// repeated after its end, so reads near the end need no wrapping.
+	std::vector<float> mSound;
+	int mSoundSize;					// size of delay-line without mirrored samples
+	int mSoundPos;					// index of newest sample
+	int mMirrorSize;				// number of mirrored samples
+
+	// Get sample i samples ago, for -1 <= i <= delaySize()
+	float read(int i) const {
+		i = mSoundPos - i;
+		if(i < 0) i += mSoundSize;
+		else if(i >= mSoundSize) i -= mSoundSize;
+		return mSound[i];
+	}
 	bool mUseAtten;
 	DopplerType mDopplerType;
 	bool mUsePerSampleProcessing;
 };
 
 
+/// Sound sources stored in contiguous arrays
+
+/// This is an alternative to SoundSource for scenes with many sources. The
+/// positions, gains, attenuation parameters and delay-line heads of all
+/// sources are kept in separate contiguous arrays, so rendering walks memory
+/// linearly instead of following a pointer to every source. All memory is
+/// allocated by the constructor, so sources can be added and removed, in
+/// constant time, from an audio callback.
+///
+/// Sources are referred to by ids returned from add(). Ids stay valid until
+/// the source is removed, but the order in which sources are rendered can
+/// change when others are removed.
+///
+/// Sources of an array are always rendered per buffer, also when the scene
+/// uses per sample processing. Spatializers are passed proxy() as source.
+///
+/// @ingroup allocore
+class SoundSourceArray{
+public:
+
+	/// @param[in] capacity		maximum number of sources
+	/// @param[in] delaySize	minimum size of delay line of each source,
+	///							rounded up to a power of two
+	SoundSourceArray(int capacity, int delaySize=8192);
+
+
+	/// Add a source
+
+	/// The delay line of the source is cleared, the source is placed at the
+	/// origin and its gain is 1.
+	/// \returns id of source or -1 if the array is full
+	int add(
+		double nearClip=0.1, double farClip=20, AttenuationLaw law = ATTEN_INVERSE,
+		DopplerType dopplerType = DOPPLER_SYMMETRICAL, double farBias=0
+	);
+
+	/// Remove a source
+	void remove(int id);
+
+	/// Remove all sources
+	void clear();
+
+	/// Whether an id refers to a source in the array
+	bool valid(int id) const { return id >= 0 && id < capacity() && mSlot[id] >= 0; }
+
+	/// Get number of sources
+	int size() const { return mSize; }
+
+	/// Get maximum number of sources
+	int capacity() const { return mSlot.size(); }
+
+	/// Get size of delay line of each source in samples
+	int delaySize() const { return mMask+1; }
+
+	/// Returns maximum index that can be used for reading samples
+	int maxIndex() const { return delaySize()-2; }
+
+	/// Get number of bytes used by the array
+	size_t memoryUsage() const;
+
+
+	/// Set position of a source
+	void pos(int id, double x, double y, double z=0.){
+		int i = mSlot[id];
+		mX[i]=x; mY[i]=y; mZ[i]=z;
+	}
+
+	/// Get position of a source
+	Vec3d pos(int id) const {
+		int i = mSlot[id];
+		return Vec3d(mX[i], mY[i], mZ[i]);
+	}
+
+	/// Set gain of a source
+	void gain(int id, float v){ mGain[mSlot[id]] = v; }
+
+	/// Get gain of a source
+	float gain(int id) const { return mGain[mSlot[id]]; }
+
+	/// Get distance attenuation of a source
+	DistAtten<double>& distAtten(int id){ return mAtten[mSlot[id]]; }
+
+	/// Enable/disable distance-based gain attenuation of a source
+	void useAttenuation(int id, bool v){ mUseAtten[mSlot[id]] = v; }
+
+	/// Returns whether distance-based attenuation of a source is enabled
+	bool useAttenuation(int id) const { return mUseAtten[mSlot[id]]; }
+
+	/// Set Doppler type of a source
+
+	/// Physical Doppler shift requires per sample processing, so it is
+	/// rendered as symmetrical.
+	void dopplerType(int id, DopplerType v){ mDoppler[mSlot[id]] = v; }
+
+	/// Get Doppler type of a source
+	DopplerType dopplerType(int id) const { return DopplerType(mDoppler[mSlot[id]]); }
+
+
+	/// Write sample to delay line of a source
+	void writeSample(int id, float v){
+		int i = mSlot[id];
+		int h = (mHead[i]+1) & mMask;
+		mHead[i] = h;
+		mDelay[size_t(id)*delaySize() + h] = v;
+	}
+
+	/// Write samples to delay line of a source
+	void writeSamples(int id, const float * src, int n);
+
+	/// Read sample from delay line of a source using cubic interpolation
+
+	/// The index specifies how many samples ago by which to read back from
+	/// the buffer. The index must be less than or equal to maxIndex().
+	float readSample(int id, double index) const {
+		return read(mSlot[id], index);
+	}
+
+
+	/// Get source passed to spatializers
+	SoundSource& proxy(){ return mProxy; }
+
+protected:
+	friend class AudioScene;
+
+	std::vector<double> mX, mY, mZ;		// positions
+	std::vector<float> mGain;
+	std::vector<DistAtten<double> > mAtten;
+	std::vector<char> mUseAtten;
+	std::vector<char> mDoppler;
+	std::vector<int> mHead;				// absolute index of newest sample
+	std::vector<int> mID;				// id of each source
+	std::vector<int> mSlot;				// array index of each id or -1
+	std::vector<int> mFreeIDs;			// stack of unused ids
+	std::vector<float> mDelay;			// delay lines, indexed by id
+	int mSize, mMask;
+	SoundSource mProxy;
+
+	const float * line(int i) const { return &mDelay[size_t(mID[i])*delaySize()]; }
+
+	float read(int i, double index) const {
+		const float * d = line(i);
+		int h = mHead[i];
+		int index0 = index;
+		float frac = index - index0;
+		float a0 = d[(h-index0+1) & mMask];
+		float a  = d[(h-index0  ) & mMask];
+		float b  = d[(h-index0-1) & mMask];
+		float b1 = d[(h-index0-2) & mMask];
+		return ipl::cubic(frac, a0, a, b, b1);
+	}
+
+	// Read a block from source at array index i, delayed by 'delay' samples
+	// relative to the end of the block, as AudioScene renders per buffer
+	void readBlock(int i, double delay, float gain, float * dst, int numFrames) const;
+};
+
+
+
 /// An audio scene consisting of Listeners and Sources.
 ///
 /// @ingroup allocore
@@ -332,7 +532,13 @@ public:
 	typedef std::vector<Listener *> Listeners;
 
 	/// A set of sources
-	typedef std::list<SoundSource *> Sources;
+
+	/// List nodes come from the current RTAllocator of the thread, if any,
+	/// so adding sources from an audio callback does not call the system
+	/// allocator. Only the node memory comes from the real-time allocator;
+	/// the list itself is not synchronized, so it must not be changed while
+	/// the scene is rendered by another thread.
+	typedef std::list<SoundSource *, RTAlloc<SoundSource *> > Sources;
 
 
 	/// @param[in] numFrames	block size of audio buffers
@@ -363,7 +569,20 @@ public:
 	/// Remove a sound source from scene
 	void removeSource(SoundSource& src);
 
+	/// Add an array of sound sources to scene
+	void addSources(SoundSourceArray& srcs);
+
+	/// Remove an array of sound sources from scene
+	void removeSources(SoundSourceArray& srcs);
+
 	/// Perform rendering
+
+	/// Sources are processed once per block and then rendered for every
+	/// listener. The block of a source without Doppler shift is the same
+	/// for all listeners, so it is read only once; each listener applies
+	/// its own gain. Sources using per sample processing are processed
+	/// once, their positions recorded per frame, and then rendered for
+	/// every listener.
 	void render(AudioIOData& io);
 
 	/// Set per sample processing (false by default)
@@ -379,10 +598,17 @@ public:
 	}
 
 protected:
+	bool firstWithSpatializer(unsigned listener) const;
+	void renderSource(AudioIOData& io, SoundSource& src);
+	void renderSources(AudioIOData& io, SoundSourceArray& srcs);
+
 	Listeners mListeners;
 	Sources mSources;
+	std::vector<SoundSourceArray *> mSourceArrays;
 	int mNumFrames;				// audio frames per block
 	std::vector<float> mBuffer;	// temporary frame buffer
+	std::vector<float> mSourceBuffer;	// block of source shared by listeners
+	std::vector<Vec3d> mFramePos;		// source positions of previous and every frame
 	double mSpeedOfSound;		// distance per second
 	bool mPerSampleProcessing;
 };
@@ -0,0 +1,150 @@
+#ifndef INCLUDE_AL_FDN_REVERB_HPP
+#define INCLUDE_AL_FDN_REVERB_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+
+	File description:
+	Multichannel reverberator built from a feedback delay network (FDN)
+
+	The network is processed a block at a time: every delay line is read for
+	a whole block, the lines are mixed by a fast Hadamard transform and the
+	block is written back. This works as long as the shortest line is longer
+	than a block, and keeps the inner loops running over contiguous samples
+	so that compilers can vectorize them.
+*/
+
+#include <vector>
+
+namespace al{
+
+class AudioIOData;
+
+/// Feedback delay network reverberator with any number of outputs
+
+/// A mono input is fed into N delay lines, whose outputs are filtered,
+/// attenuated according to the decay time, mixed by a Hadamard matrix and
+/// fed back. Each output channel is a different combination of the delay
+/// lines, tapped at slightly different delays, so that outputs are
+/// decorrelated from one another; one instance can feed all speakers of a
+/// large array.
+///
+/// Design after:
+/// Jot, J.-M., & Chaigne, A. (1991). Digital delay networks for designing
+/// artificial reverberators. Audio Engineering Society Convention 90.
+///
+/// All memory is allocated by the constructor and numOutputs(), so process()
+/// can be called from the audio thread.
+///
+/// @ingroup allocore
+class FDNReverb{
+public:
+
+	enum{
+		BLOCK_SIZE = 64,	///< Number of frames processed at a time
+		MAX_LINES = 64		///< Maximum number of delay lines
+	};
+
+	/// @param[in] numLines		number of delay lines, rounded up to a power
+	///							of two in [4, MAX_LINES]; 8, 16 or 32 are typical
+	/// @param[in] numOutputs	number of decorrelated output channels
+	/// @param[in] sampleRate	sample rate, in Hz
+	FDNReverb(int numLines = 16, int numOutputs = 2, double sampleRate = 44100);
+
+
+	/// Set decay time, in seconds, for the level to fall by 60 dB
+	FDNReverb& decay(double seconds);
+
+	/// Set high-frequency damping amount, in [0, 1)
+
+	/// Higher amounts make high frequencies decay faster than the decay time.
+	FDNReverb& damping(float v);
+
+	/// Set number of output channels
+
+	/// This allocates memory and should not be called from the audio thread.
+	FDNReverb& numOutputs(int n);
+
+	/// Zero the delay lines and filters
+	void clear();
+
+
+	double decay() const { return mDecay; }
+	float damping() const { return mDamping; }
+	int numLines() const { return mNumLines; }
+	int numOutputs() const { return mNumOutputs; }
+	double sampleRate() const { return mSampleRate; }
+
+	/// Get length of a delay line, in samples
+	int lineLength(int i) const { return mLen[i]; }
+
+
+	/// Add wet output of a block of mono input to output buffers
+
+	/// @param[in]     in		input samples
+	/// @param[in,out] outs		one buffer per output channel, numOutputs() in all
+	/// @param[in]     numFrames	number of frames of input and outputs
+	/// @param[in]     gain		gain of wet output
+	void process(const float * in, float * const * outs, int numFrames, float gain = 1);
+
+	/// Add wet output of a block of mono input to the outputs of an audio stream
+
+	/// The output is added to the first min(numOutputs(), io.channelsOut())
+	/// channels.
+	/// @param[in,out] io		audio stream
+	/// @param[in]     in		io.framesPerBuffer() input samples
+	/// @param[in]     gain		gain of wet output
+	void process(AudioIOData& io, const float * in, float gain = 1);
+
+private:
+	int mNumLines, mNumOutputs;
+	double mSampleRate, mDecay;
+	float mDamping;
+
+	std::vector<float> mBuf;		// all delay lines, one after another
+	std::vector<int> mLen, mOff, mPos;
+	std::vector<float> mFeedback;	// per-line gain for the decay time
+	std::vector<float> mFilter;		// per-line lowpass state
+	std::vector<float> mInGain;
+	std::vector<float> mOutGain;	// numOutputs x numLines
+	std::vector<int> mOutTap;		// numOutputs x numLines, samples before line end
+	std::vector<float> mTaps;		// numLines x BLOCK_SIZE
+	std::vector<float *> mOuts;
+
+	void processBlock(const float * in, float * const * outs, int numOuts, int frame, int n, float gain);
+};
+
+} // al::
+
+#endif
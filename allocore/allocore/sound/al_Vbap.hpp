@@ -42,7 +42,10 @@
 	Ryan McGee, 2012, ryanmichaelmcgee@gmail.com
 */
 
+#include <atomic>
+#include <string>
 #include "allocore/sound/al_AudioScene.hpp"
+#include "allocore/system/al_Thread.hpp"
 
 #define MAX_NUM_VBAP_TRIPLETS 512
 #define MIN_VOLUME_TO_LENGTH_RATIO 0.01
@@ -59,13 +62,18 @@ struct SpeakerTriple{
 	int s3;
 	Vec3d s3Vec;
 	Vec3d vec[3];
-	Mat3d mat;
+	Mat3d mat;		///< Inverse of the matrix of speaker directions
 
 	void loadVectors(const std::vector<Speaker>& spkrs);
 };
 
 
 /// Vector-based amplitude panner
+
+/// In 3D, the speaker triplets are the faces of the convex hull of the speaker
+/// directions, which is found in O(n log n) time. Triplets can be cached on
+/// disk and a new layout can be compiled in the background while rendering
+/// continues with the current one.
 ///
 /// @ingroup allocore
 class Vbap : public Spatializer{
@@ -74,6 +82,8 @@ public:
 	/// @param[in] sl	A speaker layout
 	Vbap(const SpeakerLayout &sl);
 
+	~Vbap();
+
 	/// Add triplet of speakers
 	void addTriple(const SpeakerTriple& st);
 
@@ -90,16 +100,69 @@ public:
 
 	void compile(Listener& listener);
 
+
+	/// Compile a new speaker layout in a background thread
+
+	/// Rendering continues with the current speaker sets until the new ones
+	/// are found. They are then swapped in by the audio thread in prepare(),
+	/// which neither blocks nor frees memory. The new layout must not have
+	/// more speakers than the output has channels.
+	void recompile(const SpeakerLayout& sl);
+
+	/// Whether a recompile has not been swapped in yet
+	bool recompiling() const { return mBusy.load() || mPending.load(); }
+
+
+	/// Set directory in which to cache speaker sets
+
+	/// Speaker sets are stored in a file named after layoutHash(), from which
+	/// later compiles of the same layout load them. Caching is off if the
+	/// directory is empty, which is the default.
+	Vbap& cacheDirectory(const std::string& dir){ mCacheDir = dir; return *this; }
+
+	/// Get directory in which speaker sets are cached
+	const std::string& cacheDirectory() const { return mCacheDir; }
+
+	/// Get hash of the speaker directions of a layout
+	static unsigned long long layoutHash(const std::vector<Speaker>& spkrs, bool is3D);
+
+
+	void prepare();
+
 	void perform(AudioIOData& io, SoundSource& src, Vec3d& relpos, const int& numFrames, int& frameIndex, float& sample);
 
+	void perform(AudioIOData& io, SoundSource& src, Vec3d& relpos, const int& numFrames, float *samples);
+
 	void print();
 
 private:
+	struct Sets{
+		Speakers speakers;
+		std::vector<SpeakerTriple> triplets;
+	};
+
 	std::vector<SpeakerTriple> mTriplets;
 	unsigned mNumTriplets;
 	Listener* mListener;
 	unsigned int mCachedTripletIndex;
 	bool mIs3D;
+
+	std::string mCacheDir;
+	Thread mThread;
+	bool mThreadStarted;
+	Sets * mCompiling;				// owned by background thread
+	std::atomic<Sets *> mPending;	// compiled, waiting for prepare()
+	std::atomic<Sets *> mRetired;	// replaced in prepare(), to be freed
+	std::atomic<bool> mBusy;
+
+	void findSpeakerSets(const std::vector<Speaker>& spkrs, std::vector<SpeakerTriple>& sets) const;
+	std::string cachePath(const std::vector<Speaker>& spkrs) const;
+	bool loadSets(const std::vector<Speaker>& spkrs, std::vector<SpeakerTriple>& sets) const;
+	void saveSets(const std::vector<Speaker>& spkrs, const std::vector<SpeakerTriple>& sets) const;
+	static void * compileFunc(void * user);
+
+	Vbap(const Vbap&);
+	Vbap& operator=(const Vbap&);
 };
 
 } // al::
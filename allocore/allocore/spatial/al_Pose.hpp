@@ -47,6 +47,7 @@
 
 #include "allocore/math/al_Vec.hpp"
 #include "allocore/math/al_Quat.hpp"
+#include "allocore/math/al_QuatArray.hpp"
 #include <stdio.h>
 
 
@@ -413,6 +414,53 @@ protected:
 
 
 
+/// Array of poses with one array per component
+
+/// This is for transforming many poses at once; see al_QuatArray.hpp.
+///
+/// @ingroup allocore
+class PoseArray{
+public:
+
+	PoseArray(int size=0){ resize(size); }
+
+	/// Get number of poses
+	int size() const { return mPos.size(); }
+
+	/// Set number of poses; new ones are the identity
+	PoseArray& resize(int n){ mPos.resize(n); mQuat.resize(n); return *this; }
+
+	/// Get a pose
+	Pose get(int i) const { return Pose(mPos.get(i), mQuat.get(i)); }
+
+	/// Set a pose
+	PoseArray& set(int i, const Pose& p){
+		mPos.set(i, p.pos()); mQuat.set(i, p.quat()); return *this;
+	}
+
+	/// Get positions
+	Vec3Array<double>& pos(){ return mPos; }
+	const Vec3Array<double>& pos() const { return mPos; }
+
+	/// Get orientations
+	QuatArray<double>& quat(){ return mQuat; }
+	const QuatArray<double>& quat() const { return mQuat; }
+
+private:
+	Vec3Array<double> mPos;
+	QuatArray<double> mQuat;
+};
+
+
+/// Transform poses from local frames into their parents' frame
+
+/// The position of each output pose is parent.pos() plus local.pos()
+/// rotated by parent.quat(), and its orientation is parent.quat() *
+/// local.quat(). The output is resized to the inputs and may be one of them.
+void compose(const PoseArray& parent, const PoseArray& local, PoseArray& out);
+
+
+
 
 // Implementation --------------------------------------------------------------
 
@@ -64,6 +64,15 @@ public:
 		virtual void onExit() {}
 	};
 
+	// interface for handlers of file descriptors:
+	class FDHandler {
+	public:
+		virtual ~FDHandler();
+
+		/// called when a watched file descriptor has data to read
+		virtual void onReadable(int fd) = 0;
+	};
+
 	enum Driver {
 		SLEEP = 0,
 		GLUT,
@@ -120,6 +129,18 @@ public:
 	Main& add(Main::Handler& v);
 	Main& remove(Main::Handler& v);
 
+	/// call a handler whenever a file descriptor has data to read
+	/// with the NATIVE driver on Linux, the loop sleeps in epoll until a
+	/// descriptor is readable or the next tick is due; other drivers check
+	/// the descriptors at every tick. Not available on Windows.
+	Main& watch(int fd, Main::FDHandler& v);
+
+	/// stop watching a file descriptor
+	Main& unwatch(int fd);
+
+	/// stop watching all file descriptors of a handler
+	Main& unwatch(Main::FDHandler& v);
+
 	// INTERNAL USE:
 
 	/// trigger a mainloop step (typically for implementation use only)
@@ -128,6 +149,9 @@ public:
 	/// calls any registerd Handlers' onExit() methods
 	void exit();
 
+	/// calls the handler of a readable file descriptor
+	void readable(int fd);
+
 	// used to switch the driver
 	// typically not called by user code
 	// but e.g. creating a GLUT window will switch to GLUT mode
@@ -152,10 +176,18 @@ private:
 
 	std::vector<Handler *> mHandlers;
 
+	struct WatchedFD {
+		int fd;
+		FDHandler * handler;
+	};
+	std::vector<WatchedFD> mFDs;
+
 	bool mActive;
 	bool mInited[NUM_DRIVERS];
 
 	static al_sec timeInSec(){ return al_steady_time(); }
+
+	void pollFDs();
 };
 
 // deprecated; for backwards compatibility only
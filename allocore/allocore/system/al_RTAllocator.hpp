@@ -0,0 +1,305 @@
+#ifndef INCLUDE_AL_RT_ALLOCATOR_HPP
+#define INCLUDE_AL_RT_ALLOCATOR_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+
+	File description:
+	Memory allocation that is safe to use from real-time (audio) threads
+
+	All memory is reserved up front: fixed size blocks come from lock-free
+	pools and per-block scratch memory from a bump arena that is reset at the
+	start of every audio block. Allocations only fall back to the heap when a
+	pool is exhausted, which is counted.
+
+	When compiled with AL_RT_DEBUG, the global operator new counts, and
+	optionally traps, heap allocations made during an audio callback.
+*/
+
+#include <stddef.h>
+#include <atomic>
+#include <new>
+#include <vector>
+
+namespace al{
+
+/// Lock-free pool of fixed size memory blocks
+
+/// Any number of threads may allocate and free concurrently. The memory is
+/// allocated by the constructor; alloc() never allocates from the heap.
+///
+/// @ingroup allocore
+class FixedPool{
+public:
+
+	/// @param[in] blockSize	size of each block, in bytes
+	/// @param[in] numBlocks	number of blocks
+	FixedPool(size_t blockSize, unsigned numBlocks);
+
+	~FixedPool();
+
+	/// Get a block or NULL if all blocks are in use
+	void * alloc();
+
+	/// Return a block obtained from alloc()
+	void free(void * block);
+
+	/// Whether a pointer is a block of this pool
+	bool owns(const void * p) const {
+		return p >= mMem && p < mMem + mBlockSize*mNumBlocks;
+	}
+
+	size_t blockSize() const { return mBlockSize; }
+	unsigned capacity() const { return mNumBlocks; }
+	unsigned available() const { return mAvailable.load(); }
+
+private:
+	char * mMem;
+	size_t mBlockSize;
+	unsigned mNumBlocks;
+	std::atomic<unsigned long long> mHead;	// ABA tag in high, index+1 in low 32 bits
+	std::vector<std::atomic<unsigned> > mNext;
+	std::atomic<unsigned> mAvailable;
+
+	FixedPool(const FixedPool&);
+	FixedPool& operator=(const FixedPool&);
+};
+
+
+/// Bump allocator for memory that lives until the next reset
+
+/// Allocation only advances an offset, so it is constant time and cannot
+/// fail except when the arena is full. It is meant to be used by a single
+/// thread, e.g. for scratch buffers of one audio block.
+///
+/// @ingroup allocore
+class ScratchArena{
+public:
+
+	/// @param[in] capacity		size of arena, in bytes
+	ScratchArena(size_t capacity);
+
+	~ScratchArena();
+
+	/// Allocate memory or return NULL if the arena is full
+	void * alloc(size_t size, size_t align = 16);
+
+	/// Allocate an array of uninitialized elements
+	template <class T>
+	T * alloc(size_t n){ return static_cast<T *>(alloc(sizeof(T)*n, alignof(T) > 16 ? alignof(T) : 16)); }
+
+	/// Free all allocations at once
+	void reset(){ mUsed = 0; }
+
+	size_t used() const { return mUsed; }
+	size_t capacity() const { return mCapacity; }
+
+	/// Most memory used between resets
+	size_t highWater() const { return mHighWater; }
+
+	/// Number of allocations that did not fit
+	unsigned long overflows() const { return mOverflows; }
+
+private:
+	char * mMem;
+	size_t mCapacity, mUsed, mHighWater;
+	unsigned long mOverflows;
+
+	ScratchArena(const ScratchArena&);
+	ScratchArena& operator=(const ScratchArena&);
+};
+
+
+/// Real-time allocator of an audio stream
+
+/// This combines pools of blocks of a few size classes, for objects and
+/// messages that are created and destroyed in any thread, with a scratch
+/// arena for temporary buffers of the current audio block. When set on an
+/// AudioIO, the allocator is current on the audio thread and its scratch
+/// arena is reset at the start of every block.
+///
+/// Memory from allocate() can be freed from any thread with deallocate(),
+/// as each block records where it came from. The static malloc() and free()
+/// have the signature of MsgQueue's malloc_func and free_func, and RTAlloc
+/// is a standard allocator for containers such as Buffer and std::list; they
+/// use the current allocator of the calling thread, or the heap if none is.
+/// An allocator must outlive the memory allocated from it.
+///
+/// @ingroup allocore
+class RTAllocator{
+public:
+
+	enum{
+		NUM_CLASSES = 5			///< Number of size classes of pools
+	};
+
+	/// @param[in] blocksPerClass	number of blocks of each size class
+	///								(64, 256, 1024, 4096 and 16384 bytes)
+	/// @param[in] scratchSize		size of scratch arena, in bytes
+	RTAllocator(unsigned blocksPerClass = 256, size_t scratchSize = 1<<20);
+
+	~RTAllocator();
+
+
+	/// Allocate memory from the smallest fitting pool
+
+	/// If the size is larger than the largest block or the pool is
+	/// exhausted, the memory comes from the heap and heapFallbacks() is
+	/// incremented.
+	void * allocate(size_t size);
+
+	/// Free memory obtained from allocate() or malloc(), from any thread
+	static void deallocate(void * p);
+
+	/// Allocate scratch memory valid until the start of the next block
+	void * scratch(size_t size, size_t align = 16){ return mScratch.alloc(size, align); }
+
+	/// Allocate scratch array valid until the start of the next block
+	template <class T>
+	T * scratch(size_t n){ return mScratch.alloc<T>(n); }
+
+	ScratchArena& scratchArena(){ return mScratch; }
+	const FixedPool& pool(int sizeClass) const { return *mPools[sizeClass]; }
+
+
+	/// Start an audio block
+
+	/// This is called by AudioIO from the audio thread. It resets the scratch
+	/// arena and makes this the current allocator of the thread until
+	/// endBlock().
+	void beginBlock();
+
+	/// Finish an audio block started with beginBlock
+
+	/// This restores the allocator that was current before beginBlock().
+	///
+	void endBlock();
+
+	/// Whether the calling thread is between beginBlock and endBlock
+	bool inBlock() const;
+
+
+	/// Get the allocator current on the calling thread
+	static RTAllocator * current();
+
+	/// Make this the current allocator of the calling thread
+	void makeCurrent();
+
+	/// Make no allocator current on the calling thread
+	static void clearCurrent();
+
+	/// Allocate with the current allocator, or the heap if none is current
+	static void * malloc(size_t size);
+
+	/// Free memory from malloc() or allocate()
+	static void free(void * p);
+
+
+	/// Number of allocations that fell back to the heap
+	unsigned long heapFallbacks() const { return mHeapFallbacks.load(); }
+
+	/// Number of heap allocations made during audio blocks
+
+	/// This includes heap fallbacks during blocks and, if compiled with
+	/// AL_RT_DEBUG, every use of the global operator new.
+	unsigned long heapAllocationsInBlock() const { return mHeapInBlock.load(); }
+
+	/// Set whether to abort on heap allocations during audio blocks
+	RTAllocator& trapHeap(bool v){ mTrap=v; return *this; }
+
+	/// Whether the global operator new is checked (compiled with AL_RT_DEBUG)
+	static bool debugging();
+
+	/// Called on any heap allocation that should be checked
+	static void onHeapAllocation(size_t size);
+
+private:
+	FixedPool * mPools[NUM_CLASSES];
+	ScratchArena mScratch;
+	std::atomic<unsigned long> mHeapFallbacks, mHeapInBlock;
+	bool mTrap;
+	RTAllocator * mPrevCurrent;	// current before beginBlock
+	bool mPrevInBlock;
+
+	RTAllocator(const RTAllocator&);
+	RTAllocator& operator=(const RTAllocator&);
+};
+
+
+/// Standard allocator using RTAllocator::malloc and RTAllocator::free
+
+/// Use this for containers that grow in the audio thread, e.g.
+/// Buffer<float, RTAlloc<float> > or std::list<T, RTAlloc<T> >.
+///
+/// @ingroup allocore
+template <class T>
+class RTAlloc{
+public:
+	typedef T value_type;
+	typedef T * pointer;
+	typedef const T * const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <class U> struct rebind{ typedef RTAlloc<U> other; };
+
+	RTAlloc(){}
+	template <class U> RTAlloc(const RTAlloc<U>&){}
+
+	T * allocate(size_t n, const void * = 0){
+		void * p = RTAllocator::malloc(n * sizeof(T));
+		if(!p) throw std::bad_alloc();
+		return static_cast<T *>(p);
+	}
+	void deallocate(T * p, size_t){ RTAllocator::free(p); }
+
+	void construct(T * p, const T& v){ new((void *)p) T(v); }
+	void destroy(T * p){ p->~T(); }
+
+	size_t max_size() const { return size_t(-1) / sizeof(T); }
+	T * address(T& v) const { return &v; }
+	const T * address(const T& v) const { return &v; }
+};
+
+template <class T, class U>
+inline bool operator==(const RTAlloc<T>&, const RTAlloc<U>&){ return true; }
+
+template <class T, class U>
+inline bool operator!=(const RTAlloc<T>&, const RTAlloc<U>&){ return false; }
+
+} // al::
+
+#endif
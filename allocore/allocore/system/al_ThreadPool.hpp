@@ -0,0 +1,154 @@
+#ifndef INCLUDE_AL_THREAD_POOL_HPP
+#define INCLUDE_AL_THREAD_POOL_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+
+	File description:
+	Persistent pool of threads for parallel loops over index ranges
+
+	Each thread of a loop starts with an equal part of the range, from which
+	it takes small pieces. A thread that runs out of work steals half of what
+	is left of another thread's part, so uneven work is balanced while each
+	thread still works mostly on contiguous indices.
+*/
+
+#include <vector>
+
+namespace al{
+
+/// Persistent pool of threads for parallel loops
+
+/// The threads are created once and sleep between loops. The thread calling
+/// a loop takes part in it, and a loop started from within a loop of the
+/// same pool runs serially in the calling thread. Loops from several threads
+/// run one after the other.
+///
+/// This replaces Threads<> for splitting loops. Instead of setting up an
+/// interval for each thread function and calling start(), pass the body of
+/// the loop to parallelFor, e.g.
+/// \code
+///	ThreadPool::get().parallelFor(0, N, [&](int begin, int end){
+///		for(int i=begin; i<end; ++i) out[i] = f(in[i]);
+///	});
+/// \endcode
+///
+/// @ingroup allocore
+class ThreadPool{
+public:
+
+	/// Function called on a piece [begin, end) of a range by a thread
+	typedef void (*RangeFunc)(void * user, int begin, int end, int thread);
+
+
+	/// @param[in] size		number of threads, including the calling thread.
+	///						If 0, the number of processors is used.
+	ThreadPool(int size = 0);
+
+	~ThreadPool();
+
+	/// Get number of threads, including the calling thread
+	int size() const { return mSize; }
+
+	/// Get pool shared by the application, with a thread per processor
+	static ThreadPool& get();
+
+
+	/// Call func(begin, end) on pieces of [begin, end) in parallel
+
+	/// @param[in] begin	first index
+	/// @param[in] end		one past last index
+	/// @param[in] func		function object taking an int begin and end
+	/// @param[in] grain	maximum number of indices in a piece, or 0 to
+	///						choose it from the size of the range
+	template <class Func>
+	void parallelFor(int begin, int end, const Func& func, int grain = 0){
+		struct Call{
+			static void run(void * f, int b, int e, int){ (*(const Func *)f)(b, e); }
+		};
+		run(begin, end, &Call::run, (void *)&func, grain);
+	}
+
+	/// Combine results of func(begin, end) over pieces of [begin, end)
+
+	/// The results of the pieces are combined with reduce(T, T) in no
+	/// particular order, so reduce must be associative and commutative.
+	/// @param[in] begin	first index
+	/// @param[in] end		one past last index
+	/// @param[in] identity	identity value of reduce, e.g. 0 for a sum
+	/// @param[in] func		function object taking an int begin and end and
+	///						returning a T
+	/// @param[in] reduce	function object combining two T
+	/// @param[in] grain	maximum number of indices in a piece, or 0 to
+	///						choose it from the size of the range
+	template <class T, class Func, class Reduce>
+	T parallelReduce(int begin, int end, const T& identity, const Func& func, const Reduce& reduce, int grain = 0){
+		// Results of each thread are a cache line apart
+		const int stride = sizeof(T) < 64 ? (64 + sizeof(T) - 1) / sizeof(T) : 1;
+		std::vector<T> partial(size() * stride, identity);
+		struct Call{
+			const Func * func;
+			const Reduce * reduce;
+			T * partial;
+			int stride;
+			static void run(void * user, int b, int e, int thread){
+				Call& c = *(Call *)user;
+				T& p = c.partial[thread * c.stride];
+				p = (*c.reduce)(p, (*c.func)(b, e));
+			}
+		} call = { &func, &reduce, &partial[0], stride };
+		run(begin, end, &Call::run, &call, grain);
+		T res = identity;
+		for(int i=0; i<size(); ++i) res = reduce(res, partial[i * stride]);
+		return res;
+	}
+
+	/// Call a function on pieces of [begin, end) in parallel
+
+	/// The function also gets the index of the thread in [0, size()), which
+	/// is 0 for the calling thread.
+	void run(int begin, int end, RangeFunc func, void * user, int grain = 0);
+
+private:
+	class Impl;
+	Impl * mImpl;
+	int mSize;
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+} // al::
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef INCLUDE_AL_COLOR_ARRAY_HPP
+#define INCLUDE_AL_COLOR_ARRAY_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+
+	File description:
+	Conversion of arrays of colors between color spaces and colormaps
+
+	The conversions give the same results as those of the color classes in
+	al_Color.hpp on single colors, up to rounding, but have no branches and
+	no calls into the math library. The compiler thus vectorizes them, e.g.
+	with SSE2 at -O3 or AVX with -mavx. Large arrays can also be split among
+	the threads of a ThreadPool.
+*/
+
+#include "allocore/types/al_Array.hpp"
+#include "allocore/types/al_Color.hpp"
+
+namespace al{
+
+class ThreadPool;
+
+/// Function converting an array of colors between two color spaces
+
+/// The colors have three float components. Those of a color are adjacent,
+/// while colors are a stride apart. The source and destination may be the
+/// same memory.
+/// @param[in]  src			first component of first source color
+/// @param[out] dst			first component of first destination color
+/// @param[in]  n			number of colors
+/// @param[in]  srcStride	distance between source colors, in floats
+/// @param[in]  dstStride	distance between destination colors, in floats
+/// @param[in]  pool		pool to run on or NULL to run in the calling thread
+typedef void (*ColorConversion)(
+	const float * src, float * dst, int n,
+	int srcStride, int dstStride, ThreadPool * pool
+);
+
+/// Convert RGB colors to HSV
+void rgbToHSV(const float * src, float * dst, int n, int srcStride=3, int dstStride=3, ThreadPool * pool=NULL);
+
+/// Convert HSV colors to RGB; hues outside [0, 1] wrap around
+void hsvToRGB(const float * src, float * dst, int n, int srcStride=3, int dstStride=3, ThreadPool * pool=NULL);
+
+/// Convert sRGB colors to CIEXYZ (reference white D65)
+void rgbToXYZ(const float * src, float * dst, int n, int srcStride=3, int dstStride=3, ThreadPool * pool=NULL);
+
+/// Convert CIEXYZ colors to sRGB clamped to [0, 1]
+void xyzToRGB(const float * src, float * dst, int n, int srcStride=3, int dstStride=3, ThreadPool * pool=NULL);
+
+/// Convert CIEXYZ colors to Lab
+void xyzToLab(const float * src, float * dst, int n, int srcStride=3, int dstStride=3, ThreadPool * pool=NULL);
+
+/// Convert Lab colors to CIEXYZ
+void labToXYZ(const float * src, float * dst, int n, int srcStride=3, int dstStride=3, ThreadPool * pool=NULL);
+
+/// Convert sRGB colors to Lab, through CIEXYZ
+void rgbToLab(const float * src, float * dst, int n, int srcStride=3, int dstStride=3, ThreadPool * pool=NULL);
+
+/// Convert Lab colors to sRGB clamped to [0, 1], through CIEXYZ
+void labToRGB(const float * src, float * dst, int n, int srcStride=3, int dstStride=3, ThreadPool * pool=NULL);
+
+
+/// Convert the colors of an array between color spaces
+
+/// The source array must have float elements with at least three
+/// components; any components after the third are left out. If the
+/// destination does not have the dimensions of the source and at least
+/// three float components, it is formatted to three components. Any further
+/// components of the destination, e.g. alpha, are left as they are.
+/// @param[in]  func		conversion, e.g. rgbToLab
+/// @param[in]  src			source array
+/// @param[out] dst			destination array; may be the source array
+/// @param[in]  pool		pool to run on or NULL to run in the calling thread
+/// \returns false if the source array does not hold colors
+bool convertColors(ColorConversion func, const Array& src, Array& dst, ThreadPool * pool=NULL);
+
+
+inline void convert(const RGB * src, HSV * dst, int n, ThreadPool * pool=NULL){
+	rgbToHSV((const float *)src, (float *)dst, n, 3, 3, pool); }
+inline void convert(const HSV * src, RGB * dst, int n, ThreadPool * pool=NULL){
+	hsvToRGB((const float *)src, (float *)dst, n, 3, 3, pool); }
+inline void convert(const RGB * src, CIEXYZ * dst, int n, ThreadPool * pool=NULL){
+	rgbToXYZ((const float *)src, (float *)dst, n, 3, 3, pool); }
+inline void convert(const CIEXYZ * src, RGB * dst, int n, ThreadPool * pool=NULL){
+	xyzToRGB((const float *)src, (float *)dst, n, 3, 3, pool); }
+inline void convert(const CIEXYZ * src, Lab * dst, int n, ThreadPool * pool=NULL){
+	xyzToLab((const float *)src, (float *)dst, n, 3, 3, pool); }
+inline void convert(const Lab * src, CIEXYZ * dst, int n, ThreadPool * pool=NULL){
+	labToXYZ((const float *)src, (float *)dst, n, 3, 3, pool); }
+inline void convert(const RGB * src, Lab * dst, int n, ThreadPool * pool=NULL){
+	rgbToLab((const float *)src, (float *)dst, n, 3, 3, pool); }
+inline void convert(const Lab * src, RGB * dst, int n, ThreadPool * pool=NULL){
+	labToRGB((const float *)src, (float *)dst, n, 3, 3, pool); }
+
+// The alpha components of Colors are neither read nor written
+inline void convert(const Color * src, HSV * dst, int n, ThreadPool * pool=NULL){
+	rgbToHSV((const float *)src, (float *)dst, n, 4, 3, pool); }
+inline void convert(const HSV * src, Color * dst, int n, ThreadPool * pool=NULL){
+	hsvToRGB((const float *)src, (float *)dst, n, 3, 4, pool); }
+inline void convert(const Color * src, Lab * dst, int n, ThreadPool * pool=NULL){
+	rgbToLab((const float *)src, (float *)dst, n, 4, 3, pool); }
+inline void convert(const Lab * src, Color * dst, int n, ThreadPool * pool=NULL){
+	labToRGB((const float *)src, (float *)dst, n, 3, 4, pool); }
+
+
+/// Map values to colors by linear interpolation of a table
+
+/// Values from lo to hi map to the first to last entry of the table and
+/// values outside this range to the nearest end of the table.
+/// @param[in]  values		values to map
+/// @param[out] dst			colors of values
+/// @param[in]  n			number of values
+/// @param[in]  table		table of colors
+/// @param[in]  tableSize	number of colors in table
+/// @param[in]  lo			value mapping to the first color
+/// @param[in]  hi			value mapping to the last color
+/// @param[in]  pool		pool to run on or NULL to run in the calling thread
+void colormap(
+	const float * values, Color * dst, int n,
+	const Color * table, int tableSize, float lo=0, float hi=1,
+	ThreadPool * pool=NULL
+);
+
+/// Map values to 8-bit colors by linear interpolation of a table
+
+/// This converts the interpolated colors like Colori::operator=(const Color&).
+///
+void colormap(
+	const float * values, Colori * dst, int n,
+	const Color * table, int tableSize, float lo=0, float hi=1,
+	ThreadPool * pool=NULL
+);
+
+/// Map the values of an array to colors by linear interpolation of a table
+
+/// The source array must have one float component. If the destination
+/// has the dimensions of the source and four 8-bit components, e.g. to be
+/// uploaded to a texture, it receives Coloris. Otherwise it is formatted to
+/// four float components, if needed, and receives Colors.
+/// \returns false if the source array does not hold one float component
+bool colormap(
+	const Array& values, Array& dst,
+	const Color * table, int tableSize, float lo=0, float hi=1,
+	ThreadPool * pool=NULL
+);
+
+} // al::
+
+#endif
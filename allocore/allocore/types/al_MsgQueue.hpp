@@ -60,6 +60,10 @@ public:
 	typedef void * (*malloc_func)(size_t size);
 	typedef void (*free_func)(void * ptr);
 
+	/// @param[in] size		initial number of messages in pool
+	/// @param[in] mfunc	allocation function, e.g. RTAllocator::malloc for
+	///						allocation from an audio thread; malloc if NULL
+	/// @param[in] ffunc	deallocation function matching mfunc
 	MsgQueue(int size = 128, malloc_func mfunc = NULL, free_func ffunc = NULL);
 	~MsgQueue();
 
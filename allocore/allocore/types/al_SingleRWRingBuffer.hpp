@@ -90,6 +90,11 @@ public:
 	*/
 	size_t peek(char * dst, size_t sz);
 
+    /** Advance the read pointer by sz bytes without copying
+        Returns bytes actually skipped
+	*/
+	size_t skip(size_t sz);
+
 protected:
 
 	size_t mSize, mWrap;
@@ -195,6 +200,13 @@ inline size_t SingleRWRingBuffer :: peek(char * dst, size_t sz) {
 	return sz;
 }
 
+inline size_t SingleRWRingBuffer :: skip(size_t sz) {
+	size_t space = readSpace();
+	sz = sz > space ? space : sz;
+	mRead = (mRead + sz) & mWrap;
+	return sz;
+}
+
 
 } // al::
 
@@ -0,0 +1,96 @@
+/*
+Allocore Example: Audio Profiler
+
+Description:
+This shows how to find out how close the audio callback comes to its deadline
+and which stages use up the time. Every block of the stream is timed against
+the block period, and the audio scene times its own stages. A background
+thread collects the timings; once a second the statistics are printed and
+sent as OSC messages to port 16447, e.g. to plot them in another program:
+
+	/profile/block		mean p99 max load misses xruns
+	/profile/stage		name mean p99 max load
+
+Times are in seconds and load is the mean time per block as a fraction of the
+block period.
+*/
+
+#include <stdio.h>
+#include "allocore/al_Allocore.hpp"
+#include "allocore/sound/al_Dbap.hpp"
+using namespace al;
+
+struct Profiled{
+	SpeakerLayout layout;
+	Dbap dbap;
+	AudioScene scene;
+	std::vector<SoundSource *> sources;
+	double phase;
+
+	Profiled(int numSources, int blockSize)
+	:	layout(HeadsetSpeakerLayout()), dbap(layout), scene(blockSize), phase(0)
+	{
+		scene.createListener(&dbap);
+		for(int i=0; i<numSources; ++i){
+			SoundSource * src = new SoundSource;
+			src->pos(rnd::uniformS()*4, rnd::uniformS()*4, rnd::uniformS()*4);
+			scene.addSource(*src);
+			sources.push_back(src);
+		}
+	}
+
+	~Profiled(){
+		for(unsigned i=0; i<sources.size(); ++i) delete sources[i];
+	}
+};
+
+void audioCB(AudioIOData& io){
+	Profiled& p = io.user<Profiled>();
+
+	{	// A user-defined stage
+		AL_PROFILE_AUDIO("write sources");
+		for(int j=0; j<io.framesPerBuffer(); ++j){
+			float s = sin(p.phase) * 0.05;
+			p.phase += M_2PI * 220. / io.framesPerSecond();
+			for(unsigned i=0; i<p.sources.size(); ++i) p.sources[i]->writeSample(s);
+		}
+	}
+
+	// AudioScene::render and Spatializer::finalize are timed by the scene
+	p.scene.render(io);
+}
+
+int main(){
+	const int blockSize = 256;
+	Profiled profiled(64, blockSize);
+
+	AudioProfiler profiler;
+	profiler.start();
+
+	AudioIO io(blockSize, 44100, audioCB, &profiled, 2, 0);
+	io.profiler(&profiler);
+	io.start();
+
+	osc::Send osc(16447, "localhost");
+
+	printf("Profiling for ten seconds...\n");
+	for(int i=0; i<10; ++i){
+		al_sleep(1);
+
+		AudioProfiler::Stats b = profiler.blockStats();
+		osc.send("/profile/block", b.mean, b.p99, b.max, b.load,
+			int(profiler.deadlineMisses()), int(profiler.xruns()));
+
+		std::vector<AudioProfiler::Stats> stages = profiler.stageStats();
+		for(unsigned j=0; j<stages.size(); ++j){
+			const AudioProfiler::Stats& s = stages[j];
+			osc.send("/profile/stage", s.name, s.mean, s.p99, s.max, s.load);
+		}
+
+		printf("\n");
+		profiler.print();
+	}
+
+	io.stop();
+	profiler.stop();
+}
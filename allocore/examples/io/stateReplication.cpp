@@ -0,0 +1,64 @@
+/*
+Allocore Example: State Replication
+
+Description:
+This demonstrates how a simulator can share its state with any number of
+renderers. The state is a plain struct without pointers. The simulator sends
+it every frame to a multicast group and only the bytes that changed since the
+previous frame are transmitted. Each renderer always reads the newest complete
+state, without waiting on the network.
+
+Run one simulator and one or more renderers, on this or other machines:
+	stateReplication sim
+	stateReplication
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "allocore/al_Allocore.hpp"
+using namespace al;
+
+struct State{
+	Pose nav;
+	unsigned frame;
+	Vec3f particles[10000];
+};
+
+int main(int argc, char * argv[]){
+
+	State * state = new State;
+	memset(state, 0, sizeof(State));
+
+	if(argc > 1 && !strcmp(argv[1], "sim")){
+		StateSender sender(sizeof(State));
+		for(unsigned frame=0; ; ++frame){
+			state->frame = frame;
+			state->nav.pos(0, 0, frame * 0.01);
+			// Only a few particles move each frame
+			for(int i=0; i<100; ++i){
+				state->particles[rnd::uniform(10000)] = Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS());
+			}
+			sender.send(state);
+			al_sleep(1./60);
+
+			if(frame % 60 == 0){
+				printf("sent frame %u, %.1f%% of state size on the wire\n",
+					frame, 100. * sender.bytesSent() / sender.stateBytes());
+			}
+		}
+	}
+	else{
+		StateReceiver receiver(sizeof(State));
+		receiver.start();
+		while(true){
+			// This would be done once per frame in onAnimate()
+			if(receiver.update(*state) && state->frame % 60 == 0){
+				printf("received frame %u, z = %g, %llu frames dropped\n",
+					state->frame, state->nav.pos().z,
+					(unsigned long long)receiver.framesDropped());
+			}
+			al_sleep(1./60);
+		}
+	}
+	delete state;
+}
@@ -7,12 +7,16 @@ computing the mean of an array. The task is broken into individual work units
 that compute the sum of a unique sub-interval of the entire array. When the
 individual workers are done, their results are combined into the final result.
 
+The same sum is then computed with a ThreadPool, which splits the interval
+into pieces itself and balances them among its threads.
+
 Author:
 Lance Putnam, 1/2012
 */
 
 #include <stdio.h>
 #include "allocore/system/al_Thread.hpp"
+#include "allocore/system/al_ThreadPool.hpp"
 using namespace al;
 
 // The function each worker thread will execute
@@ -60,6 +64,16 @@ int main(){
 		sumPll += threads.function(i).sum;
 	}
 
+	// Compute with the shared thread pool
+	double sumPool = ThreadPool::get().parallelReduce(0, int(N), 0.,
+		[&](int begin, int end){
+			double sum = 0;
+			for(int i=begin; i<end; ++i) sum += data[i];
+			return sum;
+		},
+		[](double a, double b){ return a + b; }
+	);
+
 	// Compute serially for verification
 	double sumSer = 0;
 	for(unsigned i=0; i<N; ++i){
@@ -68,4 +82,5 @@ int main(){
 
 	printf("Correct : %g\n", sumSer/N);
 	printf("Computed: %g\n", sumPll/N);
+	printf("Pool    : %g\n", sumPool/N);
 }
@@ -4,6 +4,7 @@ find_package(APR QUIET)
 set(APR_HEADERS
     allocore/io/al_File.hpp
     allocore/io/al_Socket.hpp
+    allocore/protocol/al_StateReplication.hpp
     allocore/system/al_Memory.hpp
     allocore/system/al_Time.h
     allocore/system/al_Time.hpp
@@ -16,6 +17,7 @@ list(APPEND ALLOCORE_SRC
     src/io/al_File.cpp
     src/io/al_FileAPR.cpp
     src/io/al_SocketAPR.cpp
+    src/protocol/al_StateReplication.cpp
     src/system/al_Memory.cpp
     src/system/al_Time.cpp)
 
@@ -16,6 +16,7 @@ set(GL_HEADERS
     allocore/graphics/al_Slab.hpp
     allocore/graphics/al_Stereographic.hpp
     allocore/graphics/al_Texture.hpp
+    allocore/graphics/al_TextureUpload.hpp
     allocore/io/al_App.hpp
     allocore/io/al_ControlNav.hpp
     allocore/io/al_RenderToDisk.hpp
@@ -38,6 +39,7 @@ list(APPEND ALLOCORE_SRC
   src/graphics/al_Shapes.cpp
   src/graphics/al_Stereographic.cpp
   src/graphics/al_Texture.cpp
+  src/graphics/al_TextureUpload.cpp
   src/io/al_App.cpp
   src/io/al_RenderToDisk.cpp
   src/io/al_Window.cpp)
@@ -7,6 +7,7 @@ set(PORTAUDIO_HEADERS
     allocore/sound/al_AudioScene.hpp
     allocore/sound/al_Crossover.hpp
     allocore/sound/al_Dbap.hpp
+    allocore/sound/al_FDNReverb.hpp
     allocore/sound/al_Reverb.hpp
     allocore/sound/al_Speaker.hpp
     allocore/sound/al_Vbap.hpp
@@ -40,6 +41,7 @@ list(APPEND ALLOCORE_SRC
     src/sound/al_AudioScene.cpp
     src/sound/al_Ambisonics.cpp
     src/sound/al_Dbap.cpp
+    src/sound/al_FDNReverb.cpp
     src/sound/al_Vbap.cpp
     src/sound/al_Biquad.cpp
 )
@@ -20,8 +20,21 @@
 
 #endif
 
+#include <ctype.h>
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <thread>
+
+#if defined(AL_LINUX) || defined(AL_OSX)
+	#define AL_ASSET_USE_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 using namespace al;
 
@@ -66,39 +79,647 @@ int countNodes(const aiNode * n) {
 
 class Scene::Node::Impl {
 public:
-	Impl(const aiNode * node) : node(node) {}
-	
-	const aiNode * node;
+	Impl(const std::string& name) : name(name) {}
+
+	std::string name;
 };
 
 
+namespace {
+
+// A mesh with its attributes in flat arrays, shared by all vertices
+struct MeshData {
+	std::string name;
+	unsigned material;
+	int primitive;
+
+	// Arrays point either into the storage below or into a cache file
+	const Vec3f * vertices;
+	const Vec3f * normals;
+	const Color * colors;
+	const Vec2f * texCoords;
+	const unsigned * indices;
+	unsigned numVertices, numIndices;
+
+	std::vector<Vec3f> vertexStore, normalStore;
+	std::vector<Color> colorStore;
+	std::vector<Vec2f> texCoordStore;
+	std::vector<unsigned> indexStore;
+
+	MeshData()
+	:	material(0), primitive(Graphics::TRIANGLES),
+		vertices(0), normals(0), colors(0), texCoords(0), indices(0),
+		numVertices(0), numIndices(0)
+	{}
+
+	void convert(const aiMesh * amesh){
+		name = amesh->mName.data;
+		material = amesh->mMaterialIndex;
+		numVertices = amesh->mNumVertices;
+
+		if(amesh->mNumFaces){
+			switch(amesh->mFaces[0].mNumIndices) {
+				case 1: primitive = Graphics::POINTS; break;
+				case 2: primitive = Graphics::LINES; break;
+				case 3: primitive = Graphics::TRIANGLES; break;
+				default: primitive = Graphics::POLYGON; break;
+			}
+		}
+
+		vertexStore.resize(numVertices);
+		for(unsigned i=0; i<numVertices; ++i){
+			vertexStore[i] = vec3FromAIVector3D(amesh->mVertices[i]);
+		}
+		if(amesh->mNormals){
+			normalStore.resize(numVertices);
+			for(unsigned i=0; i<numVertices; ++i){
+				normalStore[i] = vec3FromAIVector3D(amesh->mNormals[i]);
+			}
+		}
+		if(amesh->mColors[0]){
+			colorStore.resize(numVertices);
+			for(unsigned i=0; i<numVertices; ++i){
+				const aiColor4D& c = amesh->mColors[0][i];
+				colorStore[i] = Color(c.r, c.g, c.b, c.a);
+			}
+		}
+		if(amesh->mTextureCoords[0]){
+			texCoordStore.resize(numVertices);
+			for(unsigned i=0; i<numVertices; ++i){
+				texCoordStore[i] = vec2FromAIVector3D(amesh->mTextureCoords[0][i]);
+			}
+		}
+
+		unsigned Ni = 0;
+		for(unsigned t=0; t<amesh->mNumFaces; ++t) Ni += amesh->mFaces[t].mNumIndices;
+		indexStore.resize(Ni);
+		Ni = 0;
+		for(unsigned t=0; t<amesh->mNumFaces; ++t){
+			const aiFace& face = amesh->mFaces[t];
+			for(unsigned i=0; i<face.mNumIndices; ++i) indexStore[Ni++] = face.mIndices[i];
+		}
+		numIndices = Ni;
+
+		useStorage();
+	}
+
+	void useStorage(){
+		vertices = vertexStore.empty() ? 0 : &vertexStore[0];
+		normals = normalStore.empty() ? 0 : &normalStore[0];
+		colors = colorStore.empty() ? 0 : &colorStore[0];
+		texCoords = texCoordStore.empty() ? 0 : &texCoordStore[0];
+		indices = indexStore.empty() ? 0 : &indexStore[0];
+	}
+};
+
+
+// Run func(i) for i in [0, n) on all hardware threads
+template <class Func>
+void parallelFor(unsigned n, Func func){
+	unsigned numThreads = std::min(n, std::max(1u, std::thread::hardware_concurrency()));
+	if(numThreads <= 1){
+		for(unsigned i=0; i<n; ++i) func(i);
+		return;
+	}
+	std::atomic<unsigned> next(0);
+	std::vector<std::thread> threads;
+	for(unsigned t=0; t<numThreads; ++t){
+		threads.push_back(std::thread([&](){
+			for(unsigned i; (i = next++) < n;) func(i);
+		}));
+	}
+	for(unsigned t=0; t<numThreads; ++t) threads[t].join();
+}
+
+
+/*
+Binary scene cache
+
+All numbers are in the byte order of the machine that wrote the cache. The
+attribute arrays of each mesh are stored contiguously and aligned to 16 bytes
+so they can be used directly from a memory mapping of the file.
+
+	CacheHeader
+	CacheMesh[numMeshes]
+	names, materials and dependencies (see save/load)
+	attribute arrays
+
+Dependencies are the other files the import reads, i.e. material libraries
+and textures, stored with their hash and size so edits to them invalidate
+the cache as well.
+*/
+const char cacheMagic[8] = {'A','L','S','C','E','N','E','\0'};
+const uint32_t cacheVersion = 2;
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t preset;
+	uint64_t sourceHash;
+	uint64_t sourceSize;
+	uint32_t numMeshes, numMaterials, numNodes, numTextures;
+	float bounds[6];
+	uint64_t metaOffset, metaSize;
+	uint64_t fileSize;
+};
+
+struct CacheMesh {
+	enum { VERTICES, NORMALS, COLORS, TEXCOORDS, INDICES, NUM_ARRAYS };
+	uint64_t offsets[NUM_ARRAYS];	// 0 if array not present
+	uint32_t numVertices, numIndices;
+	uint32_t material;
+	int32_t primitive;
+};
+
+uint64_t align16(uint64_t v){ return (v + 15) & ~uint64_t(15); }
+
+// 64-bit FNV-1a over 8-byte words
+bool hashFile(const std::string& path, uint64_t& hash, uint64_t& size){
+	FILE * fp = fopen(path.c_str(), "rb");
+	if(!fp) return false;
+	hash = 14695981039346656037ULL;
+	size = 0;
+	std::vector<uint64_t> buf(1<<16);
+	size_t n;
+	while((n = fread(&buf[0], 1, buf.size()*8, fp)) > 0){
+		if(n & 7) memset((char *)&buf[0] + n, 0, 8 - (n & 7));
+		for(size_t i=0; i<(n+7)/8; ++i){
+			hash = (hash ^ buf[i]) * 1099511628211ULL;
+		}
+		size += n;
+	}
+	fclose(fp);
+	return true;
+}
+
+// Missing files hash to 0 with size 0, so they match until they appear
+void hashDependency(const std::string& path, uint64_t& hash, uint64_t& size){
+	if(!hashFile(path, hash, size)){
+		hash = 0;
+		size = 0;
+	}
+}
+
+bool absolutePath(const std::string& path){
+	return !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+}
+
+// Files besides the asset itself that affect the imported scene
+std::vector<std::string> findDependencies(
+	const std::string& path, const std::vector<Scene::Material>& materials
+){
+	std::string dir;
+	size_t slash = path.find_last_of("/\\");
+	if(slash != std::string::npos) dir = path.substr(0, slash+1);
+
+	std::vector<std::string> deps;
+	#define RESOLVE(name) (absolutePath(name) ? (name) : dir + (name))
+
+	// Material libraries of OBJ files
+	std::string ext = path.substr(std::min(path.size(), path.find_last_of('.')));
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	if(ext == ".obj"){
+		FILE * fp = fopen(path.c_str(), "r");
+		if(fp){
+			char line[1024];
+			while(fgets(line, sizeof line, fp)){
+				if(strncmp(line, "mtllib", 6) != 0 || !isspace(line[6])) continue;
+				for(char * tok = strtok(line+6, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")){
+					deps.push_back(RESOLVE(std::string(tok)));
+				}
+			}
+			fclose(fp);
+		}
+	}
+
+	// Textures, except embedded ones ("*0", "*1", ...)
+	for(unsigned i=0; i<materials.size(); ++i){
+		const Scene::Material& m = materials[i];
+		const Scene::Material::TextureProperty * maps[] = {
+			&m.diffusemap, &m.ambientmap, &m.specularmap, &m.opacitymap,
+			&m.emissivemap, &m.shininessmap, &m.lightmap, &m.normalmap,
+			&m.heightmap, &m.displacementmap, &m.reflectionmap
+		};
+		for(unsigned k=0; k<sizeof(maps)/sizeof(maps[0]); ++k){
+			const std::string& tex = maps[k]->texture;
+			if(maps[k]->useTexture && !tex.empty() && tex[0] != '*'){
+				deps.push_back(RESOLVE(tex));
+			}
+		}
+		if(!m.background.empty()) deps.push_back(RESOLVE(m.background));
+	}
+	#undef RESOLVE
+
+	std::sort(deps.begin(), deps.end());
+	deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+	return deps;
+}
+
+void putString(std::string& dst, const std::string& s){
+	uint32_t n = s.size();
+	dst.append((const char *)&n, 4);
+	dst.append(s);
+}
+
+template <class T>
+void putPOD(std::string& dst, const T& v){
+	dst.append((const char *)&v, sizeof(T));
+}
+
+struct MetaReader {
+	const char * pos;
+	const char * end;
+	bool ok;
+
+	MetaReader(const char * data, size_t size): pos(data), end(data + size), ok(true){}
+
+	template <class T>
+	void get(T& v){
+		if(pos + sizeof(T) > end){ ok = false; return; }
+		memcpy(&v, pos, sizeof(T));
+		pos += sizeof(T);
+	}
+
+	void get(std::string& s){
+		uint32_t n = 0;
+		get(n);
+		if(!ok || pos + n > end){ ok = false; return; }
+		s.assign(pos, n);
+		pos += n;
+	}
+};
+
+void putTexture(std::string& dst, const Scene::Material::TextureProperty& t){
+	putPOD(dst, uint8_t(t.useTexture));
+	putString(dst, t.texture);
+}
+
+void getTexture(MetaReader& r, Scene::Material::TextureProperty& t){
+	uint8_t use = 0;
+	r.get(use);
+	t.useTexture = use;
+	r.get(t.texture);
+}
+
+void putMaterial(std::string& dst, const Scene::Material& m){
+	putString(dst, m.name);
+	putPOD(dst, m.two_sided); putPOD(dst, m.wireframe);
+	putPOD(dst, m.diffuse); putPOD(dst, m.ambient);
+	putPOD(dst, m.specular); putPOD(dst, m.emissive);
+	putPOD(dst, m.shininess);
+	putPOD(dst, m.shading_model); putPOD(dst, m.blend_func);
+	putPOD(dst, m.shininess_strength); putPOD(dst, m.opacity);
+	putPOD(dst, m.reflectivity); putPOD(dst, m.refracti);
+	putPOD(dst, m.bump_scaling);
+	putPOD(dst, m.transparent); putPOD(dst, m.reflective);
+	putTexture(dst, m.diffusemap); putTexture(dst, m.ambientmap);
+	putTexture(dst, m.specularmap); putTexture(dst, m.opacitymap);
+	putTexture(dst, m.emissivemap); putTexture(dst, m.shininessmap);
+	putTexture(dst, m.lightmap); putTexture(dst, m.normalmap);
+	putTexture(dst, m.heightmap); putTexture(dst, m.displacementmap);
+	putTexture(dst, m.reflectionmap);
+	putString(dst, m.background);
+}
+
+void getMaterial(MetaReader& r, Scene::Material& m){
+	r.get(m.name);
+	r.get(m.two_sided); r.get(m.wireframe);
+	r.get(m.diffuse); r.get(m.ambient);
+	r.get(m.specular); r.get(m.emissive);
+	r.get(m.shininess);
+	r.get(m.shading_model); r.get(m.blend_func);
+	r.get(m.shininess_strength); r.get(m.opacity);
+	r.get(m.reflectivity); r.get(m.refracti);
+	r.get(m.bump_scaling);
+	r.get(m.transparent); r.get(m.reflective);
+	getTexture(r, m.diffusemap); getTexture(r, m.ambientmap);
+	getTexture(r, m.specularmap); getTexture(r, m.opacitymap);
+	getTexture(r, m.emissivemap); getTexture(r, m.shininessmap);
+	getTexture(r, m.lightmap); getTexture(r, m.normalmap);
+	getTexture(r, m.heightmap); getTexture(r, m.displacementmap);
+	getTexture(r, m.reflectionmap);
+	r.get(m.background);
+}
+
+bool useCache = false;
+
+} // ::
+
+
+void get_bounding_box_for_node(const aiScene * scene, const struct aiNode* nd, Vec3f& min, Vec3f& max, aiMatrix4x4* trafo);
+
+
 class Scene::Impl /*: public SceneNode::Impl*/ {
 public:
-	Impl(const aiScene * scene) : /* SceneNode::Impl(scene->mRootNode),*/ scene(scene) {
+	Impl(const aiScene * scene) : /* SceneNode::Impl(scene->mRootNode),*/ scene(scene), numTextures(0), cacheData(0), cacheSize(0) {
 		nodes.resize(countNodes(scene->mRootNode));
 		addNode(scene->mRootNode, 0);
+		numTextures = scene->mNumTextures;
+
+		// Meshes are independent, so convert them concurrently
+		meshes.resize(scene->mNumMeshes);
+		parallelFor(scene->mNumMeshes, [&](unsigned i){
+			if(scene->mMeshes[i]) meshes[i].convert(scene->mMeshes[i]);
+		});
+
+		aiMatrix4x4 trafo;
+		aiIdentityMatrix4(&trafo);
+		boundsMin.set(1e10f, 1e10f, 1e10f);
+		boundsMax.set(-1e10f, -1e10f, -1e10f);
+		get_bounding_box_for_node(scene, scene->mRootNode, boundsMin, boundsMax, &trafo);
 	}
-	
+
+	Impl() : scene(0), numTextures(0), cacheData(0), cacheSize(0) {}
+
 	~Impl() {
-		aiReleaseImport(scene);
+		if(scene) aiReleaseImport(scene);
+		unmapCache();
 	}
-	
+
 	int addNode(const aiNode * n, int idx) {
-		nodes[idx].mImpl = new Scene::Node::Impl(n);
-		nodeMap[n] = idx;
+		nodes[idx].mImpl = new Scene::Node::Impl(n->mName.data);
 		for (unsigned int i=0; i<n->mNumChildren; i++) {
 			idx = addNode(n->mChildren[i], idx+1);
 		}
 		return idx;
 	}
-	
-	const aiScene * scene;
-	
-	std::map<const aiNode *, int> nodeMap;
+
+	bool save(
+		const std::string& path, const std::vector<Material>& materials,
+		uint32_t preset, uint64_t sourceHash, uint64_t sourceSize,
+		const std::vector<std::string>& dependencies
+	) const;
+
+	static Impl * load(
+		const std::string& path, std::vector<Material>& materials,
+		uint32_t preset, uint64_t sourceHash, uint64_t sourceSize
+	);
+
+	bool mapCache(const std::string& path);
+	void unmapCache();
+
+	const aiScene * scene;	// NULL if loaded from cache
+
 	std::vector<Node> nodes;
+	std::vector<MeshData> meshes;
+	Vec3f boundsMin, boundsMax;
+	unsigned numTextures;
+
+	const char * cacheData;
+	size_t cacheSize;
+	#ifndef AL_ASSET_USE_MMAP
+	std::vector<char> cacheStore;
+	#endif
 };
 
 
+bool Scene::Impl::save(
+	const std::string& path, const std::vector<Material>& materials,
+	uint32_t preset, uint64_t sourceHash, uint64_t sourceSize,
+	const std::vector<std::string>& dependencies
+) const {
+	CacheHeader h;
+	memset(&h, 0, sizeof h);
+	memcpy(h.magic, cacheMagic, 8);
+	h.version = cacheVersion;
+	h.preset = preset;
+	h.sourceHash = sourceHash;
+	h.sourceSize = sourceSize;
+	h.numMeshes = meshes.size();
+	h.numMaterials = materials.size();
+	h.numNodes = nodes.size();
+	h.numTextures = numTextures;
+	for(int i=0; i<3; ++i){
+		h.bounds[i] = boundsMin[i];
+		h.bounds[i+3] = boundsMax[i];
+	}
+
+	std::string meta;
+	for(unsigned i=0; i<meshes.size(); ++i) putString(meta, meshes[i].name);
+	for(unsigned i=0; i<nodes.size(); ++i) putString(meta, nodes[i].name());
+	for(unsigned i=0; i<materials.size(); ++i) putMaterial(meta, materials[i]);
+	putPOD(meta, uint32_t(dependencies.size()));
+	for(unsigned i=0; i<dependencies.size(); ++i){
+		uint64_t depHash, depSize;
+		hashDependency(dependencies[i], depHash, depSize);
+		putString(meta, dependencies[i]);
+		putPOD(meta, depHash);
+		putPOD(meta, depSize);
+	}
+	h.metaOffset = sizeof(CacheHeader) + meshes.size() * sizeof(CacheMesh);
+	h.metaSize = meta.size();
+
+	// Lay out attribute arrays
+	std::vector<CacheMesh> table(meshes.size());
+	uint64_t offset = align16(h.metaOffset + h.metaSize);
+	for(unsigned i=0; i<meshes.size(); ++i){
+		const MeshData& m = meshes[i];
+		CacheMesh& c = table[i];
+		memset(&c, 0, sizeof c);
+		c.numVertices = m.numVertices;
+		c.numIndices = m.numIndices;
+		c.material = m.material;
+		c.primitive = m.primitive;
+		uint64_t sizes[CacheMesh::NUM_ARRAYS] = {
+			m.vertices ? m.numVertices * sizeof(Vec3f) : 0,
+			m.normals ? m.numVertices * sizeof(Vec3f) : 0,
+			m.colors ? m.numVertices * sizeof(Color) : 0,
+			m.texCoords ? m.numVertices * sizeof(Vec2f) : 0,
+			m.indices ? m.numIndices * sizeof(unsigned) : 0
+		};
+		for(int a=0; a<CacheMesh::NUM_ARRAYS; ++a){
+			if(sizes[a]){
+				c.offsets[a] = offset;
+				offset = align16(offset + sizes[a]);
+			}
+		}
+	}
+	h.fileSize = offset;
+
+	// Write to a temporary file and rename, so readers never see a partial file
+	std::string tmpPath = path + ".tmp";
+	FILE * fp = fopen(tmpPath.c_str(), "wb");
+	if(!fp) return false;
+
+	bool ok = true;
+	uint64_t pos = 0;
+	struct F{
+		static bool write(FILE * fp, uint64_t& pos, uint64_t at, const void * src, uint64_t size){
+			static const char zeros[16] = {0};
+			if(at > pos && fwrite(zeros, 1, at - pos, fp) != at - pos) return false;
+			pos = at + size;
+			return fwrite(src, 1, size, fp) == size;
+		}
+	};
+	ok &= F::write(fp, pos, 0, &h, sizeof h);
+	if(!table.empty()) ok &= F::write(fp, pos, pos, &table[0], table.size() * sizeof(CacheMesh));
+	ok &= F::write(fp, pos, h.metaOffset, meta.data(), meta.size());
+	for(unsigned i=0; i<meshes.size() && ok; ++i){
+		const MeshData& m = meshes[i];
+		const CacheMesh& c = table[i];
+		const void * arrays[CacheMesh::NUM_ARRAYS] = { m.vertices, m.normals, m.colors, m.texCoords, m.indices };
+		uint64_t sizes[CacheMesh::NUM_ARRAYS] = {
+			m.numVertices * sizeof(Vec3f), m.numVertices * sizeof(Vec3f),
+			m.numVertices * sizeof(Color), m.numVertices * sizeof(Vec2f),
+			m.numIndices * sizeof(unsigned)
+		};
+		for(int a=0; a<CacheMesh::NUM_ARRAYS; ++a){
+			if(c.offsets[a]) ok &= F::write(fp, pos, c.offsets[a], arrays[a], sizes[a]);
+		}
+	}
+	if(pos < h.fileSize){
+		static const char zeros[16] = {0};
+		ok &= fwrite(zeros, 1, h.fileSize - pos, fp) == h.fileSize - pos;
+	}
+	ok &= 0 == fclose(fp);
+
+	if(ok){
+		remove(path.c_str());
+		ok = 0 == rename(tmpPath.c_str(), path.c_str());
+	}
+	if(!ok) remove(tmpPath.c_str());
+	return ok;
+}
+
+
+bool Scene::Impl::mapCache(const std::string& path){
+	#ifdef AL_ASSET_USE_MMAP
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheHeader)){
+		close(fd);
+		return false;
+	}
+	void * p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(MAP_FAILED == p) return false;
+	cacheData = (const char *)p;
+	cacheSize = st.st_size;
+	return true;
+
+	#else
+	FILE * fp = fopen(path.c_str(), "rb");
+	if(!fp) return false;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	bool ok = size >= (long)sizeof(CacheHeader);
+	if(ok){
+		// Over-allocate to align the arrays to 16 bytes
+		cacheStore.resize(size + 16);
+		char * data = &cacheStore[0];
+		data += (16 - (uintptr_t)data % 16) % 16;
+		ok = fread(data, 1, size, fp) == (size_t)size;
+		cacheData = data;
+		cacheSize = size;
+	}
+	fclose(fp);
+	return ok;
+	#endif
+}
+
+void Scene::Impl::unmapCache(){
+	#ifdef AL_ASSET_USE_MMAP
+	if(cacheData) munmap((void *)cacheData, cacheSize);
+	#else
+	cacheStore.clear();
+	#endif
+	cacheData = 0;
+	cacheSize = 0;
+}
+
+
+Scene::Impl * Scene::Impl::load(
+	const std::string& path, std::vector<Material>& materials,
+	uint32_t preset, uint64_t sourceHash, uint64_t sourceSize
+){
+	Impl * impl = new Impl;
+	if(!impl->mapCache(path)){
+		delete impl;
+		return NULL;
+	}
+
+	const char * data = impl->cacheData;
+	CacheHeader h;
+	memcpy(&h, data, sizeof h);
+	bool ok =
+		0 == memcmp(h.magic, cacheMagic, 8)
+		&& h.version == cacheVersion
+		&& h.preset == preset
+		&& h.sourceHash == sourceHash
+		&& h.sourceSize == sourceSize
+		&& h.fileSize == impl->cacheSize
+		&& h.metaOffset == sizeof(CacheHeader) + uint64_t(h.numMeshes) * sizeof(CacheMesh)
+		&& h.metaOffset + h.metaSize <= h.fileSize;
+
+	if(ok){
+		const CacheMesh * table = (const CacheMesh *)(data + sizeof(CacheHeader));
+		impl->meshes.resize(h.numMeshes);
+		impl->nodes.resize(h.numNodes);
+		materials.resize(h.numMaterials);
+
+		MetaReader meta(data + h.metaOffset, h.metaSize);
+		for(unsigned i=0; i<h.numMeshes; ++i) meta.get(impl->meshes[i].name);
+		for(unsigned i=0; i<h.numNodes; ++i){
+			std::string name;
+			meta.get(name);
+			impl->nodes[i].mImpl = new Scene::Node::Impl(name);
+		}
+		for(unsigned i=0; i<h.numMaterials; ++i) getMaterial(meta, materials[i]);
+		uint32_t numDeps = 0;
+		meta.get(numDeps);
+		for(unsigned i=0; i<numDeps && meta.ok && ok; ++i){
+			std::string depPath;
+			uint64_t depHash = 0, depSize = 0, curHash, curSize;
+			meta.get(depPath);
+			meta.get(depHash);
+			meta.get(depSize);
+			hashDependency(depPath, curHash, curSize);
+			ok = curHash == depHash && curSize == depSize;
+		}
+		ok = ok && meta.ok;
+
+		for(unsigned i=0; i<h.numMeshes && ok; ++i){
+			const CacheMesh& c = table[i];
+			MeshData& m = impl->meshes[i];
+			m.numVertices = c.numVertices;
+			m.numIndices = c.numIndices;
+			m.material = c.material;
+			m.primitive = c.primitive;
+			uint64_t sizes[CacheMesh::NUM_ARRAYS] = {
+				c.numVertices * sizeof(Vec3f), c.numVertices * sizeof(Vec3f),
+				c.numVertices * sizeof(Color), c.numVertices * sizeof(Vec2f),
+				c.numIndices * sizeof(unsigned)
+			};
+			for(int a=0; a<CacheMesh::NUM_ARRAYS; ++a){
+				if(c.offsets[a] && (c.offsets[a] % 16 || c.offsets[a] + sizes[a] > h.fileSize)){
+					ok = false;
+				}
+			}
+			if(!ok) break;
+			#define ARRAY(a, Type) (c.offsets[a] ? (const Type *)(data + c.offsets[a]) : 0)
+			m.vertices = ARRAY(CacheMesh::VERTICES, Vec3f);
+			m.normals = ARRAY(CacheMesh::NORMALS, Vec3f);
+			m.colors = ARRAY(CacheMesh::COLORS, Color);
+			m.texCoords = ARRAY(CacheMesh::TEXCOORDS, Vec2f);
+			m.indices = ARRAY(CacheMesh::INDICES, unsigned);
+			#undef ARRAY
+		}
+
+		impl->numTextures = h.numTextures;
+		impl->boundsMin.set(h.bounds[0], h.bounds[1], h.bounds[2]);
+		impl->boundsMax.set(h.bounds[3], h.bounds[4], h.bounds[5]);
+	}
+
+	if(!ok){
+		delete impl;
+		return NULL;
+	}
+	return impl;
+}
+
+
 Scene::Material :: Material() 
 :	shading_model(0), 
 	two_sided(0), 
@@ -123,15 +744,39 @@ Scene::Node :: Node() : mImpl(0) {}
 Scene::Node :: ~Node() { if (mImpl) delete mImpl; }
 
 std::string Scene::Node :: name() const {
-	return std::string(mImpl->node->mName.data);
+	return mImpl->name;
 }
 
 void Scene::verbose(bool b) {
 	aiEnableVerboseLogging(b);
 }
 
+void Scene::cache(bool enable) {
+	useCache = enable;
+}
+
+std::string Scene::cachePath(const std::string& path) {
+	return path + ".alscene";
+}
+
+bool Scene::cached() const {
+	return NULL == mImpl->scene;
+}
+
 
 Scene * Scene :: import(const std::string& path, ImportPreset preset) {
+	uint64_t hash = 0, size = 0;
+	bool canCache = useCache && hashFile(path, hash, size);
+	if (canCache) {
+		std::vector<Material> materials;
+		Impl * impl = Impl::load(cachePath(path), materials, preset, hash, size);
+		if (impl) {
+			Scene * s = new Scene(impl);
+			s->mMaterials.swap(materials);
+			return s;
+		}
+	}
+
 	initLogStream();
 	int flags=0;
 	switch (preset) {
@@ -151,6 +796,12 @@ Scene * Scene :: import(const std::string& path, ImportPreset preset) {
 	if (scene) {
 		Impl * impl = new Impl(scene);
 		Scene * s = new Scene(impl);
+		if (canCache && !impl->save(
+			cachePath(path), s->mMaterials, preset, hash, size,
+			findDependencies(path, s->mMaterials)
+		)) {
+			AL_WARN("Could not write scene cache %s", cachePath(path).c_str());
+		}
 		return s;
 	} else {
 		return NULL;
@@ -159,7 +810,10 @@ Scene * Scene :: import(const std::string& path, ImportPreset preset) {
 }
 
 Scene :: Scene(Impl * impl) : mImpl(impl) {
-	
+
+	// Materials of cached scenes are read from the cache
+	if (!mImpl->scene) return;
+
 	mMaterials.resize(materials());
 	for (unsigned int i=0; i<materials(); i++) {
 		Scene::Material& m = mMaterials[i];
@@ -247,46 +901,30 @@ Scene :: ~Scene() {
 }
 
 unsigned int Scene :: meshes() const {
-	return mImpl->scene->mNumMeshes;
+	return mImpl->meshes.size();
 }
 
 void Scene :: mesh(unsigned int i, Mesh& mesh) const {
 	if (i < meshes()) {
-		aiMesh * amesh = mImpl->scene->mMeshes[i];
-		if (amesh) {
+		const MeshData& m = mImpl->meshes[i];
+		if (m.numIndices) {
 			//mesh.reset();
-			
-			bool hasnormals = amesh->mNormals != NULL;
-			bool hascolors = amesh->mColors[0] != NULL;
-			bool hastexcoords = amesh->mTextureCoords[0] != NULL;
-			
-			const struct aiFace* face = &amesh->mFaces[0];
-			Graphics::Primitive prim;
-			switch(face->mNumIndices) {
-				case 1: prim = Graphics::POINTS; break;
-				case 2: prim = Graphics::LINES; break;
-				case 3: prim = Graphics::TRIANGLES; break;
-				default: prim = Graphics::POLYGON; break;
-			}
-			mesh.primitive(prim);
-
-			for (unsigned int t = 0; t < amesh->mNumFaces; ++t) {
-				const struct aiFace* face = &amesh->mFaces[t];
-				for(i = 0; i < face->mNumIndices; i++) {
-					int index = face->mIndices[i];
-					if(hascolors) {
-						mesh.color(vec4FromAIColor4D(amesh->mColors[0][index]));
-					}
-					if(hasnormals) {
-						mesh.normal(vec3FromAIVector3D(amesh->mNormals[index]));
-					}
-					if(hastexcoords) {
-						mesh.texCoord(vec2FromAIVector3D(amesh->mTextureCoords[0][index]));
-					}
-					mesh.vertex(vec3FromAIVector3D(amesh->mVertices[index]));
+			mesh.primitive(m.primitive);
+
+			// Flatten faces into unindexed vertices
+			const int N = m.numIndices;
+			#define FLATTEN(src, dst)\
+				if (m.src) {\
+					int n0 = mesh.dst().size();\
+					mesh.dst().size(n0 + N);\
+					for (int j = 0; j < N; ++j) mesh.dst()[n0 + j] = m.src[m.indices[j]];\
 				}
-			}
-			
+			FLATTEN(colors, colors)
+			FLATTEN(normals, normals)
+			FLATTEN(texCoords, texCoord2s)
+			FLATTEN(vertices, vertices)
+			#undef FLATTEN
+
 			// mesh.compress();
 		}
 	}
@@ -294,48 +932,21 @@ void Scene :: mesh(unsigned int i, Mesh& mesh) const {
 
 void Scene :: meshAlt(unsigned int i, Mesh& mesh) const {
 	if (i < meshes()) {
-		aiMesh * amesh = mImpl->scene->mMeshes[i];
-		if (amesh) {
+		const MeshData& m = mImpl->meshes[i];
+		if (m.numIndices) {
 			//mesh.reset();
-						
-			bool hasnormals = amesh->mNormals != NULL;
-			bool hascolors = amesh->mColors[0] != NULL;
-			bool hastexcoords = amesh->mTextureCoords[0] != NULL;
-			
-			const struct aiFace* face = &amesh->mFaces[0];
-			Graphics::Primitive prim;
-			switch(face->mNumIndices) {
-				case 1: prim = Graphics::POINTS; break;
-				case 2: prim = Graphics::LINES; break;
-				case 3: prim = Graphics::TRIANGLES; break;
-				default: prim = Graphics::POLYGON; break;
-			}
-			mesh.primitive(prim);
-	
+			mesh.primitive(m.primitive);
+
 			//read vertices, normals, colors, texcoord
-			for (unsigned int index = 0; index < amesh->mNumVertices; ++index){
-				if(hascolors) {
-					mesh.color(vec4FromAIColor4D(amesh->mColors[0][index]));
-				}
-				if(hasnormals) {
-					mesh.normal(vec3FromAIVector3D(amesh->mNormals[index]));
-				}
-				if(hastexcoords) {
-					mesh.texCoord(vec2FromAIVector3D(amesh->mTextureCoords[0][index]));
-				}
-				mesh.vertex(vec3FromAIVector3D(amesh->mVertices[index]));			
-			}
+			const int N = m.numVertices;
+			if (m.colors) mesh.colors().append(m.colors, N);
+			if (m.normals) mesh.normals().append(m.normals, N);
+			if (m.texCoords) mesh.texCoord2s().append(m.texCoords, N);
+			mesh.vertices().append(m.vertices, N);
 
 			//read faces as indices
-			for (unsigned int t = 0; t < amesh->mNumFaces; ++t) {
-				const struct aiFace* tface = &amesh->mFaces[t];
-				for(i = 0; i < tface->mNumIndices; i++) {
-					
-					mesh.index( tface -> mIndices[i] );
-					//printf("face idx %d\n", tface -> mIndices[i] ); 
-				}
-			}
-			
+			mesh.indices().append(m.indices, m.numIndices);
+
 			// mesh.compress();
 		}
 	}
@@ -347,30 +958,24 @@ const Scene::Material& Scene :: material(unsigned int i) const {
 
 unsigned int Scene :: meshMaterial(unsigned int i) const {
 	if (i < meshes()) {
-		aiMesh * amesh = mImpl->scene->mMeshes[i];
-		if (amesh) {
-			return amesh->mMaterialIndex;
-		}
+		return mImpl->meshes[i].material;
 	}
 	return 0;
 }
 
 std::string Scene :: meshName(unsigned int i) const {
 	if (i < meshes()) {
-		aiMesh * amesh = mImpl->scene->mMeshes[i];
-		if (amesh) {
-			return amesh->mName.data;
-		}
+		return mImpl->meshes[i].name;
 	}
-	return 0;
+	return "";
 }
 
 unsigned int Scene :: materials() const {
-	return mImpl->scene->mNumMaterials;
+	return mImpl->scene ? mImpl->scene->mNumMaterials : mMaterials.size();
 }
 
 unsigned int Scene :: textures() const {
-	return mImpl->scene->mNumTextures;
+	return mImpl->numTextures;
 }
 
 unsigned int Scene :: nodes() const {
@@ -419,15 +1024,8 @@ void get_bounding_box_for_node(const aiScene * scene, const struct aiNode* nd, V
 }
 		
 void Scene :: getBounds(Vec3f& min, Vec3f& max) const {
-#ifdef USE_ASSIMP3
-    aiMatrix4x4 trafo;
-#else
-    struct aiMatrix4x4 trafo;
-#endif
-	aiIdentityMatrix4(&trafo);
-	min.set(1e10f, 1e10f, 1e10f);
-	max.set(-1e10f, -1e10f, -1e10f);
-	get_bounding_box_for_node(mImpl->scene, mImpl->scene->mRootNode,min,max,&trafo);
+	min = mImpl->boundsMin;
+	max = mImpl->boundsMax;
 }
 
 void dumpNode(aiNode * x, std::string indent) {
@@ -445,14 +1043,27 @@ void Scene :: print() const {
 	printf("==================================================\n");
 	printf("Scene\n");
 	
-	printf("%d Meshes\n", meshes());
-	for (unsigned int i=0; i<mImpl->scene->mNumMeshes; i++) {
-		aiMesh * x = mImpl->scene->mMeshes[i];
-		printf("\t%d: %s", i, x->mName.data);
-		printf("\t\t%d vertices, %d faces; material: %d; normals?%d colors?%d texcoords?%d\n", x->mNumVertices, x->mNumFaces, x->mMaterialIndex, x->HasNormals(), x->HasVertexColors(0), x->HasTextureCoords(0));
-		//printf("\t\tcolors: %d, normals %d, texcoords %d\n", x->mColors[0][0] != NULL, x->mNormals[0] != NULL, x->mTextureCoords[0][0] != NULL);
+	printf("%d Meshes%s\n", meshes(), cached() ? " (cached)" : "");
+	for (unsigned int i=0; i<meshes(); i++) {
+		const MeshData& x = mImpl->meshes[i];
+		printf("\t%d: %s", i, x.name.c_str());
+		printf("\t\t%d vertices, %d indices; material: %d; normals?%d colors?%d texcoords?%d\n", x.numVertices, x.numIndices, x.material, x.normals != NULL, x.colors != NULL, x.texCoords != NULL);
 	}
-	
+
+	if (cached()) {
+		printf("%d Materials\n", materials());
+		for (unsigned int i=0; i<materials(); i++) {
+			printf("\t%d: %s\n", i, mMaterials[i].name.c_str());
+		}
+		printf("%d Textures\n", textures());
+		printf("%d Nodes\n", nodes());
+		for (unsigned int i=0; i<nodes(); i++) {
+			printf("\t%d: %s\n", i, node(i).name().c_str());
+		}
+		printf("==================================================\n");
+		return;
+	}
+
 	printf("%d Materials\n", materials());
 	for (unsigned int i=0; i<mImpl->scene->mNumMaterials; i++) {
 		aiMaterial * x = mImpl->scene->mMaterials[i];
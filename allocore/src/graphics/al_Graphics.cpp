@@ -1,5 +1,5 @@
 //#include <vector>
-//#include <map>
+#include <map>
 //#include <string>
 #include <stdio.h>
 
@@ -9,11 +9,152 @@
 
 namespace al{
 
+// GPU buffers of retained meshes, keyed by Mesh::id()
+class Graphics::MeshCache{
+public:
+
+	// Attribute streams, each in its own buffer so they update independently
+	enum{ VERTEX=0, NORMAL, COLOR, COLORI, TEXCOORD, INDEX, NUM_STREAMS };
+
+	struct Stream{
+		GLuint id;
+		unsigned generation;
+		int bytes;
+		int capacity;
+		int comps;
+		bool dynamic;
+	};
+
+	struct Entry{
+		Stream streams[NUM_STREAMS];
+		uint64_t lastDraw;
+	};
+
+	typedef std::map<unsigned, Entry> Entries;
+
+	Entries entries;
+	MeshCacheStats stats;
+	unsigned maxEntries;
+	unsigned deaths;	// Mesh::deaths() at last sweep
+
+	MeshCache(): maxEntries(1024), deaths(Mesh::deaths()){
+		MeshCacheStats s = {0,0,0,0};
+		stats = s;
+	}
+
+	Entry& get(const Mesh& m){
+		++stats.draws;
+		if(deaths != Mesh::deaths()) sweep();
+		Entries::iterator it = entries.find(m.id());
+		if(it == entries.end()){
+			if(entries.size() >= maxEntries) evict();
+			m.registerRetained();
+			it = entries.insert(Entries::value_type(m.id(), Entry())).first;
+			memset(&it->second, 0, sizeof(Entry));
+			stats.meshes = entries.size();
+		}
+		it->second.lastDraw = stats.draws;
+		return it->second;
+	}
+
+	// Bind the stream's buffer, uploading the data if it changed
+	void update(
+		Stream& s, GLenum target, const void * data, int bytes, int comps,
+		unsigned generation
+	){
+		bool upload = false;
+		if(!s.id){
+			glGenBuffers(1, &s.id);
+			upload = true;
+		}
+		glBindBuffer(target, s.id);
+		if(upload || s.generation != generation || s.bytes != bytes || s.comps != comps){
+			if(bytes > s.capacity || !s.capacity){
+				// Data that changed before is likely to change again
+				s.dynamic = !upload;
+				glBufferData(target, bytes, data, s.dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+				s.capacity = bytes;
+			}
+			else{
+				glBufferSubData(target, 0, bytes, data);
+			}
+			s.generation = generation;
+			s.bytes = bytes;
+			s.comps = comps;
+			++stats.uploads;
+			stats.bytesUploaded += bytes;
+		}
+	}
+
+	void release(Entry& e){
+		for(int i=0; i<NUM_STREAMS; ++i){
+			if(e.streams[i].id) glDeleteBuffers(1, &e.streams[i].id);
+		}
+	}
+
+	void release(unsigned id){
+		Entries::iterator it = entries.find(id);
+		if(it != entries.end()){
+			release(it->second);
+			entries.erase(it);
+			stats.meshes = entries.size();
+		}
+	}
+
+	void releaseAll(){
+		for(Entries::iterator it = entries.begin(); it != entries.end(); ++it){
+			release(it->second);
+		}
+		entries.clear();
+		stats.meshes = 0;
+	}
+
+	// Release buffers of destroyed meshes
+	void sweep(){
+		deaths = Mesh::deaths();
+		for(Entries::iterator it = entries.begin(); it != entries.end(); ){
+			if(Mesh::alive(it->first)) ++it;
+			else{
+				release(it->second);
+				entries.erase(it++);
+			}
+		}
+		stats.meshes = entries.size();
+	}
+
+	void evict(){
+		Entries::iterator lru = entries.begin();
+		for(Entries::iterator it = entries.begin(); it != entries.end(); ++it){
+			if(it->second.lastDraw < lru->second.lastDraw) lru = it;
+		}
+		if(lru != entries.end()) release(lru->first);
+	}
+};
+
+
 Graphics::Graphics()
-:	mRescaleNormal(0), mInImmediateMode(false)
+:	mRescaleNormal(0), mInImmediateMode(false), mMeshCache(new MeshCache)
 {}
 
-Graphics::~Graphics(){}
+Graphics::Graphics(const Graphics& cpy)
+:	GPUObject(cpy),
+	mMesh(cpy.mMesh), mRescaleNormal(cpy.mRescaleNormal),
+	mInImmediateMode(cpy.mInImmediateMode), mMeshCache(new MeshCache)
+{}
+
+Graphics& Graphics::operator= (const Graphics& cpy){
+	if(this != &cpy){
+		GPUObject::operator=(cpy);
+		mMesh = cpy.mMesh;
+		mRescaleNormal = cpy.mRescaleNormal;
+		mInImmediateMode = cpy.mInImmediateMode;
+	}
+	return *this;
+}
+
+Graphics::~Graphics(){
+	delete mMeshCache;
+}
 
 
 int Graphics::numComponents(Format v){
@@ -245,22 +386,31 @@ void Graphics::draw(const Mesh& v, int count, int begin){
 	//printf("client %d, GPU %d\n", clientSide, gpuSide);
 	//printf("Nv %i Nc %i Nn %i Nt2 %i Nt3 %i Ni %i\n", Nv, Nc, Nn, Nt2, Nt3, Ni);
 
+	// Retained meshes are drawn from buffer objects, so the attribute
+	// pointers become offsets into the bound buffers
+	MeshCache::Entry * retained = v.retained() ? &mMeshCache->get(v) : NULL;
+	#define ATTRIB_POINTER(stream, buf, Type, comps, attrib)\
+		(retained ? (mMeshCache->update(\
+			retained->streams[MeshCache::stream], GL_ARRAY_BUFFER,\
+			&buf[0], buf.size()*sizeof(Type), comps, v.generation(Mesh::attrib)\
+		), (const GLvoid *)0) : (const GLvoid *)&buf[0])
+
 	// Enable arrays and set pointers...
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 0, &v.vertices()[0]);
+	glVertexPointer(3, GL_FLOAT, 0, ATTRIB_POINTER(VERTEX, v.vertices(), Mesh::Vertex, 3, VERTICES));
 
 	if(Nn >= Nv){
 		glEnableClientState(GL_NORMAL_ARRAY);
-		glNormalPointer(GL_FLOAT, 0, &v.normals()[0]);
+		glNormalPointer(GL_FLOAT, 0, ATTRIB_POINTER(NORMAL, v.normals(), Mesh::Normal, 3, NORMALS));
 	}
 
 	if(Nc >= Nv){
 		glEnableClientState(GL_COLOR_ARRAY);
-		glColorPointer(4, GL_FLOAT, 0, &v.colors()[0]);
+		glColorPointer(4, GL_FLOAT, 0, ATTRIB_POINTER(COLOR, v.colors(), Color, 4, COLORS));
 	}
 	else if(Nci >= Nv){
 		glEnableClientState(GL_COLOR_ARRAY);
-		glColorPointer(4, GL_UNSIGNED_BYTE, 0, &v.coloris()[0]);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, ATTRIB_POINTER(COLORI, v.coloris(), Colori, 4, COLORS));
 		//printf("using integer colors\n");
 	}
 	else if(0 == Nc && 0 == Nci){
@@ -276,24 +426,33 @@ void Graphics::draw(const Mesh& v, int count, int begin){
 
 	if(Nt1 >= Nv){
 		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		glTexCoordPointer(1, GL_FLOAT, 0, &v.texCoord1s()[0]);
+		glTexCoordPointer(1, GL_FLOAT, 0, ATTRIB_POINTER(TEXCOORD, v.texCoord1s(), Mesh::TexCoord1, 1, TEXCOORDS));
 	}
 	else if(Nt2 >= Nv){
 		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		glTexCoordPointer(2, GL_FLOAT, 0, &v.texCoord2s()[0]);
+		glTexCoordPointer(2, GL_FLOAT, 0, ATTRIB_POINTER(TEXCOORD, v.texCoord2s(), Mesh::TexCoord2, 2, TEXCOORDS));
 	}
 	else if(Nt3 >= Nv){
 		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		glTexCoordPointer(3, GL_FLOAT, 0, &v.texCoord3s()[0]);
+		glTexCoordPointer(3, GL_FLOAT, 0, ATTRIB_POINTER(TEXCOORD, v.texCoord3s(), Mesh::TexCoord3, 3, TEXCOORDS));
 	}
+	#undef ATTRIB_POINTER
 
 	// Draw
 	if(Ni){
+		const GLvoid * indices = &v.indices()[begin];
+		if(retained){
+			mMeshCache->update(
+				retained->streams[MeshCache::INDEX], GL_ELEMENT_ARRAY_BUFFER,
+				&v.indices()[0], Ni*sizeof(Mesh::Index), 1, v.generation(Mesh::INDICES)
+			);
+			indices = (const GLvoid *)(begin*sizeof(Mesh::Index));
+		}
 		glDrawElements(
 			((Graphics::Primitive)v.primitive()),
 			count, // number of indexed elements to render
 			GL_UNSIGNED_INT,
-			&v.indices()[begin]
+			indices
 		);
 	}
 	else{
@@ -309,6 +468,29 @@ void Graphics::draw(const Mesh& v, int count, int begin){
 	if(Nn)					glDisableClientState(GL_NORMAL_ARRAY);
 	if(Nc || Nci)			glDisableClientState(GL_COLOR_ARRAY);
 	if(Nt1 || Nt2 || Nt3)	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	if(retained){
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if(Ni) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+}
+
+const Graphics::MeshCacheStats& Graphics::meshCacheStats() const {
+	return mMeshCache->stats;
+}
+
+Graphics& Graphics::meshCacheSize(unsigned n){
+	mMeshCache->maxEntries = n ? n : 1;
+	while(mMeshCache->entries.size() > mMeshCache->maxEntries) mMeshCache->evict();
+	return *this;
+}
+
+void Graphics::releaseMesh(const Mesh& m){
+	mMeshCache->release(m.id());
+}
+
+void Graphics::releaseMeshes(){
+	mMeshCache->releaseAll();
 }
 
 
@@ -318,6 +500,7 @@ void Graphics::onCreate(){
 }
 
 void Graphics::onDestroy(){
+	releaseMeshes();
 }
 
 } // al::
@@ -1,5 +1,8 @@
 #include <algorithm>
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -11,9 +14,30 @@
 
 namespace al{
 
+namespace{
+
+// Ids of registered retained meshes. These are never destroyed, so that
+// meshes with static storage can unregister at exit.
+std::mutex& registryMutex(){
+	static std::mutex * m = new std::mutex;
+	return *m;
+}
+
+std::set<unsigned>& registryIDs(){
+	static std::set<unsigned> * s = new std::set<unsigned>;
+	return *s;
+}
+
+std::atomic<unsigned> registryDeaths(0);
+
+} // ::
+
+
 Mesh::Mesh(int primitive)
-:	mPrimitive(primitive)
-{}
+:	mPrimitive(primitive), mRetained(false), mRegistered(false)
+{
+	initID();
+}
 
 Mesh::Mesh(const Mesh& cpy)
 :	mVertices(cpy.mVertices),
@@ -24,10 +48,77 @@ Mesh::Mesh(const Mesh& cpy)
 	mTexCoord2s(cpy.mTexCoord2s),
 	mTexCoord3s(cpy.mTexCoord3s),
 	mIndices(cpy.mIndices),
-	mPrimitive(cpy.mPrimitive)
-{}
+	mPrimitive(cpy.mPrimitive),
+	mRetained(cpy.mRetained),
+	mRegistered(false)
+{
+	initID();
+}
+
+Mesh::~Mesh(){
+	if(mRegistered){
+		std::lock_guard<std::mutex> lock(registryMutex());
+		registryIDs().erase(mID);
+		++registryDeaths;
+	}
+}
+
+Mesh& Mesh::operator= (const Mesh& cpy){
+	if(this != &cpy){
+		mVertices = cpy.mVertices;
+		mNormals = cpy.mNormals;
+		mColors = cpy.mColors;
+		mColoris = cpy.mColoris;
+		mTexCoord1s = cpy.mTexCoord1s;
+		mTexCoord2s = cpy.mTexCoord2s;
+		mTexCoord3s = cpy.mTexCoord3s;
+		mIndices = cpy.mIndices;
+		mPrimitive = cpy.mPrimitive;
+		mRetained = cpy.mRetained;
+		changed();
+	}
+	return *this;
+}
+
+void Mesh::initID(){
+	static std::atomic<unsigned> counter(0);
+	mID = ++counter;
+	for(int i=0; i<5; ++i) mGenerations[i] = 0;
+}
+
+Mesh& Mesh::changed(int attributes){
+	for(int i=0; i<5; ++i){
+		if(attributes & (1<<i)) ++mGenerations[i];
+	}
+	return *this;
+}
+
+unsigned Mesh::generation(Attribute attribute) const {
+	for(int i=0; i<5; ++i){
+		if(attribute == (1<<i)) return mGenerations[i];
+	}
+	return 0;
+}
+
+void Mesh::registerRetained() const {
+	if(!mRegistered){
+		std::lock_guard<std::mutex> lock(registryMutex());
+		registryIDs().insert(mID);
+		mRegistered = true;
+	}
+}
+
+bool Mesh::alive(unsigned id){
+	std::lock_guard<std::mutex> lock(registryMutex());
+	return registryIDs().count(id) != 0;
+}
+
+unsigned Mesh::deaths(){
+	return registryDeaths;
+}
 
 Mesh& Mesh::reset() {
+	changed();
 	vertices().reset();
 	normals().reset();
 	colors().reset();
@@ -40,6 +131,7 @@ Mesh& Mesh::reset() {
 }
 
 void Mesh::decompress(){
+	changed();
 	int Ni = indices().size();
 	if(Ni){
 		#define DECOMPRESS(buf, Type)\
@@ -66,6 +158,7 @@ void Mesh::decompress(){
 }
 
 void Mesh::equalizeBuffers() {
+	changed();
 	const int Nv = vertices().size();
 	const int Nn = normals().size();
 	const int Nc = colors().size();
@@ -178,11 +271,13 @@ void Mesh::createNormalsMesh(Mesh& mesh, float length, bool perFace){
 }
 
 void Mesh::invertNormals() {
+	changed(NORMALS);
 	int Nv = normals().size();
 	for(int i=0; i<Nv; ++i) normals()[i] = -normals()[i];
 }
 
 void Mesh::compress() {
+	changed();
 
 	int Ni = indices().size();
 	int Nv = vertices().size();
@@ -253,6 +348,7 @@ void Mesh::compress() {
 }
 
 void Mesh::generateNormals(bool normalize, bool equalWeightPerFace) {
+	changed(NORMALS);
 //	/*
 //		Multi-pass algorithm:
 //			generate a list of faces (assume triangles?)
@@ -421,6 +517,7 @@ void Mesh::generateNormals(bool normalize, bool equalWeightPerFace) {
 
 
 Mesh& Mesh::repeatLast(){
+	changed();
 	if(indices().size()){
 		index(indices().last());
 	}
@@ -438,6 +535,7 @@ Mesh& Mesh::repeatLast(){
 
 
 void Mesh::ribbonize(float * widths, int widthsStride, bool faceBinormal){
+	changed();
 
 	struct F{
 		static void frenet(
@@ -516,6 +614,7 @@ void Mesh::ribbonize(float * widths, int widthsStride, bool faceBinormal){
 
 
 void Mesh::merge(const Mesh& src){
+	changed();
 //	if (indices().size() || src.indices().size()) {
 //		fprintf(stderr, "error: Mesh merging with indexed meshes not yet supported\n");
 //		return;
@@ -582,6 +681,7 @@ Mesh::Vertex Mesh::getCenter() const {
 }
 
 void Mesh::unitize(bool proportional) {
+	changed(VERTICES);
 	Vertex min(0), max(0);
 	getBounds(min, max);
 	// span of each axis:
@@ -604,6 +704,7 @@ void Mesh::unitize(bool proportional) {
 }
 
 Mesh& Mesh::translate(float x, float y, float z){
+	changed(VERTICES);
 	const Vertex xfm(x,y,z);
 	for(int i=0; i<vertices().size(); ++i)
 		mVertices[i] += xfm;
@@ -611,6 +712,7 @@ Mesh& Mesh::translate(float x, float y, float z){
 }
 
 Mesh& Mesh::scale(float x, float y, float z){
+	changed(VERTICES);
 	const Vertex xfm(x,y,z);
 	for(int i=0; i<vertices().size(); ++i)
 		mVertices[i] *= xfm;
@@ -662,6 +764,7 @@ static void stripToTri(Buffer<T>& buf){
 }
 
 void Mesh::toTriangles(){
+	changed();
 
 	if(Graphics::TRIANGLE_STRIP == primitive()){
 		primitive(Graphics::TRIANGLES);
@@ -1,4 +1,6 @@
+#include <stdint.h>
 #include <stdlib.h>
+#include "allocore/graphics/al_BufferObject.hpp"
 #include "allocore/graphics/al_Graphics.hpp"
 #include "allocore/graphics/al_Texture.hpp"
 
@@ -104,6 +106,7 @@ Texture :: Texture(AlloArrayHeader& header)
 }
 
 Texture :: ~Texture() {
+	staged(false);
 }
 
 
@@ -192,8 +195,9 @@ void Texture::shapeFromArray(){
 		// ensure texture attributes match internal array
 		shapeFrom(mArray.header, false);
 		// force texture to be submitted since the pixel data could have been
-		// tampered with
-		dirty(); // mPixelsUpdated=true;
+		// tampered with, unless the changed regions have been flagged
+		syncUpload();
+		if(!mUpload.pending()) dirty(); // mPixelsUpdated=true;
 		mArrayDirty = false;
 	}
 }
@@ -291,7 +295,7 @@ void Texture :: resetArray(unsigned align) {
 			mArray.header.dimcount = 3;
 			mArray.header.dim[0] = mWidth;
 			mArray.header.dim[1] = mHeight;
-			mArray.header.dim[3] = mDepth;
+			mArray.header.dim[2] = mDepth;
 			mArray.deriveStride(mArray.header, align);
 			break;
 	}
@@ -415,14 +419,122 @@ void Texture::sendPixels(const void * pixels, unsigned align){
 }
 
 void Texture::sendPixels(bool force){
-	if(mPixelsUpdated || force){
+	if(force) mPixelsUpdated = true;
+	syncUpload();
+	if(mUpload.pending() && mArray.data.ptr){
 		//printf("%p submitting %p\n", this, mArray.data.ptr);
-		//submit(mArray.data.ptr, mArray.alignment());
-		sendPixels(mArray.data.ptr, mArray.alignment());
+		sendRegions();
+	}
+}
+
+void Texture::sendRegion(const TextureUpload::Region& r, const void * pixels){
+	switch(target()){
+		case TEXTURE_1D:
+			glTexSubImage1D(target(), 0, r.x, r.w, format(), type(), pixels);
+			break;
+		case TEXTURE_2D:
+			glTexSubImage2D(target(), 0, r.x,r.y, r.w,r.h, format(), type(), pixels);
+			break;
+		case TEXTURE_3D:
+			glTexSubImage3D(target(), 0, r.x,r.y,r.z, r.w,r.h,r.d, format(), type(), pixels);
+			break;
+		default:;
+	}
+}
+
+void Texture::sendRegions(){
+	const char * pixels = mArray.data.ptr;
+
+	#ifdef AL_GRAPHICS_USE_OPENGL
+	// Pack the regions into the staging buffer not used by the last upload
+	// and send them from there; GL copies from it asynchronously
+	if(staged()){
+		PBO& pbo = *mStaging.pbo[mUpload.stage()];
+		int bytes = int(mUpload.bytes());
+		if(pbo.size() < bytes) pbo.resize(bytes);
+		char * dst = (char *)pbo.map();
+		if(dst){
+			mUpload.pack(dst, pixels, mArray.stride(1), mArray.stride(2));
+			if(pbo.unmap()){
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+				for(int i=0; i<mUpload.numRegions(); ++i){
+					sendRegion(mUpload.region(i), (const GLvoid *)(uintptr_t)mUpload.offset(i));
+				}
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+				pbo.unbind();
+				AL_GRAPHICS_ERROR("Texture::sendRegions (staged)", id());
+				mUpload.uploaded();
+				return;
+			}
+		}
+		// The buffer could not be filled, so send from the internal array
+		pbo.unbind();
+		AL_GRAPHICS_ERROR("Texture::sendRegions (map)", id());
+	}
+	#endif
+
+	if(mUpload.whole()){
+		sendPixels(pixels, mArray.alignment());
+	}
+
+	// Send regions straight from the internal array, telling GL its layout
+	else{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, mArray.alignment());
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, width());
+		glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, height());
+		for(int i=0; i<mUpload.numRegions(); ++i){
+			const TextureUpload::Region& r = mUpload.region(i);
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS, r.x);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS, r.y);
+			glPixelStorei(GL_UNPACK_SKIP_IMAGES, r.z);
+			sendRegion(r, pixels);
+		}
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		AL_GRAPHICS_ERROR("Texture::sendRegions", id());
+	}
+	mUpload.uploaded();
+}
+
+void Texture::syncUpload(){
+	mUpload.shape(numComponents() * Graphics::numBytes(type()), width(), height(), depth());
+	if(mPixelsUpdated){
+		mUpload.dirty();
 		mPixelsUpdated = false;
 	}
 }
 
+Texture& Texture::dirty(unsigned x, unsigned y, unsigned z, unsigned w, unsigned h, unsigned d){
+	syncUpload();
+	mUpload.dirty(TextureUpload::Region(x,y,z, w,h,d));
+	return *this;
+}
+
+Texture& Texture::staged(bool v){
+	#ifndef AL_GRAPHICS_USE_OPENGL
+	v = false;
+	#endif
+	if(v != staged()){
+		for(int i=0; i<2; ++i){
+			if(v){
+				mStaging.pbo[i] = new PBO(false, BufferObject::STREAM_DRAW);
+				#ifdef AL_GRAPHICS_USE_OPENGL
+				mStaging.pbo[i]->mapMode(BufferObject::WRITE_ONLY);
+				#endif
+			}
+			else{
+				delete mStaging.pbo[i];
+				mStaging.pbo[i] = NULL;
+			}
+		}
+	}
+	return *this;
+}
+
 void Texture::sendShape(bool force){
 	if((mShapeUpdated || force)){
 
@@ -0,0 +1,124 @@
+#include <string.h>
+#include "allocore/graphics/al_TextureUpload.hpp"
+
+namespace al{
+
+namespace{
+
+typedef TextureUpload::Region Region;
+
+inline unsigned min(unsigned a, unsigned b){ return a<b ? a:b; }
+inline unsigned max(unsigned a, unsigned b){ return a>b ? a:b; }
+
+Region bounds(const Region& a, const Region& b){
+	Region r;
+	r.x = min(a.x, b.x); r.w = max(a.x+a.w, b.x+b.w) - r.x;
+	r.y = min(a.y, b.y); r.h = max(a.y+a.h, b.y+b.h) - r.y;
+	r.z = min(a.z, b.z); r.d = max(a.z+a.d, b.z+b.d) - r.z;
+	return r;
+}
+
+// Texels added by replacing two regions by their bounding box, or a
+// negative number if they overlap such that the box has fewer
+int64_t growth(const Region& a, const Region& b){
+	return int64_t(bounds(a,b).texels()) - int64_t(a.texels() + b.texels());
+}
+
+} // ::
+
+
+TextureUpload::TextureUpload()
+:	mTexelBytes(0), mW(0), mH(1), mD(1), mStage(0), mUploads(0), mBytesUploaded(0)
+{}
+
+TextureUpload& TextureUpload::shape(unsigned texelBytes, unsigned w, unsigned h, unsigned d){
+	if(!h) h = 1;
+	if(!d) d = 1;
+	if(texelBytes != mTexelBytes || w != mW || h != mH || d != mD){
+		mTexelBytes = texelBytes;
+		mW = w; mH = h; mD = d;
+		dirty();
+	}
+	return *this;
+}
+
+TextureUpload& TextureUpload::dirty(){
+	mRegions.clear();
+	if(mW) mRegions.push_back(Region(0,0,0, mW,mH,mD));
+	return *this;
+}
+
+TextureUpload& TextureUpload::dirty(const Region& reg){
+	if(reg.x >= mW || reg.y >= mH || reg.z >= mD) return *this;
+	Region r = reg;
+	r.w = min(r.w, mW - r.x);
+	r.h = min(r.h, mH - r.y);
+	r.d = min(r.d, mD - r.z);
+	if(r.texels()) merge(r);
+	return *this;
+}
+
+TextureUpload& TextureUpload::uploaded(){
+	if(pending()){
+		++mUploads;
+		mBytesUploaded += bytes();
+		mRegions.clear();
+		mStage ^= 1;
+	}
+	return *this;
+}
+
+void TextureUpload::merge(Region r){
+	for(;;){
+		// Merge the region with others as long as that adds no texels. The
+		// bounding box may then also take in regions checked before.
+		for(unsigned i=0; i<mRegions.size(); ){
+			if(growth(r, mRegions[i]) <= 0){
+				r = bounds(r, mRegions[i]);
+				mRegions.erase(mRegions.begin() + i);
+				i = 0;
+			}
+			else ++i;
+		}
+		if(mRegions.size() < MAX_REGIONS) break;
+
+		// Too many regions, so merge r with the region adding fewest texels
+		int best = 0;
+		for(unsigned i=1; i<mRegions.size(); ++i){
+			if(growth(r, mRegions[i]) < growth(r, mRegions[best])) best = i;
+		}
+		r = bounds(r, mRegions[best]);
+		mRegions.erase(mRegions.begin() + best);
+	}
+	mRegions.push_back(r);
+}
+
+bool TextureUpload::whole() const {
+	return mRegions.size() == 1 && mRegions[0].texels() == uint64_t(mW)*mH*mD;
+}
+
+uint64_t TextureUpload::bytes() const {
+	return offset(mRegions.size());
+}
+
+uint64_t TextureUpload::offset(int i) const {
+	uint64_t texels = 0;
+	for(int k=0; k<i; ++k) texels += mRegions[k].texels();
+	return texels * mTexelBytes;
+}
+
+void TextureUpload::pack(char * dst, const char * pixels, size_t rowStride, size_t sliceStride) const {
+	for(unsigned i=0; i<mRegions.size(); ++i){
+		const Region& r = mRegions[i];
+		size_t rowBytes = size_t(r.w) * mTexelBytes;
+		for(unsigned z=r.z; z<r.z+r.d; ++z){
+			for(unsigned y=r.y; y<r.y+r.h; ++y){
+				const char * src = pixels + z*sliceStride + y*rowStride + size_t(r.x)*mTexelBytes;
+				memcpy(dst, src, rowBytes);
+				dst += rowBytes;
+			}
+		}
+	}
+}
+
+} // al::
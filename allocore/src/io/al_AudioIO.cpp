@@ -4,13 +4,69 @@
 #include <cstring>		/* memset() */
 #include <cmath>
 #include <cassert>
+#include <atomic>
 
 #include "portaudio.h"
 #include "allocore/system/al_Config.h"
+#include "allocore/system/al_Thread.hpp"
+#include "allocore/system/al_Time.hpp"
 #include "allocore/io/al_AudioIO.hpp"
+#include "allocore/io/al_AudioProfiler.hpp"
+#include "allocore/system/al_RTAllocator.hpp"
 
 namespace al{
 
+// Calls the callbacks and post-processes output of one block
+static void processBlock(AudioIO& io, unsigned long frameCount, bool xrun=false){
+	AudioProfiler * profiler = io.profiler();
+	if(profiler) profiler->beginBlock(frameCount / io.framesPerSecond());
+	RTAllocator * allocator = io.allocator();
+	if(allocator) allocator->beginBlock();
+
+	if(io.autoZeroOut()) io.zeroOut();
+
+	io.processAudio();	// call callback
+
+	// apply smoothly-ramped gain to all output channels
+	if(io.usingGain()){
+
+		float dgain = (io.mGain-io.mGainPrev) / frameCount;
+
+		for(int j=0; j<io.channelsOutDevice(); ++j){
+			float * out = io.outBuffer(j);
+			float gain = io.mGainPrev;
+
+			for(unsigned i=0; i<frameCount; ++i){
+				out[i] *= gain;
+				gain += dgain;
+			}
+		}
+
+		io.mGainPrev = io.mGain;
+	}
+
+	// kill pesky nans so we don't hurt anyone's ears
+	if(io.zeroNANs()){
+		for(unsigned i=0; i<unsigned(frameCount*io.channelsOutDevice()); ++i){
+			float& s = (&io.out(0,0))[i];
+			//if(isnan(s)) s = 0.f;
+			if(s != s) s = 0.f; // portable isnan; only nans do not equal themselves
+		}
+	}
+
+	if(io.clipOut()){
+		for(unsigned i=0; i<unsigned(frameCount*io.channelsOutDevice()); ++i){
+			float& s = (&io.out(0,0))[i];
+			if		(s<-1.f) s =-1.f;
+			else if	(s> 1.f) s = 1.f;
+		}
+	}
+
+	if(allocator) allocator->endBlock();
+	if(profiler) profiler->endBlock(xrun);
+}
+
+
 class DummyAudioBackend : public AudioBackend{
 public:
 	DummyAudioBackend(): AudioBackend(), mNumOutChans(64), mNumInChans(64){}
@@ -68,6 +124,213 @@ protected:
 };
 
 
+//==============================================================================
+
+// Drives the callbacks without an audio device, either from a thread as fast
+// as possible (or at a multiple of real-time) or from AudioIO::processOffline
+class OfflineAudioBackend : public AudioBackend{
+public:
+	OfflineAudioBackend()
+	:	AudioBackend(), mNumOutChans(0), mNumInChans(0), mIO(0),
+		mInput(0), mInputFrames(0), mInputChans(0), mInputPos(0), mInputLoop(false),
+		mGenerator(0), mGeneratorUser(0), mOutput(0), mRate(0),
+		mFrames(0), mBlocks(0), mWallTime(0), mCPU(0), mRun(false)
+	{}
+
+	virtual ~OfflineAudioBackend(){ stop(); }
+
+	virtual bool isOpen() const {return mIsOpen;}
+	virtual bool isRunning() const {return mIsRunning;}
+	virtual bool error() const {return false;}
+
+	virtual void printError(const char * text = "") const {}
+	virtual void printInfo() const {
+		printf("Using offline backend (rate %g).\n", mRate);
+	}
+
+	virtual bool supportsFPS(double fps) const {return fps > 0;}
+
+	virtual void inDevice(int index) {return;}
+	virtual void outDevice(int index) {return;}
+
+	// There is no device, so all requested channels are device channels
+	virtual void channels(int num, bool forOutput) {
+		if(num < 0) return;
+		if (forOutput) {
+			setOutDeviceChans(num);
+		} else {
+			setInDeviceChans(num);
+		}
+	}
+
+	virtual int inDeviceChans() {return mNumInChans;}
+	virtual int outDeviceChans() {return mNumOutChans;}
+	virtual void setInDeviceChans(int num) {
+		mNumInChans = num;
+	}
+
+	virtual void setOutDeviceChans(int num) {
+		mNumOutChans = num;
+	}
+
+	// Stream time is the duration of audio processed so far
+	virtual double time() {
+		return mIO ? double(mFrames) / mIO->framesPerSecond() : 0.;
+	}
+
+	virtual bool open(int framesPerSecond, int framesPerBuffer, void *userdata) {
+		mIO = (AudioIO *)userdata;
+		mIsOpen = true;
+		return true;
+	}
+
+	virtual bool close() {
+		stop();
+		mIsOpen = false;
+		return true;
+	}
+
+	virtual bool start(int framesPerSecond, int framesPerBuffer, void *userdata) {
+		if(mIsRunning) return true;
+		if(!mIsOpen) open(framesPerSecond, framesPerBuffer, userdata);
+		mRun = true;
+		mIsRunning = mThread.start(threadFunc, this);
+		return mIsRunning;
+	}
+
+	virtual bool stop() {
+		if(!mIsRunning) return true;
+		mRun = false;
+		mThread.join();
+		mIsRunning = false;
+		return true;
+	}
+
+	virtual double cpu() {return mCPU;}
+
+
+	void input(const float * samples, int frames, int channels, bool loop){
+		mInput = samples;
+		mInputFrames = samples ? frames : 0;
+		mInputChans = channels;
+		mInputLoop = loop;
+		mInputPos = 0;
+		mGenerator = 0;
+	}
+
+	void input(AudioIO::OfflineInput func, void * userData){
+		mGenerator = func;
+		mGeneratorUser = userData;
+		mInput = 0;
+	}
+
+	void output(std::vector<float> * samples){ mOutput = samples; }
+
+	void rate(double v){ mRate = v > 0 ? v : 0; }
+
+	void reset(){
+		mInputPos = 0;
+		mFrames = 0;
+		mBlocks = 0;
+		mWallTime = 0.;
+	}
+
+	AudioIO::OfflineStats stats() const {
+		AudioIO::OfflineStats s;
+		s.blocks = mBlocks;
+		s.audioTime = mIO ? double(mFrames) / mIO->framesPerSecond() : 0.;
+		s.wallTime = mWallTime;
+		return s;
+	}
+
+	// Process one block of audio
+	void process(AudioIO& io){
+		al_sec t0 = al_steady_time();
+		mIO = &io;
+
+		const int frames = io.framesPerBuffer();
+		readInput(io, frames);
+		processBlock(io, frames);
+
+		if(mOutput && io.channelsOut() > 0){
+			unsigned pos = mOutput->size();
+			mOutput->resize(pos + frames * io.channelsOut());
+			interleave(&(*mOutput)[pos], io.outBuffer(), frames, io.channelsOut());
+		}
+
+		mFrames += frames;
+		++mBlocks;
+
+		al_sec dt = al_steady_time() - t0;
+		mWallTime = mWallTime + dt;
+		mCPU = dt * io.framesPerSecond() / frames;
+	}
+
+protected:
+	int mNumOutChans;
+	int mNumInChans;
+	AudioIO * mIO;
+
+	const float * mInput;
+	int mInputFrames, mInputChans, mInputPos;
+	bool mInputLoop;
+	AudioIO::OfflineInput mGenerator;
+	void * mGeneratorUser;
+	std::vector<float> * mOutput;
+	double mRate;
+
+	// Read by other threads while the stream is running
+	std::atomic<unsigned long> mFrames, mBlocks;
+	std::atomic<double> mWallTime, mCPU;
+	std::atomic<bool> mRun;
+	Thread mThread;
+
+	void readInput(AudioIO& io, int frames){
+		const int chans = io.channelsIn();
+		if(chans <= 0) return;
+		float * buf = const_cast<float *>(io.inBuffer());
+
+		if(mGenerator){
+			mGenerator(buf, frames, chans, mGeneratorUser);
+			return;
+		}
+
+		for(int i=0; i<frames; ++i){
+			if(mInputPos >= mInputFrames && mInputLoop) mInputPos = 0;
+
+			if(mInputPos < mInputFrames){
+				const float * src = mInput + mInputPos * mInputChans;
+				for(int c=0; c<chans; ++c) buf[c*frames + i] = c < mInputChans ? src[c] : 0.f;
+				++mInputPos;
+			}
+			else{
+				for(int c=0; c<chans; ++c) buf[c*frames + i] = 0.f;
+			}
+		}
+	}
+
+	static void * threadFunc(void * user){
+		OfflineAudioBackend& b = *(OfflineAudioBackend *)user;
+		AudioIO& io = *b.mIO;
+
+		// Pace blocks against wall time when running at a finite rate
+		const al_sec startWall = al_steady_time();
+		const unsigned long startFrames = b.mFrames;
+
+		while(b.mRun){
+			b.process(io);
+
+			if(b.mRate > 0){
+				al_sec audioTime = double(b.mFrames - startFrames) / io.framesPerSecond();
+				al_sec dt = startWall + audioTime / b.mRate - al_steady_time();
+				if(dt > 0) al_sleep(dt);
+			}
+		}
+		return NULL;
+	}
+};
+
+
 //==============================================================================
 
 class PortAudioBackend : public AudioBackend{
@@ -262,46 +525,9 @@ protected:
 			//deinterleave(&io.out(0,0), paO, io.framesPerBuffer(), io.channelsOutDevice());
 		}
 
-		if(io.autoZeroOut()) io.zeroOut();
-
-
-		io.processAudio();	// call callback
-
-
-		// apply smoothly-ramped gain to all output channels
-		if(io.usingGain()){
-
-			float dgain = (io.mGain-io.mGainPrev) / frameCount;
-
-			for(int j=0; j<io.channelsOutDevice(); ++j){
-				float * out = io.outBuffer(j);
-				float gain = io.mGainPrev;
-
-				for(unsigned i=0; i<frameCount; ++i){
-					out[i] *= gain;
-					gain += dgain;
-				}
-			}
-
-			io.mGainPrev = io.mGain;
-		}
-
-		// kill pesky nans so we don't hurt anyone's ears
-		if(io.zeroNANs()){
-			for(unsigned i=0; i<unsigned(frameCount*io.channelsOutDevice()); ++i){
-				float& s = (&io.out(0,0))[i];
-				//if(isnan(s)) s = 0.f;
-				if(s != s) s = 0.f; // portable isnan; only nans do not equal themselves
-			}
-		}
-
-		if(io.clipOut()){
-			for(unsigned i=0; i<unsigned(frameCount*io.channelsOutDevice()); ++i){
-				float& s = (&io.out(0,0))[i];
-				if		(s<-1.f) s =-1.f;
-				else if	(s> 1.f) s = 1.f;
-			}
-		}
+		const PaStreamCallbackFlags xrunFlags =
+			paInputUnderflow | paInputOverflow | paOutputUnderflow | paOutputOverflow;
+		processBlock(io, frameCount, statusFlags & xrunFlags);
 
 		if(bDeinterleave){
 			interleave(paO, &io.out(0,0), frameCount, io.channelsOutDevice());
@@ -323,7 +549,10 @@ AudioDevice::AudioDevice(int deviceNum)
 :    AudioDeviceInfo(deviceNum), mImpl(0)
 {
 	if (deviceNum < 0) {
-		deviceNum = defaultOutput().id();
+		// Query PortAudio directly; without any devices, defaultOutput() would
+		// construct another default device
+		initDevices();
+		deviceNum = Pa_GetDefaultOutputDevice();
 	}
 	setImpl(deviceNum);
 }
@@ -353,6 +582,7 @@ void AudioDevice::setImpl(int deviceNum){
 	if (deviceNum >= 0) {
 		initDevices();
 		mImpl = Pa_GetDeviceInfo(deviceNum);
+		if(!mImpl){ mName[0] = '\0'; return; } // no such device
 		mID = deviceNum;
 		strncpy(mName, ((const PaDeviceInfo*)mImpl)->name, 127);
 		mName[127] = '\0';
@@ -425,7 +655,7 @@ AudioIO::AudioIO(int framesPerBuf, double framesPerSec, void (* callbackA)(Audio
 	int outChansA, int inChansA, AudioIO::Backend backend)
 :	AudioIOData(userData),
 	callback(callbackA),
-	mZeroNANs(true), mClipOut(true), mAutoZeroOut(true)
+	mBackend(backend), mProfiler(0), mAllocator(0), mZeroNANs(true), mClipOut(true), mAutoZeroOut(true)
 {
 	switch(backend) {
 	case PORTAUDIO:
@@ -436,6 +666,9 @@ AudioIO::AudioIO(int framesPerBuf, double framesPerSec, void (* callbackA)(Audio
 	case DUMMY:
 		mImpl = new DummyAudioBackend;
 		break;
+	case OFFLINE:
+		mImpl = new OfflineAudioBackend;
+		break;
 	}
 	init(outChansA, inChansA);
 	this->framesPerBuffer(framesPerBuf);
@@ -453,8 +686,11 @@ AudioIO::~AudioIO(){
 
 void AudioIO::init(int outChannels, int inChannels){
 	// Choose default devices for now...
-	deviceIn(AudioDevice::defaultInput());
-	deviceOut(AudioDevice::defaultOutput());
+	// (an offline stream has no devices and must not require any)
+	if(OFFLINE != mBackend){
+		deviceIn(AudioDevice::defaultInput());
+		deviceOut(AudioDevice::defaultOutput());
+	}
 
 	//	// Setup input stream parameters
 //	const PaDeviceInfo * dInfo = Pa_GetDeviceInfo(mInParams.device);
@@ -665,6 +901,59 @@ void AudioIO::processAudio(){
 	}
 }
 
+// Returns offline backend or NULL, with a warning, if another backend is used
+static OfflineAudioBackend * offlineBackend(AudioIO::Backend backend, AudioBackend * impl){
+	if(AudioIO::OFFLINE == backend) return static_cast<OfflineAudioBackend *>(impl);
+	warn("offline stream requires the OFFLINE backend", "AudioIO");
+	return NULL;
+}
+
+int AudioIO::processOffline(int numBlocks){
+	OfflineAudioBackend * b = offlineBackend(mBackend, mImpl);
+	if(!b) return 0;
+	if(b->isRunning()){
+		warn("offline stream is already running", "AudioIO");
+		return 0;
+	}
+	int i=0;
+	for(; i<numBlocks; ++i) b->process(*this);
+	return i;
+}
+
+AudioIO& AudioIO::offlineInput(const float * samples, int frames, int channels, bool loop){
+	OfflineAudioBackend * b = offlineBackend(mBackend, mImpl);
+	if(b) b->input(samples, frames, channels, loop);
+	return *this;
+}
+
+AudioIO& AudioIO::offlineInput(OfflineInput func, void * userData){
+	OfflineAudioBackend * b = offlineBackend(mBackend, mImpl);
+	if(b) b->input(func, userData);
+	return *this;
+}
+
+AudioIO& AudioIO::offlineOutput(std::vector<float> * samples){
+	OfflineAudioBackend * b = offlineBackend(mBackend, mImpl);
+	if(b) b->output(samples);
+	return *this;
+}
+
+AudioIO& AudioIO::offlineRate(double v){
+	OfflineAudioBackend * b = offlineBackend(mBackend, mImpl);
+	if(b) b->rate(v);
+	return *this;
+}
+
+void AudioIO::offlineReset(){
+	OfflineAudioBackend * b = offlineBackend(mBackend, mImpl);
+	if(b) b->reset();
+}
+
+AudioIO::OfflineStats AudioIO::offlineStats() const {
+	if(OFFLINE != mBackend) return OfflineStats();
+	return static_cast<const OfflineAudioBackend *>(mImpl)->stats();
+}
+
 int AudioIO::channels(bool forOutput) const {
 	return forOutput ? channelsOut() : channelsIn();
 }
@@ -0,0 +1,430 @@
+#include <math.h>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "allocore/io/al_AudioProfiler.hpp"
+#include "allocore/system/al_Thread.hpp"
+
+namespace al{
+
+namespace{
+
+enum{ BLOCK = -1 };	// stage of whole block events
+
+struct Event{
+	al_nsec start, dur;
+	al_nsec period;		// block period, for whole blocks
+	int stage;
+	bool xrun;
+};
+
+// Ring of events with one producer (its thread) and one consumer (update)
+struct EventRing{
+	std::vector<Event> events;
+	unsigned mask;
+	std::atomic<unsigned> write, read;
+	std::atomic<int> state;		// FREE, CLAIMING or OWNED
+	std::thread::id owner;		// valid once OWNED
+
+	enum{ FREE, CLAIMING, OWNED };
+
+	EventRing(): mask(0), write(0), read(0), state(FREE){}
+
+	void resize(unsigned capacity){
+		unsigned n = 1;
+		while(n < capacity) n <<= 1;
+		events.resize(n);
+		mask = n-1;
+	}
+
+	bool push(const Event& e){
+		unsigned w = write.load(std::memory_order_relaxed);
+		if(w - read.load(std::memory_order_acquire) > mask) return false;
+		events[w & mask] = e;
+		write.store(w+1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(Event& e){
+		unsigned r = read.load(std::memory_order_relaxed);
+		if(r == write.load(std::memory_order_acquire)) return false;
+		e = events[r & mask];
+		read.store(r+1, std::memory_order_release);
+		return true;
+	}
+};
+
+// Histogram of durations with logarithmically spaced bins, 16 per octave
+// (about 4% resolution) from 64 ns to about 4 s, plus one bin below 64 ns
+class Histogram{
+public:
+	enum{ BINS_PER_OCTAVE = 16, OCTAVES = 26, NUM_BINS = BINS_PER_OCTAVE*OCTAVES + 1 };
+	enum{ MIN_NSEC = 64 };
+
+	Histogram(){ clear(); }
+
+	void clear(){
+		for(int i=0; i<NUM_BINS; ++i) mBins[i] = 0;
+		mCount = 0;
+		mSum = 0;
+		mMax = 0;
+	}
+
+	void add(al_nsec dur){
+		int i = 0;
+		if(dur >= MIN_NSEC){
+			i = 1 + int(log2(double(dur) / MIN_NSEC) * BINS_PER_OCTAVE);
+			if(i >= NUM_BINS) i = NUM_BINS-1;
+		}
+		++mBins[i];
+		++mCount;
+		mSum += dur;
+		if(dur > mMax) mMax = dur;
+	}
+
+	unsigned long count() const { return mCount; }
+	double sum() const { return mSum * 1e-9; }
+	double mean() const { return mCount ? sum() / mCount : 0; }
+	double max() const { return mMax * 1e-9; }
+
+	// Get quantile in seconds, as the upper edge of its bin
+	double quantile(double q) const {
+		if(!mCount) return 0;
+		unsigned long target = (unsigned long)ceil(q * mCount);
+		if(target < 1) target = 1;
+		unsigned long cum = 0;
+		for(int i=0; i<NUM_BINS; ++i){
+			cum += mBins[i];
+			if(cum >= target){
+				double upper = MIN_NSEC * 1e-9 * pow(2., double(i) / BINS_PER_OCTAVE);
+				return upper < max() ? upper : max();
+			}
+		}
+		return max();
+	}
+
+private:
+	unsigned long mBins[NUM_BINS];
+	unsigned long mCount;
+	double mSum;		// in nanoseconds
+	al_nsec mMax;
+};
+
+std::mutex& stageMutex(){
+	static std::mutex m;
+	return m;
+}
+
+std::vector<std::string>& stageNames(){
+	static std::vector<std::string> v;
+	return v;
+}
+
+std::atomic<unsigned> sNextProfilerID(1);
+
+// Ids of profilers not yet deleted. These are never destroyed, so that
+// threads can still exit after static destruction.
+std::mutex& liveMutex(){
+	static std::mutex * m = new std::mutex;
+	return *m;
+}
+
+std::set<unsigned>& liveProfilers(){
+	static std::set<unsigned> * s = new std::set<unsigned>;
+	return *s;
+}
+
+thread_local AudioProfiler * tCurrent = NULL;
+
+// Rings claimed by the thread. They are freed when the thread exits, so
+// that the threads of restarted streams do not use up the rings.
+struct ThreadRings{
+	enum{ MAX = 16 };
+	struct Claim{
+		unsigned profilerID;
+		EventRing * ring;
+	};
+	Claim claims[MAX];
+	int size;
+
+	ThreadRings(): size(0){}
+
+	~ThreadRings(){
+		std::lock_guard<std::mutex> lock(liveMutex());
+		for(int i=0; i<size; ++i){
+			if(liveProfilers().count(claims[i].profilerID)){
+				claims[i].ring->state = EventRing::FREE;
+			}
+		}
+	}
+
+	// Claims past the maximum are kept until the profiler is deleted
+	void add(unsigned profilerID, EventRing * ring){
+		if(size < MAX){
+			claims[size].profilerID = profilerID;
+			claims[size].ring = ring;
+			++size;
+		}
+	}
+};
+thread_local ThreadRings tClaims;
+
+// Ring last used by the thread, so most lookups need no search
+struct RingCache{
+	unsigned profilerID;
+	EventRing * ring;
+};
+thread_local RingCache tRing = {0, NULL};
+
+} // ::
+
+
+class AudioProfiler::Impl{
+public:
+	Impl(unsigned maxThreads, unsigned eventsPerThread)
+	:	mID(sNextProfilerID++), mRings(maxThreads > 0 ? maxThreads : 1),
+		mDropped(0), mPeriodSum(0), mMisses(0), mXruns(0), mRun(false), mUpdatePeriod(0.25)
+	{
+		for(unsigned i=0; i<mRings.size(); ++i) mRings[i].resize(eventsPerThread);
+		std::lock_guard<std::mutex> lock(liveMutex());
+		liveProfilers().insert(mID);
+	}
+
+	~Impl(){
+		std::lock_guard<std::mutex> lock(liveMutex());
+		liveProfilers().erase(mID);
+	}
+
+	// Get ring of calling thread, claiming a free one on first use
+	EventRing * ring(){
+		if(tRing.profilerID == mID) return tRing.ring;
+
+		std::thread::id self = std::this_thread::get_id();
+		EventRing * r = NULL;
+		for(unsigned i=0; i<mRings.size() && !r; ++i){
+			if(EventRing::OWNED == mRings[i].state.load() && mRings[i].owner == self) r = &mRings[i];
+		}
+		for(unsigned i=0; i<mRings.size() && !r; ++i){
+			int expected = EventRing::FREE;
+			if(mRings[i].state.compare_exchange_strong(expected, EventRing::CLAIMING)){
+				mRings[i].owner = self;
+				mRings[i].state = EventRing::OWNED;
+				r = &mRings[i];
+				tClaims.add(mID, r);
+			}
+		}
+		tRing.profilerID = mID;
+		tRing.ring = r;
+		return r;
+	}
+
+	void push(const Event& e){
+		EventRing * r = ring();
+		if(!r || !r->push(e)) ++mDropped;
+	}
+
+	void update(){
+		std::lock_guard<std::mutex> lock(mMutex);
+		Event e;
+		// Rings freed by exited threads may still hold events
+		for(unsigned i=0; i<mRings.size(); ++i){
+			while(mRings[i].pop(e)){
+				if(BLOCK == e.stage){
+					mBlock.add(e.dur);
+					mPeriodSum += e.period * 1e-9;
+					if(e.dur > e.period) ++mMisses;
+					if(e.xrun) ++mXruns;
+				}
+				else{
+					mStages[e.stage].add(e.dur);
+				}
+			}
+		}
+	}
+
+	void reset(){
+		std::lock_guard<std::mutex> lock(mMutex);
+		mBlock.clear();
+		for(int i=0; i<MAX_STAGES; ++i) mStages[i].clear();
+		mPeriodSum = 0;
+		mMisses = 0;
+		mXruns = 0;
+		mDropped = 0;
+	}
+
+	Stats stats(const Histogram& h, const std::string& name) const {
+		Stats s;
+		s.name = name;
+		s.count = h.count();
+		s.mean = h.mean();
+		s.p50 = h.quantile(0.5);
+		s.p90 = h.quantile(0.9);
+		s.p99 = h.quantile(0.99);
+		s.max = h.max();
+		s.load = mPeriodSum > 0 ? h.sum() / mPeriodSum : 0;
+		return s;
+	}
+
+	static void * threadFunc(void * user){
+		Impl& impl = *(Impl *)user;
+		while(impl.mRun){
+			impl.update();
+			// Sleep in short steps so stop() does not wait a whole period
+			for(double t=0; t<impl.mUpdatePeriod && impl.mRun; t+=0.01) al_sleep(0.01);
+		}
+		return NULL;
+	}
+
+	unsigned mID;
+	std::vector<EventRing> mRings;
+	std::atomic<unsigned long> mDropped;
+
+	mutable std::mutex mMutex;	// guards statistics
+	Histogram mBlock;
+	Histogram mStages[MAX_STAGES];
+	double mPeriodSum;
+	unsigned long mMisses, mXruns;
+
+	Thread mThread;
+	std::atomic<bool> mRun;
+	double mUpdatePeriod;
+};
+
+
+AudioProfiler::AudioProfiler(unsigned maxThreads, unsigned eventsPerThread)
+:	mImpl(new Impl(maxThreads, eventsPerThread)), mEnabled(true),
+	mBlockStart(0), mBlockPeriod(0), mPrevCurrent(NULL)
+{}
+
+AudioProfiler::~AudioProfiler(){
+	stop();
+	if(tCurrent == this) tCurrent = NULL;
+	delete mImpl;
+}
+
+int AudioProfiler::stage(const char * name){
+	std::lock_guard<std::mutex> lock(stageMutex());
+	std::vector<std::string>& names = stageNames();
+	for(unsigned i=0; i<names.size(); ++i){
+		if(names[i] == name) return i;
+	}
+	if(names.size() >= MAX_STAGES) return -1;
+	names.push_back(name);
+	return names.size()-1;
+}
+
+std::string AudioProfiler::stageName(int stage){
+	std::lock_guard<std::mutex> lock(stageMutex());
+	std::vector<std::string>& names = stageNames();
+	return stage >= 0 && stage < int(names.size()) ? names[stage] : "";
+}
+
+AudioProfiler * AudioProfiler::current(){ return tCurrent; }
+
+void AudioProfiler::makeCurrent(){ tCurrent = this; }
+
+void AudioProfiler::clearCurrent(){ tCurrent = NULL; }
+
+void AudioProfiler::beginBlock(double period){
+	// Only current during the block, so that the thread does not record
+	// into the profiler after it was removed from the stream or deleted
+	mPrevCurrent = tCurrent;
+	if(!mEnabled){
+		mBlockStart = 0;
+		return;
+	}
+	tCurrent = this;
+	mBlockPeriod = period;
+	mBlockStart = al_steady_time_nsec();
+}
+
+void AudioProfiler::endBlock(bool xrun){
+	if(mEnabled && mBlockStart){
+		Event e;
+		e.start = mBlockStart;
+		e.dur = al_steady_time_nsec() - mBlockStart;
+		e.period = al_nsec(mBlockPeriod * 1e9);
+		e.stage = BLOCK;
+		e.xrun = xrun;
+		mImpl->push(e);
+	}
+	mBlockStart = 0;
+	tCurrent = mPrevCurrent;
+}
+
+void AudioProfiler::record(int stage, al_nsec start, al_nsec end){
+	if(!mEnabled || stage < 0 || stage >= MAX_STAGES) return;
+	Event e;
+	e.start = start;
+	e.dur = end - start;
+	e.period = 0;
+	e.stage = stage;
+	e.xrun = false;
+	mImpl->push(e);
+}
+
+void AudioProfiler::update(){ mImpl->update(); }
+
+void AudioProfiler::start(double period){
+	if(mImpl->mRun) return;
+	mImpl->mUpdatePeriod = period;
+	mImpl->mRun = true;
+	mImpl->mThread.start(Impl::threadFunc, mImpl);
+}
+
+void AudioProfiler::stop(){
+	if(!mImpl->mRun) return;
+	mImpl->mRun = false;
+	mImpl->mThread.join();
+	mImpl->update();
+}
+
+void AudioProfiler::reset(){ mImpl->reset(); }
+
+AudioProfiler::Stats AudioProfiler::blockStats() const {
+	std::lock_guard<std::mutex> lock(mImpl->mMutex);
+	return mImpl->stats(mImpl->mBlock, "block");
+}
+
+std::vector<AudioProfiler::Stats> AudioProfiler::stageStats() const {
+	std::vector<Stats> res;
+	std::lock_guard<std::mutex> lock(mImpl->mMutex);
+	for(int i=0; i<MAX_STAGES; ++i){
+		if(mImpl->mStages[i].count()){
+			res.push_back(mImpl->stats(mImpl->mStages[i], stageName(i)));
+		}
+	}
+	return res;
+}
+
+unsigned long AudioProfiler::deadlineMisses() const {
+	std::lock_guard<std::mutex> lock(mImpl->mMutex);
+	return mImpl->mMisses;
+}
+
+unsigned long AudioProfiler::xruns() const {
+	std::lock_guard<std::mutex> lock(mImpl->mMutex);
+	return mImpl->mXruns;
+}
+
+unsigned long AudioProfiler::dropped() const { return mImpl->mDropped; }
+
+static void printStats(FILE * fp, const AudioProfiler::Stats& s){
+	fprintf(fp, "%-32s %8lu %9.1f %9.1f %9.1f %9.1f %9.1f %6.1f%%\n",
+		s.name.c_str(), s.count, s.mean*1e6, s.p50*1e6, s.p90*1e6, s.p99*1e6,
+		s.max*1e6, s.load*100
+	);
+}
+
+void AudioProfiler::print(FILE * fp) const {
+	fprintf(fp, "%-32s %8s %9s %9s %9s %9s %9s %7s\n",
+		"stage", "count", "mean(us)", "p50", "p90", "p99", "max", "load");
+	printStats(fp, blockStats());
+	std::vector<Stats> stages = stageStats();
+	for(unsigned i=0; i<stages.size(); ++i) printStats(fp, stages[i]);
+	fprintf(fp, "deadline misses: %lu, xruns: %lu, dropped timings: %lu\n",
+		deadlineMisses(), xruns(), dropped());
+}
+
+} // al::
@@ -2,7 +2,9 @@
 #include <math.h>
 #include <stdio.h>
 #include "allocore/system/al_Config.h"
+#include <chrono>
 #include "allocore/io/al_MIDI.hpp"
+#include "allocore/io/al_AudioIOData.hpp"
 
 #if defined(AL_OSX)
 	#define __MACOSX_CORE__
@@ -134,6 +136,114 @@ void MIDIMessageHandler::bindTo(MIDIIn& midiIn, unsigned port){
 
 
 
+MIDIMessageQueue::MIDIMessageQueue(unsigned capacity)
+:	mMask(0), mWrite(0), mRead(0), mOverflows(0)
+{
+	unsigned n = 1;
+	while(n < capacity) n <<= 1;
+	mMask = n-1;
+	mMessages.resize(n, MIDIMessage(0, 0, 0));
+}
+
+bool MIDIMessageQueue::push(const MIDIMessage& m){
+	unsigned w = mWrite.load(std::memory_order_relaxed);
+	if(w - mRead.load(std::memory_order_acquire) > mMask){
+		mOverflows.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	// Sysex data is owned by the MIDI backend, so it cannot be kept
+	mMessages[w & mMask] = MIDIMessage(
+		m.timeStamp(), m.port(), m.bytes[0], m.bytes[1], m.bytes[2]
+	);
+	mWrite.store(w+1, std::memory_order_release);
+	return true;
+}
+
+const MIDIMessage * MIDIMessageQueue::front() const {
+	unsigned r = mRead.load(std::memory_order_relaxed);
+	if(r == mWrite.load(std::memory_order_acquire)) return NULL;
+	return &mMessages[r & mMask];
+}
+
+void MIDIMessageQueue::pop(){
+	unsigned r = mRead.load(std::memory_order_relaxed);
+	if(r != mWrite.load(std::memory_order_acquire)){
+		mRead.store(r+1, std::memory_order_release);
+	}
+}
+
+bool MIDIMessageQueue::pop(MIDIMessage& m){
+	const MIDIMessage * f = front();
+	if(!f) return false;
+	m = *f;
+	pop();
+	return true;
+}
+
+
+MIDIAudioDispatcher::MIDIAudioDispatcher(unsigned capacity)
+:	mQueue(capacity), mWindowStart(0), mWindowEnd(0), mFramesPerSec(0), mFrames(0)
+{}
+
+double MIDIAudioDispatcher::clock(){
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+void MIDIAudioDispatcher::onMIDIMessage(const MIDIMessage& m){
+	push(m, clock());
+}
+
+bool MIDIAudioDispatcher::push(const MIDIMessage& m, double time){
+	return mQueue.push(MIDIMessage(time, m.port(), m.bytes[0], m.bytes[1], m.bytes[2]));
+}
+
+void MIDIAudioDispatcher::beginBlock(const AudioIOData& io){
+	beginBlock(io.framesPerBuffer(), io.framesPerSecond(), clock());
+}
+
+void MIDIAudioDispatcher::beginBlock(int framesPerBuffer, double framesPerSecond, double time){
+	double dur = framesPerBuffer / framesPerSecond;
+
+	// The block covers the time since the previous block. If this is the
+	// first block or the callbacks stalled, start over with a nominal block.
+	double start = mWindowEnd;
+	if(mFrames == 0 || time <= start || time - start > 4*dur){
+		start = time - dur;
+	}
+
+	mWindowStart = start;
+	mWindowEnd = time;
+	mFrames = framesPerBuffer;
+	mFramesPerSec = framesPerBuffer / (time - start);
+}
+
+int MIDIAudioDispatcher::frameOf(double time) const {
+	int f = int((time - mWindowStart) * mFramesPerSec);
+	return f < 0 ? 0 : (f < mFrames ? f : mFrames-1);
+}
+
+bool MIDIAudioDispatcher::next(MIDIMessage& m, int& frame){
+	const MIDIMessage * f = mQueue.front();
+	// Messages that arrived after the block started wait for the next block
+	if(!f || f->timeStamp() >= mWindowEnd) return false;
+	frame = frameOf(f->timeStamp());
+	m = *f;
+	mQueue.pop();
+	return true;
+}
+
+bool MIDIAudioDispatcher::nextAt(MIDIMessage& m, int frame){
+	const MIDIMessage * f = mQueue.front();
+	if(!f || f->timeStamp() >= mWindowEnd || frameOf(f->timeStamp()) > frame){
+		return false;
+	}
+	m = *f;
+	mQueue.pop();
+	return true;
+}
+
+
 /*
 DO NOT MODIFY BELOW THIS POINT!!!
 Below is the RtMidi implementation code verbatim (w/o RtMidi.h header include).
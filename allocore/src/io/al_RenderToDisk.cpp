@@ -96,8 +96,8 @@ bool RenderToDisk::start(al::Window& win, double fps){
 bool RenderToDisk::start(al::AudioIO * aio, al::Window * win, double fps){
 	if(mActive) return true;
 
-	if(NON_REAL_TIME == mMode && 0 == win){
-		fprintf(stderr, "RenderToDisk::start: Warning-- Non-real-time audio-only rendering currently not supported\n");
+	if(NON_REAL_TIME == mMode && 0 == win && !(aio && AudioIO::OFFLINE == aio->backend())){
+		fprintf(stderr, "RenderToDisk::start: Warning-- Non-real-time audio-only rendering requires the OFFLINE audio backend\n");
 		return false;
 	}
 
@@ -168,9 +168,12 @@ bool RenderToDisk::start(al::AudioIO * aio, al::Window * win, double fps){
 			return NULL;
 		}};
 
-		mSoundFileThread.start(F::threadFunc, this);
+		// Offline audio-only rendering writes blocks from onAudioCB instead
+		if(!offlineAudio()){
+			mSoundFileThread.start(F::threadFunc, this);
+		}
 
-		if(NON_REAL_TIME == mMode){
+		if(NON_REAL_TIME == mMode && mWindow){
 			mAudioIO->stop();
 		}
 
@@ -196,6 +199,7 @@ void RenderToDisk::stop(){
 	if(!mActive) return;
 	
 	mActive = false;
+	const bool offline = offlineAudio();
 
 	if(mWindow){
 		// Empty and reset PBO queue
@@ -221,12 +225,12 @@ void RenderToDisk::stop(){
 	}
 
 	if(mAudioIO){
-		mSoundFileThread.join();
-		mSoundFile.close();
-
 		mAudioIO->remove(*this);
+
+		if(!offline) mSoundFileThread.join();
+		mSoundFile.close();
 	
-		if(NON_REAL_TIME == mMode){
+		if(NON_REAL_TIME == mMode && !offline){
 			mAudioIO->start();
 		}
 
@@ -263,6 +267,16 @@ void RenderToDisk::write(){
 
 void RenderToDisk::onAudioCB(AudioIOData& io){
 	mAudioRing.write(io.outBuffer(0));
+
+	// Without graphics, the offline stream sets the pace so each block can be
+	// written right away
+	if(offlineAudio() && mActive){
+		mAudioRing.read();
+		mSoundFile.write(
+			reinterpret_cast<const char*>(mAudioRing.readBuffer()),
+			mAudioRing.blockSizeInSamples() * sizeof(float)
+		);
+	}
 }
 
 bool RenderToDisk::onFrame(){
@@ -20,6 +20,7 @@ Therefore, you will need to use sendto() on UDP socket in order to specify the d
 You can actually use connect() on UDP socket as an option. In that case, you can use send()/recv() on the UDP socket to send data to the address specified with the connect() and to receive data only from the address. (The connect() on UDP socket merely sets the default peer address and you can call connect() on UDP socket as many times as you want, and the connect() on UDP socket, of course, does not perform any handshake for connection.)
 */
 
+#include <cstdio>
 #include <cstring>
 #include "allocore/io/al_Socket.hpp"
 #include "allocore/system/al_Config.h"
@@ -28,8 +29,10 @@ You can actually use connect() on UDP socket as an option. In that case, you can
 #include "../private/al_ImplAPR.h"
 #if defined(AL_LINUX)
 #include "apr-1.0/apr_network_io.h"
+#include "apr-1.0/apr_portable.h"
 #else
 #include "apr-1/apr_network_io.h"
+#include "apr-1/apr_portable.h"
 #endif
 
 #define PRINT_SOCKADDR(s)\
@@ -158,6 +161,10 @@ struct Socket::Impl : public ImplAPR {
 
 	bool bind(){ // for server-side
 		if(opened()){
+			// Let several receivers on one host listen to the same group
+			if(Socket::isMulticast(mAddress.c_str())){
+				check_apr(apr_socket_opt_set(mSock, APR_SO_REUSEADDR, 1));
+			}
 			apr_status_t res = check_apr(apr_socket_bind(mSock, mSockAddr));
 			return APR_SUCCESS == res;
 		}
@@ -237,6 +244,15 @@ struct Socket::Impl : public ImplAPR {
 		return true;
 	}
 
+	bool joinMulticast(const char * group){
+		if(!opened()) return false;
+		apr_sockaddr_t * groupAddr;
+		if(APR_SUCCESS != check_apr(
+			apr_sockaddr_info_get(&groupAddr, group, mSockAddr->family, 0, 0, mPool)
+		)) return false;
+		return APR_SUCCESS == check_apr(apr_mcast_join(mSock, groupAddr, NULL, NULL));
+	}
+
 	bool opened() const { return 0!=mSock; }
 
 	uint16_t mPort;
@@ -276,6 +292,12 @@ uint16_t Socket::port() const { return mImpl->mPort; }
 
 al_sec Socket::timeout() const { return mImpl->mTimeout; }
 
+int Socket::fileDescriptor() const {
+	apr_os_sock_t fd;
+	if(!opened() || APR_SUCCESS != apr_os_sock_get(&fd, mImpl->mSock)) return -1;
+	return (int)fd;
+}
+
 bool Socket::bind(){ return mImpl->bind(); }
 
 bool Socket::connect(){ return mImpl->connect(); }
@@ -350,6 +372,34 @@ bool Socket::accept(Socket& sock){
 }
 
 
+bool Socket::joinMulticast(const char * group){
+	return mImpl->joinMulticast(group ? group : mImpl->mAddress.c_str());
+}
+
+bool Socket::multicastHops(int hops){
+	return opened()
+		&& APR_SUCCESS == check_apr(apr_mcast_hops(mImpl->mSock, apr_byte_t(hops)));
+}
+
+bool Socket::multicastLoopback(bool v){
+	return opened()
+		&& APR_SUCCESS == check_apr(apr_mcast_loopback(mImpl->mSock, v ? 1 : 0));
+}
+
+bool Socket::receiveBufferSize(int bytes){
+	return opened()
+		&& APR_SUCCESS == check_apr(apr_socket_opt_set(mImpl->mSock, APR_SO_RCVBUF, bytes));
+}
+
+bool Socket::isMulticast(const char * address){
+	int a, b, c, d;
+	if(address && 4 == sscanf(address, "%d.%d.%d.%d", &a, &b, &c, &d)){
+		return a >= 224 && a <= 239;
+	}
+	return false;
+}
+
+
 bool SocketClient::onOpen(){
 	return connect();
 }
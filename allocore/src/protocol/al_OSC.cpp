@@ -375,16 +375,18 @@ static void * recvThreadFunc(void * user){
 }
 
 Recv::Recv()
-:	mHandler(0), mBuffer(1024), mBackground(false)
+:	mHandler(0), mBuffer(1024), mBackground(false), mMain(0)
 {
+	mMainHandler.recv = this;
   // printf("Entering Recv::Recv()\n");
 }
 
 
 Recv::Recv(uint16_t port, const char * address, al_sec timeout)
 :	SocketServer(port, address, timeout, Socket::UDP),
-	mHandler(0), mBuffer(1024), mBackground(false)
+	mHandler(0), mBuffer(1024), mBackground(false), mMain(0)
 {
+	mMainHandler.recv = this;
   // printf("Entering Recv::Recv(port=%d, addr=%s)\n", port, address);
 }
 
@@ -426,12 +428,25 @@ bool Recv::start(){
 	return mThread.start(recvThreadFunc, this);
 }
 
-/// Stop the background polling
+bool Recv::start(Main& main){
+	int fd = fileDescriptor();
+	if(fd < 0) return false;
+	if(mMain) mMain->unwatch(mMainHandler);
+	mMain = &main;
+	main.watch(fd, mMainHandler);
+	return true;
+}
+
+/// Stop the background polling and receiving in a main loop
 void Recv::stop(){
 	if(mBackground){
 		mBackground = false;
 		mThread.join();
 	}
+	if(mMain){
+		mMain->unwatch(mMainHandler);
+		mMain = 0;
+	}
 }
 
 
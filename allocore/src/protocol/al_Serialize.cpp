@@ -6,6 +6,14 @@
 
 namespace al{
 
+Serializer::Serializer()
+:	mExt(NULL), mSize(0), mCapacity(0), mOverflow(false)
+{}
+
+Serializer::Serializer(char * buf, uint32_t capacity)
+:	mExt(buf), mSize(0), mCapacity(capacity), mOverflow(false)
+{}
+
 Serializer& Serializer::operator<< (const char * v){
 	return add(v, strlen(v)+1);
 }
@@ -14,33 +22,46 @@ Serializer& Serializer::operator<< (const std::string& v){
 	return add(v.c_str(), v.size()+1);
 }
 
+Serializer& Serializer::reserve(uint32_t bytes){
+	mBuf.reserve(bytes);
+	return *this;
+}
+
+Serializer& Serializer::clear(){
+	mBuf.clear();
+	mSize = 0;
+	mOverflow = false;
+	return *this;
+}
+
 const std::vector<char>& Serializer::buf() const { return mBuf; }
 
 
 
-Deserializer::Deserializer(const std::vector<char>& b): mStart(0), mBuf(b){}
+Deserializer::Deserializer(const std::vector<char>& b)
+:	mData(b.data()), mSize(b.size()), mStart(0), mOverflow(false)
+{}
 
 Deserializer::Deserializer(const char * b, uint32_t n)
-:	mStart(0)
-{	mBuf.insert(mBuf.begin(), b, b+n); }
+:	mData(b), mSize(n), mStart(0), mOverflow(false)
+{}
 
 Deserializer& Deserializer::operator>> (char * v){
-	uint32_t n = serDecode(bufDec(), v);
-	mStart += n;
+	SerHeader h;
+	if(next(h) && h.type == SER_INT8) get(v, h.num);
 	return *this;
 }
 
 Deserializer& Deserializer::operator>> (std::string& v){
-	SerHeader h = serGetHeader(bufDec());
-	uint32_t need = serElementsSize(&h);
-	if(v.size() < need) v.resize(need);
-	return *this >> &v[0];
+	SerHeader h;
+	if(next(h) && h.type == SER_INT8){
+		const char * s = bufDec() + serHeaderSize();
+		v.assign(s, h.num && !s[h.num-1] ? h.num-1 : h.num);
+		mStart += serHeaderSize() + serElementsSize(&h);
+	}
+	return *this;
 }
 
-const std::vector<char>& Deserializer::buf() const { return mBuf; }
-
-char * Deserializer::bufDec(){ return &mBuf[mStart]; }
-
 } // al::
 #endif
 
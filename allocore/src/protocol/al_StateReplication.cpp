@@ -0,0 +1,488 @@
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "allocore/io/al_Socket.hpp"
+#include "allocore/protocol/al_StateReplication.hpp"
+#include "allocore/system/al_Printing.hpp"
+#include "allocore/system/al_Thread.hpp"
+
+namespace al{
+
+namespace{
+
+/*
+Datagram layout (host byte order):
+	0	uint32	magic
+	4	uint32	frame sequence number
+	8	uint32	state size
+	12	uint32	encoded frame size
+	16	uint32	offset of payload in encoded frame
+	20	uint32	fragment index
+	24	uint32	fragment count
+	28	uint8	flags
+	32			payload
+
+Encoded frame, unless RAW: a sequence of (zero run, literal length, literal
+bytes) where the runs are unsigned LEB128 varints and the literal bytes are
+the XOR of the new state and the previous one. RAW frames are the XOR bytes
+for the whole state.
+*/
+const uint32_t MAGIC = 0x52534c41; // "ALSR"
+const int HEADER_SIZE = 32;
+const uint8_t KEYFRAME = 1;
+const uint8_t RAW = 2;
+
+// Shortest zero run worth ending a literal for
+const size_t MIN_ZERO_RUN = 8;
+
+// Largest UDP payload over IPv4
+const unsigned MAX_DATAGRAM = 65507;
+
+// Whether frame is at most a short while before ref. Frames much further
+// back are taken to come from a restarted sender.
+inline bool isBefore(uint32_t frame, uint32_t ref, bool orSame){
+	int32_t d = int32_t(frame - ref);
+	return (orSame ? d <= 0 : d < 0) && d > -1024;
+}
+
+inline void put32(uint8_t * b, uint32_t v){ memcpy(b, &v, 4); }
+inline uint32_t get32(const uint8_t * b){ uint32_t v; memcpy(&v, b, 4); return v; }
+inline uint64_t get64(const uint8_t * b){ uint64_t v; memcpy(&v, b, 8); return v; }
+
+void putVarint(std::vector<uint8_t>& out, size_t v){
+	while(v >= 0x80){
+		out.push_back(uint8_t(v) | 0x80);
+		v >>= 7;
+	}
+	out.push_back(uint8_t(v));
+}
+
+bool getVarint(const uint8_t *& in, const uint8_t * end, size_t& v){
+	v = 0;
+	for(int shift = 0; in < end && shift < 64; shift += 7){
+		uint8_t b = *in++;
+		v |= size_t(b & 0x7f) << shift;
+		if(!(b & 0x80)) return true;
+	}
+	return false;
+}
+
+// XOR encode cur against prev (or against zeros if prev is NULL)
+uint8_t encodeFrame(
+	const uint8_t * cur, const uint8_t * prev, size_t n, std::vector<uint8_t>& out
+){
+	out.clear();
+	#define XOR_AT(k) (prev ? uint8_t(cur[k] ^ prev[k]) : cur[k])
+	size_t i = 0;
+	while(i < n){
+		// Skip unchanged bytes, a word at a time where possible
+		size_t z = i;
+		if(prev){
+			while(z + 8 <= n && get64(cur + z) == get64(prev + z)) z += 8;
+		}
+		else{
+			while(z + 8 <= n && get64(cur + z) == 0) z += 8;
+		}
+		while(z < n && XOR_AT(z) == 0) ++z;
+		if(z == n) break;
+
+		// Literal until the next run of zeros long enough to be worth a token
+		size_t l = z, zeros = 0;
+		for(; l < n; ++l){
+			if(XOR_AT(l) == 0){
+				if(++zeros == MIN_ZERO_RUN) break;
+			}
+			else zeros = 0;
+		}
+		size_t litEnd = (l < n) ? l + 1 - zeros : n - zeros;
+
+		putVarint(out, z - i);
+		putVarint(out, litEnd - z);
+		size_t pos = out.size();
+		out.resize(pos + litEnd - z);
+		for(size_t k = z; k < litEnd; ++k) out[pos++] = XOR_AT(k);
+		i = litEnd;
+
+		// Little or nothing is unchanged, don't bother with run lengths
+		if(out.size() > n) break;
+	}
+
+	if(out.size() > n){
+		out.resize(n);
+		for(size_t k = 0; k < n; ++k) out[k] = XOR_AT(k);
+		return RAW;
+	}
+	#undef XOR_AT
+	return 0;
+}
+
+// Whether the fragment fields of a datagram with len payload bytes are those
+// of a frame split into count equal fragments (except the last)
+bool validFragment(
+	uint32_t encodedSize, uint32_t offset, uint32_t index, uint32_t count, uint32_t len
+){
+	if(index >= count) return false;
+	if(!encodedSize) return count == 1 && !offset && !len;
+
+	// Size of all fragments but the last
+	uint32_t step;
+	if(index + 1 < count) step = len;
+	else if(index){
+		if(offset % index) return false;
+		step = offset / index;
+	}
+	else step = encodedSize;
+
+	if(!step || len > step || uint64_t(index) * step != offset) return false;
+	if(uint64_t(offset) + len > encodedSize) return false;
+	if(index + 1 == count && offset + len != encodedSize) return false;
+	return count == (encodedSize - 1) / step + 1;
+}
+
+// Apply an encoded frame to state in place
+bool decodeFrame(uint8_t * state, size_t n, const uint8_t * in, size_t len, uint8_t flags){
+	if(flags & KEYFRAME) memset(state, 0, n);
+	if(flags & RAW){
+		if(len != n) return false;
+		for(size_t k = 0; k < n; ++k) state[k] ^= in[k];
+		return true;
+	}
+	const uint8_t * end = in + len;
+	size_t pos = 0;
+	while(in < end){
+		size_t zeros, lit;
+		if(!getVarint(in, end, zeros) || !getVarint(in, end, lit)) return false;
+		if(zeros > n - pos || lit > n - pos - zeros || lit > size_t(end - in)) return false;
+		pos += zeros;
+		for(size_t k = 0; k < lit; ++k) state[pos + k] ^= in[k];
+		pos += lit;
+		in += lit;
+	}
+	return true;
+}
+
+} // ::
+
+
+
+class StateSender::Impl{
+public:
+	Impl(size_t stateSize, uint16_t port, const char * address, int hops)
+	:	mStateSize(stateSize), mMTU(1472), mKeyframeInterval(60),
+		mFrame(0), mLastKeyframe(0), mForceKeyframe(true),
+		mBytesSent(0), mStateBytes(0), mPacketsSent(0),
+		mPrev(stateSize, 0), mPacket(65536)
+	{
+		// Block when the send buffer is full rather than dropping datagrams
+		mSocket.open(port, address, -1, Socket::UDP|Socket::DGRAM);
+		if(Socket::isMulticast(address)){
+			mSocket.multicastHops(hops);
+			mSocket.multicastLoopback(true);
+		}
+	}
+
+	size_t send(const void * state){
+		const uint8_t * cur = (const uint8_t *)state;
+		uint32_t frame = mFrame + 1;
+		bool key = mForceKeyframe || mKeyframeInterval == 0
+			|| frame - mLastKeyframe >= mKeyframeInterval;
+
+		uint8_t flags = encodeFrame(cur, key ? NULL : &mPrev[0], mStateSize, mEncoded);
+		if(key){
+			flags |= KEYFRAME;
+			mLastKeyframe = frame;
+			mForceKeyframe = false;
+		}
+		memcpy(&mPrev[0], cur, mStateSize);
+
+		uint32_t payloadSize = mMTU - HEADER_SIZE;
+		uint32_t encodedSize = mEncoded.size();
+		uint32_t count = encodedSize ? (encodedSize + payloadSize - 1) / payloadSize : 1;
+		uint8_t * p = &mPacket[0];
+		put32(p, MAGIC);
+		put32(p + 4, frame);
+		put32(p + 8, mStateSize);
+		put32(p + 12, encodedSize);
+		put32(p + 24, count);
+		p[28] = flags;
+		p[29] = p[30] = p[31] = 0;
+
+		size_t sent = 0;
+		for(uint32_t i = 0; i < count; ++i){
+			uint32_t offset = i * payloadSize;
+			uint32_t len = encodedSize - offset < payloadSize ? encodedSize - offset : payloadSize;
+			put32(p + 16, offset);
+			put32(p + 20, i);
+			if(len) memcpy(p + HEADER_SIZE, &mEncoded[offset], len);
+			sent += mSocket.send((const char *)p, HEADER_SIZE + len);
+		}
+
+		mFrame = frame;
+		mBytesSent += sent;
+		mStateBytes += mStateSize;
+		mPacketsSent += count;
+		return sent;
+	}
+
+	SocketClient mSocket;
+	size_t mStateSize;
+	unsigned mMTU;
+	unsigned mKeyframeInterval;
+	uint32_t mFrame, mLastKeyframe;
+	bool mForceKeyframe;
+	uint64_t mBytesSent, mStateBytes, mPacketsSent;
+	std::vector<uint8_t> mPrev, mEncoded, mPacket;
+};
+
+
+StateSender::StateSender(size_t stateSize, uint16_t port, const char * address, int hops)
+:	mImpl(new Impl(stateSize, port, address, hops))
+{}
+
+StateSender::~StateSender(){ delete mImpl; }
+
+bool StateSender::opened() const { return mImpl->mSocket.opened(); }
+
+size_t StateSender::stateSize() const { return mImpl->mStateSize; }
+
+StateSender& StateSender::mtu(unsigned bytes){
+	if(bytes <= HEADER_SIZE || bytes > MAX_DATAGRAM){
+		AL_WARN("StateSender: invalid MTU %u", bytes);
+	}
+	else{
+		mImpl->mMTU = bytes;
+	}
+	return *this;
+}
+
+StateSender& StateSender::keyframeInterval(unsigned frames){
+	mImpl->mKeyframeInterval = frames;
+	return *this;
+}
+
+StateSender& StateSender::requestKeyframe(){
+	mImpl->mForceKeyframe = true;
+	return *this;
+}
+
+size_t StateSender::send(const void * state){ return mImpl->send(state); }
+
+uint32_t StateSender::frame() const { return mImpl->mFrame; }
+
+uint64_t StateSender::bytesSent() const { return mImpl->mBytesSent; }
+
+uint64_t StateSender::stateBytes() const { return mImpl->mStateBytes; }
+
+uint64_t StateSender::packetsSent() const { return mImpl->mPacketsSent; }
+
+
+
+class StateReceiver::Impl{
+public:
+	enum{ FRESH = 4 };
+
+	Impl(size_t stateSize, uint16_t port, const char * address)
+	:	mStateSize(stateSize), mTimeout(0), mRunning(false),
+		mAssembling(false), mAsmFrame(0), mAsmFlags(0), mAsmReceived(0),
+		mBase(stateSize, 0), mHasBase(false), mBaseFrame(0),
+		mWriteIndex(0), mReadIndex(1), mMiddle(2), mAcquired(false),
+		mFramesReceived(0), mFramesDropped(0), mPacketsReceived(0),
+		mPacket(65536)
+	{
+		bool multicast = Socket::isMulticast(address);
+		mSocket.open(port, multicast ? address : "", 0, Socket::UDP|Socket::DGRAM);
+		if(multicast && !mSocket.joinMulticast()){
+			AL_WARN("StateReceiver: could not join multicast group %s", address);
+		}
+		// Room for bursts of large frames
+		mSocket.receiveBufferSize(8<<20);
+		for(int i=0; i<3; ++i){
+			mBuffers[i].resize(stateSize);
+			mFrames[i] = 0;
+		}
+	}
+
+	void timeout(al_sec t){
+		if(t != mTimeout){
+			mTimeout = t;
+			mSocket.timeout(t);
+		}
+	}
+
+	// Returns 1 if the datagram completed a frame
+	int receive(){
+		size_t len = mSocket.recv((char *)&mPacket[0], mPacket.size());
+		if(len < (size_t)HEADER_SIZE) return len ? 0 : -1;
+		++mPacketsReceived;
+
+		const uint8_t * p = &mPacket[0];
+		uint32_t frame = get32(p + 4);
+		uint32_t encodedSize = get32(p + 12);
+		uint32_t offset = get32(p + 16);
+		uint32_t index = get32(p + 20);
+		uint32_t count = get32(p + 24);
+		uint32_t payloadSize = len - HEADER_SIZE;
+		// Encoded frames are never larger than the state, which also bounds
+		// the number of fragments, so forged sizes can not exhaust memory
+		if(get32(p) != MAGIC || get32(p + 8) != mStateSize
+			|| encodedSize > mStateSize
+			|| !validFragment(encodedSize, offset, index, count, payloadSize)
+		) return 0;
+
+		if(!mAssembling || frame != mAsmFrame){
+			// Datagrams of an older frame arriving late
+			if(mAssembling && isBefore(frame, mAsmFrame, false)) return 0;
+			if(mHasBase && isBefore(frame, mBaseFrame, true)) return 0;
+			// The frame being assembled will never complete
+			if(mAssembling) ++mFramesDropped;
+			mAssembling = true;
+			mAsmFrame = frame;
+			mAsmFlags = p[28];
+			mAsmData.resize(encodedSize);
+			mAsmHave.assign(count, 0);
+			mAsmReceived = 0;
+		}
+		if(count != mAsmHave.size() || encodedSize != mAsmData.size()) return 0;
+		if(mAsmHave[index]) return 0;
+		mAsmHave[index] = 1;
+		if(payloadSize) memcpy(&mAsmData[offset], p + HEADER_SIZE, payloadSize);
+		if(++mAsmReceived < count) return 0;
+
+		mAssembling = false;
+		bool key = mAsmFlags & KEYFRAME;
+		if(!key && !(mHasBase && frame == mBaseFrame + 1)){
+			// Missed the frame this one is relative to, wait for a keyframe
+			mHasBase = false;
+			++mFramesDropped;
+			return 0;
+		}
+		if(!decodeFrame(&mBase[0], mStateSize,
+			mAsmData.empty() ? NULL : &mAsmData[0], mAsmData.size(), mAsmFlags)
+		){
+			mHasBase = false;
+			++mFramesDropped;
+			return 0;
+		}
+		mHasBase = true;
+		mBaseFrame = frame;
+		publish();
+		return 1;
+	}
+
+	void publish(){
+		memcpy(&mBuffers[mWriteIndex][0], &mBase[0], mStateSize);
+		mFrames[mWriteIndex] = mBaseFrame;
+		mWriteIndex = mMiddle.exchange(mWriteIndex | FRESH) & 3;
+		++mFramesReceived;
+	}
+
+	bool newFrame(){
+		if(!(mMiddle.load() & FRESH)) return false;
+		mReadIndex = mMiddle.exchange(mReadIndex) & 3;
+		mAcquired = true;
+		return true;
+	}
+
+	static void * receiveThread(void * user){
+		Impl& impl = *(Impl *)user;
+		while(impl.mRunning){
+			impl.receive();
+		}
+		return NULL;
+	}
+
+	SocketServer mSocket;
+	size_t mStateSize;
+	al_sec mTimeout;
+	Thread mThread;
+	std::atomic<bool> mRunning;
+
+	// Frame being assembled
+	bool mAssembling;
+	uint32_t mAsmFrame;
+	uint8_t mAsmFlags;
+	uint32_t mAsmReceived;
+	std::vector<uint8_t> mAsmData;
+	std::vector<char> mAsmHave;
+
+	// Last complete frame, base for the next delta
+	std::vector<uint8_t> mBase;
+	bool mHasBase;
+	uint32_t mBaseFrame;
+
+	// Triple buffer. The middle index carries a flag when it holds a frame
+	// the reader has not acquired yet.
+	std::vector<uint8_t> mBuffers[3];
+	uint32_t mFrames[3];
+	int mWriteIndex, mReadIndex;
+	std::atomic<int> mMiddle;
+	bool mAcquired;
+
+	std::atomic<uint64_t> mFramesReceived, mFramesDropped, mPacketsReceived;
+	std::vector<uint8_t> mPacket;
+};
+
+
+StateReceiver::StateReceiver(size_t stateSize, uint16_t port, const char * address)
+:	mImpl(new Impl(stateSize, port, address))
+{}
+
+StateReceiver::~StateReceiver(){
+	stop();
+	delete mImpl;
+}
+
+bool StateReceiver::opened() const { return mImpl->mSocket.opened(); }
+
+size_t StateReceiver::stateSize() const { return mImpl->mStateSize; }
+
+bool StateReceiver::start(){
+	if(mImpl->mRunning) return true;
+	// Wake up periodically to check whether to stop
+	mImpl->timeout(0.05);
+	mImpl->mRunning = true;
+	if(!mImpl->mThread.start(Impl::receiveThread, mImpl)){
+		mImpl->mRunning = false;
+		return false;
+	}
+	return true;
+}
+
+void StateReceiver::stop(){
+	if(mImpl->mRunning){
+		mImpl->mRunning = false;
+		mImpl->mThread.join();
+	}
+}
+
+int StateReceiver::poll(al_sec timeout){
+	int frames = 0;
+	mImpl->timeout(timeout);
+	int r = mImpl->receive();
+	if(r < 0) return 0;
+	frames += r;
+	mImpl->timeout(0);
+	while((r = mImpl->receive()) >= 0){
+		frames += r;
+	}
+	return frames;
+}
+
+bool StateReceiver::newFrame(){ return mImpl->newFrame(); }
+
+const void * StateReceiver::state() const {
+	return mImpl->mAcquired ? &mImpl->mBuffers[mImpl->mReadIndex][0] : NULL;
+}
+
+uint32_t StateReceiver::frame() const {
+	return mImpl->mAcquired ? mImpl->mFrames[mImpl->mReadIndex] : 0;
+}
+
+uint64_t StateReceiver::framesReceived() const { return mImpl->mFramesReceived; }
+
+uint64_t StateReceiver::framesDropped() const { return mImpl->mFramesDropped; }
+
+uint64_t StateReceiver::packetsReceived() const { return mImpl->mPacketsReceived; }
+
+} // al::
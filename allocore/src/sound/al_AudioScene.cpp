@@ -1,9 +1,13 @@
+#include <algorithm>
 #include "allocore/sound/al_AudioScene.hpp"
+#include "allocore/io/al_AudioProfiler.hpp"
 #include "allocore/math/al_Constants.hpp"
 
 namespace al{
 
-Spatializer::Spatializer(const SpeakerLayout& sl){
+Spatializer::Spatializer(const SpeakerLayout& sl)
+:	mEnabled(true)
+{
 	unsigned numSpeakers = sl.speakers().size();
 	for(unsigned i=0;i<numSpeakers;++i){
 		mSpeakers.push_back(sl.speakers()[i]);
@@ -51,7 +55,7 @@ SoundSource::SoundSource(
 		double farBias, int delaySize
 		)
 	:	DistAtten<double>(nearClip, farClip, law, farBias),
-	  mSound(delaySize), mUseAtten(true), mDopplerType(dopplerType), mUsePerSampleProcessing(false)
+	  mSoundSize(delaySize > 4 ? delaySize : 4), mUseAtten(true), mDopplerType(dopplerType), mUsePerSampleProcessing(false)
 {
 	// initialize the position history to be VERY FAR AWAY so that we don't deafen ourselves...
 	for(int i=0; i<mPosHistory.size(); ++i){
@@ -59,6 +63,55 @@ SoundSource::SoundSource(
 	}
 
 	presenceFilter.set(2700);
+
+	mMirrorSize = mSoundSize < MIRROR_SIZE ? mSoundSize : MIRROR_SIZE;
+	mSound.assign(mSoundSize + mMirrorSize, 0.f);
+	mSoundPos = mSoundSize-1;
+}
+
+void SoundSource::readBlock(float * dst, int n, double delayStart, double delayEnd) const {
+	if(n <= 0) return;
+	double slope = n > 1 ? (delayEnd - delayStart) / (n-1) : 0.;
+
+	// Range of read indices of the block
+	double first = delayStart + (n-1);	// index of first sample
+	double last = delayEnd;				// index of last sample
+	double indexMax = first > last ? first : last;
+	double indexMin = first > last ? last : first;
+	int index0Max = indexMax;
+	int index0Min = indexMin;
+
+	// The taps of a sample are 1 newer to 2 older than its integer index
+	if(indexMin < 0 || indexMax > maxIndex() || index0Max - index0Min + 4 > mMirrorSize){
+		for(int i=0; i<n; ++i){
+			double index = delayStart + slope*i + (n-1-i);
+			dst[i] = readSample(index < maxIndex() ? index : maxIndex());
+		}
+		return;
+	}
+
+	// Start of contiguous window at the oldest tap; since the window is
+	// no longer than the mirrored part, it never runs past the buffer.
+	int oldest = mSoundPos - index0Max - 2;
+	if(oldest < 0) oldest += mSoundSize;
+	const float * win = &mSound[oldest] + index0Max + 2; // win[-k] is k samples ago
+
+	if(slope == 0.){
+		// Constant fraction, so interpolate all samples at once
+		int index0 = first;
+		float frac = first - index0;
+		const float * x = win - index0;	// sample 0 is at x[0]
+		ipl::cubic(dst, x+1, x, x-1, x-2, n, frac);
+	}
+	else{
+		for(int i=0; i<n; ++i){
+			double index = delayStart + slope*i + (n-1-i);
+			int index0 = index;
+			float frac = index - index0;
+			const float * x = win - index0;
+			dst[i] = ipl::cubic(frac, x[1], x[0], x[-1], x[-2]);
+		}
+	}
 }
 
 /*static*/
@@ -68,6 +121,111 @@ int SoundSource::bufferSize(double samplerate, double speedOfSound, double dista
 
 
 
+SoundSourceArray::SoundSourceArray(int capacity, int delaySize)
+:	mSize(0), mMask(0), mProxy(0.1, 20, ATTEN_INVERSE, DOPPLER_SYMMETRICAL, 0, 4)
+{
+	if(capacity < 0) capacity = 0;
+	int n = 4;
+	while(n < delaySize) n <<= 1;
+	mMask = n-1;
+
+	mX.resize(capacity); mY.resize(capacity); mZ.resize(capacity);
+	mGain.resize(capacity);
+	mAtten.resize(capacity);
+	mUseAtten.resize(capacity);
+	mDoppler.resize(capacity);
+	mHead.resize(capacity);
+	mID.resize(capacity);
+	mSlot.assign(capacity, -1);
+	mFreeIDs.resize(capacity);
+	for(int i=0; i<capacity; ++i) mFreeIDs[i] = capacity-1-i; // lowest id on top
+	mDelay.resize(size_t(capacity) * n);
+}
+
+int SoundSourceArray::add(
+	double nearClip, double farClip, AttenuationLaw law, DopplerType dopplerType,
+	double farBias
+){
+	if(mFreeIDs.empty()) return -1;
+	int id = mFreeIDs.back();
+	mFreeIDs.pop_back(); // never reallocates
+
+	int i = mSize++;
+	mSlot[id] = i;
+	mID[i] = id;
+	mX[i] = mY[i] = mZ[i] = 0;
+	mGain[i] = 1;
+	mAtten[i] = DistAtten<double>(nearClip, farClip, law, farBias);
+	mUseAtten[i] = true;
+	mDoppler[i] = dopplerType;
+	mHead[i] = mMask;
+	float * d = &mDelay[size_t(id)*delaySize()];
+	std::fill(d, d+delaySize(), 0.f);
+	return id;
+}
+
+void SoundSourceArray::remove(int id){
+	if(!valid(id)) return;
+
+	// Move last source into the slot of the removed one
+	int i = mSlot[id];
+	int last = --mSize;
+	if(i != last){
+		mX[i] = mX[last]; mY[i] = mY[last]; mZ[i] = mZ[last];
+		mGain[i] = mGain[last];
+		mAtten[i] = mAtten[last];
+		mUseAtten[i] = mUseAtten[last];
+		mDoppler[i] = mDoppler[last];
+		mHead[i] = mHead[last];
+		mID[i] = mID[last];
+		mSlot[mID[i]] = i;
+	}
+	mSlot[id] = -1;
+	mFreeIDs.push_back(id); // within capacity, so never reallocates
+}
+
+void SoundSourceArray::clear(){
+	while(mSize) remove(mID[mSize-1]);
+}
+
+size_t SoundSourceArray::memoryUsage() const {
+	size_t perSource =
+		3*sizeof(double) + sizeof(float) + sizeof(DistAtten<double>)
+		+ 2*sizeof(char) + 4*sizeof(int);
+	return sizeof(*this) + perSource*capacity() + mDelay.size()*sizeof(float);
+}
+
+void SoundSourceArray::writeSamples(int id, const float * src, int n){
+	int i = mSlot[id];
+	float * d = &mDelay[size_t(id)*delaySize()];
+	int h = mHead[i];
+	for(int k=0; k<n; ++k){
+		h = (h+1) & mMask;
+		d[h] = src[k];
+	}
+	mHead[i] = h;
+}
+
+void SoundSourceArray::readBlock(int i, double delay, float gain, float * dst, int numFrames) const {
+	double first = delay + (numFrames-1);
+	int index0 = first;
+	int oldest = (mHead[i] - index0 - 2) & mMask;
+
+	// Interpolate all at once if the taps do not wrap around the delay line
+	if(oldest + numFrames + 3 <= delaySize()){
+		const float * x = line(i) + oldest + 2;
+		ipl::cubic(dst, x+1, x, x-1, x-2, numFrames, float(first - index0));
+		for(int k=0; k<numFrames; ++k) dst[k] *= gain;
+	}
+	else{
+		for(int k=0; k<numFrames; ++k){
+			dst[k] = gain * read(i, delay + (numFrames - k - 1));
+		}
+	}
+}
+
+
+
 AudioScene::AudioScene(int numFrames_)
 	:   mNumFrames(0), mSpeedOfSound(340), mPerSampleProcessing(false)
 {
@@ -92,9 +250,22 @@ void AudioScene::removeSource(SoundSource& src){
 	mSources.remove(&src);
 }
 
+void AudioScene::addSources(SoundSourceArray& srcs){
+	mSourceArrays.push_back(&srcs);
+}
+
+void AudioScene::removeSources(SoundSourceArray& srcs){
+	mSourceArrays.erase(
+		std::remove(mSourceArrays.begin(), mSourceArrays.end(), &srcs),
+		mSourceArrays.end()
+	);
+}
+
 void AudioScene::numFrames(int v){
 	if(mNumFrames != v){
 		mBuffer.resize(v);
+		mSourceBuffer.resize(v);
+		mFramePos.resize(v+1);
 
 		Listeners::iterator it = mListeners.begin();
 		while(it != mListeners.end()){
@@ -122,117 +293,216 @@ Listener * AudioScene::createListener(Spatializer* spatializer){
 
 
 void AudioScene::render(AudioIOData& io) {
+	AL_PROFILE_AUDIO("AudioScene::render");
 	const int numFrames = io.framesPerBuffer();
-	double sampleRate = io.framesPerSecond();
 	io.zeroOut();
 
-	// iterate through all listeners adding contribution from all sources
+	if(mListeners.empty()) return;
+
+	// update listener history data:
 	for(unsigned il=0; il<mListeners.size(); ++il){
 		Listener& l = *mListeners[il];
+		if(firstWithSpatializer(il)) l.mSpatializer->prepare();
+		l.updateHistory(numFrames);
+	}
 
-		Spatializer* spatializer = l.mSpatializer;
-		spatializer->prepare();
+	// iterate through all sound sources, rendering each for all listeners
+	for(Sources::iterator it = mSources.begin(); it != mSources.end(); ++it){
+		renderSource(io, *(*it));
+	}
 
-		// update listener history data:
-		l.updateHistory(numFrames);
+	// iterate through all sources in arrays, always per buffer
+	for(unsigned ia=0; ia<mSourceArrays.size(); ++ia){
+		renderSources(io, *mSourceArrays[ia]);
+	}
+
+	{
+		AL_PROFILE_AUDIO("Spatializer::finalize");
+		for(unsigned il=0; il<mListeners.size(); ++il){
+			if(firstWithSpatializer(il)) mListeners[il]->mSpatializer->finalize(io);
+		}
+	}
+}
+
+// Listeners sharing a spatializer must prepare and finalize it only once,
+// as all their sources are rendered in between
+bool AudioScene::firstWithSpatializer(unsigned listener) const {
+	for(unsigned i=0; i<listener; ++i){
+		if(mListeners[i]->mSpatializer == mListeners[listener]->mSpatializer) return false;
+	}
+	return true;
+}
+
+void AudioScene::renderSource(AudioIOData& io, SoundSource& src){
+	const int numFrames = io.framesPerBuffer();
+	const double sampleRate = io.framesPerSecond();
+
+	// scalar factor to convert distances into delayline indices
+	double distanceToSample = 0;
+	if(src.dopplerType() == DOPPLER_SYMMETRICAL)
+		distanceToSample = sampleRate / mSpeedOfSound;
+
+	// Without Doppler shift, the block read is the same for all listeners
+	bool shareBlock = src.dopplerType() == DOPPLER_NONE;
+
+	if(mPerSampleProcessing && src.usePerSampleProcessing()) //audioscene and source per sample processing
+	{
+		// Process the source once, recording its position at every frame.
+		// As the delay-line is then written up to the end of the block, sample
+		// i is read numFrames-1-i samples further back.
+		for(int i=0; i < numFrames; ++i){
+			src.updateHistory();
+			if(i == 0) mFramePos[0] = src.posHistory()[1];
+			mFramePos[i+1] = src.posHistory()[0];
+			src.onProcessSample(i);
+		}
 
-		// iterate through all sound sources
-		for(Sources::iterator it = mSources.begin(); it != mSources.end(); ++it){
-			SoundSource& src = *(*it);
-
-			// scalar factor to convert distances into delayline indices
-			double distanceToSample = 0;
-			if(src.dopplerType() == DOPPLER_SYMMETRICAL)
-				distanceToSample = sampleRate / mSpeedOfSound;
-
-			if(!src.usePerSampleProcessing()) //if our src is using per sample processing we will update this in the frame loop instead
-				src.updateHistory();
-
-			if(mPerSampleProcessing) //audioscene per sample processing
-			{
-				// iterate time samples
-				for(int i=0; i < numFrames; ++i){
-
-					Vec3d relpos;
-
-					if(src.usePerSampleProcessing() && il == 0) //if src is using per sample processing, we can only do this for the first listener (TODO: better design for this)
-					{
-						src.updateHistory();
-						src.onProcessSample(i);
-
-						relpos = src.posHistory()[0] - l.posHistory()[0];
-
-						if(src.dopplerType() == DOPPLER_PHYSICAL)
-						{
-							double currentDist = relpos.mag();
-							double prevDistance = (src.posHistory()[1] - l.posHistory()[0]).mag();
-							double sourceVel = (currentDist - prevDistance)*sampleRate; //positive when moving away, negative moving toward
-
-							if(sourceVel == -mSpeedOfSound) sourceVel -= 0.001; //prevent divide by 0 / inf freq
-
-							distanceToSample = fabs(sampleRate / (mSpeedOfSound + sourceVel));
-						}
-					}
-					else
-					{
-						// compute interpolated source position relative to listener
-						// TODO: this tends to warble when moving fast
-						double alpha = double(i)/numFrames;
-
-						// moving average:
-						// cheaper & slightly less warbly than cubic,
-						// less glitchy than linear
-						relpos = (
-									(src.posHistory()[3]-l.posHistory()[3])*(1.-alpha) +
-								(src.posHistory()[2]-l.posHistory()[2]) +
-								(src.posHistory()[1]-l.posHistory()[1]) +
-								(src.posHistory()[0]-l.posHistory()[0])*(alpha)
-								)/3.0;
-					}
-
-					//Compute distance in world-space units
-					double dist = relpos.mag();
-
-					// Compute how many samples ago to read from buffer
-					// Start with time delay due to speed of sound
-					double samplesAgo = dist * distanceToSample;
-
-					// Add on time delay (in samples) - only needed if the source is rendered per buffer
-					if(!src.usePerSampleProcessing())
-						samplesAgo += (numFrames-i);
-
-					// Is our delay line big enough?
-					if(samplesAgo <= src.maxIndex()){
-						double gain = src.attenuation(dist);
-						float s = src.readSample(samplesAgo) * gain;
-						//s = src.presenceFilter(s); //TODO: causing stopband ripple here, why?
-						spatializer->perform(io, src,relpos, numFrames, i, s);
-					}
-
-				} //end for each frame
-			} //end per sample processing
-
-			else //more efficient, per buffer processing for audioscene (does not work well with doppler)
-			{
-				Vec3d relpos = src.pose().pos() - l.pose().pos();
-				double distance = relpos.mag();
-				double gain = src.attenuation(distance);
-
-				for(int i = 0; i < numFrames; i++)
+		if(shareBlock) src.readBlock(&mSourceBuffer[0], numFrames, 0.);
+
+		for(unsigned il=0; il<mListeners.size(); ++il){
+			Listener& l = *mListeners[il];
+			Spatializer * spatializer = l.mSpatializer;
+			const Vec3d& lpos = l.posHistory()[0];
+
+			// iterate time samples
+			for(int i=0; i < numFrames; ++i){
+				Vec3d relpos = mFramePos[i+1] - lpos;
+
+				//Compute distance in world-space units
+				double dist = relpos.mag();
+
+				if(src.dopplerType() == DOPPLER_PHYSICAL)
 				{
-					double readIndex = distance * distanceToSample;
-					readIndex += (numFrames - i - 1);
-					mBuffer[i] = gain * src.readSample(readIndex);
+					double prevDistance = (mFramePos[i] - lpos).mag();
+					double sourceVel = (dist - prevDistance)*sampleRate; //positive when moving away, negative moving toward
+
+					if(sourceVel == -mSpeedOfSound) sourceVel -= 0.001; //prevent divide by 0 / inf freq
+
+					distanceToSample = fabs(sampleRate / (mSpeedOfSound + sourceVel));
 				}
 
-				spatializer->perform(io, src, relpos, numFrames, &mBuffer[0]);
+				// Compute how many samples ago to read from buffer
+				// Start with time delay due to speed of sound
+				double samplesAgo = dist * distanceToSample + (numFrames-1-i);
+
+				// Is our delay line big enough?
+				if(samplesAgo <= src.maxIndex()){
+					double gain = src.attenuation(dist);
+					float s = (shareBlock ? mSourceBuffer[i] : src.readSample(samplesAgo)) * gain;
+					//s = src.presenceFilter(s); //TODO: causing stopband ripple here, why?
+					spatializer->perform(io, src, relpos, numFrames, i, s);
+				}
+			} //end for each frame
+		}
+		return;
+	}
+
+	//if our src is using per sample processing it is not updated unless the scene is
+	if(!src.usePerSampleProcessing())
+		src.updateHistory();
+
+	if(mPerSampleProcessing) //audioscene per sample processing, source read per buffer
+	{
+		// Read delay is one more than per buffer, i.e. numFrames-i samples
+		if(shareBlock) src.readBlock(&mSourceBuffer[0], numFrames, 1.);
+
+		for(unsigned il=0; il<mListeners.size(); ++il){
+			Listener& l = *mListeners[il];
+			Spatializer * spatializer = l.mSpatializer;
+
+			// compute interpolated source position relative to listener
+			// TODO: this tends to warble when moving fast
+			// moving average:
+			// cheaper & slightly less warbly than cubic,
+			// less glitchy than linear
+			// As it is linear in alpha, relpos = relpos0 + drelpos*alpha.
+			Vec3d h3 = src.posHistory()[3]-l.posHistory()[3];
+			Vec3d h0 = src.posHistory()[0]-l.posHistory()[0];
+			Vec3d relpos0 = (h3 + (src.posHistory()[2]-l.posHistory()[2]) + (src.posHistory()[1]-l.posHistory()[1]))/3.0;
+			Vec3d drelpos = (h0 - h3)/3.0;
+
+			// The distance, and so the delay, is interpolated linearly
+			// between the first and last frame of the block
+			double alphaEnd = double(numFrames-1)/numFrames;
+			double distStart = relpos0.mag();
+			double distEnd = (relpos0 + drelpos*alphaEnd).mag();
+			double dDist = numFrames > 1 ? (distEnd - distStart)/(numFrames-1) : 0.;
+
+			const float * samples = &mSourceBuffer[0];
+			if(!shareBlock){
+				src.readBlock(&mBuffer[0], numFrames,
+					distStart * distanceToSample + 1, distEnd * distanceToSample + 1);
+				samples = &mBuffer[0];
+			}
+
+			for(int i=0; i < numFrames; ++i){
+				double alpha = double(i)/numFrames;
+				Vec3d relpos = relpos0 + drelpos*alpha;
+				double dist = distStart + dDist*i;
+
+				// Is our delay line big enough?
+				if(dist * distanceToSample + (numFrames-i) <= src.maxIndex()){
+					double gain = src.attenuation(dist);
+					float s = samples[i] * gain;
+					spatializer->perform(io, src, relpos, numFrames, i, s);
+				}
+			}
+		}
+	}
+
+	else //more efficient, per buffer processing for audioscene (does not work well with doppler)
+	{
+		if(shareBlock) src.readBlock(&mSourceBuffer[0], numFrames, 0.);
+
+		for(unsigned il=0; il<mListeners.size(); ++il){
+			Listener& l = *mListeners[il];
+			Vec3d relpos = src.pose().pos() - l.pose().pos();
+			double distance = relpos.mag();
+			double gain = src.attenuation(distance);
+
+			if(shareBlock){
+				for(int i = 0; i < numFrames; i++) mBuffer[i] = mSourceBuffer[i] * gain;
+			}
+			else{
+				src.readBlock(&mBuffer[0], numFrames, distance * distanceToSample);
+				for(int i = 0; i < numFrames; i++) mBuffer[i] *= gain;
 			}
 
-		} //end for each source
+			l.mSpatializer->perform(io, src, relpos, numFrames, &mBuffer[0]);
+		}
+	}
+}
 
-		spatializer->finalize(io);
+void AudioScene::renderSources(AudioIOData& io, SoundSourceArray& srcs){
+	const int numFrames = io.framesPerBuffer();
+	const double sampleRate = io.framesPerSecond();
+	const double maxDelay = srcs.maxIndex() - numFrames;
+
+	for(int i=0; i<srcs.size(); ++i){
+		bool shareBlock = srcs.mDoppler[i] == DOPPLER_NONE;
+		if(shareBlock) srcs.readBlock(i, 0., 1.f, &mSourceBuffer[0], numFrames);
+
+		for(unsigned il=0; il<mListeners.size(); ++il){
+			Listener& l = *mListeners[il];
+			const Vec3d& lpos = l.pose().pos();
+			Vec3d relpos(srcs.mX[i] - lpos.x, srcs.mY[i] - lpos.y, srcs.mZ[i] - lpos.z);
+			double distance = relpos.mag();
+			double gain = srcs.mGain[i];
+			if(srcs.mUseAtten[i]) gain *= srcs.mAtten[i].attenuation(distance);
+			if(gain == 0) continue;
+
+			if(shareBlock){
+				for(int k=0; k<numFrames; ++k) mBuffer[k] = mSourceBuffer[k] * gain;
+			}
+			else{
+				double delay = distance * sampleRate / mSpeedOfSound;
+				if(delay > maxDelay) delay = maxDelay;
+				srcs.readBlock(i, delay, gain, &mBuffer[0], numFrames);
+			}
 
-	} // end for each listener
+			l.mSpatializer->perform(io, srcs.proxy(), relpos, numFrames, &mBuffer[0]);
+		}
+	}
 }
 
 } // al::
@@ -0,0 +1,244 @@
+#include <math.h>
+#include <string.h>
+#include "allocore/io/al_AudioIOData.hpp"
+#include "allocore/sound/al_FDNReverb.hpp"
+
+namespace al{
+
+namespace{
+
+// Range of delay line lengths, in seconds
+const double minDelay = 0.029;
+const double maxDelay = 0.097;
+
+// Largest output tap offset, as a fraction of the shortest line
+const double maxTapFraction = 0.25;
+
+// Offset keeping the filter states out of the denormal range
+const float denormOffset = 1e-18f;
+
+bool isPrime(int n){
+	if(n < 2) return false;
+	for(int d=2; d*d<=n; ++d){
+		if(n % d == 0) return false;
+	}
+	return true;
+}
+
+// Sign of element (i,j) of a Sylvester Hadamard matrix
+inline float hadamardSign(unsigned i, unsigned j){
+	unsigned v = i & j;
+	v ^= v >> 16; v ^= v >> 8; v ^= v >> 4; v ^= v >> 2; v ^= v >> 1;
+	return v & 1 ? -1.f : 1.f;
+}
+
+// Pseudo-random number from an integer pair
+inline unsigned hashIndex(unsigned a, unsigned b){
+	unsigned h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u) * 0x85EBCA77u;
+	h ^= h >> 15; h *= 0x2C1B3C6Du; h ^= h >> 12;
+	return h;
+}
+
+inline float hashSign(unsigned a, unsigned b){
+	return hashIndex(a, b) & 0x100 ? -1.f : 1.f;
+}
+
+// In-place fast Walsh-Hadamard transform of rows of BLOCK_SIZE samples
+void hadamard(float * rows, int numRows){
+	const int B = FDNReverb::BLOCK_SIZE;
+	for(int h=1; h<numRows; h<<=1){
+		for(int i=0; i<numRows; i+=h<<1){
+			for(int j=i; j<i+h; ++j){
+				float * a = rows + j*B;
+				float * b = rows + (j+h)*B;
+				for(int k=0; k<B; ++k){
+					float s = a[k], d = b[k];
+					a[k] = s + d;
+					b[k] = s - d;
+				}
+			}
+		}
+	}
+}
+
+} // ::
+
+
+FDNReverb::FDNReverb(int numLines, int numOuts, double sampleRate)
+:	mNumLines(4), mNumOutputs(0), mSampleRate(sampleRate), mDecay(2), mDamping(0.2f)
+{
+	while(mNumLines < numLines && mNumLines < MAX_LINES) mNumLines <<= 1;
+	const int N = mNumLines;
+
+	mLen.resize(N);
+	mOff.resize(N);
+	mPos.assign(N, 0);
+	mFeedback.resize(N);
+	mFilter.assign(N, 0.f);
+	mInGain.resize(N);
+	mTaps.assign(N * BLOCK_SIZE, 0.f);
+
+	// Prime lengths spread geometrically over the range, so that the echoes
+	// of the lines rarely coincide
+	int total = 0;
+	for(int i=0; i<N; ++i){
+		double t = minDelay * pow(maxDelay/minDelay, double(i)/(N-1));
+		int len = int(t * mSampleRate);
+		if(len < BLOCK_SIZE) len = BLOCK_SIZE;
+		if(i && len <= mLen[i-1]) len = mLen[i-1] + 1;
+		while(!isPrime(len)) ++len;
+		mLen[i] = len;
+		mOff[i] = total;
+		total += len;
+	}
+	mBuf.assign(total, 0.f);
+
+	for(int i=0; i<N; ++i) mInGain[i] = hashSign(i, 0x1234) / sqrt(float(N));
+
+	decay(mDecay);
+	numOutputs(numOuts);
+}
+
+FDNReverb& FDNReverb::decay(double seconds){
+	if(seconds < 1e-3) seconds = 1e-3;
+	mDecay = seconds;
+	// -60 dB after 'seconds' means a gain of 10^(-3 len / (decay fs)) per pass
+	for(int i=0; i<mNumLines; ++i){
+		mFeedback[i] = pow(10., -3. * mLen[i] / (mDecay * mSampleRate));
+	}
+	return *this;
+}
+
+FDNReverb& FDNReverb::damping(float v){
+	if(v < 0.f) v = 0.f;
+	else if(v > 0.999f) v = 0.999f;
+	mDamping = v;
+	return *this;
+}
+
+FDNReverb& FDNReverb::numOutputs(int n){
+	if(n < 0) n = 0;
+	mNumOutputs = n;
+	mOutGain.resize(n * mNumLines);
+	mOutTap.resize(n * mNumLines);
+	mOuts.resize(n > 0 ? n : 1);
+	// Gains are rows of a Hadamard matrix with pseudo-random sign flips,
+	// which keep them orthogonal but unlike the rows of the feedback matrix.
+	// As only N outputs can be orthogonal, each output also taps the lines
+	// a little earlier than their ends, by different amounts.
+	float scale = 1.f / sqrt(float(mNumLines));
+	int maxTap = int(mLen[0] * maxTapFraction);
+	for(int c=0; c<n; ++c){
+		for(int i=0; i<mNumLines; ++i){
+			float s = hadamardSign(c % mNumLines, i) * hashSign(c / mNumLines, i);
+			mOutGain[c*mNumLines + i] = s * scale;
+			mOutTap[c*mNumLines + i] = hashIndex(c, i) % (maxTap + 1);
+		}
+	}
+	return *this;
+}
+
+void FDNReverb::clear(){
+	memset(&mBuf[0], 0, mBuf.size()*sizeof(float));
+	memset(&mFilter[0], 0, mFilter.size()*sizeof(float));
+	memset(&mTaps[0], 0, mTaps.size()*sizeof(float));
+}
+
+void FDNReverb::process(const float * in, float * const * outs, int numFrames, float gain){
+	for(int f=0; f<numFrames; f+=BLOCK_SIZE){
+		int n = numFrames - f < BLOCK_SIZE ? numFrames - f : int(BLOCK_SIZE);
+		processBlock(in, outs, mNumOutputs, f, n, gain);
+	}
+}
+
+void FDNReverb::process(AudioIOData& io, const float * in, float gain){
+	int numOuts = io.channelsOut() < mNumOutputs ? io.channelsOut() : mNumOutputs;
+	for(int c=0; c<numOuts; ++c) mOuts[c] = io.outBuffer(c);
+	const int numFrames = io.framesPerBuffer();
+	for(int f=0; f<numFrames; f+=BLOCK_SIZE){
+		int n = numFrames - f < BLOCK_SIZE ? numFrames - f : int(BLOCK_SIZE);
+		processBlock(in, &mOuts[0], numOuts, f, n, gain);
+	}
+}
+
+void FDNReverb::processBlock(const float * in, float * const * outs, int numOuts, int frame, int n, float gain){
+	const int N = mNumLines;
+	const int B = BLOCK_SIZE;
+	float * taps = &mTaps[0];
+	in += frame;
+
+	// Read the oldest n samples of each line; every line is longer than a
+	// block, so none of them is overwritten before being read
+	for(int i=0; i<N; ++i){
+		const float * line = &mBuf[mOff[i]];
+		int pos = mPos[i], len = mLen[i];
+		int n1 = len - pos < n ? len - pos : n;
+		memcpy(taps + i*B, line + pos, n1*sizeof(float));
+		memcpy(taps + i*B + n1, line, (n-n1)*sizeof(float));
+	}
+
+	// Outputs are combinations of the lines, tapped near their ends; the
+	// block is written back to the ends only after this. Sums go into a
+	// local block, which the compiler knows does not alias the lines.
+	float sum[BLOCK_SIZE];
+	for(int c=0; c<numOuts; ++c){
+		const float * g = &mOutGain[c*N];
+		const int * d = &mOutTap[c*N];
+		for(int k=0; k<n; ++k) sum[k] = 0.f;
+		for(int i=0; i<N; ++i){
+			const float * line = &mBuf[mOff[i]];
+			int len = mLen[i];
+			int pos = mPos[i] + d[i];
+			if(pos >= len) pos -= len;
+			int n1 = len - pos < n ? len - pos : n;
+			const float gi = g[i];
+			const float * tap = line + pos;
+			for(int k=0; k<n1; ++k) sum[k] += tap[k] * gi;
+			for(int k=n1; k<n; ++k) sum[k] += line[k-n1] * gi;
+		}
+		float * out = outs[c] + frame;
+		for(int k=0; k<n; ++k) out[k] += sum[k] * gain;
+	}
+
+	// Damp and attenuate line outputs, then mix them by the Hadamard matrix.
+	// The filters of four lines run together, so their recursions overlap.
+	const float b1 = mDamping, a0 = 1.f - b1;
+	for(int i=0; i<N; i+=4){
+		float * t0 = taps + i*B;
+		float * t1 = t0 + B;
+		float * t2 = t1 + B;
+		float * t3 = t2 + B;
+		float y0 = mFilter[i], y1 = mFilter[i+1], y2 = mFilter[i+2], y3 = mFilter[i+3];
+		const float g0 = mFeedback[i], g1 = mFeedback[i+1], g2 = mFeedback[i+2], g3 = mFeedback[i+3];
+		for(int k=0; k<n; ++k){
+			y0 = t0[k]*a0 + denormOffset + y0*b1;
+			y1 = t1[k]*a0 + denormOffset + y1*b1;
+			y2 = t2[k]*a0 + denormOffset + y2*b1;
+			y3 = t3[k]*a0 + denormOffset + y3*b1;
+			t0[k] = y0*g0;
+			t1[k] = y1*g1;
+			t2[k] = y2*g2;
+			t3[k] = y3*g3;
+		}
+		mFilter[i] = y0; mFilter[i+1] = y1; mFilter[i+2] = y2; mFilter[i+3] = y3;
+	}
+	hadamard(taps, N);
+
+	// Feed back, with the input, into the lines
+	const float norm = 1.f / sqrt(float(N));
+	for(int i=0; i<N; ++i){
+		float * tap = taps + i*B;
+		const float ig = mInGain[i];
+		for(int k=0; k<n; ++k) tap[k] = tap[k]*norm + in[k]*ig;
+
+		float * line = &mBuf[mOff[i]];
+		int pos = mPos[i], len = mLen[i];
+		int n1 = len - pos < n ? len - pos : n;
+		memcpy(line + pos, tap, n1*sizeof(float));
+		memcpy(line, tap + n1, (n-n1)*sizeof(float));
+		pos += n;
+		mPos[i] = pos >= len ? pos - len : pos;
+	}
+}
+
+} // al::
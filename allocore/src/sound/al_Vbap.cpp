@@ -1,58 +1,180 @@
+#include <stdio.h>
+#include <unordered_map>
 #include "allocore/sound/al_Vbap.hpp"
 
 namespace al{
 
-void SpeakerTriple::loadVectors(const std::vector<Speaker>& spkrs){
-	s1Vec = spkrs[s1].vec();
-	s2Vec = spkrs[s2].vec();
-	if(s3!=-1){
-		s3Vec = spkrs[s3].vec();
-	}
-	vec[0]=s1Vec;
-	vec[1]=s2Vec;
-	vec[2]=s3Vec;
+namespace{
 
-	mat.set(s1Vec[0],s1Vec[1],s1Vec[2],
-			s2Vec[0],s2Vec[1],s2Vec[2],
-			s3Vec[0],s3Vec[1],s3Vec[2]
-			);
-}
+// Face of a convex hull, with its vertices counter-clockwise seen from outside
+struct HullFace{
+	int v[3];
+	Vec3d n;					// outward normal
+	double d;					// distance of plane from origin
+	bool alive;
+	std::vector<int> outside;	// points in front of the face
 
+	double dist(const Vec3d& p) const { return n.dot(p) - d; }
+};
 
+typedef unsigned long long EdgeKey;
 
-Vbap::Vbap(const SpeakerLayout &sl)
-:	Spatializer(sl), mCachedTripletIndex(0), mIs3D(true)
-{}
+inline EdgeKey edgeKey(int a, int b){ return (EdgeKey(a)<<32) | unsigned(b); }
 
-void Vbap::addTriple(const SpeakerTriple& st) {
-	mTriplets.push_back(st);
-	++mNumTriplets;
+const double HULL_EPS = 1e-10;
+
+int addFace(std::vector<HullFace>& faces, const std::vector<Vec3d>& pts, int a, int b, int c){
+	faces.push_back(HullFace());
+	HullFace& f = faces.back();
+	f.v[0]=a; f.v[1]=b; f.v[2]=c;
+	f.n = cross(pts[b]-pts[a], pts[c]-pts[a]).normalize();
+	f.d = f.n.dot(pts[a]);
+	f.alive = true;
+	return faces.size()-1;
 }
 
-Vec3d Vbap::computeGains(const Vec3d& vecA, const SpeakerTriple& speak) {
-	const Mat3d& mat = speak.mat;
-	unsigned dimensions = mIs3D ? 3 : 2;
-	Vec3d vec(0., 0., 0.);
+// Find the convex hull of points with Quickhull. Every point outside the
+// hull is assigned to one face it is in front of and the hull is grown by the
+// farthest point of a face, which takes O(n log n) time on average. No faces
+// are returned if the points are coplanar.
+void convexHull(const std::vector<Vec3d>& pts, std::vector<HullFace>& faces){
+	faces.clear();
+	int n = pts.size();
+	if(n < 4) return;
+
+	// Initial tetrahedron from extreme points
+	int i0 = 0;
+	for(int i=1; i<n; ++i) if(pts[i].x < pts[i0].x) i0 = i;
+	int i1 = i0;
+	double best = 0;
+	for(int i=0; i<n; ++i){
+		double v = (pts[i]-pts[i0]).mag();
+		if(v > best){ best = v; i1 = i; }
+	}
+	if(best < HULL_EPS) return;
+	int i2 = i0;
+	best = 0;
+	for(int i=0; i<n; ++i){
+		double v = cross(pts[i]-pts[i0], pts[i1]-pts[i0]).mag();
+		if(v > best){ best = v; i2 = i; }
+	}
+	if(best < HULL_EPS) return;
+	int i3 = i0;
+	best = 0;
+	Vec3d n012 = cross(pts[i1]-pts[i0], pts[i2]-pts[i0]).normalize();
+	for(int i=0; i<n; ++i){
+		double v = fabs(n012.dot(pts[i]-pts[i0]));
+		if(v > best){ best = v; i3 = i; }
+	}
+	if(best < HULL_EPS) return;
+	if(n012.dot(pts[i3]-pts[i0]) > 0) std::swap(i1, i2);
+
+	std::unordered_map<EdgeKey, int> edges;	// directed edge to its face
+	int tet[4][3] = {{i0,i1,i2}, {i0,i3,i1}, {i1,i3,i2}, {i2,i3,i0}};
+	for(int k=0; k<4; ++k){
+		int f = addFace(faces, pts, tet[k][0], tet[k][1], tet[k][2]);
+		for(int e=0; e<3; ++e) edges[edgeKey(tet[k][e], tet[k][(e+1)%3])] = f;
+	}
 
-	// For each node, insert speaker coordinates in matrix
-	for (unsigned i = 0; i < dimensions; i++){
-		for (unsigned j = 0; j < dimensions; j++){
-			vec[i] += vecA[j] * mat(j,i);
+	for(int i=0; i<n; ++i){
+		if(i==i0 || i==i1 || i==i2 || i==i3) continue;
+		for(int k=0; k<4; ++k){
+			if(faces[k].dist(pts[i]) > HULL_EPS){ faces[k].outside.push_back(i); break; }
 		}
 	}
-	//printf("Gains: (%f,%f,%f)",vec[0],vec[1],vec[2]);
-	//printf("Triplet: (%d,%d,%d)",speak.s1,speak.s2,speak.s3);
-	return vec;
+
+	// Faces are appended as the hull grows, so this visits all of them
+	std::vector<unsigned> visited;	// last face whose flood fill reached a face, plus 1
+	std::vector<int> visible, stack, horizon, newFaces;
+	for(unsigned f=0; f<faces.size(); ++f){
+		if(!faces[f].alive || faces[f].outside.empty()) continue;
+
+		int apex = faces[f].outside[0];
+		best = 0;
+		for(unsigned k=0; k<faces[f].outside.size(); ++k){
+			int i = faces[f].outside[k];
+			double v = faces[f].dist(pts[i]);
+			if(v > best){ best = v; apex = i; }
+		}
+
+		// Flood fill the faces visible from the apex; their boundary is the horizon
+		visited.resize(faces.size(), 0);
+		visible.clear();
+		horizon.clear();
+		stack.assign(1, f);
+		visited[f] = f+1;
+		while(!stack.empty()){
+			int g = stack.back();
+			stack.pop_back();
+			visible.push_back(g);
+			for(int e=0; e<3; ++e){
+				int a = faces[g].v[e], b = faces[g].v[(e+1)%3];
+				int h = edges[edgeKey(b,a)];
+				if(visited[h] == f+1) continue;
+				if(faces[h].dist(pts[apex]) > HULL_EPS){
+					visited[h] = f+1;
+					stack.push_back(h);
+				}
+				else{
+					horizon.push_back(a);
+					horizon.push_back(b);
+				}
+			}
+		}
+
+		for(unsigned k=0; k<visible.size(); ++k){
+			const HullFace& g = faces[visible[k]];
+			for(int e=0; e<3; ++e) edges.erase(edgeKey(g.v[e], g.v[(e+1)%3]));
+		}
+
+		newFaces.clear();
+		for(unsigned k=0; k<horizon.size(); k+=2){
+			int a = horizon[k], b = horizon[k+1];
+			int g = addFace(faces, pts, a, b, apex);
+			edges[edgeKey(a,b)] = g;
+			edges[edgeKey(b,apex)] = g;
+			edges[edgeKey(apex,a)] = g;
+			newFaces.push_back(g);
+		}
+
+		// Points outside removed faces are either inside or outside a new face
+		for(unsigned k=0; k<visible.size(); ++k){
+			std::vector<int> outside;
+			outside.swap(faces[visible[k]].outside);
+			faces[visible[k]].alive = false;
+			for(unsigned j=0; j<outside.size(); ++j){
+				int i = outside[j];
+				if(i == apex) continue;
+				for(unsigned m=0; m<newFaces.size(); ++m){
+					HullFace& g = faces[newFaces[m]];
+					if(g.dist(pts[i]) > HULL_EPS){ g.outside.push_back(i); break; }
+				}
+			}
+		}
+	}
+
+	unsigned alive = 0;
+	for(unsigned f=0; f<faces.size(); ++f){
+		if(faces[f].alive) faces[alive++] = faces[f];
+	}
+	faces.resize(alive);
 }
 
+bool tooNarrow(const SpeakerTriple& trip){
+	Vec3d xprod = cross(trip.s1Vec,trip.s2Vec);
+	float volume = fabs(xprod.dot(trip.s3Vec));
+	float length = fabs(angle(trip.s1Vec , trip.s2Vec) ) + fabs(angle(trip.s1Vec , trip.s3Vec) ) + fabs(angle(trip.s2Vec , trip.s3Vec) );
+	float ratio = length > MIN_LENGTH ? volume / length : 0.0;
+	return ratio < MIN_VOLUME_TO_LENGTH_RATIO;
+}
 
-// 2D VBAP, find pairs of speakers.
-void Vbap::findSpeakerPairs(const std::vector<Speaker>& spkrs){
+void findPairs(const std::vector<Speaker>& spkrs, std::vector<SpeakerTriple>& sets){
 
 	unsigned numSpeakers = spkrs.size();
+	if(numSpeakers < 2) return;
 	unsigned j, index;
-	unsigned speakerMapping[numSpeakers]; // To map unordered speakers into an ordered set.
-	float speakerAngles[numSpeakers];
+	std::vector<unsigned> speakerMapping(numSpeakers); // To map unordered speakers into an ordered set.
+	std::vector<float> speakerAngles(numSpeakers);
 	float indexAngle;
 
 	// Build a map to the speakers, that points to speaker indexes.
@@ -81,23 +203,102 @@ void Vbap::findSpeakerPairs(const std::vector<Speaker>& spkrs){
 		}
 	}
 
-	// Add speaker-pairs
-	for (unsigned i = 1; i < numSpeakers; i++){
+	// Add speaker-pairs, including the one from the last to the first speaker
+	for (unsigned i = 0; i < numSpeakers; i++){
 		SpeakerTriple triple;
-		triple.s1 = speakerMapping[i-1];
-		triple.s2 = speakerMapping[i];
+		triple.s1 = speakerMapping[i];
+		triple.s2 = speakerMapping[(i+1) % numSpeakers];
 		triple.s3 = -1;
 		triple.loadVectors(spkrs);
-		addTriple(triple);
+		sets.push_back(triple);
+	}
+}
+
+// The triplets are the faces of the convex hull of the speaker directions,
+// which do not overlap and contain no other speakers. Faces that are too
+// narrow or that do not face away from the listener, as happens for the
+// open bottom of a dome, are left out.
+void findTriplets(const std::vector<Speaker>& spkrs, std::vector<SpeakerTriple>& sets){
+	std::vector<Vec3d> dirs(spkrs.size());
+	for(unsigned i=0; i<spkrs.size(); ++i) dirs[i] = spkrs[i].vec().normalize();
+
+	std::vector<HullFace> faces;
+	convexHull(dirs, faces);
+
+	for(unsigned i=0; i<faces.size(); ++i){
+		if(faces[i].d <= HULL_EPS) continue;
+		SpeakerTriple triplet;
+		triplet.s1 = faces[i].v[0];
+		triplet.s2 = faces[i].v[1];
+		triplet.s3 = faces[i].v[2];
+		triplet.loadVectors(spkrs);
+		if(!tooNarrow(triplet)) sets.push_back(triplet);
+	}
+}
+
+} // ::
+
+
+void SpeakerTriple::loadVectors(const std::vector<Speaker>& spkrs){
+	s1Vec = spkrs[s1].vec();
+	s2Vec = spkrs[s2].vec();
+	if(s3!=-1){
+		s3Vec = spkrs[s3].vec();
+	}
+	vec[0]=s1Vec;
+	vec[1]=s2Vec;
+	vec[2]=s3Vec;
+
+	// A pair is completed with the up vector, whose gain is ignored
+	Vec3d v1 = Vec3d(s1Vec).normalize();
+	Vec3d v2 = Vec3d(s2Vec).normalize();
+	Vec3d v3 = s3!=-1 ? Vec3d(s3Vec).normalize() : Vec3d(0,1,0);
+	mat.set(v1[0],v1[1],v1[2],
+			v2[0],v2[1],v2[2],
+			v3[0],v3[1],v3[2]
+			);
+
+	// Gains are the coordinates of a direction in the basis of the speakers
+	invert(mat);
+}
+
+
+
+Vbap::Vbap(const SpeakerLayout &sl)
+:	Spatializer(sl), mNumTriplets(0), mListener(NULL), mCachedTripletIndex(0), mIs3D(true),
+	mThreadStarted(false), mCompiling(NULL), mPending(NULL), mRetired(NULL), mBusy(false)
+{}
+
+Vbap::~Vbap(){
+	if(mThreadStarted) mThread.join();
+	delete mPending.exchange(NULL);
+	delete mRetired.exchange(NULL);
+}
+
+void Vbap::addTriple(const SpeakerTriple& st) {
+	mTriplets.push_back(st);
+	++mNumTriplets;
+}
+
+Vec3d Vbap::computeGains(const Vec3d& vecA, const SpeakerTriple& speak) {
+	const Mat3d& mat = speak.mat;
+	Vec3d vec(0., 0., 0.);
+
+	// Source direction times inverse of speaker matrix
+	for (unsigned i = 0; i < 3; i++){
+		for (unsigned j = 0; j < 3; j++){
+			vec[i] += vecA[j] * mat(j,i);
+		}
 	}
+	return vec;
+}
+
 
-	// Add the last speaker-pair
-	SpeakerTriple triple;
-	triple.s1 = speakerMapping[numSpeakers-1];
-	triple.s2 = speakerMapping[0];
-	triple.s3 = -1;
-	triple.loadVectors(spkrs);
-	addTriple(triple);
+// 2D VBAP, find pairs of speakers.
+void Vbap::findSpeakerPairs(const std::vector<Speaker>& spkrs){
+	std::vector<SpeakerTriple> sets;
+	findPairs(spkrs, sets);
+	for(unsigned i=0; i<sets.size(); ++i) addTriple(sets[i]);
 }
 
 bool Vbap::isCrossing(Vec3d c, Vec3d v, const SpeakerTriple& trip){
@@ -109,130 +310,148 @@ bool Vbap::isCrossing(Vec3d c, Vec3d v, const SpeakerTriple& trip){
 }
 
 void Vbap::findSpeakerTriplets(const std::vector<Speaker>& spkrs){
-	std::list<SpeakerTriple> triplets;
-
-	unsigned numSpeakers = spkrs.size();
-	int numSpeakersSigned = (int)numSpeakers;
-
-	// form all possible triples
-	for (unsigned i = 0; i < numSpeakers; i++){
-		for (unsigned j = i+1; j < numSpeakers; j++){
-			for (unsigned k = j+1; k < numSpeakers; k++){
-				SpeakerTriple triplet;
-				triplet.s1=i;
-				triplet.s2=j;
-				triplet.s3=k;
-				triplet.loadVectors(spkrs);
-				triplets.push_back(triplet);
-			}
-		}
-	}
-	printf("Speaker-count=%d, Initial triplet-count=%d\n",numSpeakers,(unsigned)triplets.size());
+	std::vector<SpeakerTriple> sets;
+	findTriplets(spkrs, sets);
+	for(unsigned i=0; i<sets.size(); ++i) addTriple(sets[i]);
+}
 
+void Vbap::findSpeakerSets(const std::vector<Speaker>& spkrs, std::vector<SpeakerTriple>& sets) const {
+	sets.clear();
+	if(loadSets(spkrs, sets)) return;
+	if(mIs3D) findTriplets(spkrs, sets);
+	else findPairs(spkrs, sets);
+	if(!sets.empty()) saveSets(spkrs, sets);
+}
 
-	// remove too narrow triples
-	for(std::list<SpeakerTriple>::iterator it = triplets.begin(); it != triplets.end();++it){
-		SpeakerTriple trip = (*it);
+void Vbap::compile(Listener& listener){
+	this->mListener = &listener;
 
-		Vec3d xprod = cross(trip.s1Vec,trip.s2Vec);
-		float volume = fabs(xprod.dot(trip.s3Vec));
-		float length = fabs(angle(trip.s1Vec , trip.s2Vec) ) + fabs(angle(trip.s1Vec , trip.s3Vec) ) + fabs(angle(trip.s2Vec , trip.s3Vec) );
-		float ratio;
+	std::vector<SpeakerTriple> sets;
+	findSpeakerSets(mSpeakers, sets);
+	mTriplets.clear();
+	mNumTriplets = 0;
+	mCachedTripletIndex = 0;
+	for(unsigned i=0; i<sets.size(); ++i) addTriple(sets[i]);
 
-		if (length > MIN_LENGTH){
-			ratio =  volume / length;
-		}else{
-			ratio = 0.0;
-		}
+	if (mNumTriplets == 0 ){
+		printf("No SpeakerSets found. Check mode setting or speaker layout.\n");
+		throw -1;
+	}
+}
 
-		if (ratio < MIN_VOLUME_TO_LENGTH_RATIO) {
-			//printf("v=%f, l=%f, r=%f x=(%f,%f,%f)\n",volume,length,ratio,xprod[0],xprod[1],xprod[2]);
-			triplets.erase(it);
-			--it;
-		}
+void * Vbap::compileFunc(void * user){
+	Vbap& vbap = *static_cast<Vbap *>(user);
+	Sets * sets = vbap.mCompiling;
+	vbap.mCompiling = NULL;
+	vbap.findSpeakerSets(sets->speakers, sets->triplets);
+	if(sets->triplets.empty()){
+		printf("No SpeakerSets found. Check mode setting or speaker layout.\n");
+		delete sets;
 	}
+	else{
+		vbap.mPending.store(sets);
+	}
+	vbap.mBusy.store(false);
+	return NULL;
+}
 
+void Vbap::recompile(const SpeakerLayout& sl){
+	if(mThreadStarted) mThread.join();
+	delete mPending.exchange(NULL);
+	delete mRetired.exchange(NULL);
 
-	for(std::list<SpeakerTriple>::iterator it = triplets.begin(); it != triplets.end();++it){
-		SpeakerTriple trip = (*it);
-		bool remove = false;
-		for(std::list<SpeakerTriple>::iterator it2 = triplets.begin(); it2 != triplets.end();++it2){
-			SpeakerTriple trip2 = (*it2);
-			for (unsigned j = 0; j < 3; ++j) {
-				Vec3d v = trip2.vec[j];
-				Vec3d c = cross(cross(trip.s1Vec, trip.s2Vec),cross(trip.s3Vec,v));
-				if (isCrossing(c,v,trip) || isCrossing(-c,v, trip)) {
-					remove = true;
-					printf("Removing v=(%f,%f,%f) c=(%f,%f,%f)\n",v[0],v[1],v[2],c[0],c[1],c[2]);
-					break;
-				}
-			}
-		}
+	mCompiling = new Sets;
+	mCompiling->speakers = sl.speakers();
+	mBusy.store(true);
+	mThreadStarted = mThread.start(compileFunc, this);
+	if(!mThreadStarted) compileFunc(this);
+}
 
-		if (remove) {
-			triplets.erase(it);
-			--it;
-		}
+void Vbap::prepare(){
+	Sets * sets = mPending.exchange(NULL);
+	if(sets){
+		// Swapping vectors only exchanges pointers
+		mSpeakers.swap(sets->speakers);
+		mTriplets.swap(sets->triplets);
+		mNumTriplets = mTriplets.size();
+		mCachedTripletIndex = 0;
+		mRetired.store(sets);
 	}
+}
 
-	// remove triangles that contain other Speakers
-	for(std::list<SpeakerTriple>::iterator it = triplets.begin(); it != triplets.end();++it){
-		SpeakerTriple trip = (*it);
-		Mat3d invMat = Mat3d(trip.mat).transpose();
-
-		for (int jj = 0; jj < numSpeakersSigned; ++jj) {
-			// check to see if the current speaker is one of the nodes of the triple
-			if ((jj == trip.s1) || (jj == trip.s2) || (jj == trip.s3) )
-				continue;
-
-			Vec3d sVec = spkrs[jj].vec();
-			Vec3d v = sVec * invMat;
-
-			// inside if positive or negative near zero, -1e-4 is a magic number
-			bool x_inside = v[0] >= -1e-4;
-			bool y_inside = v[1] >= -1e-4;
-			bool z_inside = v[2] >= -1e-4;
-
-			if (x_inside && y_inside && (mIs3D || z_inside)){
-				//printf("Removing v=(%f,%f,%f)\n",v[0],v[1],v[2]);
-				triplets.erase(it);
-				--it;
-				break;
-			}
+unsigned long long Vbap::layoutHash(const std::vector<Speaker>& spkrs, bool is3D){
+	// 64-bit FNV-1a of the mode and speaker angles
+	unsigned long long h = 14695981039346656037ULL;
+	struct{
+		void operator()(unsigned long long& h, const void * data, size_t size){
+			const unsigned char * p = static_cast<const unsigned char *>(data);
+			for(size_t i=0; i<size; ++i){ h ^= p[i]; h *= 1099511628211ULL; }
 		}
+	} add;
+	unsigned head[2] = { is3D, unsigned(spkrs.size()) };
+	add(h, head, sizeof head);
+	for(unsigned i=0; i<spkrs.size(); ++i){
+		float angles[2] = { spkrs[i].azimuth, spkrs[i].elevation };
+		add(h, angles, sizeof angles);
 	}
+	return h;
+}
 
-	for(std::list<SpeakerTriple>::iterator it = triplets.begin(); it != triplets.end(); ++it) {
-		addTriple(*it);
-	}
+std::string Vbap::cachePath(const std::vector<Speaker>& spkrs) const {
+	char name[32];
+	snprintf(name, sizeof name, "vbap_%016llx.txt", layoutHash(spkrs, mIs3D));
+	std::string dir = mCacheDir;
+	if(dir[dir.size()-1] != '/') dir += '/';
+	return dir + name;
 }
 
-void Vbap::compile(Listener& listener){
-	this->mListener = &listener;
+bool Vbap::loadSets(const std::vector<Speaker>& spkrs, std::vector<SpeakerTriple>& sets) const {
+	if(mCacheDir.empty()) return false;
+	FILE * fp = fopen(cachePath(spkrs).c_str(), "r");
+	if(!fp) return false;
 
-	//Check if 3D...
-	if(mIs3D){
-		printf("Finding triplets\n");
-		findSpeakerTriplets(mSpeakers);
-	}
-	else{
-		printf("Finding pairs\n");
-		findSpeakerPairs(mSpeakers);
+	int version, numSpeakers, numSets;
+	bool ok = 3 == fscanf(fp, "vbap %d %d %d", &version, &numSpeakers, &numSets)
+		&& 1 == version && int(spkrs.size()) == numSpeakers && numSets > 0;
+	for(int i=0; ok && i<numSets; ++i){
+		SpeakerTriple triple;
+		ok = 3 == fscanf(fp, "%d %d %d", &triple.s1, &triple.s2, &triple.s3)
+			&& triple.s1 >= 0 && triple.s1 < numSpeakers
+			&& triple.s2 >= 0 && triple.s2 < numSpeakers
+			&& triple.s3 >= -1 && triple.s3 < numSpeakers
+			&& (triple.s3 != -1 || !mIs3D);
+		if(ok){
+			triple.loadVectors(spkrs);
+			sets.push_back(triple);
+		}
 	}
+	fclose(fp);
+	if(!ok) sets.clear();
+	return ok;
+}
 
-	print();
-
-	if (mNumTriplets == 0 ){
-		printf("No SpeakerSets found. Check mode setting or speaker layout.\n");
-		throw -1;
+void Vbap::saveSets(const std::vector<Speaker>& spkrs, const std::vector<SpeakerTriple>& sets) const {
+	if(mCacheDir.empty()) return;
+	// Write to a temporary file first, so a cache file is never incomplete
+	std::string path = cachePath(spkrs);
+	std::string tmp = path + ".tmp";
+	FILE * fp = fopen(tmp.c_str(), "w");
+	if(!fp) return;
+	fprintf(fp, "vbap 1 %d %d\n", int(spkrs.size()), int(sets.size()));
+	for(unsigned i=0; i<sets.size(); ++i){
+		fprintf(fp, "%d %d %d\n", sets[i].s1, sets[i].s2, sets[i].s3);
 	}
+	bool ok = 0 == ferror(fp);
+	ok = 0 == fclose(fp) && ok;
+	if(!ok || 0 != rename(tmp.c_str(), path.c_str())) remove(tmp.c_str());
 }
 
 void Vbap::perform(AudioIOData& io, SoundSource& src, Vec3d& relpos, const int& numFrames, int& frameIndex, float& sample){
+	if (mNumTriplets == 0) return;	// not compiled, or no speaker sets found
+
 	unsigned currentTripletIndex = mCachedTripletIndex; // Cached source placement, so it starts searching from there.
 
 	Vec3d vec = Vec3d(relpos);
-	//printf("(%f,%f,%f)\n",vec[0],vec[1],vec[2]);
 
 	//Rotate vector according to listener-rotation
 	Quatd srcRot = this->mListener->pose().quat();
@@ -246,10 +465,9 @@ void Vbap::perform(AudioIOData& io, SoundSource& src, Vec3d& relpos, const int&
 	for (unsigned count = 0; count < mNumTriplets; ++count) {
 		gainsTemp = computeGains(vec, mTriplets[currentTripletIndex]);
 		if ((gainsTemp[0] >= 0) && (gainsTemp[1] >= 0) && (!mIs3D || (gainsTemp[2] >= 0)) ){
-			//printf("Gainstemp: (%f,%f,%f)\n",gainsTemp[0],gainsTemp[1],gainsTemp[2]);
+			if(!mIs3D) gainsTemp[2] = 0;
 			gainsTemp.normalize();
 			gains = gainsTemp*sample/relpos.mag();
-			//printf("Found: (%d,%d,%d) \n", mTriplets[currentTripletIndex].s1, mTriplets[currentTripletIndex].s2, mTriplets[currentTripletIndex].s3);
 			break;
 		}
 
@@ -257,17 +475,9 @@ void Vbap::perform(AudioIOData& io, SoundSource& src, Vec3d& relpos, const int&
 		if (currentTripletIndex >= mNumTriplets){
 			currentTripletIndex = 0;
 		}
-		//printf("Index: %d\n",count);
 	}
-	//printf("Gains: (%f,%f,%f)\n",gains[0],gains[1],gains[2]);
-
-	SpeakerTriple triple = mTriplets[currentTripletIndex];
 
-	if(mCachedTripletIndex!=currentTripletIndex){
-		printf("Triple: (%d,%d,%d)\n",triple.s1,triple.s2,triple.s3);
-		printf("Gains: (%f,%f,%f)\n",gains[0],gains[1],gains[2]);
-		printf("Gains-temp: (%f,%f,%f)\n",gainsTemp[0],gainsTemp[1],gainsTemp[2]);
-	}
+	const SpeakerTriple& triple = mTriplets[currentTripletIndex];
 
 	mCachedTripletIndex = currentTripletIndex; // Store the new index
 
@@ -278,6 +488,55 @@ void Vbap::perform(AudioIOData& io, SoundSource& src, Vec3d& relpos, const int&
 	}
 }
 
+void Vbap::perform(AudioIOData& io, SoundSource& src, Vec3d& relpos, const int& numFrames, float *samples){
+	if (mNumTriplets == 0) return;	// not compiled, or no speaker sets found
+
+	unsigned currentTripletIndex = mCachedTripletIndex;
+
+	//Rotate vector according to listener-rotation
+	Vec3d vec = this->mListener->pose().quat().rotate(relpos);
+
+	//Silent by default
+	Vec3d gains;
+
+	// The position is constant over the buffer, so search for its triplet once
+	for (unsigned count = 0; count < mNumTriplets; ++count) {
+		Vec3d gainsTemp = computeGains(vec, mTriplets[currentTripletIndex]);
+		if ((gainsTemp[0] >= 0) && (gainsTemp[1] >= 0) && (!mIs3D || (gainsTemp[2] >= 0)) ){
+			if(!mIs3D) gainsTemp[2] = 0;
+			gains = gainsTemp.normalize() / relpos.mag();
+			break;
+		}
+
+		++currentTripletIndex;
+		if (currentTripletIndex >= mNumTriplets){
+			currentTripletIndex = 0;
+		}
+	}
+
+	mCachedTripletIndex = currentTripletIndex;
+
+	const SpeakerTriple& triple = mTriplets[currentTripletIndex];
+	float * out1 = io.outBuffer(triple.s1);
+	float * out2 = io.outBuffer(triple.s2);
+	float g1 = gains[0], g2 = gains[1];
+	if(mIs3D){
+		float * out3 = io.outBuffer(triple.s3);
+		float g3 = gains[2];
+		for (int i = 0; i < numFrames; ++i) {
+			out1[i] += g1 * samples[i];
+			out2[i] += g2 * samples[i];
+			out3[i] += g3 * samples[i];
+		}
+	}
+	else{
+		for (int i = 0; i < numFrames; ++i) {
+			out1[i] += g1 * samples[i];
+			out2[i] += g2 * samples[i];
+		}
+	}
+}
+
 void Vbap::print() {
 	printf("Number of Triplets: %d\n",mNumTriplets);
 	for (unsigned i = 0; i < mNumTriplets; i++) {
@@ -235,4 +235,44 @@ void Nav::step(double dt){
 	}
 }
 
+
+void compose(const PoseArray& parent, const PoseArray& local, PoseArray& out){
+	const int B = 64;
+	const int n = parent.size();
+	const double * pw = parent.quat().w(), * px = parent.quat().x();
+	const double * py = parent.quat().y(), * pz = parent.quat().z();
+	const double * ppx = parent.pos().x(), * ppy = parent.pos().y(), * ppz = parent.pos().z();
+	const double * lw = local.quat().w(), * lx = local.quat().x();
+	const double * ly = local.quat().y(), * lz = local.quat().z();
+	const double * lpx = local.pos().x(), * lpy = local.pos().y(), * lpz = local.pos().z();
+	out.resize(n);
+
+	// Results go into local blocks first, which the compiler knows do not
+	// alias the inputs, so the loop vectorizes and out may be an input
+	double rw[B], rx[B], ry[B], rz[B], rpx[B], rpy[B], rpz[B];
+	for(int i=0; i<n; i+=B){
+		const int m = n-i < B ? n-i : B;
+		for(int k=0; k<m; ++k){
+			const int j = i+k;
+			const double qw = pw[j], qx = px[j], qy = py[j], qz = pz[j];
+			double vx, vy, vz;
+			quatArray::rotate(qw, qx, qy, qz, lpx[j], lpy[j], lpz[j], vx, vy, vz);
+			rpx[k] = ppx[j] + vx;
+			rpy[k] = ppy[j] + vy;
+			rpz[k] = ppz[j] + vz;
+			rw[k] = qw*lw[j] - qx*lx[j] - qy*ly[j] - qz*lz[j];
+			rx[k] = qw*lx[j] + qx*lw[j] + qy*lz[j] - qz*ly[j];
+			ry[k] = qw*ly[j] + qy*lw[j] + qz*lx[j] - qx*lz[j];
+			rz[k] = qw*lz[j] + qz*lw[j] + qx*ly[j] - qy*lx[j];
+		}
+		quatArray::copy(out.pos().x()+i, rpx, m);
+		quatArray::copy(out.pos().y()+i, rpy, m);
+		quatArray::copy(out.pos().z()+i, rpz, m);
+		quatArray::copy(out.quat().w()+i, rw, m);
+		quatArray::copy(out.quat().x()+i, rx, m);
+		quatArray::copy(out.quat().y()+i, ry, m);
+		quatArray::copy(out.quat().z()+i, rz, m);
+	}
+}
+
 } // al::
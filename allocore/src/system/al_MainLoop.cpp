@@ -3,8 +3,13 @@
 #include "allocore/system/al_Printing.hpp"
 
 #include <stdlib.h>		// exit
+#include <math.h>		// ceil
 #include <algorithm>	// std::find
 
+#ifndef AL_WINDOWS
+	#include <poll.h>
+#endif
+
 // native bindings:
 
 extern "C" void al_main_native_init();
@@ -13,12 +18,127 @@ extern "C" void al_main_native_enter(al_sec interval);
 extern "C" void al_main_native_stop();
 
 #ifdef AL_LINUX
+	#include <errno.h>
+	#include <stdint.h>
+	#include <string.h>
+	#include <unistd.h>
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+	#include <sys/timerfd.h>
+
+	// The native loop waits in epoll for the tick timer, the file descriptors
+	// watched by Main and a wakeup from stop(). The timer expires at absolute
+	// times on the monotonic clock, so ticks stay in phase no matter how long
+	// each one takes, and the loop uses no CPU between events.
+	struct EpollLoop {
+		int epoll, timer, wake;
+		al_sec armedInterval;
+
+		EpollLoop()
+		:	epoll(epoll_create1(EPOLL_CLOEXEC)),
+			timer(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+			wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+			armedInterval(0)
+		{
+			if(ok()){
+				add(timer);
+				add(wake);
+			}
+		}
+
+		bool ok() const { return epoll >= 0 && timer >= 0 && wake >= 0; }
+
+		bool add(int fd){
+			struct epoll_event e;
+			memset(&e, 0, sizeof(e));
+			e.events = EPOLLIN;
+			e.data.fd = fd;
+			return 0 == epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &e);
+		}
+
+		void remove(int fd){
+			struct epoll_event e; // non-NULL for kernels before 2.6.9
+			epoll_ctl(epoll, EPOLL_CTL_DEL, fd, &e);
+		}
+
+		static struct timespec toTimespec(al_nsec t){
+			struct timespec ts;
+			ts.tv_sec = t / al_nsec(1e9);
+			ts.tv_nsec = t % al_nsec(1e9);
+			return ts;
+		}
+
+		// Tick now and then every interval after
+		void arm(al_sec interval){
+			al_nsec period = al_nsec(interval * 1e9);
+			struct itimerspec spec;
+			spec.it_value = toTimespec(al_steady_time_nsec());
+			spec.it_interval = toTimespec(period);
+			timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, NULL);
+			armedInterval = interval;
+		}
+
+		void disarm(){
+			struct itimerspec spec;
+			memset(&spec, 0, sizeof(spec));
+			timerfd_settime(timer, 0, &spec, NULL);
+			armedInterval = 0;
+		}
+	};
+
+	// Never destroyed, like Main
+	static EpollLoop& epollLoop(){
+		static EpollLoop * loop = new EpollLoop;
+		return *loop;
+	}
+
 	extern "C" void al_main_native_init(){
-		AL_WARN("Linux native loop not yet implemented");
+		if(!epollLoop().ok()){
+			AL_WARN("Linux native loop could not be created: %s", strerror(errno));
+		}
 	}
 	extern "C" void al_main_native_attach(al_sec interval){}
-	extern "C" void al_main_native_enter(al_sec interval){}
-	extern "C" void al_main_native_stop(){}
+	extern "C" void al_main_native_enter(al_sec interval){
+		EpollLoop& loop = epollLoop();
+		if(!loop.ok()) return;
+		al::Main& M = al::Main::get();
+		loop.arm(interval);
+
+		struct epoll_event events[32];
+		while(M.isRunning()){
+			if(M.interval() != loop.armedInterval) loop.arm(M.interval());
+
+			int n = epoll_wait(loop.epoll, events, 32, -1);
+			if(n < 0){
+				if(EINTR == errno) continue;
+				AL_WARN("epoll_wait failed: %s", strerror(errno));
+				break;
+			}
+
+			for(int i=0; i<n && M.isRunning(); ++i){
+				int fd = events[i].data.fd;
+				uint64_t count;
+				if(fd == loop.timer){
+					// Late ticks are dropped rather than run back to back
+					if(read(loop.timer, &count, sizeof(count)) > 0) M.tick();
+				}
+				else if(fd == loop.wake){
+					ssize_t r = read(loop.wake, &count, sizeof(count));
+					(void)r;
+				}
+				else{
+					M.readable(fd);
+				}
+			}
+		}
+		loop.disarm();
+	}
+	extern "C" void al_main_native_stop(){
+		// Wake up epoll_wait if stopped from another thread
+		uint64_t one = 1;
+		ssize_t r = write(epollLoop().wake, &one, sizeof(one));
+		(void)r;
+	}
 
 #elif defined AL_WINDOWS
 	extern "C" void al_main_native_init(){
@@ -115,6 +235,10 @@ Main::Handler :: ~Handler() {
 	onExit();
 }
 
+Main::FDHandler :: ~FDHandler() {
+	Main::get().unwatch(*this);
+}
+
 ////////////////////////////////////////////////////////////////
 
 Main::Main()
@@ -160,6 +284,12 @@ void Main::tick() {
 	// trigger any scheduled functions:
 	mQueue.update(mLogicalTime);
 
+	// check file descriptors, unless the driver waits on them:
+	#ifdef AL_LINUX
+	if (mDriver != NATIVE)
+	#endif
+	pollFDs();
+
 	// call tick handlers...
 	std::vector<Handler *>::iterator it = mHandlers.begin();
 	while(it != mHandlers.end()){
@@ -197,13 +327,22 @@ void Main::start() {
 		switch (mDriver) {
 			case Main::GLUT: al_main_glut_enter(interval()); break;
 			case Main::NATIVE: al_main_native_enter(interval()); break;
-			default:
+			default: {
 				// default sleep version
+				// ticks are due at multiples of the interval, so the period
+				// does not grow with the time spent in each tick
+				al_sec next = timeInSec();
 				while (mActive) {
 					tick();
-					al_sleep(interval());
+					next += interval();
+					al_sec now = timeInSec();
+					if (next <= now) {
+						// skip ticks that are already late
+						next += (floor((now - next) / interval()) + 1) * interval();
+					}
+					al_sleep(next - now);
 				}
-				break;
+			}	break;
 		}
 
 		// if we got here, then the mainloop was started, and then stopped:
@@ -249,6 +388,69 @@ Main& Main::remove(Main::Handler& v) {
 	return *this;
 }
 
+Main& Main::watch(int fd, Main::FDHandler& v) {
+	#ifdef AL_WINDOWS
+		AL_WARN("Main::watch not available on Windows");
+	#else
+		unwatch(fd);
+		WatchedFD w = { fd, &v };
+		mFDs.push_back(w);
+		#ifdef AL_LINUX
+			if (!epollLoop().ok() || !epollLoop().add(fd)) {
+				AL_WARN("Main::watch could not add file descriptor %d", fd);
+			}
+		#endif
+	#endif
+	return *this;
+}
+
+Main& Main::unwatch(int fd) {
+	for (unsigned i=0; i<mFDs.size(); ++i) {
+		if (mFDs[i].fd == fd) {
+			mFDs.erase(mFDs.begin() + i);
+			#ifdef AL_LINUX
+				epollLoop().remove(fd);
+			#endif
+			break;
+		}
+	}
+	return *this;
+}
+
+Main& Main::unwatch(Main::FDHandler& v) {
+	for (unsigned i=mFDs.size(); i>0; --i) {
+		if (mFDs[i-1].handler == &v) unwatch(mFDs[i-1].fd);
+	}
+	return *this;
+}
+
+void Main::readable(int fd) {
+	for (unsigned i=0; i<mFDs.size(); ++i) {
+		if (mFDs[i].fd == fd) {
+			mFDs[i].handler->onReadable(fd);
+			break;
+		}
+	}
+}
+
+void Main::pollFDs() {
+	#ifndef AL_WINDOWS
+	if (mFDs.empty()) return;
+	std::vector<struct pollfd> fds(mFDs.size());
+	for (unsigned i=0; i<fds.size(); ++i) {
+		fds[i].fd = mFDs[i].fd;
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+	if (poll(&fds[0], fds.size(), 0) > 0) {
+		// handlers may unwatch, so look each one up again
+		for (unsigned i=0; i<fds.size(); ++i) {
+			if (fds[i].revents & POLLIN) readable(fds[i].fd);
+		}
+	}
+	#endif
+}
+
 
 } //al::
 
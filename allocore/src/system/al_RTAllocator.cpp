@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "allocore/system/al_RTAllocator.hpp"
+
+namespace al{
+
+namespace{
+
+// Every allocation of RTAllocator starts with a header telling where it
+// came from. Its size keeps the memory after it 16-byte aligned.
+struct Header{
+	FixedPool * pool;	// NULL if from heap
+	char pad[16 - sizeof(FixedPool *)];
+};
+
+const size_t classSizes[RTAllocator::NUM_CLASSES] = {64, 256, 1024, 4096, 16384};
+
+thread_local RTAllocator * tCurrent = NULL;
+thread_local bool tInBlock = false;
+thread_local bool tReporting = false;	// guards against recursion when reporting
+
+void * heapAlloc(size_t size){
+	Header * h = (Header *)::malloc(sizeof(Header) + size);
+	if(!h) return NULL;
+	h->pool = NULL;
+	return h + 1;
+}
+
+} // ::
+
+
+FixedPool::FixedPool(size_t blockSize, unsigned numBlocks)
+:	mMem(NULL), mBlockSize((blockSize + 15) & ~size_t(15)), mNumBlocks(numBlocks),
+	mHead(0), mNext(numBlocks), mAvailable(numBlocks)
+{
+	if(mNumBlocks){
+		mMem = (char *)::malloc(mBlockSize * mNumBlocks);
+		if(!mMem){
+			mNumBlocks = 0;
+			mAvailable = 0;
+			return;
+		}
+	}
+	// Link all blocks in order
+	for(unsigned i=0; i<mNumBlocks; ++i) mNext[i].store(i+1 < mNumBlocks ? i+2 : 0);
+	mHead = mNumBlocks ? 1 : 0;
+}
+
+FixedPool::~FixedPool(){
+	::free(mMem);
+}
+
+void * FixedPool::alloc(){
+	unsigned long long head = mHead.load(std::memory_order_acquire);
+	for(;;){
+		unsigned idx = unsigned(head & 0xffffffffULL);
+		if(!idx) return NULL;
+		unsigned next = mNext[idx-1].load(std::memory_order_relaxed);
+		// The tag changes on every update, so a stale head cannot win
+		unsigned long long newHead = (((head >> 32) + 1) << 32) | next;
+		if(mHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel)){
+			--mAvailable;
+			return mMem + (idx-1) * mBlockSize;
+		}
+	}
+}
+
+void FixedPool::free(void * block){
+	if(!block) return;
+	unsigned idx = unsigned(((char *)block - mMem) / mBlockSize);
+	unsigned long long head = mHead.load(std::memory_order_relaxed);
+	for(;;){
+		mNext[idx].store(unsigned(head & 0xffffffffULL), std::memory_order_relaxed);
+		unsigned long long newHead = (((head >> 32) + 1) << 32) | (idx+1);
+		if(mHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel)){
+			++mAvailable;
+			return;
+		}
+	}
+}
+
+
+ScratchArena::ScratchArena(size_t capacity)
+:	mMem((char *)::malloc(capacity ? capacity : 1)), mCapacity(mMem ? capacity : 0),
+	mUsed(0), mHighWater(0), mOverflows(0)
+{}
+
+ScratchArena::~ScratchArena(){
+	::free(mMem);
+}
+
+void * ScratchArena::alloc(size_t size, size_t align){
+	size_t start = (mUsed + align-1) & ~(align-1);
+	if(start + size > mCapacity){
+		++mOverflows;
+		return NULL;
+	}
+	mUsed = start + size;
+	if(mUsed > mHighWater) mHighWater = mUsed;
+	return mMem + start;
+}
+
+
+RTAllocator::RTAllocator(unsigned blocksPerClass, size_t scratchSize)
+:	mScratch(scratchSize), mHeapFallbacks(0), mHeapInBlock(0), mTrap(false),
+	mPrevCurrent(NULL), mPrevInBlock(false)
+{
+	for(int i=0; i<NUM_CLASSES; ++i){
+		mPools[i] = new FixedPool(sizeof(Header) + classSizes[i], blocksPerClass);
+	}
+}
+
+RTAllocator::~RTAllocator(){
+	if(tCurrent == this){
+		tCurrent = NULL;
+		tInBlock = false;
+	}
+	for(int i=0; i<NUM_CLASSES; ++i) delete mPools[i];
+}
+
+void * RTAllocator::allocate(size_t size){
+	for(int i=0; i<NUM_CLASSES; ++i){
+		if(size <= classSizes[i]){
+			Header * h = (Header *)mPools[i]->alloc();
+			if(h){
+				h->pool = mPools[i];
+				return h + 1;
+			}
+			// Pool exhausted; a larger class would waste memory of other users
+			break;
+		}
+	}
+	++mHeapFallbacks;
+	if(tInBlock && tCurrent == this) onHeapAllocation(size);
+	return heapAlloc(size);
+}
+
+void RTAllocator::deallocate(void * p){
+	if(!p) return;
+	Header * h = (Header *)p - 1;
+	if(h->pool) h->pool->free(h);
+	else ::free(h);
+}
+
+void RTAllocator::beginBlock(){
+	mScratch.reset();
+	// Only current during the block, so that the thread does not allocate
+	// from the allocator after it was removed from the stream or deleted
+	mPrevCurrent = tCurrent;
+	mPrevInBlock = tInBlock;
+	tCurrent = this;
+	tInBlock = true;
+}
+
+void RTAllocator::endBlock(){
+	tCurrent = mPrevCurrent;
+	tInBlock = mPrevInBlock;
+}
+
+bool RTAllocator::inBlock() const { return tInBlock && tCurrent == this; }
+
+RTAllocator * RTAllocator::current(){ return tCurrent; }
+
+void RTAllocator::makeCurrent(){ tCurrent = this; }
+
+void RTAllocator::clearCurrent(){
+	tCurrent = NULL;
+	tInBlock = false;
+}
+
+void * RTAllocator::malloc(size_t size){
+	return tCurrent ? tCurrent->allocate(size) : heapAlloc(size);
+}
+
+void RTAllocator::free(void * p){ deallocate(p); }
+
+bool RTAllocator::debugging(){
+	#ifdef AL_RT_DEBUG
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+void RTAllocator::onHeapAllocation(size_t size){
+	RTAllocator * a = tCurrent;
+	if(!a || !tInBlock || tReporting) return;
+	++a->mHeapInBlock;
+	if(a->mTrap){
+		tReporting = true;
+		fprintf(stderr, "RTAllocator: heap allocation of %lu bytes in audio block\n", (unsigned long)size);
+		abort();
+	}
+}
+
+} // al::
+
+
+#ifdef AL_RT_DEBUG
+// Replacements of the global operator new that check the audio thread
+
+void * operator new(size_t size){
+	al::RTAllocator::onHeapAllocation(size);
+	void * p = ::malloc(size ? size : 1);
+	if(!p) throw std::bad_alloc();
+	return p;
+}
+
+void * operator new[](size_t size){
+	al::RTAllocator::onHeapAllocation(size);
+	void * p = ::malloc(size ? size : 1);
+	if(!p) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void * p) noexcept { ::free(p); }
+void operator delete[](void * p) noexcept { ::free(p); }
+#endif
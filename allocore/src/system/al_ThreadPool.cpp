@@ -0,0 +1,231 @@
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "allocore/system/al_Info.hpp"
+#include "allocore/system/al_Thread.hpp"
+#include "allocore/system/al_ThreadPool.hpp"
+
+namespace al{
+
+namespace{
+
+// A range of offsets [begin, end) packed into one word, so the owner can
+// take from the front and thieves from the back with compare-and-swap
+inline uint64_t pack(uint32_t b, uint32_t e){ return (uint64_t(e) << 32) | b; }
+inline uint32_t rangeBegin(uint64_t r){ return uint32_t(r); }
+inline uint32_t rangeEnd(uint64_t r){ return uint32_t(r >> 32); }
+
+// Remaining range of a thread, on its own cache line
+struct Slot{
+	std::atomic<uint64_t> range;
+	char pad[64 - sizeof(std::atomic<uint64_t>)];
+	Slot(): range(0){}
+};
+
+struct Job{
+	ThreadPool::RangeFunc func;
+	void * user;
+	int begin;
+	uint32_t grain;
+	std::atomic<long> remaining;	// indices not yet done
+};
+
+// Pool whose loop the thread is running, and the thread's index in it
+thread_local void * tPool = NULL;
+thread_local int tThread = 0;
+
+} // ::
+
+
+class ThreadPool::Impl{
+public:
+	Impl(int size)
+	:	mSlots(size), mThreads(size-1), mJob(NULL), mGeneration(0), mActive(0), mQuit(false)
+	{
+		mArgs.resize(size-1);
+		for(int i=0; i<size-1; ++i){
+			mArgs[i].impl = this;
+			mArgs[i].thread = i+1;
+			mThreads[i].start(workerFunc, &mArgs[i]);
+		}
+	}
+
+	~Impl(){
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mWake.notify_all();
+		for(unsigned i=0; i<mThreads.size(); ++i) mThreads[i].join();
+	}
+
+	int size() const { return mSlots.size(); }
+
+	void run(int begin, int end, RangeFunc func, void * user, int grain){
+		int n = end - begin;
+		if(n <= 0) return;
+		if(grain <= 0){
+			grain = n / (size() * 16);
+			if(grain < 1) grain = 1;
+		}
+
+		// Loops within loops and loops too small to split run serially
+		if(tPool == this || size() == 1 || n <= grain){
+			func(user, begin, end, tPool == this ? tThread : 0);
+			return;
+		}
+
+		std::lock_guard<std::mutex> runLock(mRunMutex);
+
+		Job job;
+		job.func = func;
+		job.user = user;
+		job.begin = begin;
+		job.grain = grain;
+		job.remaining = n;
+		for(int i=0; i<size(); ++i){
+			uint32_t b = uint64_t(n) * i / size();
+			uint32_t e = uint64_t(n) * (i+1) / size();
+			mSlots[i].range.store(pack(b, e));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mJob = &job;
+			++mGeneration;
+		}
+		mWake.notify_all();
+
+		void * prevPool = tPool;
+		int prevThread = tThread;
+		tPool = this;
+		tThread = 0;
+		work(job, 0);
+		tPool = prevPool;
+		tThread = prevThread;
+
+		// Wait for pieces still running in other threads, then until no
+		// thread can touch the job anymore
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDone.wait(lock, [&]{ return job.remaining.load() == 0; });
+		mJob = NULL;
+		mDone.wait(lock, [&]{ return mActive == 0; });
+	}
+
+private:
+	struct WorkerArgs{
+		Impl * impl;
+		int thread;
+	};
+
+	std::vector<Slot> mSlots;
+	std::vector<Thread> mThreads;
+	std::vector<WorkerArgs> mArgs;
+
+	std::mutex mRunMutex;		// one loop at a time
+	std::mutex mMutex;			// guards the members below
+	std::condition_variable mWake, mDone;
+	Job * mJob;
+	unsigned mGeneration;
+	int mActive;
+	bool mQuit;
+
+	static void * workerFunc(void * user){
+		WorkerArgs& args = *(WorkerArgs *)user;
+		args.impl->workerLoop(args.thread);
+		return NULL;
+	}
+
+	void workerLoop(int thread){
+		tPool = this;
+		tThread = thread;
+		unsigned seen = 0;
+		for(;;){
+			Job * job;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWake.wait(lock, [&]{ return mQuit || (mJob && mGeneration != seen); });
+				if(mQuit) return;
+				seen = mGeneration;
+				job = mJob;
+				++mActive;
+			}
+			work(*job, thread);
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if(--mActive == 0) mDone.notify_all();
+			}
+		}
+	}
+
+	// Run pieces of own range, then of stolen ranges, until none are left
+	void work(Job& job, int thread){
+		uint32_t b, e;
+		while(take(thread, job.grain, b, e) || steal(thread, job.grain, b, e)){
+			job.func(job.user, job.begin + int(b), job.begin + int(e), thread);
+			long len = e - b;
+			if(job.remaining.fetch_sub(len) == len){
+				std::lock_guard<std::mutex> lock(mMutex);
+				mDone.notify_all();
+			}
+		}
+	}
+
+	bool take(int thread, uint32_t grain, uint32_t& b, uint32_t& e){
+		std::atomic<uint64_t>& range = mSlots[thread].range;
+		uint64_t r = range.load();
+		for(;;){
+			b = rangeBegin(r);
+			uint32_t end = rangeEnd(r);
+			if(b >= end) return false;
+			e = end - b > grain ? b + grain : end;
+			if(range.compare_exchange_weak(r, pack(e, end))) return true;
+		}
+	}
+
+	bool steal(int thread, uint32_t grain, uint32_t& b, uint32_t& e){
+		for(int k=1; k<size(); ++k){
+			int victim = (thread + k) % size();
+			std::atomic<uint64_t>& range = mSlots[victim].range;
+			uint64_t r = range.load();
+			for(;;){
+				uint32_t vb = rangeBegin(r), ve = rangeEnd(r);
+				if(vb >= ve) break;
+				// Take the back half, or all of it if less than two pieces
+				uint32_t mid = ve - vb > grain ? vb + (ve - vb)/2 : vb;
+				if(range.compare_exchange_weak(r, pack(vb, mid))){
+					// Own range is empty, so only thieves can see the store
+					mSlots[thread].range.store(pack(mid, ve));
+					return take(thread, grain, b, e);
+				}
+			}
+		}
+		return false;
+	}
+};
+
+
+ThreadPool::ThreadPool(int size)
+:	mImpl(NULL), mSize(size > 0 ? size : numProcessors())
+{
+	if(mSize < 1) mSize = 1;
+	mImpl = new Impl(mSize);
+}
+
+ThreadPool::~ThreadPool(){
+	delete mImpl;
+}
+
+ThreadPool& ThreadPool::get(){
+	// Never destroyed, so its threads outlive any static object using it
+	static ThreadPool * pool = new ThreadPool;
+	return *pool;
+}
+
+void ThreadPool::run(int begin, int end, RangeFunc func, void * user, int grain){
+	mImpl->run(begin, end, func, user, grain);
+}
+
+} // al::
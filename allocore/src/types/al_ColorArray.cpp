@@ -0,0 +1,400 @@
+#include <stdint.h>
+#include "allocore/system/al_ThreadPool.hpp"
+#include "allocore/types/al_ColorArray.hpp"
+
+namespace al{
+
+namespace{
+
+// Colors converted at once. The components of a block are copied into
+// local arrays, which the compiler knows do not alias each other or the
+// source and destination.
+enum{ BLOCK = 64 };
+
+// Colors per piece of an array split among threads
+const int grain = 4096;
+
+// CIE constants and reference white D65, as in al_Color.cpp
+const float epsilon = 216.f / 24389.f;
+const float kappa = 24389.f / 27.f;
+const float Xn = 0.95047f, Yn = 1.f, Zn = 1.08883f;
+
+inline float asFloat(int32_t i){
+	union{ int32_t i; float f; } u; u.i = i; return u.f;
+}
+
+inline int32_t asInt(float f){
+	union{ int32_t i; float f; } u; u.f = f; return u.i;
+}
+
+// a if c is true, otherwise b. With trapping math, the compiler does not
+// turn a ?: with arithmetic into a vector blend, since it might evaluate
+// the arithmetic that is not selected; masking bits it does.
+inline float select(bool c, float a, float b){
+	int32_t m = -int32_t(c);
+	return asFloat((asInt(a) & m) | (asInt(b) & ~m));
+}
+
+// Largest integer not greater than x, for |x| < 2^31
+inline float floorSmall(float x){
+	int i = int(x);
+	i -= float(i) > x;
+	return float(i);
+}
+
+// Base 2 logarithm of a normal, positive x, to about float precision
+inline float log2Approx(float x){
+	int32_t i = asInt(x);
+	float e = float((i >> 23) - 127);
+	float m = asFloat((i & 0x7fffff) | 0x3f800000);	// in [1, 2)
+	// ln(m) = 2 atanh(t) with t in [0, 1/3)
+	float t = (m - 1.f) / (m + 1.f), t2 = t*t;
+	float ln = 2.f*t*(1.f + t2*(1.f/3 + t2*(1.f/5 + t2*(1.f/7 + t2*(1.f/9 + t2*(1.f/11))))));
+	return e + ln * 1.44269504f;
+}
+
+// 2 to the power y, for y in [-126, 128), to about float precision
+inline float exp2Approx(float y){
+	float fl = floorSmall(y);
+	float f = (y - fl) * 0.693147181f;	// in [0, ln 2)
+	float p = 1.f + f*(1.f + f*(1.f/2 + f*(1.f/6 + f*(1.f/24 + f*(1.f/120
+			+ f*(1.f/720 + f*(1.f/5040 + f*(1.f/40320))))))));
+	return p * asFloat((int32_t(fl) + 127) << 23);
+}
+
+// x to the power p, for a normal, positive x
+inline float powApprox(float x, float p){
+	return exp2Approx(p * log2Approx(x));
+}
+
+// sRGB component to linear. Both sides are computed and one of them
+// selected, so the loops have no branches; the power gets a harmless
+// argument when not used.
+inline float linearize(float c){
+	float p = powApprox(select(c > 0.04045f, (c + 0.055f) / 1.055f, 1.f), 2.4f);
+	return select(c <= 0.04045f, c / 12.92f, p);
+}
+
+// Linear component to sRGB clamped to [0, 1]
+inline float delinearize(float c){
+	float p = powApprox(select(c > 0.0031308f, c, 1.f), 1.f/2.4f) * 1.055f - 0.055f;
+	float v = select(c <= 0.0031308f, c * 12.92f, p);
+	v = v > 0.f ? v : 0.f;
+	return v < 1.f ? v : 1.f;
+}
+
+// Compression of CIEXYZ component relative to white for Lab
+inline float labCompress(float t){
+	float p = powApprox(select(t > epsilon, t, 1.f), 1.f/3.f);
+	return select(t > epsilon, p, (kappa * t + 16.f) / 116.f);
+}
+
+// Inverse of labCompress
+inline float labExpand(float f){
+	float f3 = f*f*f;
+	return select(f3 > epsilon, f3, (116.f * f - 16.f) / kappa);
+}
+
+
+// The block kernels convert the components in place
+
+void rgbToHSVBlock(float * c0, float * c1, float * c2, int n){
+	for(int k=0; k<n; ++k){
+		float r = c0[k], g = c1[k], b = c2[k];
+		float min = r<g ? r:g; min = min<b ? min:b;
+		float max = r>g ? r:g; max = max>b ? max:b;
+		float rng = max - min;
+		bool chroma = (rng != 0.f) & (max != 0.f);
+		float inv = 1.f / select(rng != 0.f, rng, 1.f);
+		float s = rng / select(max != 0.f, max, 1.f);
+		float hr =       (g - b)*inv;
+		float hg = 2.f + (b - r)*inv;
+		float hb = 4.f + (r - g)*inv;
+		float hl = select(r == max, hr, select(g == max, hg, hb));
+		hl = select(hl < 0.f, hl + 6.f, hl);
+		c0[k] = select(chroma, hl * (1.f/6.f), 0.f);
+		c1[k] = select(chroma, s, 0.f);
+		c2[k] = max;
+	}
+}
+
+// Reduction of an RGB component from HSV value, given the distance k in
+// [0, 6) from the hue where the component starts to fall
+inline float hueWeight(float k){
+	float w = select(k < 4.f - k, k, 4.f - k);
+	w = select(w < 1.f, w, 1.f);
+	return select(w > 0.f, w, 0.f);
+}
+
+void hsvToRGBBlock(float * c0, float * c1, float * c2, int n){
+	for(int k=0; k<n; ++k){
+		float h = c0[k], s = c1[k], v = c2[k];
+		float h6 = (h - floorSmall(h)) * 6.f;
+		float vs = v * s;
+		float kr = 5.f + h6; kr = select(kr >= 6.f, kr - 6.f, kr);
+		float kg = 3.f + h6; kg = select(kg >= 6.f, kg - 6.f, kg);
+		float kb = 1.f + h6; kb = select(kb >= 6.f, kb - 6.f, kb);
+		c0[k] = v - vs*hueWeight(kr);
+		c1[k] = v - vs*hueWeight(kg);
+		c2[k] = v - vs*hueWeight(kb);
+	}
+}
+
+void rgbToXYZBlock(float * c0, float * c1, float * c2, int n){
+	for(int k=0; k<n; ++k){
+		float r = linearize(c0[k]), g = linearize(c1[k]), b = linearize(c2[k]);
+		c0[k] = 0.4124f*r + 0.3576f*g + 0.1805f*b;
+		c1[k] = 0.2126f*r + 0.7152f*g + 0.0722f*b;
+		c2[k] = 0.0193f*r + 0.1192f*g + 0.9505f*b;
+	}
+}
+
+void xyzToRGBBlock(float * c0, float * c1, float * c2, int n){
+	for(int k=0; k<n; ++k){
+		float x = c0[k], y = c1[k], z = c2[k];
+		c0[k] = delinearize( 3.2405f*x - 1.5371f*y - 0.4985f*z);
+		c1[k] = delinearize(-0.9693f*x + 1.8760f*y + 0.0416f*z);
+		c2[k] = delinearize( 0.0556f*x - 0.2040f*y + 1.0572f*z);
+	}
+}
+
+void xyzToLabBlock(float * c0, float * c1, float * c2, int n){
+	for(int k=0; k<n; ++k){
+		float fx = labCompress(c0[k] / Xn);
+		float fy = labCompress(c1[k] / Yn);
+		float fz = labCompress(c2[k] / Zn);
+		c0[k] = 116.f * fy - 16.f;
+		c1[k] = 500.f * (fx - fy);
+		c2[k] = 200.f * (fy - fz);
+	}
+}
+
+void labToXYZBlock(float * c0, float * c1, float * c2, int n){
+	for(int k=0; k<n; ++k){
+		float l = c0[k];
+		float fy = (l + 16.f) / 116.f;
+		float fx = c1[k] / 500.f + fy;
+		float fz = fy - c2[k] / 200.f;
+		float yr = select(l > epsilon * kappa, fy*fy*fy, l / kappa);
+		c0[k] = labExpand(fx) * Xn;
+		c1[k] = yr * Yn;
+		c2[k] = labExpand(fz) * Zn;
+	}
+}
+
+void rgbToLabBlock(float * c0, float * c1, float * c2, int n){
+	rgbToXYZBlock(c0, c1, c2, n);
+	xyzToLabBlock(c0, c1, c2, n);
+}
+
+void labToRGBBlock(float * c0, float * c1, float * c2, int n){
+	labToXYZBlock(c0, c1, c2, n);
+	xyzToRGBBlock(c0, c1, c2, n);
+}
+
+
+// Call func(begin, end) on pieces of [0, n), in parallel if worthwhile
+template <class Func>
+void run(int n, ThreadPool * pool, const Func& func){
+	if(pool && n >= 2*grain) pool->parallelFor(0, n, func, grain);
+	else func(0, n);
+}
+
+template <void (*Kernel)(float *, float *, float *, int)>
+void convertBlocks(
+	const float * src, float * dst, int n,
+	int srcStride, int dstStride, ThreadPool * pool
+){
+	run(n, pool, [=](int begin, int end){
+		float c0[BLOCK], c1[BLOCK], c2[BLOCK];
+		for(int i=begin; i<end; i+=BLOCK){
+			int m = end - i < BLOCK ? end - i : int(BLOCK);
+			const float * s = src + size_t(i)*srcStride;
+			for(int k=0; k<m; ++k){
+				c0[k] = s[k*srcStride  ];
+				c1[k] = s[k*srcStride+1];
+				c2[k] = s[k*srcStride+2];
+			}
+			Kernel(c0, c1, c2, m);
+			float * d = dst + size_t(i)*dstStride;
+			for(int k=0; k<m; ++k){
+				d[k*dstStride  ] = c0[k];
+				d[k*dstStride+1] = c1[k];
+				d[k*dstStride+2] = c2[k];
+			}
+		}
+	});
+}
+
+
+bool sameDims(const Array& a, const Array& b){
+	if(a.dimcount() != b.dimcount()) return false;
+	for(int i=0; i<a.dimcount(); ++i){
+		if(a.dim(i) != b.dim(i)) return false;
+	}
+	return true;
+}
+
+// Make dst hold cells of the given format for each cell of src
+void formatCells(Array& dst, const Array& src, int components, AlloTy ty){
+	AlloArrayHeader h = src.header;
+	h.components = components;
+	h.type = ty;
+	allo_array_setstride(&h, 1);
+	dst.format(h);
+}
+
+bool isContiguous(const Array& a){
+	for(int i=1; i<a.dimcount(); ++i){
+		if(a.stride(i) != a.stride(i-1) * a.dim(i-1)) return false;
+	}
+	return true;
+}
+
+// Call func(src cells, dst cells, number of cells) on all cells of two
+// arrays of equal dimensions, at once if neither has padded rows
+template <class Func>
+void forRows(const Array& src, Array& dst, const Func& func){
+	if(isContiguous(src) && isContiguous(dst)){
+		func(src.data.ptr, dst.data.ptr, src.cells());
+		return;
+	}
+	unsigned ny = src.dimcount() > 1 ? src.dim(1) : 1;
+	unsigned nz = src.dimcount() > 2 ? src.dim(2) : 1;
+	for(unsigned z=0; z<nz; ++z){
+		for(unsigned y=0; y<ny; ++y){
+			size_t srcOffset = size_t(y)*src.stride(1) + size_t(z)*src.stride(2);
+			size_t dstOffset = size_t(y)*dst.stride(1) + size_t(z)*dst.stride(2);
+			func(src.data.ptr + srcOffset, dst.data.ptr + dstOffset, src.dim(0));
+		}
+	}
+}
+
+
+template <class Out>
+void colormapBlocks(
+	const float * values, Out * dst, int n,
+	const Color * table, int tableSize, float lo, float hi,
+	ThreadPool * pool
+){
+	if(tableSize < 1) return;
+	if(tableSize == 1){
+		for(int i=0; i<n; ++i) dst[i] = table[0];
+		return;
+	}
+	const float last = float(tableSize - 1);
+	const float scale = hi != lo ? last / (hi - lo) : 0.f;
+	run(n, pool, [=](int begin, int end){
+		float frac[BLOCK];
+		int index[BLOCK];
+		for(int i=begin; i<end; i+=BLOCK){
+			int m = end - i < BLOCK ? end - i : int(BLOCK);
+			const float * v = values + i;
+			// Positions in table; NaNs go to its start
+			for(int k=0; k<m; ++k){
+				float t = (v[k] - lo) * scale;
+				t = t > 0.f ? t : 0.f;
+				t = t < last ? t : last;
+				int j = int(t);
+				j = j < tableSize-2 ? j : tableSize-2;
+				index[k] = j;
+				frac[k] = t - float(j);
+			}
+			Out * d = dst + i;
+			for(int k=0; k<m; ++k){
+				const Color& c1 = table[index[k]];
+				const Color& c2 = table[index[k]+1];
+				float f = frac[k];
+				d[k] = Color(
+					c1.r + (c2.r - c1.r)*f, c1.g + (c2.g - c1.g)*f,
+					c1.b + (c2.b - c1.b)*f, c1.a + (c2.a - c1.a)*f
+				);
+			}
+		}
+	});
+}
+
+} // ::
+
+
+void rgbToHSV(const float * src, float * dst, int n, int srcStride, int dstStride, ThreadPool * pool){
+	convertBlocks<rgbToHSVBlock>(src, dst, n, srcStride, dstStride, pool);
+}
+
+void hsvToRGB(const float * src, float * dst, int n, int srcStride, int dstStride, ThreadPool * pool){
+	convertBlocks<hsvToRGBBlock>(src, dst, n, srcStride, dstStride, pool);
+}
+
+void rgbToXYZ(const float * src, float * dst, int n, int srcStride, int dstStride, ThreadPool * pool){
+	convertBlocks<rgbToXYZBlock>(src, dst, n, srcStride, dstStride, pool);
+}
+
+void xyzToRGB(const float * src, float * dst, int n, int srcStride, int dstStride, ThreadPool * pool){
+	convertBlocks<xyzToRGBBlock>(src, dst, n, srcStride, dstStride, pool);
+}
+
+void xyzToLab(const float * src, float * dst, int n, int srcStride, int dstStride, ThreadPool * pool){
+	convertBlocks<xyzToLabBlock>(src, dst, n, srcStride, dstStride, pool);
+}
+
+void labToXYZ(const float * src, float * dst, int n, int srcStride, int dstStride, ThreadPool * pool){
+	convertBlocks<labToXYZBlock>(src, dst, n, srcStride, dstStride, pool);
+}
+
+void rgbToLab(const float * src, float * dst, int n, int srcStride, int dstStride, ThreadPool * pool){
+	convertBlocks<rgbToLabBlock>(src, dst, n, srcStride, dstStride, pool);
+}
+
+void labToRGB(const float * src, float * dst, int n, int srcStride, int dstStride, ThreadPool * pool){
+	convertBlocks<labToRGBBlock>(src, dst, n, srcStride, dstStride, pool);
+}
+
+
+bool convertColors(ColorConversion func, const Array& src, Array& dst, ThreadPool * pool){
+	if(!src.isType<float>() || src.components() < 3) return false;
+	if(!dst.isType<float>() || dst.components() < 3 || !sameDims(src, dst)){
+		formatCells(dst, src, 3, AlloFloat32Ty);
+	}
+	int srcStride = src.stride(0) / sizeof(float);
+	int dstStride = dst.stride(0) / sizeof(float);
+	forRows(src, dst, [&](const char * s, char * d, unsigned n){
+		func((const float *)s, (float *)d, n, srcStride, dstStride, pool);
+	});
+	return true;
+}
+
+
+void colormap(
+	const float * values, Color * dst, int n,
+	const Color * table, int tableSize, float lo, float hi,
+	ThreadPool * pool
+){
+	colormapBlocks(values, dst, n, table, tableSize, lo, hi, pool);
+}
+
+void colormap(
+	const float * values, Colori * dst, int n,
+	const Color * table, int tableSize, float lo, float hi,
+	ThreadPool * pool
+){
+	colormapBlocks(values, dst, n, table, tableSize, lo, hi, pool);
+}
+
+bool colormap(
+	const Array& values, Array& dst,
+	const Color * table, int tableSize, float lo, float hi,
+	ThreadPool * pool
+){
+	if(!values.isType<float>() || values.components() != 1) return false;
+	bool toColori = dst.isType<uint8_t>() && dst.components() == 4 && sameDims(values, dst);
+	if(!toColori && !(dst.isType<float>() && dst.components() == 4 && sameDims(values, dst))){
+		formatCells(dst, values, 4, AlloFloat32Ty);
+	}
+	forRows(values, dst, [&](const char * s, char * d, unsigned n){
+		if(toColori) colormap((const float *)s, (Colori *)d, n, table, tableSize, lo, hi, pool);
+		else         colormap((const float *)s, (Color *)d, n, table, tableSize, lo, hi, pool);
+	});
+	return true;
+}
+
+} // al::
@@ -0,0 +1,202 @@
+/*
+ * Runs the allocore benchmarks or compares two runs.
+ *
+ * Usage:
+ *	allocoreBenchmarks [options]
+ *		--filter <str>		only run benchmarks whose name contains str
+ *		--warmup <n>		untimed repetitions (default 3)
+ *		--reps <n>			minimum timed repetitions (default 10)
+ *		--max-reps <n>		maximum timed repetitions (default 1000)
+ *		--min-time <sec>	minimum time spent in timed repetitions (default 0.5)
+ *		--json <file>		write results as JSON
+ *
+ *	allocoreBenchmarks --compare <base.json> <new.json> [--threshold <percent>]
+ *		Prints the change in median time of every benchmark present in both
+ *		runs. Exits with 1 if any benchmark is slower by more than the
+ *		threshold (default 5%).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bmAllocore.h"
+
+volatile char benchmarkSink;
+
+static void printTime(double t){
+	if(t < 1e-6)		printf("%7.1f ns", t*1e9);
+	else if(t < 1e-3)	printf("%7.2f us", t*1e6);
+	else if(t < 1)		printf("%7.2f ms", t*1e3);
+	else				printf("%7.3f s ", t);
+}
+
+static void printRate(double r){
+	if(r >= 1e9)		printf("%7.2f G", r*1e-9);
+	else if(r >= 1e6)	printf("%7.2f M", r*1e-6);
+	else if(r >= 1e3)	printf("%7.2f k", r*1e-3);
+	else				printf("%7.2f  ", r);
+}
+
+void Benchmarks::print(const BenchmarkResult& r){
+	printf("%-44s %5u reps  median ", r.name.c_str(), r.reps);
+	printTime(r.median);
+	printf("  p99 ");
+	printTime(r.p99);
+	printf("  ");
+	printRate(r.itemsPerSec());
+	printf("items/s\n");
+	fflush(stdout);
+}
+
+void Benchmarks::writeJSON(FILE * fp) const {
+	fprintf(fp, "{\n\"benchmarks\": [\n");
+	for(unsigned i=0; i<mResults.size(); ++i){
+		const BenchmarkResult& r = mResults[i];
+		// One benchmark per line, so results can be compared with readJSON
+		fprintf(fp,
+			"{\"name\": \"%s\", \"items\": %.17g, \"reps\": %u, \"median\": %.9g,"
+			" \"p99\": %.9g, \"mean\": %.9g, \"min\": %.9g, \"items_per_sec\": %.9g}%s\n",
+			r.name.c_str(), r.items, r.reps, r.median,
+			r.p99, r.mean, r.min, r.itemsPerSec(),
+			i+1 < mResults.size() ? "," : ""
+		);
+	}
+	fprintf(fp, "]\n}\n");
+}
+
+static bool readNumber(const char * line, const char * key, double& v){
+	std::string k = std::string("\"") + key + "\":";
+	const char * p = strstr(line, k.c_str());
+	if(!p) return false;
+	v = strtod(p + k.size(), NULL);
+	return true;
+}
+
+bool Benchmarks::readJSON(const char * path, std::vector<BenchmarkResult>& results){
+	FILE * fp = fopen(path, "r");
+	if(!fp) return false;
+	char line[4096];
+	while(fgets(line, sizeof(line), fp)){
+		const char * name = strstr(line, "\"name\": \"");
+		if(!name) continue;
+		name += 9;
+		const char * end = strchr(name, '"');
+		if(!end) continue;
+		BenchmarkResult r;
+		r.name.assign(name, end);
+		double reps = 0;
+		if(readNumber(line, "items", r.items) && readNumber(line, "reps", reps)
+			&& readNumber(line, "median", r.median) && readNumber(line, "p99", r.p99)
+			&& readNumber(line, "mean", r.mean) && readNumber(line, "min", r.min)
+		){
+			r.reps = reps;
+			results.push_back(r);
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+static int compare(const char * basePath, const char * newPath, double threshold){
+	std::vector<BenchmarkResult> base, curr;
+	if(!Benchmarks::readJSON(basePath, base)){
+		fprintf(stderr, "Could not read %s\n", basePath);
+		return 2;
+	}
+	if(!Benchmarks::readJSON(newPath, curr)){
+		fprintf(stderr, "Could not read %s\n", newPath);
+		return 2;
+	}
+
+	int regressions = 0;
+	printf("%-44s %10s %10s %8s\n", "benchmark", "base", "new", "change");
+	for(unsigned i=0; i<curr.size(); ++i){
+		const BenchmarkResult * b = NULL;
+		for(unsigned j=0; j<base.size(); ++j){
+			if(base[j].name == curr[i].name){ b = &base[j]; break; }
+		}
+		if(!b){
+			printf("%-44s %10s ", curr[i].name.c_str(), "-");
+			printTime(curr[i].median);
+			printf("      new\n");
+			continue;
+		}
+		// Time per item, in case the sizes of a benchmark changed
+		double tb = b->median / b->items;
+		double tc = curr[i].median / curr[i].items;
+		double change = (tc / tb - 1.) * 100.;
+		const char * flag = "";
+		if(change > threshold){ flag = "  slower"; ++regressions; }
+		else if(change < -threshold) flag = "  faster";
+		printf("%-44s ", curr[i].name.c_str());
+		printTime(b->median);
+		printf(" ");
+		printTime(curr[i].median);
+		printf(" %+7.1f%%%s\n", change, flag);
+	}
+	for(unsigned j=0; j<base.size(); ++j){
+		bool found = false;
+		for(unsigned i=0; i<curr.size(); ++i) found |= base[j].name == curr[i].name;
+		if(!found) printf("%-44s %10s %10s  removed\n", base[j].name.c_str(), "", "-");
+	}
+	printf("%d of %u benchmarks slower by more than %g%%\n",
+		regressions, (unsigned)curr.size(), threshold);
+	return regressions ? 1 : 0;
+}
+
+static void usage(){
+	printf(
+		"usage: allocoreBenchmarks [--filter str] [--warmup n] [--reps n]"
+		" [--max-reps n] [--min-time sec] [--json file]\n"
+		"       allocoreBenchmarks --compare base.json new.json [--threshold percent]\n"
+	);
+}
+
+int main(int argc, char * argv[]){
+	Benchmarks b;
+	const char * jsonPath = NULL;
+	const char * comparePaths[2] = {NULL, NULL};
+	double threshold = 5;
+
+	for(int i=1; i<argc; ++i){
+		std::string arg = argv[i];
+		bool hasValue = i+1 < argc;
+		if(arg == "--filter" && hasValue)			b.filter = argv[++i];
+		else if(arg == "--warmup" && hasValue)		b.warmup = atoi(argv[++i]);
+		else if(arg == "--reps" && hasValue)		b.minReps = atoi(argv[++i]);
+		else if(arg == "--max-reps" && hasValue)	b.maxReps = atoi(argv[++i]);
+		else if(arg == "--min-time" && hasValue)	b.minTime = atof(argv[++i]);
+		else if(arg == "--json" && hasValue)		jsonPath = argv[++i];
+		else if(arg == "--threshold" && hasValue)	threshold = atof(argv[++i]);
+		else if(arg == "--compare" && i+2 < argc){
+			comparePaths[0] = argv[++i];
+			comparePaths[1] = argv[++i];
+		}
+		else{
+			usage();
+			return 2;
+		}
+	}
+
+	if(comparePaths[0]) return compare(comparePaths[0], comparePaths[1], threshold);
+
+	if(b.minReps < 1) b.minReps = 1;
+	if(b.maxReps < b.minReps) b.maxReps = b.minReps;
+
+	bmAudioScene(b);
+	bmSpatial(b);
+	bmGraphics(b);
+	bmField3D(b);
+	bmProtocol(b);
+	bmSystem(b);
+
+	if(jsonPath){
+		FILE * fp = fopen(jsonPath, "w");
+		if(!fp){
+			fprintf(stderr, "Could not write %s\n", jsonPath);
+			return 2;
+		}
+		b.writeJSON(fp);
+		fclose(fp);
+	}
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Cold versus warm import of a Scene through the binary mesh cache.
+ *
+ * Writes a large grid as an OBJ file, then reports the time to import it
+ * with the cache disabled, with an empty cache (import plus cache write) and
+ * with a warm cache, together with the time to flatten every mesh.
+ */
+
+#include <stdio.h>
+#include <string>
+
+#include "allocore/graphics/al_Asset.hpp"
+#include "allocore/graphics/al_Mesh.hpp"
+#include "allocore/system/al_Time.hpp"
+
+using namespace al;
+
+static void writeGrid(const std::string& path, int N, int meshes){
+	FILE * fp = fopen(path.c_str(), "w");
+	int base = 1;
+	for(int m=0; m<meshes; ++m){
+		fprintf(fp, "o grid%d\n", m);
+		for(int j=0; j<N; ++j){
+		for(int i=0; i<N; ++i){
+			fprintf(fp, "v %f %f %f\n", float(i)/N, float(j)/N, float(m));
+			fprintf(fp, "vt %f %f\n", float(i)/N, float(j)/N);
+		}}
+		for(int j=0; j<N-1; ++j){
+		for(int i=0; i<N-1; ++i){
+			int a = base + j*N + i, b = a+1, c = a+N, d = c+1;
+			fprintf(fp, "f %d/%d %d/%d %d/%d\n", a,a, b,b, d,d);
+			fprintf(fp, "f %d/%d %d/%d %d/%d\n", a,a, d,d, c,c);
+		}}
+		base += N*N;
+	}
+	fclose(fp);
+}
+
+static double timeImport(const std::string& path, bool cache, bool * cached){
+	Scene::cache(cache);
+	al_sec t0 = al_steady_time();
+	Scene * scene = Scene::import(path);
+	double t = al_steady_time() - t0;
+	if(cached) *cached = scene && scene->cached();
+	delete scene;
+	return t;
+}
+
+static double timeFlatten(const std::string& path){
+	Scene * scene = Scene::import(path);
+	al_sec t0 = al_steady_time();
+	Mesh mesh;
+	for(unsigned i=0; i<scene->meshes(); ++i){
+		scene->mesh(i, mesh);
+	}
+	double t = al_steady_time() - t0;
+	delete scene;
+	return t;
+}
+
+int main(){
+	const std::string path = "assetCacheBenchmark.obj";
+	int sizes[] = {128, 512};
+	for(int s=0; s<2; ++s){
+		int N = sizes[s], meshes = 8;
+		writeGrid(path, N, meshes);
+		remove(Scene::cachePath(path).c_str());
+
+		bool cold, warm;
+		double tOff = timeImport(path, false, 0);
+		double tCold = timeImport(path, true, &cold);
+		double tWarm = timeImport(path, true, &warm);
+		double tFlat = timeFlatten(path);
+
+		printf("%d meshes x %7d vertices: no cache %8.2f ms  cold %8.2f ms"
+			"  warm %8.2f ms%s  (%.1fx)  flatten %7.2f ms\n",
+			meshes, N*N, tOff*1e3, tCold*1e3, tWarm*1e3,
+			(!cold && warm) ? "" : " [cache not used]",
+			tOff / tWarm, tFlat*1e3
+		);
+	}
+	remove(Scene::cachePath(path).c_str());
+	remove(path.c_str());
+	return 0;
+}
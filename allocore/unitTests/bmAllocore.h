@@ -0,0 +1,127 @@
+#ifndef BM_ALLOCORE_H
+#define BM_ALLOCORE_H
+
+/*
+ * Microbenchmark framework for allocore hot paths.
+ *
+ * A benchmark is a function that performs one repetition of some work and
+ * the number of items (samples, objects, cells, ...) processed by it. Each
+ * benchmark is repeated after a few warm-up repetitions until both a minimum
+ * number of repetitions and a minimum time have been reached, and the time
+ * of every repetition is kept to report the median and 99th percentile.
+ */
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "allocore/system/al_Time.hpp"
+
+using namespace al;
+
+/// Timing statistics of a benchmark
+struct BenchmarkResult{
+	std::string name;
+	double items;		///< Items processed per repetition
+	unsigned reps;		///< Number of timed repetitions
+	double median;		///< Median time of a repetition, in seconds
+	double p99;			///< 99th percentile time of a repetition, in seconds
+	double mean;		///< Mean time of a repetition, in seconds
+	double min;			///< Minimum time of a repetition, in seconds
+
+	/// Items processed per second, from the median time
+	double itemsPerSec() const { return median > 0 ? items / median : 0; }
+};
+
+
+/// Runs benchmarks and collects their results
+class Benchmarks{
+public:
+
+	Benchmarks()
+	:	warmup(3), minReps(10), maxReps(1000), minTime(0.5)
+	{}
+
+	unsigned warmup;	///< Number of untimed repetitions
+	unsigned minReps;	///< Minimum number of timed repetitions
+	unsigned maxReps;	///< Maximum number of timed repetitions
+	double minTime;		///< Minimum total time of timed repetitions, in seconds
+	std::string filter;	///< Only run benchmarks whose name contains this
+
+	/// Whether a benchmark passes the filter
+
+	/// Use this to skip expensive setup of benchmarks that will not run.
+	bool enabled(const std::string& name) const {
+		return filter.empty() || name.find(filter) != std::string::npos;
+	}
+
+	/// Time a benchmark
+
+	/// @param[in] name		unique name of the benchmark
+	/// @param[in] items	number of items processed per repetition
+	/// @param[in] func		function object performing one repetition
+	template <class Func>
+	void run(const std::string& name, double items, Func func){
+		if(!enabled(name)) return;
+
+		for(unsigned i=0; i<warmup; ++i) func();
+
+		std::vector<double> times;
+		double total = 0;
+		while(times.size() < maxReps && (times.size() < minReps || total < minTime)){
+			al_sec t0 = al_steady_time();
+			func();
+			double t = al_steady_time() - t0;
+			times.push_back(t);
+			total += t;
+		}
+
+		std::sort(times.begin(), times.end());
+		BenchmarkResult r;
+		r.name = name;
+		r.items = items;
+		r.reps = times.size();
+		r.median = times.size() & 1 ? times[times.size()/2]
+			: 0.5 * (times[times.size()/2 - 1] + times[times.size()/2]);
+		r.p99 = times[(times.size() * 99 + 99) / 100 - 1];
+		r.mean = total / times.size();
+		r.min = times[0];
+		mResults.push_back(r);
+		print(r);
+	}
+
+	/// Get results of all benchmarks run so far
+	const std::vector<BenchmarkResult>& results() const { return mResults; }
+
+	/// Print a result on one line
+	static void print(const BenchmarkResult& r);
+
+	/// Write results as JSON
+	void writeJSON(FILE * fp) const;
+
+	/// Read results written by writeJSON
+	static bool readJSON(const char * path, std::vector<BenchmarkResult>& results);
+
+private:
+	std::vector<BenchmarkResult> mResults;
+};
+
+
+extern volatile char benchmarkSink;
+
+/// Keep the optimizer from removing a computation whose result is unused
+template <class T>
+inline void benchmarkUse(const T& v){
+	benchmarkSink = *(const volatile char *)&v;
+}
+
+
+void bmAudioScene(Benchmarks& b);
+void bmField3D(Benchmarks& b);
+void bmGraphics(Benchmarks& b);
+void bmProtocol(Benchmarks& b);
+void bmSpatial(Benchmarks& b);
+void bmSystem(Benchmarks& b);
+
+#endif
@@ -0,0 +1,270 @@
+#include "bmAllocore.h"
+#include "allocore/io/al_AudioIO.hpp"
+#include "allocore/math/al_Random.hpp"
+#include "allocore/sound/al_AudioScene.hpp"
+#include "allocore/sound/al_Dbap.hpp"
+#include "allocore/sound/al_FDNReverb.hpp"
+#include "allocore/sound/al_Reverb.hpp"
+#include "allocore/sound/al_Vbap.hpp"
+
+namespace{
+
+const int numSources = 512;
+const int numFrames = 512;
+
+// 54 speakers in three rings, as in the AlloSphere
+struct DomeSpeakerLayout : public SpeakerLayout{
+	DomeSpeakerLayout(){
+		int chan = 0;
+		for(int i=0; i<12; ++i) addSpeaker(Speaker(chan++, 360./12*i, 41));
+		for(int i=0; i<30; ++i) addSpeaker(Speaker(chan++, 360./30*i, 0));
+		for(int i=0; i<12; ++i) addSpeaker(Speaker(chan++, 360./12*i, -32.5));
+	}
+};
+
+// Speakers spread evenly over a sphere, on a Fibonacci spiral
+struct SphereSpeakerLayout : public SpeakerLayout{
+	SphereSpeakerLayout(int num){
+		for(int i=0; i<num; ++i){
+			double el = asin(1. - 2.*(i+0.5)/num) * 180./M_PI;
+			double az = fmod(i * 137.50776405, 360.);
+			addSpeaker(Speaker(i, az, el));
+		}
+	}
+};
+
+void renderScene(Benchmarks& b, const std::string& name, AudioScene& scene, int numSpeakers, DopplerType doppler = DOPPLER_SYMMETRICAL){
+	if(!b.enabled(name)) return;
+	AudioIO io(numFrames, 44100, NULL, NULL, numSpeakers, 0, AudioIOData::OFFLINE);
+
+	std::vector<SoundSource *> sources;
+	for(int i=0; i<numSources; ++i){
+		SoundSource * src = new SoundSource(0.1, 20, ATTEN_INVERSE, doppler, 0, 8192);
+		Vec3d p = rnd::ball<Vec3d>() * 10.;
+		src->pos(p.x, p.y, p.z);
+		scene.addSource(*src);
+		sources.push_back(src);
+	}
+
+	b.run(name, double(numSources) * numFrames, [&](){
+		for(int i=0; i<numSources; ++i){
+			for(int j=0; j<numFrames; ++j) sources[i]->writeSample(rnd::uniformS());
+		}
+		scene.render(io);
+		benchmarkUse(io.out(0, 0));
+	});
+
+	for(int i=0; i<numSources; ++i){
+		scene.removeSource(*sources[i]);
+		delete sources[i];
+	}
+}
+
+// Reads a block from a delay line per sample and per block
+void readDelay(Benchmarks& b){
+	const int reps = 256;
+	SoundSource src(0.1, 20, ATTEN_INVERSE, DOPPLER_SYMMETRICAL, 0, 8192);
+	for(int i=0; i<src.delaySize(); ++i) src.writeSample(rnd::uniformS());
+	std::vector<float> block(numFrames);
+
+	b.run("SoundSource::readSample/512", double(reps) * numFrames, [&](){
+		for(int k=0; k<reps; ++k){
+			double delay = 100.25 + k;
+			for(int i=0; i<numFrames; ++i) block[i] = src.readSample(delay + (numFrames-1-i));
+			src.writeSample(block[0]);
+			benchmarkUse(block[numFrames-1]);
+		}
+	});
+
+	b.run("SoundSource::readBlock/512", double(reps) * numFrames, [&](){
+		for(int k=0; k<reps; ++k){
+			src.readBlock(&block[0], numFrames, 100.25 + k);
+			src.writeSample(block[0]);
+			benchmarkUse(block[numFrames-1]);
+		}
+	});
+
+	b.run("SoundSource::readBlock/512 ramp", double(reps) * numFrames, [&](){
+		for(int k=0; k<reps; ++k){
+			src.readBlock(&block[0], numFrames, 100.25 + k, 130.6 + k);
+			src.writeSample(block[0]);
+			benchmarkUse(block[numFrames-1]);
+		}
+	});
+}
+
+// Renders many sources as SoundSources and as a SoundSourceArray
+void renderManySources(Benchmarks& b, Spatializer& spatializer, int numSpeakers){
+	const int num = 1024;
+	const int delaySize = 8192;
+	const std::string listName = "AudioScene::render/dbap 1ksrc list";
+	const std::string arrayName = "AudioScene::render/dbap 1ksrc array";
+	std::vector<Vec3d> positions(num);
+	for(int i=0; i<num; ++i) positions[i] = rnd::ball<Vec3d>() * 10.;
+	std::vector<float> samples(numFrames);
+	for(int i=0; i<numFrames; ++i) samples[i] = rnd::uniformS();
+	AudioIO io(numFrames, 44100, NULL, NULL, numSpeakers, 0, AudioIOData::OFFLINE);
+
+	if(b.enabled(listName)){
+		AudioScene scene(numFrames);
+		scene.createListener(&spatializer);
+		std::vector<SoundSource *> sources;
+		for(int i=0; i<num; ++i){
+			SoundSource * src = new SoundSource(0.1, 20, ATTEN_INVERSE, DOPPLER_SYMMETRICAL, 0, delaySize);
+			src->pos(positions[i].x, positions[i].y, positions[i].z);
+			scene.addSource(*src);
+			sources.push_back(src);
+		}
+		printf("%-48s %8.1f MB\n", (listName + " memory").c_str(),
+			num * (sizeof(SoundSource) + delaySize*sizeof(float)) / 1e6);
+
+		b.run(listName, double(num) * numFrames, [&](){
+			for(int i=0; i<num; ++i){
+				for(int j=0; j<numFrames; ++j) sources[i]->writeSample(samples[j]);
+			}
+			scene.render(io);
+			benchmarkUse(io.out(0, 0));
+		});
+
+		for(int i=0; i<num; ++i) delete sources[i];
+	}
+
+	if(b.enabled(arrayName)){
+		AudioScene scene(numFrames);
+		scene.createListener(&spatializer);
+		SoundSourceArray srcs(num, delaySize);
+		std::vector<int> ids(num);
+		for(int i=0; i<num; ++i){
+			ids[i] = srcs.add(0.1, 20, ATTEN_INVERSE, DOPPLER_SYMMETRICAL);
+			srcs.pos(ids[i], positions[i].x, positions[i].y, positions[i].z);
+		}
+		scene.addSources(srcs);
+		printf("%-48s %8.1f MB\n", (arrayName + " memory").c_str(), srcs.memoryUsage() / 1e6);
+
+		b.run(arrayName, double(num) * numFrames, [&](){
+			for(int i=0; i<num; ++i) srcs.writeSamples(ids[i], &samples[0], numFrames);
+			scene.render(io);
+			benchmarkUse(io.out(0, 0));
+		});
+	}
+}
+
+// Reverb of a mono bus to every speaker. Items are output samples, so the
+// rates compare the cost per channel.
+void reverb(Benchmarks& b, int numSpeakers){
+	AudioIO io(numFrames, 44100, NULL, NULL, numSpeakers, 0, AudioIOData::OFFLINE);
+	std::vector<float> in(numFrames);
+	for(int i=0; i<numFrames; ++i) in[i] = rnd::uniformS();
+	char name[64];
+
+	// The plate reverb is stereo, so it takes one instance per two speakers
+	snprintf(name, sizeof name, "Reverb/%dch", numSpeakers);
+	if(b.enabled(name)){
+		std::vector<Reverb<float> > reverbs((numSpeakers + 1) / 2);
+		b.run(name, double(numSpeakers) * numFrames, [&](){
+			io.zeroOut();
+			for(unsigned r=0; r<reverbs.size(); ++r){
+				float * out1 = io.outBuffer(2*r);
+				float * out2 = io.outBuffer(2*r + 1 < unsigned(numSpeakers) ? 2*r + 1 : 2*r);
+				for(int i=0; i<numFrames; ++i){
+					float s1, s2;
+					reverbs[r](in[i], s1, s2);
+					out1[i] += s1;
+					out2[i] += s2;
+				}
+			}
+			benchmarkUse(io.out(0, numFrames-1));
+		});
+	}
+
+	for(int lines = 8; lines <= 32; lines *= 2){
+		snprintf(name, sizeof name, "FDNReverb/%dch %d lines", numSpeakers, lines);
+		if(!b.enabled(name)) continue;
+		FDNReverb fdn(lines, numSpeakers);
+		b.run(name, double(numSpeakers) * numFrames, [&](){
+			io.zeroOut();
+			fdn.process(io, &in[0]);
+			benchmarkUse(io.out(0, numFrames-1));
+		});
+	}
+}
+
+} // ::
+
+void bmAudioScene(Benchmarks& b){
+	DomeSpeakerLayout layout;
+
+	const std::string vbapRender = "AudioScene::render/vbap 512src 54spk";
+	const std::string vbapPerform = "Vbap::perform/512src 54spk";
+	if(b.enabled(vbapRender) || b.enabled(vbapPerform)){
+		Vbap vbap(layout);
+		AudioScene scene(numFrames);
+		scene.createListener(&vbap);
+
+		renderScene(b, vbapRender, scene, layout.numSpeakers());
+
+		// Vbap alone, with the sources already read into a buffer
+		if(b.enabled(vbapPerform)){
+			AudioIO io(numFrames, 44100, NULL, NULL, layout.numSpeakers(), 0, AudioIOData::OFFLINE);
+			SoundSource src;
+			std::vector<Vec3d> positions(numSources);
+			std::vector<float> samples(numFrames);
+			for(int i=0; i<numSources; ++i) positions[i] = rnd::ball<Vec3d>() * 10.;
+			for(int i=0; i<numFrames; ++i) samples[i] = rnd::uniformS();
+
+			b.run(vbapPerform, double(numSources) * numFrames, [&](){
+				io.zeroOut();
+				for(int i=0; i<numSources; ++i){
+					vbap.perform(io, src, positions[i], numFrames, &samples[0]);
+				}
+				benchmarkUse(io.out(0, 0));
+			});
+		}
+	}
+
+	// Finding the speaker triplets of a layout
+	for(int num = 54; num <= 4096; num *= 4){
+		char name[64];
+		snprintf(name, sizeof name, "Vbap::compile/%dspk", num);
+		if(!b.enabled(name)) continue;
+		SphereSpeakerLayout sphere(num);
+		b.run(name, num, [&](){
+			Vbap vbap(num == 54 ? (const SpeakerLayout&)layout : sphere);
+			AudioScene scene(numFrames);
+			scene.createListener(&vbap);	// compiles
+		});
+	}
+
+	const std::string dbapRender = "AudioScene::render/dbap 512src 54spk";
+	if(b.enabled(dbapRender)){
+		Dbap dbap(layout);
+		AudioScene scene(numFrames);
+		scene.createListener(&dbap);
+		renderScene(b, dbapRender, scene, layout.numSpeakers());
+	}
+
+	// Several listening positions, each with its own spatializer
+	const std::string listenersRender = "AudioScene::render/dbap 512src 4lis";
+	const std::string listenersNoDoppler = "AudioScene::render/dbap 512src 4lis no doppler";
+	if(b.enabled(listenersRender) || b.enabled(listenersNoDoppler)){
+		std::vector<Dbap *> dbaps;
+		AudioScene scene(numFrames);
+		for(int i=0; i<4; ++i){
+			dbaps.push_back(new Dbap(layout));
+			scene.createListener(dbaps[i])->pos(i, 0, 0);
+		}
+		renderScene(b, listenersRender, scene, layout.numSpeakers());
+		renderScene(b, listenersNoDoppler, scene, layout.numSpeakers(), DOPPLER_NONE);
+		for(int i=0; i<4; ++i) delete dbaps[i];
+	}
+
+	readDelay(b);
+
+	reverb(b, 2);
+	reverb(b, layout.numSpeakers());
+
+	if(b.enabled("AudioScene::render/dbap 1ksrc")){
+		Dbap dbap(layout);
+		renderManySources(b, dbap, layout.numSpeakers());
+	}
+}
@@ -0,0 +1,20 @@
+#include "bmAllocore.h"
+#include "alloutil/al_Field3D.hpp"
+
+void bmField3D(Benchmarks& b){
+	const int N = 128;
+	const unsigned passes = 14;
+
+	const std::string name = "Field3D::diffuse/128^3 14 passes";
+	if(!b.enabled(name)) return;
+
+	Field3D<float> field(1, N, N, N);
+	float * data = field.ptr();
+	for(int i=0; i<N*N*N; ++i) data[i] = rnd::uniform();
+
+	// Items are cell updates
+	b.run(name, double(N)*N*N*passes, [&](){
+		field.diffuse(0.01f, passes);
+		benchmarkUse(field.ptr()[0]);
+	});
+}
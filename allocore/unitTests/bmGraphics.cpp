@@ -0,0 +1,109 @@
+#include "bmAllocore.h"
+#include "allocore/graphics/al_Graphics.hpp"
+#include "allocore/graphics/al_Isosurface.hpp"
+#include "allocore/graphics/al_Mesh.hpp"
+#include "allocore/math/al_Random.hpp"
+#include "allocore/system/al_ThreadPool.hpp"
+#include "allocore/types/al_ColorArray.hpp"
+
+void bmGraphics(Benchmarks& b){
+
+	// A 256x256 grid of triangles without indices, so every vertex is shared
+	// by up to six triangles
+	if(b.enabled("Mesh::compress")){
+		const int N = 256;
+		Mesh grid;
+		grid.primitive(Graphics::TRIANGLES);
+		for(int j=0; j<N; ++j){
+		for(int i=0; i<N; ++i){
+			Vec3f a(i, j, 0), b(i+1, j, 0), c(i, j+1, 0), d(i+1, j+1, 0);
+			grid.vertex(a); grid.vertex(b); grid.vertex(d);
+			grid.vertex(a); grid.vertex(d); grid.vertex(c);
+		}}
+
+		Mesh mesh;
+		b.run("Mesh::compress/256x256 grid", grid.vertices().size(), [&](){
+			mesh = grid;
+			mesh.compress();
+			benchmarkUse(mesh.indices().size());
+		});
+	}
+
+	// Blobs in a 128^3 field
+	if(b.enabled("Isosurface::generate")){
+		const int N = 128;
+		std::vector<float> field(N*N*N);
+		Vec3f blobs[8];
+		for(int i=0; i<8; ++i) blobs[i] = (rnd::ball<Vec3f>() + 1.f) * (N/2);
+		for(int k=0; k<N; ++k){
+		for(int j=0; j<N; ++j){
+		for(int i=0; i<N; ++i){
+			float v = 0;
+			for(int n=0; n<8; ++n){
+				v += 100.f / (1.f + (Vec3f(i,j,k) - blobs[n]).magSqr());
+			}
+			field[(k*N + j)*N + i] = v;
+		}}}
+
+		Isosurface iso(1.f);
+		b.run("Isosurface::generate/128^3", double(N-1)*(N-1)*(N-1), [&](){
+			iso.generate(&field[0], N, 1.f/N);
+			benchmarkUse(iso.vertices().size());
+		});
+	}
+
+	// Colors of a 512x512 image, one at a time and as an array
+	if(b.enabled("color")){
+		const int N = 512*512;
+		std::vector<RGB> rgb(N), rgb2(N);
+		for(int i=0; i<N; ++i) rgb[i].set(rnd::uniform(), rnd::uniform(), rnd::uniform());
+		std::vector<HSV> hsv(N);
+		std::vector<Lab> lab(N);
+
+		b.run("color/HSV(RGB)", N, [&](){
+			for(int i=0; i<N; ++i) hsv[i] = rgb[i];
+			benchmarkUse(hsv[N/2].h);
+		});
+		b.run("color/rgbToHSV", N, [&](){
+			convert(&rgb[0], &hsv[0], N);
+			benchmarkUse(hsv[N/2].h);
+		});
+		b.run("color/RGB(HSV)", N, [&](){
+			for(int i=0; i<N; ++i) rgb2[i] = hsv[i];
+			benchmarkUse(rgb2[N/2].r);
+		});
+		b.run("color/hsvToRGB", N, [&](){
+			convert(&hsv[0], &rgb2[0], N);
+			benchmarkUse(rgb2[N/2].r);
+		});
+		b.run("color/Lab(CIEXYZ(RGB))", N, [&](){
+			for(int i=0; i<N; ++i) lab[i] = CIEXYZ(rgb[i]);
+			benchmarkUse(lab[N/2].l);
+		});
+		b.run("color/rgbToLab", N, [&](){
+			convert(&rgb[0], &lab[0], N);
+			benchmarkUse(lab[N/2].l);
+		});
+		b.run("color/rgbToLab, pool", N, [&](){
+			convert(&rgb[0], &lab[0], N, &ThreadPool::get());
+			benchmarkUse(lab[N/2].l);
+		});
+		b.run("color/RGB(Lab)", N, [&](){
+			for(int i=0; i<N; ++i) rgb2[i] = lab[i];
+			benchmarkUse(rgb2[N/2].r);
+		});
+		b.run("color/labToRGB", N, [&](){
+			convert(&lab[0], &rgb2[0], N);
+			benchmarkUse(rgb2[N/2].r);
+		});
+
+		Color table[5] = { Color(0,0,0), Color(0.5,0,0.5), Color(1,0,0), Color(1,1,0), Color(1) };
+		std::vector<float> values(N);
+		for(int i=0; i<N; ++i) values[i] = rnd::uniform();
+		std::vector<Colori> pixels(N);
+		b.run("color/colormap to Colori", N, [&](){
+			colormap(&values[0], &pixels[0], N, table, 5);
+			benchmarkUse(pixels[N/2].rgba);
+		});
+	}
+}
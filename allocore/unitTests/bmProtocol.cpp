@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include "bmAllocore.h"
+#include "allocore/math/al_Random.hpp"
+#include "allocore/protocol/al_OSC.hpp"
+#include "allocore/protocol/al_Serialize.hpp"
+#include "allocore/protocol/al_StateReplication.hpp"
+
+namespace{
+
+struct PosHandler : public osc::PacketHandler{
+	float sum;
+	PosHandler(): sum(0){}
+	void onMessage(osc::Message& m){
+		if(m.typeTags() == "fff"){
+			float x,y,z;
+			m >> x >> y >> z;
+			sum += x + y + z;
+		}
+	}
+};
+
+} // ::
+
+void bmProtocol(Benchmarks& b){
+
+	// OSC bundle of source positions, as sent by a controller every frame
+	{
+		const int numMessages = 64;
+		char addr[32];
+		osc::Packet packet(8192);
+		b.run("osc::Packet/bundle 64 msgs", numMessages, [&](){
+			packet.clear();
+			packet.beginBundle();
+			for(int i=0; i<numMessages; ++i){
+				snprintf(addr, sizeof(addr), "/source/%d/pos", i);
+				packet.addMessage(addr, float(i), 0.5f, -0.5f);
+			}
+			packet.endBundle();
+			benchmarkUse(packet.size());
+		});
+
+		PosHandler handler;
+		b.run("osc::PacketHandler::parse/bundle 64 msgs", numMessages, [&](){
+			handler.parse(packet.data(), packet.size());
+			benchmarkUse(handler.sum);
+		});
+	}
+
+	// Serialization of scalars one at a time and of arrays
+	{
+		const int N = 1000;
+		std::vector<float> values(N);
+		for(int i=0; i<N; ++i) values[i] = rnd::uniform();
+
+		b.run("Serializer/1000 floats", N, [&](){
+			Serializer s;
+			for(int i=0; i<N; ++i) s << values[i];
+			benchmarkUse(s.buf().size());
+		});
+
+		Serializer s;
+		for(int i=0; i<N; ++i) s << values[i];
+		b.run("Deserializer/1000 floats", N, [&](){
+			Deserializer d(s.buf());
+			float v, sum = 0;
+			for(int i=0; i<N; ++i){ d >> v; sum += v; }
+			benchmarkUse(sum);
+		});
+
+		// Reusing memory, as when serializing every frame
+		std::vector<char> mem(N * (serHeaderSize() + sizeof(float)));
+		b.run("Serializer external/1000 floats", N, [&](){
+			Serializer s(&mem[0], mem.size());
+			for(int i=0; i<N; ++i) s << values[i];
+			benchmarkUse(s.size());
+		});
+
+		const int M = 1<<16;
+		std::vector<float> array(M, 0.5f);
+		b.run("Serializer::add/64k floats", M, [&](){
+			Serializer s;
+			s.add(&array[0], M);
+			benchmarkUse(s.buf().size());
+		});
+
+		Serializer reused;
+		b.run("Serializer::add reused/64k floats", M, [&](){
+			reused.clear();
+			reused.add(&array[0], M);
+			benchmarkUse(reused.size());
+		});
+
+		std::vector<float> decoded(M);
+		b.run("Deserializer::get/64k floats", M, [&](){
+			Deserializer d(reused.buf());
+			benchmarkUse(d.get(&decoded[0], M));
+		});
+	}
+
+	// Encoding of a 1 MB state in which 1% of the values change every frame.
+	// Datagrams are sent to the loopback interface without a receiver.
+	{
+		const std::string name = "StateSender::send/1MB 1% changed";
+		if(b.enabled(name)){
+			const size_t stateSize = 1<<20;
+			std::vector<float> state(stateSize / sizeof(float), 0.f);
+			StateSender sender(stateSize, 4140, "127.0.0.1");
+			b.run(name, stateSize, [&](){
+				for(size_t i=rnd::uniform(100); i<state.size(); i+=100){
+					state[i] += 1.f;
+				}
+				sender.send(&state[0]);
+			});
+		}
+	}
+}
@@ -0,0 +1,175 @@
+#include "bmAllocore.h"
+#include "allocore/math/al_Random.hpp"
+#include "allocore/spatial/al_HashSpace.hpp"
+#include "allocore/spatial/al_Pose.hpp"
+#include "alloutil/al_VoxelStack.hpp"
+
+namespace{
+
+struct Agent{ Vec3d pos; };
+
+struct AgentPos{
+	const Vec3d& operator()(const Agent& a) const { return a.pos; }
+};
+
+// Stack agents in a 64^3 grid one at a time and with a rebuild
+void voxelStack(Benchmarks& b, int numAgents, const char * suffix){
+	std::vector<Agent> agents(numAgents);
+	for(int i=0; i<numAgents; ++i){
+		agents[i].pos = Vec3d(rnd::uniform(64.), rnd::uniform(64.), rnd::uniform(64.));
+	}
+
+	VoxelStack<Agent> voxels(64);
+	const int numVoxels = 64*64*64;
+
+	b.run(std::string("VoxelStack::set/") + suffix, numAgents, [&](){
+		voxels.clear();
+		for(int i=0; i<numAgents; ++i) voxels.set(agents[i].pos, &agents[i]);
+		benchmarkUse(voxels.at(0));
+	});
+
+	b.run(std::string("VoxelStack::rebuild/") + suffix, numAgents, [&](){
+		voxels.rebuild(&agents[0], numAgents, AgentPos());
+		benchmarkUse(voxels.at(0));
+	});
+
+	b.run(std::string("VoxelStack::rebuild parallel/") + suffix, numAgents, [&](){
+		voxels.rebuild(&agents[0], numAgents, AgentPos(), &ThreadPool::get());
+		benchmarkUse(voxels.at(0));
+	});
+
+	// Queries of the rebuilt layout, then of stacks filled with set()
+	b.run(std::string("VoxelStack::at rebuilt/") + suffix, numVoxels, [&](){
+		int found = 0;
+		for(int i=0; i<numVoxels; ++i) found += voxels.at(i) != NULL;
+		benchmarkUse(found);
+	});
+
+	voxels.clear();
+	for(int i=0; i<numAgents; ++i) voxels.set(agents[i].pos, &agents[i]);
+
+	b.run(std::string("VoxelStack::at stacked/") + suffix, numVoxels, [&](){
+		int found = 0;
+		for(int i=0; i<numVoxels; ++i) found += voxels.at(i) != NULL;
+		benchmarkUse(found);
+	});
+}
+
+// Transform 10k vectors and poses one at a time and in batches
+void quatBatch(Benchmarks& b){
+	const int N = 10000;
+	QuatArray<double> qa(N), qb(N), qr(N);
+	Vec3Array<double> va(N), vr(N);
+	PoseArray pa(N), pb(N), pr(N);
+	std::vector<Quatd> qs(N), qt(N), qo(N);
+	std::vector<Vec3d> vs(N), vo(N);
+	std::vector<Pose> ps(N), pt(N), po(N);
+	for(int i=0; i<N; ++i){
+		qs[i] = Quatd(rnd::uniformS(), rnd::uniformS(), rnd::uniformS(), rnd::uniformS()).normalize();
+		qt[i] = Quatd(rnd::uniformS(), rnd::uniformS(), rnd::uniformS(), rnd::uniformS()).normalize();
+		vs[i] = Vec3d(rnd::uniformS(), rnd::uniformS(), rnd::uniformS());
+		ps[i] = Pose(vs[i], qs[i]);
+		pt[i] = Pose(vs[N-1-i], qt[i]);
+		qa.set(i, qs[i]); qb.set(i, qt[i]); va.set(i, vs[i]);
+		pa.set(i, ps[i]); pb.set(i, pt[i]);
+	}
+
+	b.run("Quat::rotate/10k by one", N, [&](){
+		for(int i=0; i<N; ++i) vo[i] = qs[0].rotate(vs[i]);
+		benchmarkUse(vo[0]);
+	});
+	b.run("rotate batch/10k by one", N, [&](){
+		rotate(qs[0], va, vr);
+		benchmarkUse(vr.x()[0]);
+	});
+
+	b.run("Quat::rotate/10k by 10k", N, [&](){
+		for(int i=0; i<N; ++i) vo[i] = qs[i].rotate(vs[i]);
+		benchmarkUse(vo[0]);
+	});
+	b.run("rotate batch/10k by 10k", N, [&](){
+		rotate(qa, va, vr);
+		benchmarkUse(vr.x()[0]);
+	});
+
+	b.run("Quat::slerp/10k", N, [&](){
+		for(int i=0; i<N; ++i) qo[i] = Quatd::slerp(qs[i], qt[i], 0.3);
+		benchmarkUse(qo[0]);
+	});
+	b.run("slerp batch/10k", N, [&](){
+		slerp(qa, qb, 0.3, qr);
+		benchmarkUse(qr.w()[0]);
+	});
+
+	b.run("Pose compose/10k", N, [&](){
+		for(int i=0; i<N; ++i){
+			po[i].pos() = ps[i].pos() + ps[i].quat().rotate(pt[i].pos());
+			po[i].quat() = ps[i].quat() * pt[i].quat();
+		}
+		benchmarkUse(po[0]);
+	});
+	b.run("compose batch/10k", N, [&](){
+		compose(pa, pb, pr);
+		benchmarkUse(pr.pos().x()[0]);
+	});
+}
+
+} // ::
+
+
+void bmSpatial(Benchmarks& b){
+	const int numObjects = 100000;
+	const int numQueries = 1000;
+
+	// 100k objects in a 64^3 space, about 0.4 objects per voxel
+	HashSpace space(6, numObjects);
+	double dim = space.dim();
+	for(int i=0; i<numObjects; ++i){
+		space.move(i, rnd::uniform(dim), rnd::uniform(dim), rnd::uniform(dim));
+	}
+
+	b.run("HashSpace::move/100k", numObjects, [&](){
+		for(int i=0; i<numObjects; ++i){
+			Vec3d p = space.object(i).pos;
+			p += Vec3d(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()) * 0.5;
+			space.move(i, space.wrap(p));
+		}
+	});
+
+	std::vector<Vec3d> centers(numQueries);
+	for(int i=0; i<numQueries; ++i){
+		centers[i] = Vec3d(rnd::uniform(dim), rnd::uniform(dim), rnd::uniform(dim));
+	}
+
+	HashSpace::Query query(128);
+	b.run("HashSpace::Query/100k radius 2", numQueries, [&](){
+		int found = 0;
+		for(int i=0; i<numQueries; ++i){
+			query.clear();
+			found += query(space, centers[i], 2.);
+		}
+		benchmarkUse(found);
+	});
+
+	b.run("HashSpace::Query/100k radius 8", numQueries, [&](){
+		int found = 0;
+		for(int i=0; i<numQueries; ++i){
+			query.clear();
+			found += query(space, centers[i], 8.);
+		}
+		benchmarkUse(found);
+	});
+
+	b.run("HashSpace::Query/100k nearest", numQueries, [&](){
+		int found = 0;
+		for(int i=0; i<numQueries; ++i){
+			found += query.nearest(space, &space.object(i * (numObjects / numQueries))) != NULL;
+		}
+		benchmarkUse(found);
+	});
+
+	voxelStack(b, 100000, "100k");
+	voxelStack(b, 1000000, "1M");
+
+	quatBatch(b);
+}
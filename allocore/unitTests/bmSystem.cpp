@@ -0,0 +1,80 @@
+#include <math.h>
+#include <vector>
+#include "bmAllocore.h"
+#include "allocore/system/al_Info.hpp"
+#include "allocore/system/al_Thread.hpp"
+#include "allocore/system/al_ThreadPool.hpp"
+
+namespace{
+
+// Work of an index grows with the index, so equal slices are unbalanced
+inline double kernel(int i){
+	double v = 0;
+	for(int j=0; j<i/8; ++j) v += sin(j * 0.001 + i);
+	return v;
+}
+
+struct SliceFunc : public ThreadFunction{
+	int begin, end;
+	double * out;
+	void operator()(){
+		for(int i=begin; i<end; ++i) out[i] = kernel(i);
+	}
+};
+
+} // ::
+
+void bmSystem(Benchmarks& b){
+
+	// Unbalanced loop split into static slices vs. stolen pieces
+	{
+		const int N = 4096;
+		const int numThreads = numProcessors();
+		std::vector<double> out(N);
+
+		b.run("Threads/static slices, unbalanced", N, [&](){
+			Threads<SliceFunc> threads(numThreads);
+			for(int i=0; i<numThreads; ++i){
+				SliceFunc& f = threads.function(i);
+				f.begin = N * i / numThreads;
+				f.end = N * (i+1) / numThreads;
+				f.out = &out[0];
+			}
+			threads.start();
+			benchmarkUse(out[N-1]);
+		});
+
+		ThreadPool pool(numThreads);
+		b.run("ThreadPool::parallelFor, unbalanced", N, [&](){
+			pool.parallelFor(0, N, [&](int begin, int end){
+				for(int i=begin; i<end; ++i) out[i] = kernel(i);
+			});
+			benchmarkUse(out[N-1]);
+		});
+
+		b.run("ThreadPool::parallelReduce, unbalanced", N, [&](){
+			double sum = pool.parallelReduce(0, N, 0.,
+				[](int begin, int end){
+					double s = 0;
+					for(int i=begin; i<end; ++i) s += kernel(i);
+					return s;
+				},
+				[](double x, double y){ return x + y; }
+			);
+			benchmarkUse(sum);
+		});
+	}
+
+	// Overhead of a loop with little work per index
+	{
+		const int N = 1024;
+		std::vector<float> out(N);
+		ThreadPool& pool = ThreadPool::get();
+		b.run("ThreadPool::parallelFor, 1024 cheap items", N, [&](){
+			pool.parallelFor(0, N, [&](int begin, int end){
+				for(int i=begin; i<end; ++i) out[i] = i * 0.5f;
+			});
+			benchmarkUse(out[N-1]);
+		});
+	}
+}
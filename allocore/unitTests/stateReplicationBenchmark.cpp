@@ -0,0 +1,65 @@
+/*
+ * Throughput of StateSender/StateReceiver over the loopback interface.
+ *
+ * Streams states of a few MB in which a given fraction of the values change
+ * every frame and reports the rate at which complete states reach a
+ * receiver running on a background thread, together with the bandwidth
+ * used on the wire.
+ */
+
+#include <stdio.h>
+#include <vector>
+
+#include "allocore/math/al_Random.hpp"
+#include "allocore/protocol/al_StateReplication.hpp"
+#include "allocore/system/al_Time.hpp"
+
+using namespace al;
+
+static void run(size_t stateSize, double changed, unsigned mtu){
+	const al_sec duration = 2;
+	std::vector<float> state(stateSize / sizeof(float), 0.f);
+	StateSender sender(stateSize, 4130, "127.0.0.1");
+	StateReceiver receiver(stateSize, 4130, "127.0.0.1");
+	sender.mtu(mtu);
+	receiver.start();
+
+	size_t stride = 1. / changed;
+	al_sec t0 = al_steady_time(), t;
+	do{
+		for(size_t i=rnd::uniform(stride); i<state.size(); i+=stride){
+			state[i] += 1.f;
+		}
+		sender.send(&state[0]);
+		// Keep the sender from running too far ahead of the receiver
+		while(sender.frame() - receiver.framesReceived() - receiver.framesDropped() > 4
+			&& al_steady_time() - t0 < duration){
+			al_sleep(0.0001);
+		}
+		t = al_steady_time() - t0;
+	} while(t < duration);
+	al_sleep(0.05);
+	receiver.stop();
+
+	double mb = 1024 * 1024;
+	printf("%6.1f MB state %5.1f%% changed  MTU %5u: %7.1f MB/s state received"
+		"  %7.1f MB/s on wire  %llu/%u frames  %llu dropped\n",
+		stateSize / mb, changed * 100, mtu,
+		receiver.framesReceived() * stateSize / mb / t,
+		sender.bytesSent() / mb / t,
+		(unsigned long long)receiver.framesReceived(), sender.frame(),
+		(unsigned long long)receiver.framesDropped()
+	);
+}
+
+int main(){
+	size_t sizes[] = {1<<20, 8<<20};
+	double changes[] = {0.001, 0.01, 0.1, 1.0};
+	for(int s=0; s<2; ++s){
+		for(int c=0; c<4; ++c){
+			run(sizes[s], changes[c], 1472);
+		}
+		run(sizes[s], 1.0, 65000);
+	}
+	return 0;
+}
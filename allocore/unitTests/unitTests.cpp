@@ -35,10 +35,17 @@ int main (int argc, char * const argv[]) {
 	RUNTEST(ProtocolSerialize);
 
 	RUNTEST(IOSocket);
+	RUNTEST(IOMIDI);
+	RUNTEST(ProtocolStateReplication);
 	RUNTEST(File);
 	RUNTEST(Thread);
 
 	RUNTEST(GraphicsMesh);
+	RUNTEST(GraphicsTexture);
+
+#ifndef ALLOCORE_TESTS_NO_ASSET
+	RUNTEST(Asset);
+#endif
 
 #ifndef ALLOCORE_TESTS_NO_AUDIO
 	RUNTEST(IOAudioIO);
@@ -48,18 +55,16 @@ int main (int argc, char * const argv[]) {
 	RUNTEST(Ambisonics);
 	
 #ifndef ALLOCORE_TESTS_NO_GUI
-	// This test should always be run last since it calls exit()
-	// This test will not run on headless machines.
-	printf("IOWindow .... (calls exit() internally)\n");
+	// These tests should always be run last since they call exit()
+	// These tests will not run on headless machines.
+	printf("GraphicsDraw, IOWindow .... (calls exit() internally)\n");
+	utGraphicsDraw();
 	utIOWindowGL();
 #endif
 
 	// Empirical tests; leave commented
 	// These are tests that require some kind of observation to validate.
 
-//	utAsset();
-//	utGraphicsDraw();
-
 	return 0;
 }
 
@@ -18,14 +18,17 @@ using namespace al;
 
 int utAudioScene();
 int utIOAudioIO();
+int utIOMIDI();
 int utIOSocket();
 int utIOWindowGL();
 int utMath();
 int utMathSpherical();
 int utGraphicsDraw();
 int utGraphicsMesh();
+int utGraphicsTexture();
 int utProtocolOSC();
 int utProtocolSerialize();
+int utProtocolStateReplication();
 int utSpatial();
 int utSystem();
 int utTypes();
@@ -1,11 +1,101 @@
 #include "utAllocore.h"
 
 #include "allocore/graphics/al_Asset.hpp"
+#include "allocore/io/al_File.hpp"
+
+static void copyFile(const std::string& src, const std::string& dst){
+	File f(src, "r", true);
+	assert(f.opened());
+	std::string data(f.readAll(), f.size());
+	int written = File::write(dst, data);
+	assert(written == 1);
+}
+
+static bool sameMaterials(const Scene& a, const Scene& b){
+	if(a.materials() != b.materials()) return false;
+	for(unsigned i=0; i<a.materials(); ++i){
+		const Scene::Material& x = a.material(i);
+		const Scene::Material& y = b.material(i);
+		if(x.name != y.name) return false;
+		if(x.diffuse != y.diffuse) return false;
+		if(x.diffusemap.texture != y.diffusemap.texture) return false;
+	}
+	return true;
+}
 
 int utAsset() {
-	SearchPaths searchPaths;
-	searchPaths.addAppPaths();
-	Scene * scene = Scene::import(searchPaths.find("ducky.obj").filepath());
-	scene->dump();
+
+	// Work on a copy of the fixture model so it can be edited
+	const std::string dir = "utAssetTestDir" AL_FILE_DELIMITER_STR;
+	const std::string srcDir = getSearchPaths().find("cube.obj").path();
+	assert(!srcDir.empty());
+	Dir::make(dir);
+	copyFile(srcDir + "cube.obj", dir + "cube.obj");
+	copyFile(srcDir + "cube.mtl", dir + "cube.mtl");
+	copyFile(srcDir + "cube.ppm", dir + "cube.ppm");
+	const std::string path = dir + "cube.obj";
+
+	Scene::cache(false);
+	Scene * scene = Scene::import(path);
+	assert(scene);
+	assert(!scene->cached());
+	assert(scene->meshes());
+
+	// A scene loaded from the cache matches the imported scene
+	Scene::cache(true);
+	remove(Scene::cachePath(path).c_str());
+	Scene * cold = Scene::import(path);
+	Scene * warm = Scene::import(path);
+	assert(!cold->cached());
+	assert(warm->cached());
+	assert(warm->meshes() == scene->meshes());
+	assert(warm->nodes() == scene->nodes());
+	assert(sameMaterials(*warm, *scene));
+	for (unsigned i=0; i<scene->meshes(); ++i) {
+		Mesh a, b;
+		scene->mesh(i, a);
+		warm->mesh(i, b);
+		assert(a.vertices().size() == b.vertices().size());
+		assert(a.indices().size() == b.indices().size());
+		for (int j=0; j<a.vertices().size(); ++j) assert(a.vertices()[j] == b.vertices()[j]);
+		for (int j=0; j<a.indices().size(); ++j) assert(a.indices()[j] == b.indices()[j]);
+		assert(warm->meshMaterial(i) == scene->meshMaterial(i));
+	}
+	delete warm;
+	delete cold;
+
+	// Edits to the material library invalidate the cache
+	File::write(dir + "cube.mtl",
+		"newmtl cube\n"
+		"Ka 0 0 0\n"
+		"Kd 0.2 0.4 0.6\n"
+		"Ks 0 0 0\n"
+		"map_Kd cube.ppm\n"
+	);
+	cold = Scene::import(path);
+	warm = Scene::import(path);
+	assert(!cold->cached());
+	assert(warm->cached());
+	assert(sameMaterials(*warm, *cold));
+	delete warm;
+	delete cold;
+
+	// So do edits to textures
+	File::write(dir + "cube.ppm", "P3\n1 1\n255\n0 0 0\n");
+	cold = Scene::import(path);
+	warm = Scene::import(path);
+	assert(!cold->cached());
+	assert(warm->cached());
+	delete warm;
+	delete cold;
+
+	Scene::cache(false);
+	remove(Scene::cachePath(path).c_str());
+	remove((dir + "cube.obj").c_str());
+	remove((dir + "cube.mtl").c_str());
+	remove((dir + "cube.ppm").c_str());
+	Dir::remove(dir);
+
+	delete scene;
 	return 0;
 }
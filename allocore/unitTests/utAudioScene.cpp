@@ -212,6 +212,156 @@ void testMultipleSourcesMoving() {
 //	}
 }
 
+void testReadBlock() {
+	const int n = 64;
+	SoundSource src(0.1, 20, ATTEN_INVERSE, DOPPLER_SYMMETRICAL, 0, 1000);
+	std::vector<float> block(n);
+
+	// Write enough to wrap the delay line several times, checking at
+	// every write position near its end
+	for (int k = 0; k < 3000; k++) {
+		src.writeSample(sin(k * 0.05) + 0.1 * cos(k * 1.3));
+		if (k % 7 && k < 2900) continue;
+
+		double delays[][2] = {
+			{0, 0}, {0.25, 0.25}, {17.5, 17.5}, {300.75, 300.75},
+			{src.maxIndex() - n + 1, src.maxIndex() - n + 1},	// oldest samples
+			{10, 30.5}, {40.3, 2.1}, {5, 900},					// ramps
+			{990, 990}											// out of range
+		};
+		for (unsigned j = 0; j < sizeof(delays)/sizeof(delays[0]); j++) {
+			double d0 = delays[j][0], d1 = delays[j][1];
+			src.readBlock(&block[0], n, d0, d1);
+			for (int i = 0; i < n; i++) {
+				double index = d0 + (d1 - d0) * i / (n - 1) + (n - 1 - i);
+				if (index > src.maxIndex()) continue;
+				assert(fabs(block[i] - src.readSample(index)) < 1e-5);
+			}
+		}
+	}
+}
+
+void testSourceArray(int bufferSize) {
+	SoundSourceArray srcs(3, 1000);
+	assert(srcs.capacity() == 3);
+	assert(srcs.delaySize() == 1024);
+
+	// Adding and removing keeps ids of other sources
+	int id1 = srcs.add();
+	int id2 = srcs.add();
+	int id3 = srcs.add();
+	assert(srcs.size() == 3);
+	assert(srcs.add() == -1);
+	srcs.pos(id1, 1, 0, 0);
+	srcs.pos(id3, 3, 0, 0);
+	srcs.remove(id1);
+	assert(!srcs.valid(id1) && srcs.valid(id2) && srcs.valid(id3));
+	assert(srcs.size() == 2);
+	assert(srcs.pos(id3) == Vec3d(3, 0, 0));
+	id1 = srcs.add();
+	assert(srcs.valid(id1) && srcs.pos(id1) == Vec3d(0, 0, 0));
+	srcs.clear();
+	assert(srcs.size() == 0);
+
+	// Same mix as testMultipleSources
+	SpeakerLayout speakerLayout = HeadsetSpeakerLayout();
+	StereoPanner panner(speakerLayout);
+	AudioScene scene(bufferSize);
+	scene.createListener(&panner);
+	scene.addSources(srcs);
+	AudioIO audioIO(bufferSize, 44100, NULL, NULL, speakerLayout.numSpeakers(), 0, AudioIOData::DUMMY);
+
+	float values[] = {0.5, 0.25, -0.3};
+	float xs[] = {1, -1, -1};
+	std::vector<float> block(bufferSize);
+	for (int j = 0; j < 3; j++) {
+		int id = srcs.add(0.1, 20, ATTEN_INVERSE, DOPPLER_NONE);
+		srcs.useAttenuation(id, false);
+		srcs.pos(id, xs[j], 0, 0);
+		for (int i = 0; i < bufferSize; i++) block[i] = values[j];
+		srcs.writeSamples(id, &block[0], bufferSize);
+	}
+	scene.render(audioIO);
+
+	for (int i = 0; i < bufferSize; i++) {
+		assert(almostEqual(audioIO.out(0, i), -0.05));
+		assert(almostEqual(audioIO.out(1, i), 0.5));
+	}
+
+	// Matches a SoundSource with delay and attenuation
+	srcs.clear();
+	int id = srcs.add(0.1, 20, ATTEN_INVERSE, DOPPLER_SYMMETRICAL);
+	srcs.pos(id, 2, 0, 0);
+	SoundSource src(0.1, 20, ATTEN_INVERSE, DOPPLER_SYMMETRICAL, 0, 1024);
+	src.pos(2, 0, 0);
+	for (int i = 0; i < 2*bufferSize; i++) {
+		float v = sin(i * 0.1);
+		srcs.writeSample(id, v);
+		src.writeSample(v);
+	}
+	for (int i = 0; i < 20; i++) {
+		assert(srcs.readSample(id, i + 0.5) == src.readSample(i + 0.5));
+	}
+	scene.render(audioIO);
+	std::vector<float> expected(bufferSize);
+	for (int i = 0; i < bufferSize; i++) expected[i] = audioIO.out(1, i);
+
+	scene.removeSources(srcs);
+	scene.addSource(src);
+	scene.render(audioIO);
+	for (int i = 0; i < bufferSize; i++) {
+		assert(almostEqual(audioIO.out(1, i), expected[i]));
+	}
+}
+
+// Writes its samples from onProcessSample
+struct CountingSource : public SoundSource {
+	int count;
+	CountingSource(DopplerType doppler): SoundSource(0.1, 20, ATTEN_INVERSE, doppler, 0, 1024), count(0) {
+		usePerSampleProcessing(true);
+	}
+	void onProcessSample(int frame){
+		writeSample(sin(++count * 0.1));
+	}
+};
+
+// Renders with listeners at two positions and compares with the sum of
+// scenes with one listener each
+void testMultipleListeners(int bufferSize, bool perSample, DopplerType doppler) {
+	SpeakerLayout speakerLayout = HeadsetSpeakerLayout();
+	StereoPanner panner1(speakerLayout), panner2(speakerLayout);
+	AudioIO audioIO(bufferSize, 44100, NULL, NULL, speakerLayout.numSpeakers(), 0, AudioIOData::DUMMY);
+	std::vector<float> expected(bufferSize*2, 0.f);
+
+	for (int scenes = 0; scenes < 3; scenes++) {
+		AudioScene scene(bufferSize);
+		scene.usePerSampleProcessing(perSample);
+		if (scenes != 1) scene.createListener(&panner1)->pos(0, 0, 1);
+		if (scenes != 0) scene.createListener(&panner2)->pos(-2, 0, 0);
+
+		SoundSource src(0.1, 20, ATTEN_INVERSE, doppler, 0, 1024);
+		CountingSource counting(doppler);
+		src.pos(1, 0, 0);
+		counting.pos(0.5, 0, -1);
+		scene.addSource(src);
+		scene.addSource(counting);
+
+		// Render a few blocks so the position history is filled
+		for (int block = 0; block < 6; block++) {
+			for (int i = 0; i < bufferSize; i++) src.writeSample(cos(i * 0.2 + block));
+			scene.render(audioIO);
+		}
+		assert(counting.count == (perSample ? 6 * bufferSize : 0));
+
+		for (int i = 0; i < bufferSize; i++) {
+			for (int c = 0; c < 2; c++) {
+				if (scenes < 2) expected[i*2 + c] += audioIO.out(c, i);
+				else assert(fabs(audioIO.out(c, i) - expected[i*2 + c]) < 1e-5);
+			}
+		}
+	}
+}
+
 void testAmbisonicsFirstOrder2D(int bufferSize) {
 	// TODO Finish ambisonics scene tester
 	SpeakerLayout speakerLayout = OctalSpeakerLayout();
@@ -274,6 +424,230 @@ void testAmbisonicsFirstOrder2D(int bufferSize) {
 	delete panner;
 }
 
+// Renders a source from a direction and returns the output of each speaker
+std::vector<float> renderVbap(AudioScene& scene, AudioIO& audioIO, SoundSource& src, const Vec3d& dir, float sample) {
+	for (int i = 0; i < audioIO.framesPerBuffer(); i++) {
+		src.writeSample(sample);
+	}
+	src.pos(dir.x, dir.y, dir.z);
+	scene.render(audioIO);
+	std::vector<float> outs(audioIO.channelsOut());
+	for (unsigned chan = 0; chan < outs.size(); chan++) {
+		outs[chan] = audioIO.out(chan, audioIO.framesPerBuffer()-1);
+		for (int i = 0; i < audioIO.framesPerBuffer(); i++) {
+			assert(almostEqual(audioIO.out(chan, i), outs[chan]));
+		}
+	}
+	return outs;
+}
+
+void testVbap(int bufferSize) {
+	SpeakerLayout octahedron;
+	octahedron.addSpeaker(Speaker(0, 0, 0));
+	octahedron.addSpeaker(Speaker(1, 90, 0));
+	octahedron.addSpeaker(Speaker(2, 180, 0));
+	octahedron.addSpeaker(Speaker(3, 270, 0));
+	octahedron.addSpeaker(Speaker(4, 0, 90));
+	octahedron.addSpeaker(Speaker(5, 0, -90));
+	const int numSpeakers = octahedron.numSpeakers();
+
+	Vbap *panner = new Vbap(octahedron);
+	AudioScene scene(bufferSize);
+	SoundSource src;
+	scene.createListener(panner);
+	AudioIO audioIO(bufferSize, 44100, NULL, NULL, numSpeakers, 0, AudioIOData::DUMMY);
+	src.dopplerType(DOPPLER_NONE);
+	src.useAttenuation(false);
+	scene.addSource(src);
+
+	// At a speaker, only that speaker plays
+	for (int k = 0; k < numSpeakers; k++) {
+		Vec3d dir = octahedron.speakers()[k].vec();
+		std::vector<float> outs = renderVbap(scene, audioIO, src, dir, 0.5);
+		for (int chan = 0; chan < numSpeakers; chan++) {
+			assert(almostEqual(outs[chan], chan == k ? 0.5 : 0.0));
+		}
+	}
+
+	// Between three speakers, they play equally loud
+	{
+		const Speakers& s = octahedron.speakers();
+		Vec3d dir = (s[0].vec() + s[1].vec() + s[4].vec()).normalize();
+		std::vector<float> outs = renderVbap(scene, audioIO, src, dir, 0.5);
+		for (int chan = 0; chan < numSpeakers; chan++) {
+			float expected = (chan == 0 || chan == 1 || chan == 4) ? 0.5/sqrt(3.) : 0.0;
+			assert(almostEqual(outs[chan], expected));
+		}
+	}
+
+	// Recompile in the background, rotated by 45 degrees
+	SpeakerLayout rotated;
+	for (int k = 0; k < numSpeakers; k++) {
+		Speaker s = octahedron.speakers()[k];
+		s.azimuth += 45;
+		rotated.addSpeaker(s);
+	}
+	panner->recompile(rotated);
+	assert(panner->recompiling());
+	for (int i = 0; i < 1000 && panner->recompiling(); i++) {
+		renderVbap(scene, audioIO, src, Vec3d(0,0,-1), 0.5);
+		al_sleep(0.001);
+	}
+	assert(!panner->recompiling());
+	{
+		std::vector<float> outs = renderVbap(scene, audioIO, src, rotated.speakers()[1].vec(), 0.5);
+		for (int chan = 0; chan < numSpeakers; chan++) {
+			assert(almostEqual(outs[chan], chan == 1 ? 0.5 : 0.0));
+		}
+	}
+
+	scene.removeSource(src);
+	delete panner;
+
+	// A dome with rings of speakers covers all directions without gaps
+	SpeakerLayout dome;
+	for (int i = 0; i < 12; i++) dome.addSpeaker(Speaker(dome.numSpeakers(), 360./12*i, 41));
+	for (int i = 0; i < 30; i++) dome.addSpeaker(Speaker(dome.numSpeakers(), 360./30*i, 0));
+	for (int i = 0; i < 12; i++) dome.addSpeaker(Speaker(dome.numSpeakers(), 360./12*i, -32.5));
+
+	// Compile once to fill the cache and once more to load from it
+	std::vector<float> cachedOuts[2];
+	for (int pass = 0; pass < 2; pass++) {
+		Vbap *vbap = new Vbap(dome);
+		vbap->cacheDirectory(".");
+		AudioScene domeScene(bufferSize);
+		domeScene.createListener(vbap);
+		AudioIO domeIO(bufferSize, 44100, NULL, NULL, dome.numSpeakers(), 0, AudioIOData::DUMMY);
+		domeScene.addSource(src);
+
+		rnd::Random<> rng(1);
+		for (int j = 0; j < 100; j++) {
+			Vec3d dir = Vec3d(rng.uniformS(), rng.uniformS(), rng.uniformS()).normalize();
+			std::vector<float> outs = renderVbap(domeScene, domeIO, src, dir, 0.5);
+			float power = 0;
+			int active = 0;
+			for (unsigned chan = 0; chan < outs.size(); chan++) {
+				assert(outs[chan] >= 0);
+				power += outs[chan] * outs[chan];
+				if (outs[chan] > 0) active++;
+			}
+			assert(almostEqual(power, 0.25));
+			assert(active <= 3);
+			if (j == 0) cachedOuts[pass] = outs;
+		}
+
+		domeScene.removeSource(src);
+		delete vbap;
+	}
+	for (unsigned chan = 0; chan < cachedOuts[0].size(); chan++) {
+		assert(almostEqual(cachedOuts[0][chan], cachedOuts[1][chan]));
+	}
+
+	char cacheFile[32];
+	snprintf(cacheFile, sizeof cacheFile, "./vbap_%016llx.txt", Vbap::layoutHash(dome.speakers(), true));
+	FILE * fp = fopen(cacheFile, "r");
+	assert(fp);
+	fclose(fp);
+	remove(cacheFile);
+}
+
+void testFDNReverb(int numLines) {
+	const double fs = 44100;
+	const int numOuts = 8;
+	const int numFrames = int(fs);
+	std::vector<float> in(numFrames, 0.f);
+	in[0] = 1.f;
+
+	// Impulse response, in one pass and in blocks not a multiple of the
+	// internal block size
+	std::vector<std::vector<float> > outs(numOuts, std::vector<float>(numFrames, 0.f));
+	std::vector<std::vector<float> > outsBlocked = outs;
+	{
+		FDNReverb rev(numLines, numOuts, fs);
+		rev.decay(0.5).damping(0);
+		assert(rev.numLines() == numLines);
+		for(int i=1; i<numLines; ++i) assert(rev.lineLength(i) > rev.lineLength(i-1));
+		assert(rev.lineLength(0) > FDNReverb::BLOCK_SIZE);
+
+		std::vector<float *> p(numOuts);
+		for(int c=0; c<numOuts; ++c) p[c] = &outs[c][0];
+		rev.process(&in[0], &p[0], numFrames);
+	}
+	{
+		FDNReverb rev(numLines, numOuts, fs);
+		rev.decay(0.5).damping(0);
+		std::vector<float *> p(numOuts);
+		for(int f=0; f<numFrames; f+=37){
+			int n = numFrames - f < 37 ? numFrames - f : 37;
+			for(int c=0; c<numOuts; ++c) p[c] = &outsBlocked[c][f];
+			rev.process(&in[f], &p[0], n);
+		}
+	}
+	for(int c=0; c<numOuts; ++c){
+		for(int i=0; i<numFrames; ++i){
+			assert(outs[c][i] == outsBlocked[c][i]);
+		}
+	}
+
+	// Nothing comes out before the shortest delay, less the output taps
+	for(int c=0; c<numOuts; ++c){
+		for(int i=0; i<900; ++i) assert(fabs(outs[c][i]) < 1e-12);
+	}
+
+	// The level falls by 60 dB in the decay time
+	double e1 = 0, e2 = 0;
+	for(int i=int(0.2*fs); i<int(0.3*fs); ++i) e1 += outs[0][i]*outs[0][i];
+	for(int i=int(0.7*fs); i<int(0.8*fs); ++i) e2 += outs[0][i]*outs[0][i];
+	double dB = 10*log10(e2/e1);
+	assert(dB < -50 && dB > -70);
+
+	// Outputs are decorrelated
+	for(int c=1; c<numOuts; ++c){
+		double xy = 0, xx = 0, yy = 0;
+		for(int i=int(0.1*fs); i<int(0.5*fs); ++i){
+			xy += outs[0][i]*outs[c][i];
+			xx += outs[0][i]*outs[0][i];
+			yy += outs[c][i]*outs[c][i];
+		}
+		assert(fabs(xy / sqrt(xx*yy)) < 0.1);
+	}
+
+	// Output added to a stream; channels beyond the reverb's are untouched
+	{
+		const int bufferSize = 100;
+		AudioIO audioIO(bufferSize, fs, NULL, NULL, 4, 0, AudioIOData::DUMMY);
+		FDNReverb rev(numLines, 2, fs);
+		rev.decay(0.5).damping(0);
+		audioIO.zeroOut();
+		for(int i=0; i<bufferSize; ++i) audioIO.out(0, i) = 1.f;
+		std::vector<float> block(bufferSize, 0.f);
+		block[0] = 1.f;
+		double sum = 0;
+		for(int b=0; b<40; ++b){
+			rev.process(audioIO, &block[0], 0.5f);
+			block[0] = 0.f;
+		}
+		for(int i=0; i<bufferSize; ++i){
+			sum += fabs(audioIO.out(1, i));
+			assert(audioIO.out(2, i) == 0.f && audioIO.out(3, i) == 0.f);
+		}
+		assert(sum > 0);
+	}
+
+	// Silence stays silent after clearing
+	{
+		FDNReverb rev(numLines, 1, fs);
+		std::vector<float> out(numFrames, 0.f);
+		float * p = &out[0];
+		rev.process(&in[0], &p, numFrames);
+		rev.clear();
+		std::vector<float> zeros(numFrames, 0.f);
+		out.assign(numFrames, 0.f);
+		rev.process(&zeros[0], &p, numFrames);
+		for(int i=0; i<numFrames; ++i) assert(fabs(out[i]) < 1e-10);
+	}
+}
+
 int utAudioScene() {
 	testStereo(8);
 	testStereo(4096);
@@ -282,7 +656,25 @@ int utAudioScene() {
 
 	testMultipleSourcesMoving();
 
+	testReadBlock();
+
+	testMultipleListeners(8, false, DOPPLER_NONE);
+	testMultipleListeners(64, false, DOPPLER_SYMMETRICAL);
+	testMultipleListeners(64, true, DOPPLER_NONE);
+	testMultipleListeners(64, true, DOPPLER_SYMMETRICAL);
+	testMultipleListeners(64, true, DOPPLER_PHYSICAL);
+
+	testSourceArray(8);
+	testSourceArray(512);
+
+	testVbap(8);
+	testVbap(64);
+
 	testAmbisonicsFirstOrder2D(8);
 
+	testFDNReverb(8);
+	testFDNReverb(16);
+	testFDNReverb(32);
+
 	return 0;
 }
@@ -4,6 +4,8 @@ static Graphics gl;
 
 struct MyWindow2 : Window{
 
+	MyWindow2(): frames(0){}
+
 	bool onFrame(){
 
 		gl.clear(gl.COLOR_BUFFER_BIT | gl.DEPTH_BUFFER_BIT);
@@ -30,20 +32,37 @@ struct MyWindow2 : Window{
 
 		gl.draw(data);
 
+		// A static mesh drawn from GPU buffers is only uploaded once
+		if(!shape.vertices().size()){
+			shape.primitive(gl.TRIANGLES).retained(true);
+			shape.vertex(-0.5,-0.5); shape.color(1,0,0);
+			shape.vertex( 0.5,-0.5); shape.color(0,1,0);
+			shape.vertex( 0.0, 0.5); shape.color(0,0,1);
+		}
+		gl.draw(shape);
+		const Graphics::MeshCacheStats& stats = gl.meshCacheStats();
+		assert(stats.meshes == 1);
+		assert(stats.draws == uint64_t(++frames));
+		assert(stats.uploads == 2);
+		assert(stats.bytesUploaded == 3*(sizeof(Mesh::Vertex) + sizeof(Color)));
+
 		return true;
 	}
 
 	Mesh data;
+	Mesh shape;
+	int frames;
 };
 
 
 
+// Creates a window to be run by the window loop started in utIOWindowGL()
 int utGraphicsDraw(){
 
-	MyWindow2 win;
+	// The window loop ends with exit(), so the window is never deleted
+	MyWindow2 * win = new MyWindow2;
 
-	win.create(Window::Dim(400,400), "Window 1", 40);
+	win->create(Window::Dim(400,400), "Window 1", 40);
 
-	Window::startLoop();
 	return 0;
 }
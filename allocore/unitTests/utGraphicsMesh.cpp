@@ -43,5 +43,56 @@ int utGraphicsMesh(){
 
 	}
 
+	// Change tracking for retained drawing
+	{
+		Mesh a;
+		assert(!a.retained());
+		assert(a.generation(Mesh::VERTICES) == 0);
+
+		a.vertex(0,0,0);
+		a.color(1,0,0);
+		unsigned gv = a.generation(Mesh::VERTICES);
+		unsigned gc = a.generation(Mesh::COLORS);
+		unsigned gi = a.generation(Mesh::INDICES);
+		assert(gv > 0 && gc > 0);
+
+		// Reading does not flag a change, nor do direct writes to a buffer
+		assert(a.vertices()[0] == Vec3f(0,0,0));
+		assert(a.vertices().size() == 1);
+		assert(a.colors().capacity() >= 1);
+		a.vertices()[0] = Vec3f(0,1,0);
+		assert(a.generation(Mesh::VERTICES) == gv);
+		assert(a.generation(Mesh::COLORS) == gc);
+		a.changed(Mesh::VERTICES);
+		assert(a.generation(Mesh::VERTICES) == gv+1);
+		gv = a.generation(Mesh::VERTICES);
+
+		a.translate(1,0,0);
+		assert(a.generation(Mesh::VERTICES) > gv);
+		assert(a.generation(Mesh::COLORS) == gc);
+
+		a.changed(Mesh::COLORS | Mesh::INDICES);
+		assert(a.generation(Mesh::COLORS) == gc+1);
+		assert(a.generation(Mesh::INDICES) == gi+1);
+
+		// Copies are distinct meshes, assignment keeps identity
+		a.retained(true);
+		Mesh b(a);
+		assert(b.id() != a.id());
+		assert(b.retained());
+		Mesh c;
+		unsigned cid = c.id();
+		gc = c.generation(Mesh::COLORS);
+		c = a;
+		assert(c.id() == cid);
+		assert(c.generation(Mesh::COLORS) == gc+1);
+		assert(c.vertices()[0] == a.vertices()[0]);
+
+		// Assigning a mesh with fewer changes still flags a change
+		gv = a.generation(Mesh::VERTICES);
+		a = Mesh();
+		assert(a.generation(Mesh::VERTICES) == gv+1);
+	}
+
 	return 0;
 }
@@ -0,0 +1,151 @@
+#include "utAllocore.h"
+
+int utGraphicsTexture(){
+
+	typedef TextureUpload::Region Region;
+
+	// Whole texture is pending after shaping
+	{
+		TextureUpload u;
+		assert(!u.pending());
+		u.shape(4, 16,8);
+		assert(u.pending());
+		assert(u.whole());
+		assert(u.numRegions() == 1);
+		assert(u.bytes() == 16*8*4);
+
+		u.uploaded();
+		assert(!u.pending());
+		assert(u.bytes() == 0);
+		assert(u.uploads() == 1);
+		assert(u.bytesUploaded() == 16*8*4);
+
+		// Same shape adds nothing
+		u.shape(4, 16,8);
+		assert(!u.pending());
+	}
+
+	// Adjacent and overlapping regions merge
+	{
+		TextureUpload u;
+		u.shape(4, 16,8).uploaded();
+
+		u.dirty(Region(0,2,0, 16,1));
+		u.dirty(Region(0,3,0, 16,1));
+		assert(u.numRegions() == 1);
+		assert(u.region(0) == Region(0,2,0, 16,2));
+		assert(u.bytes() == 16*2*4);
+		assert(!u.whole());
+
+		u.dirty(Region(4,2,0, 4,2));	// contained
+		assert(u.numRegions() == 1);
+		assert(u.bytes() == 16*2*4);
+
+		u.dirty(Region(0,6,0, 2,2));	// separate
+		assert(u.numRegions() == 2);
+		assert(u.bytes() == (16*2 + 2*2)*4);
+		assert(u.offset(1) == 16*2*4);
+
+		// Region taking in both
+		u.dirty(Region(0,0,0, 16,8));
+		assert(u.numRegions() == 1);
+		assert(u.whole());
+	}
+
+	// Regions are clipped to the texture
+	{
+		TextureUpload u;
+		u.shape(1, 16,8).uploaded();
+		u.dirty(Region(12,6,0, 10,10));
+		assert(u.region(0) == Region(12,6,0, 4,2));
+		u.dirty(Region(16,0,0, 1,1));
+		u.dirty(Region(0,0,0, 0,1));
+		assert(u.numRegions() == 1);
+	}
+
+	// Number of regions is capped
+	{
+		TextureUpload u;
+		u.shape(1, 64,64).uploaded();
+		for(int i=0; i<TextureUpload::MAX_REGIONS*2; ++i){
+			u.dirty(Region(0,i*4,0, 1,1));
+		}
+		assert(u.numRegions() <= TextureUpload::MAX_REGIONS);
+		uint64_t texels = 0;
+		for(int i=0; i<u.numRegions(); ++i) texels += u.region(i).texels();
+		assert(u.bytes() == texels);
+		for(int i=0; i<TextureUpload::MAX_REGIONS*2; ++i){
+			bool covered = false;
+			for(int k=0; k<u.numRegions(); ++k){
+				const Region& r = u.region(k);
+				covered |= r.x==0 && r.y<=unsigned(i*4) && unsigned(i*4)<r.y+r.h;
+			}
+			assert(covered);
+		}
+	}
+
+	// Packing regions of a 3D array
+	{
+		const int W=5, H=4, D=3;
+		char pixels[W*H*D*2];
+		for(int i=0; i<W*H*D*2; ++i) pixels[i] = i;
+
+		TextureUpload u;
+		u.shape(2, W,H,D).uploaded();
+		u.dirty(Region(1,2,1, 2,1,2));
+		u.dirty(Region(4,0,0, 1,1,1));
+		assert(u.numRegions() == 2);
+		assert(u.bytes() == (2*1*2 + 1)*2);
+
+		char packed[10];
+		u.pack(packed, pixels, W*2, W*H*2);
+		int k = 0;
+		for(int z=1; z<3; ++z){
+		for(int x=1; x<3; ++x){
+		for(int c=0; c<2; ++c){
+			assert(packed[k++] == pixels[((z*H + 2)*W + x)*2 + c]);
+		}}}
+		assert(packed[k++] == pixels[4*2]);
+		assert(packed[k++] == pixels[4*2+1]);
+
+		// Staging buffers alternate between uploads
+		int stage = u.stage();
+		u.uploaded();
+		assert(u.stage() != stage);
+		u.uploaded();	// nothing pending
+		assert(u.stage() != stage);
+	}
+
+	// Texture regions, without sending anything to the GPU
+	{
+		Texture tex(32,16, Graphics::RGBA, Graphics::UBYTE);
+		assert(tex.upload().whole());
+		assert(tex.upload().bytes() == 32*16*4);
+
+		Texture tex1(32,16, Graphics::RGB, Graphics::FLOAT);
+		tex1.array();	// internal array may have changed
+		assert(tex1.upload().whole());
+
+		Texture tex2(64, Graphics::LUMINANCE, Graphics::UBYTE);
+		tex2.dirty(8,4);
+		assert(tex2.upload().bytes() == 64);
+	}
+
+	// Copies do not share staging buffers
+	{
+		Texture tex(8,8, Graphics::RGBA, Graphics::UBYTE);
+		tex.staged(true);
+		bool staged = tex.staged();
+		Texture copy(tex);
+		assert(!copy.staged());
+		Texture assigned(4,4, Graphics::RGBA, Graphics::UBYTE);
+		assigned = tex;
+		assert(!assigned.staged());
+		copy.staged(true);
+		copy = tex;
+		assert(copy.staged() == staged);
+		assert(tex.staged() == staged);
+	}
+
+	return 0;
+}
@@ -1,4 +1,6 @@
 #include "utAllocore.h"
+#include <list>
+#include <thread>
 
 struct LowPass{
 	LowPass(): p(0){}
@@ -37,9 +39,178 @@ void audioCB(AudioIOData& io){
 }
 
 
+// Copies input to first output and half of input to second output
+void offlineCB(AudioIOData& io){
+	while(io()){
+		io.out(0) = io.in(0);
+		io.out(1) = io.in(0) * 0.5f;
+	}
+}
+
+void testOffline(){
+	const int frames = 64;
+	const int inFrames = 100;
+
+	std::vector<float> input(inFrames);
+	for(int i=0; i<inFrames; ++i) input[i] = float(i+1) / inFrames;
+	std::vector<float> output;
+
+	AudioIO io(frames, 44100, offlineCB, 0, 2, 1, AudioIOData::OFFLINE);
+	assert(io.backend() == AudioIOData::OFFLINE);
+	assert(io.channelsOut() == 2);
+	assert(io.channelsIn() == 1);
+	io.offlineInput(&input[0], inFrames, 1);
+	io.offlineOutput(&output);
+
+	// Blocks are processed on this thread
+	assert(io.processOffline(4) == 4);
+	assert(output.size() == unsigned(4 * frames * 2));
+	for(int i=0; i<4*frames; ++i){
+		float s = i < inFrames ? input[i] : 0.f;
+		assert(output[i*2  ] == s);
+		assert(output[i*2+1] == s * 0.5f);
+	}
+
+	AudioIO::OfflineStats stats = io.offlineStats();
+	assert(stats.blocks == 4);
+	assert(fabs(stats.audioTime - 4.*frames/44100) < 1e-9);
+	assert(fabs(io.time() - 4.*frames/44100) < 1e-9);
+
+	// Looped input starts over
+	output.clear();
+	io.offlineReset();
+	io.offlineInput(&input[0], inFrames, 1, true);
+	io.processOffline(2);
+	for(int i=0; i<2*frames; ++i) assert(output[i*2] == input[i % inFrames]);
+	assert(io.offlineStats().blocks == 2);
+
+	// Blocks are processed on a thread as fast as possible
+	io.offlineOutput(NULL);
+	io.offlineReset();
+	assert(io.start());
+	while(io.offlineStats().blocks < 100) al_sleep(0.001);
+	assert(io.processOffline(1) == 0); // already running
+	io.stop();
+	stats = io.offlineStats();
+	assert(stats.blocks >= 100);
+	assert(stats.speedup() > 1);
+}
+
+// Misses the deadline of the sixth block
+void profiledCB(AudioIOData& io){
+	AudioProfiler& profiler = io.user<AudioProfiler>();
+	assert(AudioProfiler::current() == (profiler.enabled() ? &profiler : NULL));
+	AL_PROFILE_AUDIO("utIOAudioIO stage");
+	static int block = 0;
+	if(++block == 6) al_sleep(io.secondsPerBuffer() * 2);
+}
+
+void testProfiler(){
+	AudioProfiler profiler;
+	AudioIO io(64, 44100, profiledCB, &profiler, 2, 0, AudioIOData::OFFLINE);
+	io.profiler(&profiler);
+	assert(io.profiler() == &profiler);
+
+	// Current only while processing a block
+	io.processOffline(20);
+	assert(AudioProfiler::current() == NULL);
+	profiler.update();
+
+	AudioProfiler::Stats block = profiler.blockStats();
+	assert(block.count == 20);
+	assert(block.max >= io.secondsPerBuffer() * 2);
+	assert(block.p50 <= block.p90 && block.p90 <= block.p99 && block.p99 <= block.max);
+	assert(profiler.deadlineMisses() >= 1);
+	assert(profiler.xruns() == 0);
+	assert(profiler.dropped() == 0);
+
+	std::vector<AudioProfiler::Stats> stages = profiler.stageStats();
+	bool found = false;
+	for(unsigned i=0; i<stages.size(); ++i){
+		if(stages[i].name == "utIOAudioIO stage"){
+			found = true;
+			assert(stages[i].count == 20);
+			assert(stages[i].load > 0 && stages[i].load <= block.load);
+		}
+	}
+	assert(found);
+
+	// Nothing is recorded while disabled
+	profiler.enabled(false);
+	io.processOffline(5);
+	profiler.update();
+	assert(profiler.blockStats().count == 20);
+	profiler.enabled(true);
+	AudioProfiler::clearCurrent();
+
+	// Percentiles are accurate to the histogram resolution
+	profiler.reset();
+	int stage = AudioProfiler::stage("utIOAudioIO percentiles");
+	for(int i=1; i<=100; ++i) profiler.record(stage, 0, i*1000);
+	profiler.update();
+	stages = profiler.stageStats();
+	assert(stages.size() == 1);
+	assert(fabs(stages[0].p50 - 50e-6) < 50e-6 * 0.05);
+	assert(fabs(stages[0].p90 - 90e-6) < 90e-6 * 0.05);
+	assert(stages[0].max == 100e-6);
+	assert(fabs(stages[0].mean - 50.5e-6) < 1e-9);
+
+	// Rings of threads that have exited are reused
+	{
+		AudioProfiler p(1, 16);
+		for(int i=0; i<4; ++i){
+			std::thread t([&](){ p.record(stage, 0, 1000); });
+			t.join();
+		}
+		p.update();
+		assert(p.dropped() == 0);
+		assert(p.stageStats().size() == 1);
+		assert(p.stageStats()[0].count == 4);
+	}
+}
+
+
+// Uses scratch memory and a list allocated from the current allocator
+void allocatorCB(AudioIOData& io){
+	RTAllocator * rta = RTAllocator::current();
+	assert(rta && rta->inBlock());
+	assert(rta->scratchArena().used() == 0);
+	float * tmp = rta->scratch<float>(io.framesPerBuffer());
+	assert(tmp);
+	for(int i=0; i<io.framesPerBuffer(); ++i) tmp[i] = i;
+
+	std::list<int, RTAlloc<int> >& list = io.user<std::list<int, RTAlloc<int> > >();
+	list.push_back(list.size());
+}
+
+void testAllocator(){
+	RTAllocator rta(16, 4096);
+	std::list<int, RTAlloc<int> > list;
+	AudioIO io(64, 44100, allocatorCB, &list, 2, 0, AudioIOData::OFFLINE);
+	io.allocator(&rta);
+	assert(io.allocator() == &rta);
+
+	io.processOffline(10);
+	assert(list.size() == 10);
+	assert(rta.pool(0).available() == 6);
+	assert(rta.scratchArena().highWater() == 64*sizeof(float));
+	assert(!rta.inBlock());
+	assert(RTAllocator::current() == NULL);
+	assert(rta.heapFallbacks() == 0);
+	if(!RTAllocator::debugging()) assert(rta.heapAllocationsInBlock() == 0);
+
+	list.clear();
+	assert(rta.pool(0).available() == 16);
+	RTAllocator::clearCurrent();
+}
+
 
 int utIOAudioIO(){
 
+	testOffline();
+	testProfiler();
+	testAllocator();
+
 	//AudioDevice::printAll();
 	AudioIO audioIO(256, 44100, audioCB, 0, 1, 1, AudioIOData::PORTAUDIO);
 
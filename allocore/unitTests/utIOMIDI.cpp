@@ -0,0 +1,119 @@
+#include "utAllocore.h"
+#include "allocore/io/al_MIDI.hpp"
+
+namespace{
+
+// Stands in for a MIDI input, sending notes on its own thread
+struct SyntheticMIDISource{
+	MIDIMessageHandler& handler;
+	int numNotes;
+	Thread thread;
+
+	SyntheticMIDISource(MIDIMessageHandler& h, int n): handler(h), numNotes(n){}
+
+	static void * run(void * user){
+		SyntheticMIDISource& s = *(SyntheticMIDISource *)user;
+		for(int i=0; i<s.numNotes; ++i){
+			s.handler.onMIDIMessage(MIDIMessage(0, 0, 0x90, i & 127, i >> 7));
+			if((i & 31) == 0) al_sleep(0.001);
+		}
+		return NULL;
+	}
+
+	void start(){ thread.start(run, this); }
+	void join(){ thread.join(); }
+};
+
+} // ::
+
+int utIOMIDI(){
+
+	// Queue
+	{
+		MIDIMessageQueue q(5);
+		assert(q.capacity() == 8);
+		assert(q.size() == 0);
+		assert(!q.front());
+
+		for(int i=0; i<8; ++i) assert(q.push(MIDIMessage(i, 0, 0x90, i)));
+		assert(!q.push(MIDIMessage(8, 0, 0x90, 8)));
+		assert(q.overflows() == 1);
+		assert(q.size() == 8);
+
+		MIDIMessage m(0, 0, 0);
+		for(int i=0; i<8; ++i){
+			assert(q.front()->noteNumber() == i);
+			assert(q.pop(m));
+			assert(m.noteNumber() == i && m.timeStamp() == i);
+		}
+		assert(!q.pop(m));
+	}
+
+	// Time stamps map to frames of the block following their arrival
+	{
+		MIDIAudioDispatcher d(16);
+		const int N = 64;
+		const double sr = 4096;
+		const double T = 1./sr;
+		MIDIMessage m(0, 0, 0);
+		int frame;
+
+		d.beginBlock(N, sr, 1);
+		d.push(MIDIMessage(0, 0, 0x90, 60), 1 + 16*T);
+		d.push(MIDIMessage(0, 0, 0x90, 61), 1 + 48*T);
+		d.push(MIDIMessage(0, 0, 0x90, 62), 1 + 80*T);
+		assert(!d.next(m, frame));	// all arrived after this block started
+
+		d.beginBlock(N, sr, 1 + 64*T);
+		assert(d.next(m, frame) && m.noteNumber() == 60 && frame == 16);
+		assert(d.next(m, frame) && m.noteNumber() == 61 && frame == 48);
+		assert(!d.next(m, frame));
+
+		// A late callback stretches the block over the elapsed time
+		d.beginBlock(N, sr, 1 + 192*T);
+		assert(d.next(m, frame) && m.noteNumber() == 62 && frame == 8);
+
+		// After a stall, old messages are delivered at the start of the block
+		d.push(MIDIMessage(0, 0, 0x90, 63), 1.05);
+		d.push(MIDIMessage(0, 0, 0x90, 64), 2 - 32*T);
+		d.beginBlock(N, sr, 2);
+		assert(d.nextAt(m, 0) && m.noteNumber() == 63);
+		assert(!d.nextAt(m, 0));
+		assert(!d.nextAt(m, 31));
+		assert(d.nextAt(m, 32) && m.noteNumber() == 64);
+	}
+
+	// Messages from another thread arrive in order and without loss
+	{
+		const int numNotes = 20000;
+		MIDIAudioDispatcher d(4096);
+		SyntheticMIDISource source(d, numNotes);
+		const int N = 128;
+		const double sr = 44100;
+		MIDIMessage m(0, 0, 0);
+		int count = 0;
+
+		double t = MIDIAudioDispatcher::clock();
+		source.start();
+		while(count < numNotes){
+			// Simulate blocks that take the expected time to process
+			while(MIDIAudioDispatcher::clock() - t < N/sr) al_sleep(0.0001);
+			t = MIDIAudioDispatcher::clock();
+			d.beginBlock(N, sr, t);
+			for(int i=0; i<N; ++i){
+				while(d.nextAt(m, i)){
+					assert(m.noteNumber() + (m.velocity(1) * 128) == count);
+					assert(m.timeStamp() < t);
+					++count;
+				}
+			}
+			// Messages still in the queue all came after the block started
+			const MIDIMessage * f = d.queue().front();
+			assert(!f || f->timeStamp() >= t);
+		}
+		source.join();
+		assert(d.queue().overflows() == 0);
+	}
+
+	return 0;
+}
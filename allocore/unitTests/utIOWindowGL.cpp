@@ -70,7 +70,9 @@ struct MyWindow : Window{
 		assert(defaultDim().w == dim.w);
 		assert(defaultDim().h == dim.h);
 
-		Window::stopLoop();
+		// Give other windows, such as the one of utGraphicsDraw(), a few
+		// frames before ending the loop
+		if(++frameNum == 8) Window::stopLoop();
 		return true;
 	}
 };
@@ -444,6 +444,69 @@ int utMath(){
 			assert(eq(vz, Vec3d(0,0,1)));
 		}
 
+		// Test batch operations against the ones on single elements
+		{
+			const int N = 1000;	// not a multiple of the block size
+			QuatArray<double> qa(N), qb(N), qr;
+			Vec3Array<double> va(N), vr;
+			std::vector<double> amts(N);
+			for(int i=0; i<N; ++i){
+				Quatd a(rnd::uniformS(), rnd::uniformS(), rnd::uniformS(), rnd::uniformS());
+				a *= 1./sqrt(a.magSqr());
+				Quatd b(rnd::uniformS(), rnd::uniformS(), rnd::uniformS(), rnd::uniformS());
+				b *= 1./sqrt(b.magSqr());
+				// Some pairs are nearly the same or opposite
+				if(i%10 == 1) b = a;
+				if(i%10 == 2) b = -a;
+				if(i%10 == 3){ b = a; b.x += 1e-9; b *= 1./sqrt(b.magSqr()); }
+				qa.set(i, a);
+				qb.set(i, b);
+				va.set(i, Vec3d(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()) * 10.);
+				amts[i] = rnd::uniform();
+			}
+
+			rotate(qa.get(0), va, vr);
+			assert(vr.size() == N);
+			for(int i=0; i<N; ++i) assert(eq(vr.get(i), qa.get(0).rotate(va.get(i)), 1e-12));
+
+			rotate(qa, va, vr);
+			for(int i=0; i<N; ++i) assert(eq(vr.get(i), qa.get(i).rotate(va.get(i)), 1e-12));
+
+			// In place
+			vr = va;
+			rotate(qa, vr, vr);
+			for(int i=0; i<N; ++i) assert(eq(vr.get(i), qa.get(i).rotate(va.get(i)), 1e-12));
+
+			slerp(qa, qb, 0.3, qr);
+			assert(qr.size() == N);
+			for(int i=0; i<N; ++i){
+				Quatd r = qr.get(i);
+				assert(eq(r, Quatd::slerp(qa.get(i), qb.get(i), 0.3)));
+				assert(eq(r.magSqr(), 1., 1e-12));
+			}
+
+			slerp(qa, qb, &amts[0], qr);
+			for(int i=0; i<N; ++i){
+				assert(eq(qr.get(i), Quatd::slerp(qa.get(i), qb.get(i), amts[i])));
+			}
+
+			slerp(qa, qb, 0., qr);
+			for(int i=0; i<N; ++i) assert(eq(qr.get(i), qa.get(i), 1e-12));
+
+			// Single precision
+			QuatArray<float> fa(N);
+			Vec3Array<float> fv(N), fr;
+			for(int i=0; i<N; ++i){
+				fa.set(i, qa.get(i));
+				fv.set(i, va.get(i));
+			}
+			rotate(fa, fv, fr);
+			for(int i=0; i<N; ++i) assert(eq(fr.get(i), fa.get(i).rotate(fv.get(i)), 1e-4f));
+
+			slerp(fa, fa, 0.5f, fa);
+			for(int i=0; i<N; ++i) assert(eq(fa.get(i), Quatf(qa.get(i)), 1e-6f));
+		}
+
 
 
 //		int smps = 100;
@@ -130,5 +130,36 @@ int utProtocolOSC(){
 		}
 	}
 
+	// Receiving in the main loop
+	{
+		struct Counter : public osc::PacketHandler, public Main::Handler{
+			osc::Send * send;
+			int received, ticks;
+			Counter(): received(0), ticks(0){}
+			void onMessage(osc::Message& m){
+				assert(m.addressPattern() == "/count");
+				if(++received == 3) Main::get().stop();
+			}
+			void onTick(){
+				if(++ticks <= 3) send->send("/count", ticks);
+				if(ticks == 200) Main::get().stop();
+			}
+		} counter;
+
+		unsigned port = 4111;
+		osc::Send s(port, "127.0.0.1");
+		osc::Recv r(port);
+		r.handler(counter);
+		bool watched = r.start(Main::get());
+		assert(watched);
+		counter.send = &s;
+
+		Main::get().interval(0.005).add(counter);
+		Main::get().start();
+		Main::get().remove(counter);
+		r.stop();
+		assert(counter.received == 3);
+	}
+
 	return 0;
 }
@@ -42,7 +42,7 @@ int utProtocolSerialize(){
 			assert(ou1 == iu1);
 			assert(oU1 == iU1);
 			assert(ob1 == ib1);
-			//assert(ostr == istr);
+			assert(ostr == istr);
 
 			//printf("\n%f, %f, %d, %s\n", of1, od1, ob1, ostr.c_str());
 		}
@@ -89,6 +89,94 @@ int utProtocolSerialize(){
 			ASSERT(iun, oun);
 			ASSERT(iUn, oUn);
 		}
+
+		// External memory and arrays
+		{
+			const int N = 100;
+			float in[N], out[N+1];
+			for(int i=0; i<N; ++i) in[i] = i*0.5f;
+			int32_t tag = 7;
+
+			Serializer v;
+			v << tag;
+			v.add(in, N);
+			v << "end";
+			assert(v.size() == v.buf().size());
+
+			// Same bytes as the internal buffer
+			char mem[1024];
+			Serializer e(mem, sizeof(mem));
+			e << tag;
+			e.add(in, N);
+			e << "end";
+			assert(!e.overflowed());
+			assert(e.size() == v.size());
+			assert(e.data() == mem);
+			assert(memcmp(mem, v.data(), e.size()) == 0);
+			assert(e.buf().empty());
+
+			// Groups that do not fit are dropped
+			Serializer small(mem, 20);
+			small << tag;
+			small.add(in, N);
+			assert(small.overflowed());
+			assert(small.size() == uint32_t(serHeaderSize() + 4));
+			small.clear();
+			assert(!small.overflowed() && small.size() == 0);
+
+			// The deserializer reads external memory in place
+			Deserializer d(mem, e.size());
+			assert(d.data() == mem);
+			int32_t otag = 0;
+			d >> otag;
+			assert(otag == tag);
+
+			SerHeader h;
+			assert(d.peek(h));
+			assert(h.type == SER_FLOAT32 && h.num == uint32_t(N));
+
+			// Wrong type is not decoded
+			double dbl[N];
+			assert(d.get(dbl, N) == 0);
+
+			// Decoding into a smaller array skips the rest
+			uint32_t remaining = d.remaining();
+			assert(d.get(out, 10) == 10);
+			for(int i=0; i<10; ++i) assert(out[i] == in[i]);
+			assert(d.remaining() == remaining - serHeaderSize() - N*sizeof(float));
+
+			char str[4];
+			d >> str;
+			assert(strcmp(str, "end") == 0);
+			assert(d.remaining() == 0 && !d.overflowed());
+
+			// Wrong type or number of elements is not decoded nor skipped
+			Deserializer w(mem, e.size());
+			float ftag = 0;
+			int64_t ltag = 0;
+			w >> ftag >> ltag;
+			assert(ftag == 0 && ltag == 0);
+			assert(w.remaining() == e.size() && !w.overflowed());
+			float two[2] = {0,0};
+			std::string ostr;
+			w >> otag >> two >> ostr;
+			assert(two[0] == 0 && two[1] == 0 && ostr.empty());
+			assert(w.remaining() == e.size() - serHeaderSize() - 4);
+
+			// Reading past the end, or an incomplete group, does nothing
+			d >> otag;
+			assert(d.overflowed());
+
+			Deserializer cut(mem, 2*serHeaderSize() + 4 + N*sizeof(float) - 1);
+			cut >> otag;
+			assert(cut.get(out, N+1) == 0);
+			assert(cut.overflowed());
+
+			Deserializer all(v.buf());
+			all >> otag;
+			assert(all.get(out, N+1) == uint32_t(N));
+			for(int i=0; i<N; ++i) assert(out[i] == in[i]);
+		}
 	}
 
 	return 0;
@@ -0,0 +1,156 @@
+#include "utAllocore.h"
+#include "allocore/protocol/al_StateReplication.hpp"
+
+namespace{
+
+struct State{
+	Pose pose;
+	int frame;
+	float field[20000];
+};
+
+void fillState(State& s, int frame){
+	s.pose.pos(frame, 2*frame, 3*frame);
+	s.frame = frame;
+	for(int i=0; i<20000; ++i){
+		s.field[i] = frame;
+	}
+}
+
+bool sameState(const State& a, const State& b){
+	return 0 == memcmp(&a, &b, sizeof(State));
+}
+
+} // ::
+
+int utProtocolStateReplication(){
+
+	const uint16_t port = 4120;
+	const char * addr = "127.0.0.1";
+	State * sent = new State;
+	State * recvd = new State;
+	memset(sent, 0, sizeof(State));
+
+	// Every frame arrives and matches the sent state, only changes cost bandwidth
+	{
+		StateSender sender(sizeof(State), port, addr);
+		StateReceiver receiver(sizeof(State), port, addr);
+		assert(sender.opened());
+		assert(receiver.opened());
+		assert(!receiver.state());
+
+		fillState(*sent, 0);
+		for(int i=0; i<20; ++i){
+			sent->frame = i;
+			sent->pose.pos().x = i * 0.5;
+			sent->field[(i * 997) % 20000] = i;
+			sender.send(sent);
+			assert(receiver.poll(0.5) == 1);
+			assert(receiver.update(*recvd));
+			assert(sameState(*sent, *recvd));
+			assert(receiver.frame() == sender.frame());
+		}
+		// Nothing new
+		assert(!receiver.update(*recvd));
+		assert(receiver.framesReceived() == 20);
+		assert(receiver.framesDropped() == 0);
+		assert(sender.stateBytes() == 20 * sizeof(State));
+		assert(sender.bytesSent() < sender.stateBytes() / 10);
+
+		// Full frames of incompressible data are split into MTU sized datagrams
+		for(int i=0; i<20000; ++i) sent->field[i] = rnd::uniform();
+		sender.mtu(1000).requestKeyframe().send(sent);
+		assert(sender.packetsSent() > 20 + sizeof(State) / 1000);
+		receiver.poll(0.5);
+		while(!receiver.newFrame()) receiver.poll(0.5);
+		assert(0 == memcmp(receiver.state(), sent, sizeof(State)));
+	}
+
+	// A receiver that missed frames waits for the next keyframe
+	{
+		StateSender sender(sizeof(State), port, addr);
+		sender.keyframeInterval(4);
+		for(int i=1; i<=5; ++i){
+			fillState(*sent, i);
+			sender.send(sent);
+		}
+		StateReceiver receiver(sizeof(State), port, addr);
+		for(int i=6; i<=9; ++i){
+			fillState(*sent, i);
+			sender.send(sent);
+			receiver.poll(0.5);
+			if(i < 9){ // 9 is a keyframe
+				assert(!receiver.newFrame());
+			}
+		}
+		assert(receiver.update(*recvd));
+		assert(recvd->frame == 9);
+		assert(receiver.framesDropped() == 3);
+		fillState(*sent, 10);
+		sender.send(sent);
+		receiver.poll(0.5);
+		assert(receiver.update(*recvd));
+		assert(sameState(*sent, *recvd));
+	}
+
+	// Datagrams with inconsistent sizes are ignored
+	{
+		StateReceiver receiver(sizeof(State), port, addr);
+		SocketClient forger(port, addr, 0, Socket::UDP|Socket::DGRAM);
+		// encoded size, offset, index, count, payload size
+		const uint32_t forged[][5] = {
+			{0xffffffff, 0, 0, 0xffffffff, 64},		// larger than state
+			{sizeof(State), 0, 0, 0x10000000, 64},	// too many fragments
+			{1000, 0, 0, 3, 100},					// too few fragments
+			{1000, 100, 1, 2, 100},					// last does not end frame
+			{1000, 0, 1, 10, 100}					// misplaced
+		};
+		uint8_t packet[32 + 100] = {0};
+		for(int i=0; i<5; ++i){
+			uint32_t header[7] = {
+				0x52534c41, 1, uint32_t(sizeof(State)),
+				forged[i][0], forged[i][1], forged[i][2], forged[i][3]
+			};
+			memcpy(packet, header, sizeof(header));
+			packet[28] = 1; // keyframe
+			assert(forger.send((const char *)packet, 32 + forged[i][4]));
+			assert(receiver.poll(0.5) == 0);
+		}
+		assert(receiver.framesDropped() == 0);
+
+		StateSender sender(sizeof(State), port, addr);
+		fillState(*sent, 1);
+		sender.send(sent);
+		assert(receiver.poll(0.5) == 1);
+		assert(receiver.update(*recvd));
+		assert(sameState(*sent, *recvd));
+	}
+
+	// Frames received on a background thread are always read whole
+	{
+		StateSender sender(sizeof(State), port, addr);
+		StateReceiver receiver(sizeof(State), port, addr);
+		assert(receiver.start());
+		int lastFrame = 0;
+		for(int i=1; i<=100; ++i){
+			fillState(*sent, i);
+			sender.send(sent);
+			if(receiver.newFrame()){
+				const State& s = *(const State *)receiver.state();
+				assert(s.frame > lastFrame);
+				for(int j=0; j<20000; ++j) assert(s.field[j] == s.frame);
+				lastFrame = s.frame;
+			}
+		}
+		for(int i=0; i<100 && lastFrame < 100; ++i){
+			al_sleep(0.01);
+			if(receiver.newFrame()) lastFrame = ((const State *)receiver.state())->frame;
+		}
+		receiver.stop();
+		assert(lastFrame == 100);
+	}
+
+	delete sent;
+	delete recvd;
+	return 0;
+}
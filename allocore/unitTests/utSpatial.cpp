@@ -1,4 +1,5 @@
 #include "utAllocore.h"
+#include "alloutil/al_VoxelStack.hpp"
 
 int utSpatial(){
 
@@ -17,5 +18,87 @@ int utSpatial(){
 		a.step(0.5);	assert(a.vec() == Vec3d(2.5,0,0));
 	}
 
+	// Batch composition
+	{
+		const int N = 100;
+		PoseArray parent(N), local(N), out;
+		for(int i=0; i<N; ++i){
+			Quatd q;
+			parent.set(i, Pose(Vec3d(i, 1, 2), q.fromAxisAngle(i*0.1, 0,0,1)));
+			local.set(i, Pose(Vec3d(1, -i, 3), q.fromAxisAngle(i*0.2, 1,0,0)));
+		}
+		compose(parent, local, out);
+		assert(out.size() == N);
+		for(int i=0; i<N; ++i){
+			Pose p = parent.get(i), l = local.get(i), o = out.get(i);
+			Vec3d pos = p.pos() + p.quat().rotate(l.pos());
+			Quatd quat = p.quat() * l.quat();
+			for(int k=0; k<3; ++k) assert(fabs(o.pos()[k] - pos[k]) < 1e-12);
+			for(int k=0; k<4; ++k) assert(fabs(o.quat()[k] - quat[k]) < 1e-12);
+		}
+
+		// In place
+		compose(parent, local, local);
+		for(int i=0; i<N; ++i){
+			assert(local.get(i).pos() == out.get(i).pos());
+			assert(local.get(i).quat() == out.get(i).quat());
+		}
+	}
+
+	// Rebuilt voxel stacks match stacks filled one item at a time
+	{
+		struct Item{ Vec3d pos; };
+		struct ItemPos{
+			const Vec3d& operator()(const Item& a) const { return a.pos; }
+		};
+
+		// Enough items for the pool to be used, with a wrapping 8^3 grid
+		// holding about 10 per voxel and one voxel holding many more
+		const int N = 5000;
+		std::vector<Item> items(N);
+		for(int i=0; i<N; ++i){
+			if(i % 50 == 0) items[i].pos = Vec3d(1.5, 2.5, 3.5);
+			else items[i].pos = Vec3d((i*7)%19 - 3, (i*13)%23 - 7, (i*5)%17);
+		}
+
+		VoxelStack<Item> stacked(8), rebuilt(8), pooled(8);
+		for(int i=0; i<N; ++i) stacked.set(items[i].pos, &items[i]);
+		rebuilt.rebuild(&items[0], N, ItemPos());
+		ThreadPool pool(3);
+		pooled.rebuild(&items[0], N, ItemPos(), &pool);
+
+		int full = 0;
+		for(int i=0; i<8*8*8; ++i){
+			int c = stacked.count(i);
+			if(c == VoxelStack<Item>::STACK_SIZE) ++full;
+			assert(rebuilt.count(i) == c);
+			assert(pooled.count(i) == c);
+			assert(rebuilt.at(i) == stacked.at(i));
+			assert(pooled.at(i) == stacked.at(i));
+			while(c--){
+				Item * v = stacked.pop(i);
+				assert(v);
+				assert(rebuilt.pop(i) == v);
+				assert(pooled.pop(i) == v);
+				assert(rebuilt.count(i) == c);
+				assert(pooled.count(i) == c);
+			}
+			assert(!rebuilt.at(i) && !rebuilt.pop(i));
+			assert(!pooled.at(i) && !pooled.pop(i));
+		}
+		assert(full > 1);
+
+		// Items set after a rebuild go on top
+		Item extra;
+		rebuilt.rebuild(&items[0], N, ItemPos());
+		int i = rebuilt.pos2voxelindex(items[1].pos);
+		while(rebuilt.count(i) > 2) rebuilt.pop(i);
+		Item * below = rebuilt.at(i);
+		rebuilt.set(i, &extra);
+		assert(rebuilt.count(i) == 3);
+		assert(rebuilt.pop(i) == &extra);
+		assert(rebuilt.pop(i) == below);
+	}
+
 	return 0;
 }
@@ -1,4 +1,8 @@
 #include "utAllocore.h"
+#include <vector>
+#ifndef AL_WINDOWS
+	#include <unistd.h>
+#endif
 
 template <class T>
 bool aboutEqual(T v, T to, T r){ return v<(to+r) && v>(to-r); }
@@ -50,5 +54,210 @@ int utSystem(){
 		assert(al_time_ns2s * tm.elapsed() == tm.elapsedSec());
 	}
 
+	// Real-time allocation
+	{
+		FixedPool pool(24, 4);
+		assert(pool.blockSize() == 32);
+		void * blocks[4];
+		for(int i=0; i<4; ++i){
+			blocks[i] = pool.alloc();
+			assert(blocks[i] && pool.owns(blocks[i]));
+		}
+		assert(pool.available() == 0);
+		assert(!pool.alloc());
+		pool.free(blocks[2]);
+		assert(pool.alloc() == blocks[2]);
+		for(int i=0; i<4; ++i) pool.free(blocks[i]);
+		assert(pool.available() == 4);
+	}
+
+	{	// Concurrent use of a pool from several threads
+		struct Worker{
+			static void * func(void * user){
+				FixedPool& pool = *(FixedPool *)user;
+				for(int i=0; i<10000; ++i){
+					int * a = (int *)pool.alloc();
+					int * b = (int *)pool.alloc();
+					if(a){ *a = i; }
+					if(b){ *b = -i; }
+					if(a){ assert(*a == i); pool.free(a); }
+					if(b){ assert(*b == -i); pool.free(b); }
+				}
+				return NULL;
+			}
+		};
+		FixedPool pool(64, 6);
+		Thread threads[3];
+		for(int i=0; i<3; ++i) threads[i].start(Worker::func, &pool);
+		for(int i=0; i<3; ++i) threads[i].join();
+		assert(pool.available() == 6);
+	}
+
+	{
+		ScratchArena arena(256);
+		float * a = arena.alloc<float>(10);
+		char * b = (char *)arena.alloc(1, 1);
+		double * c = arena.alloc<double>(4);
+		assert(a && b && c);
+		assert(((size_t)a & 15) == 0 && ((size_t)c & 15) == 0);
+		assert(b == (char *)(a+10) && (char *)c == (char *)a + 48);
+		assert(!arena.alloc(256));
+		assert(arena.overflows() == 1);
+		arena.reset();
+		assert(arena.used() == 0 && arena.highWater() == 80);
+		assert(arena.alloc<float>(10) == a);
+	}
+
+	{
+		RTAllocator rta(2, 1024);
+		assert(!RTAllocator::current());
+
+		// Size classes and fallback to heap
+		void * a = rta.allocate(60);
+		void * b = rta.allocate(200);
+		void * c = rta.allocate(100000);
+		assert(rta.pool(0).available() == 1 && rta.pool(1).available() == 1);
+		assert(rta.heapFallbacks() == 1);
+		void * d = rta.allocate(10);
+		void * e = rta.allocate(10);
+		assert(rta.pool(0).available() == 0 && rta.heapFallbacks() == 2);
+		RTAllocator::deallocate(a);
+		RTAllocator::deallocate(b);
+		RTAllocator::deallocate(c);
+		RTAllocator::deallocate(d);
+		RTAllocator::deallocate(e);
+		assert(rta.pool(0).available() == 2 && rta.pool(1).available() == 2);
+
+		// Only fallbacks within blocks are counted as block heap allocations
+		rta.beginBlock();
+		assert(RTAllocator::current() == &rta && rta.inBlock());
+		float * s = rta.scratch<float>(64);
+		assert(s && rta.scratchArena().used() == 256);
+		RTAllocator::free(RTAllocator::malloc(50000));
+		if(!RTAllocator::debugging()) assert(rta.heapAllocationsInBlock() == 1);
+		rta.endBlock();
+		assert(!rta.inBlock());
+		assert(!RTAllocator::current());
+		rta.beginBlock();
+		assert(rta.scratchArena().used() == 0);
+		rta.endBlock();
+
+		// Blocks restore the allocator current before them
+		RTAllocator other(1, 64);
+		other.makeCurrent();
+		rta.beginBlock();
+		assert(RTAllocator::current() == &rta);
+		rta.endBlock();
+		assert(RTAllocator::current() == &other && !other.inBlock());
+
+		// Containers and messages with the current allocator
+		rta.makeCurrent();
+		{
+			Buffer<float, RTAlloc<float> > buf(0, 8);
+			buf.append(1.f);
+			assert(buf.size() == 1 && buf[0] == 1.f);
+			assert(rta.pool(0).available() == 1);
+		}
+		assert(rta.pool(0).available() == 2);
+		{
+			struct Msg{
+				static void func(al_sec t, int * count){ ++*count; }
+			};
+			MsgQueue mq(4, RTAllocator::malloc, RTAllocator::free);
+			int count = 0;
+			mq.send(0.5, Msg::func, &count);
+			mq.update(1);
+			assert(count == 1);
+		}
+		RTAllocator::clearCurrent();
+		assert(!RTAllocator::current());
+	}
+
+	// Main loop
+	{
+		// Ticks are phase-locked to the interval under load
+		struct Ticker : public Main::Handler{
+			std::vector<al_sec> times;
+			void onTick(){
+				al_sec t = al_steady_time();
+				times.push_back(t);
+				while(al_steady_time() < t + 0.003){}	// synthetic load
+				if(times.size() == 50) Main::get().stop();
+			}
+		};
+
+		// Data on a file descriptor is handled between ticks
+		struct Reader : public Main::Handler, public Main::FDHandler{
+			int fds[2];
+			int ticks, readAt;
+			Reader(): ticks(0), readAt(0){}
+			void onTick(){
+				++ticks;
+				if(3 == ticks){
+					ssize_t n = write(fds[1], "x", 1);
+					assert(1 == n);
+				}
+				if(100 == ticks) Main::get().stop();
+			}
+			void onReadable(int fd){
+				char c = 0;
+				ssize_t n = read(fd, &c, 1);
+				assert(1 == n && 'x' == c);
+				readAt = ticks;
+				Main::get().stop();
+			}
+		};
+
+		Main& M = Main::get();
+		const al_sec interval = 0.01;
+		M.interval(interval);
+
+		std::vector<Main::Driver> drivers;
+		drivers.push_back(Main::SLEEP);
+		#ifdef AL_LINUX
+		drivers.push_back(Main::NATIVE);
+		#endif
+
+		for(unsigned i=0; i<drivers.size(); ++i){
+			M.driver(drivers[i]);
+			{
+				Ticker ticker;
+				M.add(ticker);
+				M.start();
+				M.remove(ticker);
+
+				// Ticks are due at multiples of the interval, so most of them
+				// stay close to one even if a busy machine delays some. If
+				// the load in each tick added to the period, ticks would move
+				// by 0.3 intervals each time and few would be close.
+				const std::vector<al_sec>& t = ticker.times;
+				unsigned onTime = 0;
+				for(unsigned k=1; k<t.size(); ++k){
+					assert(t[k] > t[k-1]);
+					al_sec jitter = fmod(t[k] - t.front(), interval);
+					if(jitter < interval*0.1 || jitter > interval*0.9) ++onTime;
+				}
+				assert(onTime >= t.size()/2);
+			}
+
+			#ifndef AL_WINDOWS
+			{
+				Reader reader;
+				int r = pipe(reader.fds);
+				assert(0 == r);
+				M.add(reader);
+				M.watch(reader.fds[0], reader);
+				M.start();
+				M.remove(reader);
+				M.unwatch(reader);
+				assert(3 == reader.readAt);
+				close(reader.fds[0]);
+				close(reader.fds[1]);
+			}
+			#endif
+		}
+		M.driver(Main::SLEEP);
+	}
+
 	return 0;
 }
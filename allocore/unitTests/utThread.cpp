@@ -1,4 +1,5 @@
 #include "utAllocore.h"
+#include <vector>
 
 void * threadFunc(void * user){
 	*(int *)user = 1; return NULL;
@@ -54,5 +55,72 @@ int utThread() {
 		assert(1 == x);
 	}
 
+	// Thread pool
+	{
+		ThreadPool pool(4);
+		assert(pool.size() == 4);
+
+		// Each index is visited exactly once, including negative ones
+		const int N = 10000;
+		std::vector<int> visits(N, 0);
+		pool.parallelFor(-N/2, N/2, [&](int begin, int end){
+			for(int i=begin; i<end; ++i) ++visits[i + N/2];
+		}, 7);
+		for(int i=0; i<N; ++i) assert(1 == visits[i]);
+
+		// Uneven work is still complete
+		std::vector<double> out(1000, 0);
+		pool.parallelFor(0, 1000, [&](int begin, int end){
+			for(int i=begin; i<end; ++i){
+				double v = 0;
+				for(int j=0; j<(i<100 ? 10000 : 10); ++j) v += 1;
+				out[i] = v;
+			}
+		});
+		for(int i=0; i<1000; ++i) assert(out[i] == (i<100 ? 10000 : 10));
+
+		long long sum = pool.parallelReduce(0, 100000, 0LL,
+			[](int begin, int end){
+				long long s = 0;
+				for(int i=begin; i<end; ++i) s += i;
+				return s;
+			},
+			[](long long a, long long b){ return a + b; }
+		);
+		assert(sum == 100000LL * 99999 / 2);
+
+		// A loop within a loop runs in the calling thread
+		std::vector<int> inner(64*64, 0);
+		pool.parallelFor(0, 64, [&](int begin, int end){
+			for(int i=begin; i<end; ++i){
+				pool.parallelFor(0, 64, [&](int b, int e){
+					for(int j=b; j<e; ++j) ++inner[i*64 + j];
+				});
+			}
+		}, 1);
+		for(int i=0; i<64*64; ++i) assert(1 == inner[i]);
+
+		// Empty ranges and a pool of only the calling thread
+		pool.parallelFor(5, 5, [](int, int){ assert(false); });
+		ThreadPool single(1);
+		int count = single.parallelReduce(0, 10, 0, [](int b, int e){ return e-b; }, [](int a, int b){ return a+b; });
+		assert(10 == count);
+
+		// Loops started from several threads run one after the other
+		struct Caller{
+			static void * func(void * user){
+				ThreadPool& pool = *(ThreadPool *)user;
+				for(int k=0; k<20; ++k){
+					int n = pool.parallelReduce(0, 5000, 0, [](int b, int e){ return e-b; }, [](int a, int b){ return a+b; });
+					assert(5000 == n);
+				}
+				return NULL;
+			}
+		};
+		Thread callers[3];
+		for(int i=0; i<3; ++i) callers[i].start(Caller::func, &pool);
+		for(int i=0; i<3; ++i) callers[i].join();
+	}
+
 	return 0;
 }
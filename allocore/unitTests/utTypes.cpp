@@ -286,6 +286,152 @@ int utTypes(){
 		assert(a.read(3) == 2);
 	}
 
+	// Color arrays
+	{
+		auto near = [](const float * a, const float * b, float eps){
+			return fabs(a[0]-b[0]) <= eps && fabs(a[1]-b[1]) <= eps && fabs(a[2]-b[2]) <= eps;
+		};
+
+		// Grid of colors in [0, 1], including grays and primaries
+		const int M = 17;
+		const int N = M*M*M;
+		std::vector<RGB> rgb(N);
+		for(int i=0; i<N; ++i){
+			rgb[i].set(float(i%M)/(M-1), float(i/M%M)/(M-1), float(i/(M*M))/(M-1));
+		}
+
+		std::vector<HSV> hsv(N);
+		convert(&rgb[0], &hsv[0], N);
+		for(int i=0; i<N; ++i){
+			HSV v = rgb[i];
+			assert(near(hsv[i].components, v.components, 1e-6));
+		}
+
+		std::vector<RGB> rgb2(N);
+		convert(&hsv[0], &rgb2[0], N);
+		for(int i=0; i<N; ++i){
+			RGB v = hsv[i];
+			assert(near(rgb2[i].components, v.components, 1e-5));
+			assert(near(rgb2[i].components, rgb[i].components, 1e-5));
+		}
+
+		{	// hues wrap around
+			HSV h[2] = { HSV(1.25, 0.5, 0.8), HSV(-0.75, 0.5, 0.8) };
+			RGB c[2];
+			convert(h, c, 2);
+			RGB v = HSV(0.25, 0.5, 0.8);
+			assert(near(c[0].components, v.components, 1e-5));
+			assert(near(c[1].components, v.components, 1e-5));
+		}
+
+		std::vector<CIEXYZ> xyz(N);
+		convert(&rgb[0], &xyz[0], N);
+		for(int i=0; i<N; ++i){
+			CIEXYZ v = rgb[i];
+			assert(near(xyz[i].components, v.components, 1e-5));
+		}
+
+		convert(&xyz[0], &rgb2[0], N);
+		for(int i=0; i<N; ++i){
+			RGB v = xyz[i];
+			assert(near(rgb2[i].components, v.components, 1e-5));
+		}
+
+		std::vector<Lab> lab(N);
+		convert(&rgb[0], &lab[0], N);
+		for(int i=0; i<N; ++i){
+			Lab v = CIEXYZ(rgb[i]);
+			assert(near(lab[i].components, v.components, 1e-3));
+		}
+
+		convert(&lab[0], &rgb2[0], N);
+		for(int i=0; i<N; ++i){
+			RGB v = lab[i];
+			assert(near(rgb2[i].components, v.components, 1e-5));
+			assert(near(rgb2[i].components, rgb[i].components, 3e-3));
+		}
+
+		{	// alpha is left as it is, in place
+			std::vector<Color> col(N, Color(0,0,0,0.5));
+			for(int i=0; i<N; ++i) col[i].rgb() = rgb[i];
+			float * c = col[0].components;
+			rgbToLab(c, c, N, 4, 4);
+			labToRGB(c, c, N, 4, 4);
+			for(int i=0; i<N; ++i){
+				assert(col[i].a == 0.5);
+				assert(near(col[i].components, rgb[i].components, 3e-3));
+			}
+		}
+
+		{	// threads split the array, with the same results
+			ThreadPool pool(4);
+			const int N4 = N*4;
+			std::vector<RGB> big(N4), big2(N4);
+			for(int i=0; i<N4; ++i) big[i] = rgb[i%N];
+			std::vector<Lab> labs(N4);
+			convert(&big[0], &labs[0], N4, &pool);
+			convert(&labs[0], &big2[0], N4, &pool);
+			for(int i=0; i<N4; ++i){
+				assert(near(labs[i].components, lab[i%N].components, 0));
+				assert(near(big2[i].components, rgb2[i%N].components, 0));
+			}
+		}
+
+		{	// Arrays
+			Array src(3, AlloFloat32Ty, M, M*M);
+			memcpy(src.data.ptr, &rgb[0], N*sizeof(RGB));
+			Array dst;
+			assert(convertColors(rgbToHSV, src, dst));
+			assert(dst.isType<float>() && dst.components() == 3);
+			assert(dst.width() == unsigned(M) && dst.height() == unsigned(M*M));
+			for(int i=0; i<N; ++i){
+				assert(near(&dst.elem<float>(0, i%M, i/M), hsv[i].components, 0));
+			}
+
+			// Keeps format of destination with room for the colors
+			Array rgba(4, AlloFloat32Ty, M, M*M);
+			rgba.zero();
+			assert(convertColors(rgbToHSV, src, rgba));
+			assert(rgba.components() == 4);
+			assert(near(&rgba.elem<float>(0, 5, 7), hsv[7*M+5].components, 0));
+			assert(rgba.elem<float>(3, 5, 7) == 0);
+
+			Array ints(3, AlloSInt32Ty, M);
+			assert(!convertColors(rgbToHSV, ints, dst));
+		}
+
+		{	// Colormaps
+			Color table[3] = { Color(0,0,0,1), Color(1,0,0,1), Color(1,1,0,0) };
+			float values[8] = { -1, 0, 0.5, 1, 1.5, 2, 4, NAN };
+			Color c[8];
+			colormap(values, c, 8, table, 3, 0, 2);
+			assert(c[0] == table[0]);
+			assert(c[1] == table[0]);
+			assert(c[2] == Color(0.5,0,0,1));
+			assert(c[3] == table[1]);
+			assert(c[4] == Color(1,0.5,0,0.5));
+			assert(c[5] == table[2]);
+			assert(c[6] == table[2]);
+			assert(c[7] == table[0]);
+
+			Colori ci[8];
+			colormap(values, ci, 8, table, 3, 0, 2);
+			for(int i=0; i<8; ++i) assert(ci[i].rgba == Colori(c[i]).rgba);
+
+			Array v(1, AlloFloat32Ty, 4, 2);
+			memcpy(v.data.ptr, values, sizeof(values));
+			Array tex(4, AlloUInt8Ty, 4, 2);
+			assert(colormap(v, tex, table, 3, 0, 2));
+			assert(tex.components() == 4 && tex.isType<uint8_t>());
+			assert(tex.as<Colori>(0, 1).rgba == ci[4].rgba);
+
+			Array col;
+			assert(colormap(v, col, table, 3, 0, 2));
+			assert(col.components() == 4 && col.isType<float>());
+			assert(col.as<Color>(0, 1) == c[4]);
+		}
+	}
+
 	return 0;
 }
 
@@ -42,11 +42,168 @@
 	Lance Putnam, 2014, putnam.lance@gmail.com
 */
 
+#include <atomic>
+#include <mutex>
+#include <vector>
 #include "allocore/system/al_PeriodicThread.hpp"
 #include "allocv/al_OpenCV.hpp"
 
 namespace al{
 
+class VideoFramePool;
+
+
+/// Video frame owned by a VideoFramePool
+class VideoFrame{
+public:
+
+	/// Get pixel data
+	const Array& array() const { return mArray; }
+
+	/// Get a cv::Mat referencing the pixel data (no copying)
+	cv::Mat cvMat() const { return toCV(mArray); }
+
+	/// Get time, in seconds of al_steady_time(), when frame was captured
+	double time() const { return mTime; }
+
+	/// Get sequence number of frame, starting from 1
+	uint64_t number() const { return mNumber; }
+
+private:
+	friend class VideoFramePool;
+	friend class VideoFrameRef;
+	friend class VideoCapture;
+	Array mArray;
+	double mTime;
+	uint64_t mNumber;
+	std::atomic<int> mRefs;
+	bool mQueued, mWriting;
+	VideoFrame();
+};
+
+
+/// Reference counted handle to a VideoFrame
+
+/// The frame is returned to its pool when the last handle to it is destroyed.
+/// Handles must not outlive the pool.
+class VideoFrameRef{
+public:
+	VideoFrameRef(): mFrame(NULL){}
+	VideoFrameRef(const VideoFrameRef& r);
+	~VideoFrameRef(){ release(); }
+
+	VideoFrameRef& operator= (const VideoFrameRef& r);
+
+	/// Release the frame
+	void release();
+
+	/// Whether the handle references a frame
+	bool valid() const { return NULL != mFrame; }
+	operator bool() const { return valid(); }
+
+	const VideoFrame& operator* () const { return *mFrame; }
+	const VideoFrame * operator->() const { return mFrame; }
+
+private:
+	friend class VideoFramePool;
+	VideoFrame * mFrame;
+	explicit VideoFrameRef(VideoFrame * f): mFrame(f){}
+};
+
+
+/// Fixed set of reusable video frames passed from a capture thread to consumers
+
+/// Frames are decoded directly into the pool's storage and handed to
+/// consumers by reference, so the pixel data is never copied after
+/// decoding and no memory is allocated once the frame format is known.
+/// When consumers fall behind, the oldest unread frame is recycled for the
+/// next capture (drop-oldest). Frames held by consumers are never
+/// overwritten; if all frames are held, new captures are skipped.
+class VideoFramePool{
+public:
+
+	/// Capture and delivery statistics
+	struct Stats{
+		uint64_t captured;		///< Frames captured
+		uint64_t delivered;		///< Frames handed to consumers
+		uint64_t dropped;		///< Captured frames never delivered
+		uint64_t skipped;		///< Captures skipped because all frames were held
+		double fps;				///< Smoothed capture rate, in frames/second
+		double latency;			///< Smoothed capture to delivery time, in seconds
+		double maxLatency;		///< Maximum capture to delivery time, in seconds
+	};
+
+
+	/// @param[in] numFrames	number of frames in pool (at least 2)
+	VideoFramePool(int numFrames = 3);
+
+	~VideoFramePool();
+
+
+	/// Set number of frames in pool
+
+	/// This must not be called while frames are being captured or held.
+	///
+	VideoFramePool& numFrames(int n);
+
+	/// Get number of frames in pool
+	int numFrames() const { return int(mFrames.size()); }
+
+	/// Get number of captured frames not yet delivered
+	int numReady() const;
+
+
+	/// Get the newest captured frame, dropping older undelivered frames
+
+	/// \returns an invalid handle if no frame was captured since the last call
+	///
+	VideoFrameRef latest();
+
+	/// Get the oldest undelivered frame
+
+	/// \returns an invalid handle if there are no undelivered frames
+	///
+	VideoFrameRef next();
+
+
+	/// Get a copy of the statistics
+	Stats stats() const;
+
+	/// Reset statistics
+	void resetStats();
+
+
+	/// Get a frame to capture into (capture thread only)
+
+	/// \returns NULL if all frames are held by consumers
+	///
+	VideoFrame * beginWrite();
+
+	/// Finish a capture started with beginWrite()
+
+	/// @param[in] frame	frame returned from beginWrite()
+	/// @param[in] valid	whether a frame was decoded; if false, the frame
+	///						is returned to the pool
+	void endWrite(VideoFrame * frame, bool valid = true);
+
+private:
+	friend class VideoFrameRef;
+	mutable std::mutex mMutex;
+	std::vector<VideoFrame *> mFrames;
+	std::vector<VideoFrame *> mReady;	// ring of captured frames
+	int mReadyBegin, mReadyCount;
+	Stats mStats;
+	double mLastCapture;
+
+	VideoFrame * popReady(bool newest);
+	VideoFrameRef deliver(VideoFrame * f);
+	void clear();
+
+	VideoFramePool(const VideoFramePool&);
+	VideoFramePool& operator=(const VideoFramePool&);
+};
+
+
 /// Video capture from files or cameras
 
 /// This is basically a direct wrapper around cv::VideoCapture.
@@ -129,6 +286,19 @@ public:
 	/// disconnected, or there are no more frames in video file).
 	bool retrieveFlip(Array& dst, int chan=0);
 
+	/// Decodes the grabbed video frame into a frame of a pool
+
+	/// The frame is decoded directly into the pool's storage when the
+	/// backend supports it, otherwise it is copied once. Rows are in the same
+	/// order as OpenCV's.
+	///
+	/// @param[in] pool			the pool to decode into
+	/// @param[in] chan			the video channel to retrieve
+	///
+	/// \returns false if no frame has been grabbed or all frames of the pool
+	/// are held by consumers.
+	bool retrieve(VideoFramePool& pool, int chan=0);
+
 	/// Grabs, decodes and returns the next video frame
 
 	/// @param[in] dst			the array to copy the frame into
@@ -240,6 +410,11 @@ private:
 
 
 /// Handler for one or more video capture threads
+
+/// Each stream has a VideoFramePool. When frame pools are enabled, every
+/// grabbed frame is decoded into the stream's pool on the capture thread
+/// before onVideo() is called, and other threads can then read frames with
+/// framePool(streamIdx).latest() without copying.
 class VideoCaptureHandler{
 public:
 
@@ -271,7 +446,7 @@ public:
 
 
 	/// Called whenever new video frame(s) are ready
-	virtual void onVideo(VideoCapture& vid, int streamIdx) = 0;
+	virtual void onVideo(VideoCapture& vid, int streamIdx){}
 
 	/// Called just before a grab is attempted
 
@@ -292,6 +467,12 @@ public:
 	/// @param[in] streamIdx	stream index (must be <= numStreams())
 	VideoCaptureHandler& attach(VideoCapture& vid, int streamIdx=0);
 
+	/// Set whether grabbed frames are decoded into the streams' frame pools
+	VideoCaptureHandler& useFramePools(bool v);
+
+	/// Get frame pool of a stream
+	VideoFramePool& framePool(int streamIdx=0){ return *mFramePools[streamIdx]; }
+
 	/// Start the video thread(s)
 	void startVideo();
 
@@ -300,6 +481,8 @@ public:
 
 private:
 	WorkThreads mWorkThreads;
+	std::vector<VideoFramePool *> mFramePools;
+	bool mUseFramePools;
 };
 
 } // al::
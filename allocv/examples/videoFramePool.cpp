@@ -0,0 +1,76 @@
+/*
+AlloCV Example: Video Frame Pool
+
+Description:
+This shows how to receive video frames without copying them. The capture
+thread decodes each frame into a pool of reusable frames and the graphics
+thread reads the newest one. If drawing falls behind, older frames are
+dropped. Capture and delivery statistics are printed every few seconds.
+*/
+
+#include "allocv/al_VideoCapture.hpp"
+#include "allocore/io/al_App.hpp"
+using namespace al;
+
+
+class MyApp : public App, public VideoCaptureHandler{
+public:
+
+	al::VideoCapture vid;
+	VideoFrameRef frame;
+	Texture texture;
+	double statsTime;
+
+	MyApp(): statsTime(0){
+
+		vid.open(RUN_MAIN_SOURCE_PATH "beetle.mp4");
+		vid.print();
+
+		// Decode frames into a pool of three frames
+		framePool().numFrames(3);
+		useFramePools(true);
+		attach(vid);
+		startVideo();
+
+		nav().pos(0,0,4);
+		initWindow();
+	}
+
+	// Called on the capture thread after a frame was added to the pool
+	void onVideo(VideoCapture& vidcap, int streamIdx){
+		vidcap.loop();
+	}
+
+	virtual void onAnimate(double dt){
+		VideoFrameRef newest = framePool().latest();
+		if(newest){
+			// Holding the frame keeps it from being overwritten
+			frame = newest;
+			const Array& arr = frame->array();
+			texture.submit(arr, texture.width() != arr.width());
+			texture.format(Graphics::BGR);
+		}
+
+		statsTime += dt;
+		if(statsTime > 4){
+			statsTime = 0;
+			VideoFramePool::Stats s = framePool().stats();
+			printf("%.1f fps, latency %.1f ms (max %.1f ms), %llu captured, %llu dropped, %llu skipped\n",
+				s.fps, s.latency*1000, s.maxLatency*1000,
+				(unsigned long long)s.captured,
+				(unsigned long long)s.dropped,
+				(unsigned long long)s.skipped
+			);
+		}
+	}
+
+	virtual void onDraw(Graphics& g, const Viewpoint& v){
+		// Frame rows are top to bottom, so flip vertically
+		texture.quad(g, 4./3, -1, -2./3, 0.5);
+	}
+};
+
+
+int main(){
+	MyApp().start();
+}
@@ -1,3 +1,4 @@
+#include "allocore/system/al_Time.hpp"
 #include "allocv/al_VideoCapture.hpp"
 
 /*
@@ -40,6 +41,156 @@ protected:
 namespace al{
 
 
+VideoFrame::VideoFrame()
+:	mTime(0), mNumber(0), mRefs(0), mQueued(false), mWriting(false)
+{}
+
+
+VideoFrameRef::VideoFrameRef(const VideoFrameRef& r)
+:	mFrame(r.mFrame)
+{
+	if(mFrame) ++mFrame->mRefs;
+}
+
+VideoFrameRef& VideoFrameRef::operator= (const VideoFrameRef& r){
+	if(r.mFrame) ++r.mFrame->mRefs;
+	release();
+	mFrame = r.mFrame;
+	return *this;
+}
+
+void VideoFrameRef::release(){
+	// Once unreferenced and not queued, a frame can be reused by the pool
+	if(mFrame) --mFrame->mRefs;
+	mFrame = NULL;
+}
+
+
+VideoFramePool::VideoFramePool(int n)
+:	mReadyBegin(0), mReadyCount(0)
+{
+	numFrames(n);
+}
+
+VideoFramePool::~VideoFramePool(){
+	clear();
+}
+
+void VideoFramePool::clear(){
+	for(unsigned i=0; i<mFrames.size(); ++i) delete mFrames[i];
+	mFrames.clear();
+	mReady.clear();
+	mReadyBegin = mReadyCount = 0;
+}
+
+VideoFramePool& VideoFramePool::numFrames(int n){
+	if(n < 2) n = 2;
+	std::lock_guard<std::mutex> lock(mMutex);
+	clear();
+	for(int i=0; i<n; ++i) mFrames.push_back(new VideoFrame);
+	mReady.resize(n);
+	resetStats();
+	return *this;
+}
+
+int VideoFramePool::numReady() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mReadyCount;
+}
+
+VideoFramePool::Stats VideoFramePool::stats() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+void VideoFramePool::resetStats(){
+	Stats s = {0,0,0,0, 0.,0.,0.};
+	mStats = s;
+	mLastCapture = -1;
+}
+
+VideoFrame * VideoFramePool::popReady(bool newest){
+	if(!mReadyCount) return NULL;
+	VideoFrame * f;
+	if(newest){
+		f = mReady[(mReadyBegin + mReadyCount - 1) % mReady.size()];
+	}
+	else{
+		f = mReady[mReadyBegin];
+		mReadyBegin = (mReadyBegin + 1) % mReady.size();
+	}
+	--mReadyCount;
+	f->mQueued = false;
+	return f;
+}
+
+VideoFrameRef VideoFramePool::deliver(VideoFrame * f){
+	if(!f) return VideoFrameRef();
+	++f->mRefs;
+	++mStats.delivered;
+	double latency = al_steady_time() - f->mTime;
+	mStats.latency = mStats.delivered > 1 ? mStats.latency + 0.1*(latency - mStats.latency) : latency;
+	if(latency > mStats.maxLatency) mStats.maxLatency = latency;
+	return VideoFrameRef(f);
+}
+
+VideoFrameRef VideoFramePool::latest(){
+	std::lock_guard<std::mutex> lock(mMutex);
+	VideoFrame * f = popReady(true);
+	if(f){
+		mStats.dropped += mReadyCount;
+		while(mReadyCount) popReady(false);
+	}
+	return deliver(f);
+}
+
+VideoFrameRef VideoFramePool::next(){
+	std::lock_guard<std::mutex> lock(mMutex);
+	return deliver(popReady(false));
+}
+
+VideoFrame * VideoFramePool::beginWrite(){
+	std::lock_guard<std::mutex> lock(mMutex);
+	for(unsigned i=0; i<mFrames.size(); ++i){
+		VideoFrame * f = mFrames[i];
+		if(!f->mQueued && !f->mWriting && 0 == f->mRefs){
+			f->mWriting = true;
+			return f;
+		}
+	}
+	// Recycle the oldest frame no one has read
+	VideoFrame * f = popReady(false);
+	if(f){
+		++mStats.dropped;
+		f->mWriting = true;
+	}
+	else{
+		++mStats.skipped;
+	}
+	return f;
+}
+
+void VideoFramePool::endWrite(VideoFrame * f, bool valid){
+	std::lock_guard<std::mutex> lock(mMutex);
+	f->mWriting = false;
+	if(!valid) return;
+
+	double now = al_steady_time();
+	f->mTime = now;
+	f->mNumber = ++mStats.captured;
+	if(mLastCapture >= 0 && now > mLastCapture){
+		double fps = 1./(now - mLastCapture);
+		mStats.fps = mStats.fps > 0 ? mStats.fps + 0.1*(fps - mStats.fps) : fps;
+	}
+	mLastCapture = now;
+
+	f->mQueued = true;
+	mReady[(mReadyBegin + mReadyCount) % mReady.size()] = f;
+	++mReadyCount;
+}
+
+
+
 VideoCapture::VideoCapture()
 :	mFPS(1.), mRate(1.), mBadFrame(-1), mIsFile(false), mValid(true)
 {}
@@ -110,6 +261,25 @@ bool VideoCapture::retrieve(Array& dst, int chan, int copyPolicy){
 	return res;
 }
 
+bool VideoCapture::retrieve(VideoFramePool& pool, int chan){
+	VideoFrame * f = pool.beginWrite();
+	if(!f) return false;
+
+	// Let OpenCV write into the frame's memory. If the format differs (e.g.,
+	// on the first frame) or the backend hands back its own buffer, the
+	// frame is reformatted and copied once.
+	Array& arr = f->mArray;
+	cv::Mat mat;
+	if(arr.hasData()) mat = toCV(arr);
+	bool res = cvVideoCapture.retrieve(mat, chan);
+	if(res && (void *)mat.data != (void *)arr.data.ptr){
+		fromCV(arr, mat);
+	}
+
+	pool.endWrite(f, res);
+	return res;
+}
+
 bool VideoCapture::retrieveFlip(Array& dst, int chan){
 	return retrieve(dst, chan, -1);
 }
@@ -267,6 +437,9 @@ void VideoCaptureHandler::VideoThreadFunction::operator()(){
 	if(NULL != videoCapture && videoCapture->mValid && videoCapture->cvVideoCapture.isOpened()){
 		handler->onPregrab(*videoCapture, streamIdx);
 		if(videoCapture->grab()){
+			if(handler->mUseFramePools){
+				videoCapture->retrieve(handler->framePool(streamIdx));
+			}
 			handler->onVideo(*videoCapture, streamIdx);
 			double fps = videoCapture->fps() * videoCapture->rate();
 			handler->mWorkThreads[streamIdx].thread.period(1./fps);
@@ -289,16 +462,28 @@ void VideoCaptureHandler::WorkThread::stop(){
 }
 
 
-VideoCaptureHandler::VideoCaptureHandler(int numStreams){
+VideoCaptureHandler::VideoCaptureHandler(int numStreams)
+:	mUseFramePools(false)
+{
 	numVideoStreams(numStreams);
 }
 
 VideoCaptureHandler::~VideoCaptureHandler(){
 	stopVideo();
+	numVideoStreams(0);
 }
 
 VideoCaptureHandler& VideoCaptureHandler::numVideoStreams(int num){
 	mWorkThreads.resize(num);
+	for(int i=num; i<int(mFramePools.size()); ++i) delete mFramePools[i];
+	int oldNum = int(mFramePools.size());
+	mFramePools.resize(num);
+	for(int i=oldNum; i<num; ++i) mFramePools[i] = new VideoFramePool;
+	return *this;
+}
+
+VideoCaptureHandler& VideoCaptureHandler::useFramePools(bool v){
+	mUseFramePools = v;
 	return *this;
 }
 
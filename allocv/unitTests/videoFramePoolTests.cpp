@@ -0,0 +1,157 @@
+
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#include "allocv/al_VideoCapture.hpp"
+#include "allocore/system/al_Time.hpp"
+
+using namespace al;
+
+// Capture a frame into the pool as the capture thread would
+static VideoFrame * capture(VideoFramePool &pool)
+{
+	VideoFrame * f = pool.beginWrite();
+	if (f) {
+		pool.endWrite(f);
+	}
+	return f;
+}
+
+void ut_write_read(void)
+{
+	VideoFramePool pool(3);
+	assert(pool.numFrames() == 3);
+	assert(pool.numReady() == 0);
+	assert(!pool.next());
+	assert(!pool.latest());
+
+	// Frames are delivered in capture order
+	capture(pool);
+	capture(pool);
+	assert(pool.numReady() == 2);
+	VideoFrameRef a = pool.next();
+	assert(a && a->number() == 1);
+	VideoFrameRef b = pool.next();
+	assert(b && b->number() == 2);
+	assert(!pool.next());
+
+	// A capture that decoded nothing is not delivered
+	VideoFrame * f = pool.beginWrite();
+	assert(f);
+	pool.endWrite(f, false);
+	assert(pool.numReady() == 0);
+	assert(pool.stats().captured == 2);
+	assert(pool.beginWrite() == f);
+	pool.endWrite(f);
+	assert(pool.next()->number() == 3);
+
+	VideoFramePool::Stats s = pool.stats();
+	assert(s.captured == 3);
+	assert(s.delivered == 3);
+	assert(s.dropped == 0);
+	assert(s.skipped == 0);
+}
+
+void ut_drop_oldest(void)
+{
+	VideoFramePool pool(3);
+
+	// With all frames unread, the oldest is recycled for the next capture
+	VideoFrame * first = capture(pool);
+	capture(pool);
+	capture(pool);
+	assert(pool.numReady() == 3);
+	assert(capture(pool) == first);
+	assert(pool.numReady() == 3);
+	assert(pool.stats().dropped == 1);
+	assert(pool.next()->number() == 2);
+
+	// latest() drops the frames it skips over
+	VideoFrameRef r = pool.latest();
+	assert(r->number() == 4);
+	assert(pool.numReady() == 0);
+	assert(pool.stats().dropped == 2);
+	assert(pool.stats().delivered == 2);
+}
+
+void ut_refcount(void)
+{
+	VideoFramePool pool(2);
+
+	capture(pool);
+	VideoFrameRef a = pool.next();
+	capture(pool);
+	VideoFrameRef b = pool.latest();
+	assert(a && b);
+	const VideoFrame * held = &*a;
+
+	// Held frames are never written; with all frames held, captures are skipped
+	assert(pool.beginWrite() == NULL);
+	assert(pool.stats().skipped == 1);
+
+	// The frame returns to the pool only when its last handle goes away
+	VideoFrameRef c = a;
+	a.release();
+	assert(!a);
+	assert(pool.beginWrite() == NULL);
+	{
+		VideoFrameRef d;
+		d = c;
+		c = VideoFrameRef();
+		assert(pool.beginWrite() == NULL);
+	}
+	assert(pool.stats().skipped == 3);
+	VideoFrame * f = pool.beginWrite();
+	assert(f == held);
+	pool.endWrite(f);
+	assert(pool.latest()->number() == 3);
+}
+
+void ut_stats(void)
+{
+	VideoFramePool pool(3);
+
+	// Captures 10 ms apart run at no more than 100 frames/second
+	capture(pool);
+	al_sleep(0.01);
+	capture(pool);
+	al_sleep(0.01);
+	VideoFramePool::Stats s = pool.stats();
+	assert(s.fps > 0 && s.fps <= 100.01);
+	assert(s.latency == 0 && s.maxLatency == 0);
+
+	// Latency is the time from capture to delivery
+	pool.next();
+	s = pool.stats();
+	assert(s.latency >= 0.02);
+	assert(s.maxLatency == s.latency);
+	pool.next();
+	s = pool.stats();
+	assert(s.latency >= 0.01);
+	assert(s.maxLatency >= 0.02);
+	assert(s.latency < s.maxLatency);
+
+	pool.resetStats();
+	s = pool.stats();
+	assert(s.captured == 0 && s.delivered == 0);
+	assert(s.dropped == 0 && s.skipped == 0);
+	assert(s.fps == 0 && s.latency == 0 && s.maxLatency == 0);
+}
+
+
+#define RUNTEST(Name)\
+	printf("%s ", #Name);\
+	ut_##Name();\
+	for(size_t i=0; i<32-strlen(#Name); ++i) printf(".");\
+	printf(" pass\n")
+
+int main(int argc, char *argv[])
+{
+	RUNTEST(write_read);
+	RUNTEST(drop_oldest);
+	RUNTEST(refcount);
+	RUNTEST(stats);
+
+	return 0;
+}
@@ -53,6 +53,12 @@
 
 	Sub-class FileWatcher and implement the onFileWatch() method.
 	Register for notifications of files using the watch() method(s)
+
+	Where the OS reports changes to files (inotify on Linux), the directories
+	of watched files are watched and changes are handled by the MainLoop as
+	soon as they are reported, without any polling. Several changes to a file
+	reported together result in one notification. Other files are checked by
+	poll() and pollAll(), e.g. periodically with autoPoll().
 */
 
 namespace al {
@@ -81,13 +87,18 @@ public:
 	virtual void onFileWatch(File& file) = 0;
 
 	/// trigger notifications from modified files:
-	/// (affects only this FileWatcher):
+	/// (affects only this FileWatcher, except for changes already reported
+	/// by the OS, which are delivered to all FileWatchers)
 	void poll();
 
 	/// trigger notifications from modified files:
 	/// (global, affecting all FileWatchers)
 	static void pollAll();
 
+	/// whether the OS reports changes to files, so that polling is only
+	/// needed for files whose directories could not be watched
+	static bool native();
+
 	/// start/stop automatic background polling (using MainLoop):
 	/// use period <= 0 to stop polling
 	static void autoPoll(al_sec period);
@@ -48,6 +48,7 @@
 #include "allocore/io/al_File.hpp"
 #include "allocore/system/al_Watcher.hpp"
 #include "allocore/graphics/al_Shader.hpp"
+#include "alloutil/al_FileWatcher.hpp"
 //#include "alloutil/al_Lua.hpp" // removed lua dependency
 
 #include <map>
@@ -58,6 +59,11 @@ namespace al {
 
 
 
+/// Loads text files and reloads them when they change
+
+/// Files that are found are watched with a FileWatcher, so where the OS
+/// reports changes they are reloaded as soon as the MainLoop handles the
+/// report; other files are checked by poll().
 class ResourceManager {
 public:
 	struct FileInfo {
@@ -66,10 +72,12 @@ public:
 		al_sec modified;
 		bool loaded;	// flag signals when file has been read
 
-		FileInfo() : modified(0) {}
-		FileInfo(const FileInfo& cpy) : path(cpy.path), modified(cpy.modified) {}
+		FileInfo() : modified(0), loaded(false) {}
+		FileInfo(const FileInfo& cpy) : path(cpy.path), modified(cpy.modified), loaded(false) {}
 	};
 
+	ResourceManager();
+
 	///! returns "" if the file cannot be found
 	std::string find(std::string filename);
 
@@ -87,7 +95,8 @@ public:
 	std::string data(std::string filename);
 
 	///! updates the modified/changed flags of all files in the filemap:
-	/// returns true if any of them changed
+	/// returns true if any of them changed since the last poll,
+	/// including files reloaded when the OS reported changes
 	bool poll();
 
 
@@ -100,6 +109,22 @@ protected:
 	///! map of filenames to FileInfo structures:
 	typedef std::map<std::string, FileInfo> FileMap;
 	FileMap mFileMap;
+
+	// reloads files it is notified of
+	class Watcher : public FileWatcher {
+	public:
+		Watcher(ResourceManager * rm) : mRM(rm) {}
+		virtual void onFileWatch(File& file);
+	private:
+		ResourceManager * mRM;
+	};
+
+	Watcher mWatcher;
+	bool mChanged;	// a file was read since the last poll
+
+private:
+	ResourceManager(const ResourceManager&);
+	ResourceManager& operator=(const ResourceManager&);
 };
 
 
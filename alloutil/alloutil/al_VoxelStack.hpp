@@ -2,15 +2,28 @@
 #define AL_UTIL_VOXEL_STACK_HPP
 
 #include "allocore/math/al_Functions.hpp"
+#include "allocore/math/al_Vec.hpp"
+#include "allocore/system/al_ThreadPool.hpp"
 
 #include <list>
 #include <vector>
 
 namespace al {
 
+	/// Stacks of items in the voxels of a wrapping 3D grid
+
+	/// Items can be stacked one at a time with set(), or all at once with
+	/// rebuild(). The latter sorts the items by voxel into one contiguous
+	/// array with an offset per voxel (as in a CSR sparse matrix). This avoids
+	/// touching a separate vector per voxel, both when filling and querying.
+	/// Queries work the same in both cases; items set after a rebuild are
+	/// stacked on top of the rebuilt ones.
 	template<typename T>
 	struct VoxelStack {
 
+		/// Maximum number of items per voxel; more are ignored
+		enum { STACK_SIZE = 8 };
+
 		template<int N>
 		struct Stack {
 
@@ -48,17 +61,21 @@ namespace al {
 			std::vector<T *> nodes;
 		};
 
-		VoxelStack(int dim=32) : mDim(al::ceilPow2(dim)), mDim2(mDim*mDim), mDim3(mDim*mDim*mDim), mDimWrap(mDim-1) {
+		VoxelStack(int dim=32) : mDim(al::ceilPow2(dim)), mDim2(mDim*mDim), mDim3(mDim*mDim*mDim), mDimWrap(mDim-1), mStacked(false) {
 			voxels.resize(mDim3);
 		}
 
 		void clear() {
-			for (int i=0; i<mDim3; i++){
-				voxels[i].clear();
+			if (mStacked) {
+				for (unsigned i=0; i<mDim3; i++){
+					voxels[i].clear();
+				}
+				mStacked = false;
 			}
+			mCounts.clear();
 		}
 
-		inline int pos2voxelindex(const Vec3d & v) {	// column-major.
+		inline int pos2voxelindex(const Vec3d & v) const {	// column-major.
 			return (unsigned(int(v[0])) & mDimWrap)
 				 + (unsigned(int(v[1])) & mDimWrap)*mDim
 				 + (unsigned(int(v[2])) & mDimWrap)*mDim2;
@@ -84,27 +101,118 @@ namespace al {
 		}
 
 		void set(int i, T * v) {
-			voxels[i].push(v);
+			if (count(i) < STACK_SIZE) {
+				voxels[i].push(v);
+				mStacked = true;
+			}
 		}
 		T * at(int i) const {
-			return voxels[i].top();
+			if (mStacked && !voxels[i].nodes.empty()) return voxels[i].top();
+			if (mCounts.empty() || !mCounts[i]) return NULL;
+			return mItems[mOffsets[i] + mCounts[i] - 1];
 		}
 		T * pop(int i) {
 			//T * v = voxels[i].front();
-			T * v = voxels[i].pop(); //pop_front();
-			return v;
+			if (mStacked && !voxels[i].nodes.empty()) return voxels[i].pop(); //pop_front();
+			if (mCounts.empty() || !mCounts[i]) return NULL;
+			return mItems[mOffsets[i] + --mCounts[i]];
+		}
+
+		/// Get number of items in a voxel
+		int count(int i) const {
+			return (mStacked ? voxels[i].nodes.size() : 0) + (mCounts.empty() ? 0 : mCounts[i]);
 		}
 
 		std::list<T *>& operator[](int i) { return voxels[i]; }
 		const std::list<T *>& operator[](int i) const { return voxels[i]; }
 
+
+		/// Replace all stacks by the items of an array
+
+		/// The result is the same as calling clear() and then set() for each
+		/// item in order. Items are counted per voxel, and then copied into
+		/// their voxels' ranges of one array. Both passes are split among
+		/// the threads of a pool, each taking a fixed range of items.
+		/// @param[in] items	array of items
+		/// @param[in] n		number of items
+		/// @param[in] posOf	function object returning the position of an
+		///						item, called as posOf(const T&)
+		/// @param[in] pool		pool to run on or NULL to run in the calling thread
+		template <class PosOf>
+		void rebuild(T * items, int n, const PosOf& posOf, ThreadPool * pool = NULL) {
+			clear();
+			int numThreads = pool && n >= 4096 ? pool->size() : 1;
+
+			// Voxel of each item and number of items per voxel and thread
+			mIndices.resize(n);
+			mThreadCounts.assign(numThreads * mDim3, 0);
+			runChunks(pool, numThreads, n, [&](int t, int begin, int end){
+				unsigned * counts = &mThreadCounts[t * mDim3];
+				for (int k=begin; k<end; ++k) {
+					int i = pos2voxelindex(posOf(items[k]));
+					mIndices[k] = i;
+					++counts[i];
+				}
+			});
+
+			// Offsets of voxels and, within them, of each thread's items. All
+			// items are stored, but only the first ones of a voxel are counted.
+			mOffsets.resize(mDim3 + 1);
+			mCounts.resize(mDim3);
+			unsigned total = 0;
+			for (unsigned i=0; i<mDim3; ++i) {
+				mOffsets[i] = total;
+				for (int t=0; t<numThreads; ++t) {
+					unsigned& tc = mThreadCounts[t * mDim3 + i];
+					unsigned start = total;
+					total += tc;
+					tc = start;		// now where the thread's next item goes
+				}
+				unsigned c = total - mOffsets[i];
+				mCounts[i] = c < unsigned(STACK_SIZE) ? c : unsigned(STACK_SIZE);
+			}
+			mOffsets[mDim3] = total;
+
+			// Copy items into their voxels, in the order of the array
+			mItems.resize(total);
+			runChunks(pool, numThreads, n, [&](int t, int begin, int end){
+				unsigned * next = &mThreadCounts[t * mDim3];
+				T ** dst = mItems.data();
+				for (int k=begin; k<end; ++k) {
+					dst[next[mIndices[k]]++] = &items[k];
+				}
+			});
+		}
+
 	protected:
 		//std::vector< std::list< T * > > voxels;
-		std::vector<Stack<8> > voxels;
+		std::vector<Stack<STACK_SIZE> > voxels;
 
 		unsigned mDim, mDim2, mDim3, mDimWrap;
+		bool mStacked;	// whether any stack may be non-empty
+
+		// Rebuilt items, sorted by voxel
+		std::vector<T *> mItems;
+		std::vector<unsigned> mOffsets;		// first item of each voxel, plus end
+		std::vector<unsigned> mCounts;		// remaining items of each voxel
+		std::vector<int> mIndices;			// voxel of each item
+		std::vector<unsigned> mThreadCounts;	// per voxel and thread
+
+		// Call func(thread, begin, end) for fixed ranges of [0, n)
+		template <class Func>
+		static void runChunks(ThreadPool * pool, int numThreads, int n, const Func& func) {
+			if (numThreads <= 1) {
+				func(0, 0, n);
+				return;
+			}
+			pool->parallelFor(0, numThreads, [&](int begin, int end){
+				for (int t=begin; t<end; ++t) {
+					func(t, int((long long)n * t / numThreads), int((long long)n * (t+1) / numThreads));
+				}
+			}, 1);
+		}
 	};
 
 } // al::
 
-#endif
\ No newline at end of file
+#endif
@@ -2,15 +2,22 @@
 
 #include <vector>
 #include <map>
+#include <set>
 #include <limits>
 
+#ifdef AL_LINUX
+	#define AL_FILEWATCHER_INOTIFY
+	#include <unistd.h>
+	#include <sys/inotify.h>
+#endif
+
 using namespace al;
 
 typedef std::vector<FileWatcher *> WatcherList;
 
 struct WatchedFile {
-	WatchedFile() : mModified(-std::numeric_limits<double>::max()) {}
-	WatchedFile(const WatchedFile& cpy) : mModified(cpy.mModified) {}
+	WatchedFile() : mModified(-std::numeric_limits<double>::max()), mNative(false) {}
+	WatchedFile(const WatchedFile& cpy) : mModified(cpy.mModified), mNative(false) {}
 
 	void add(FileWatcher * watcher) {
 		mWatchers.push_back(watcher);
@@ -68,27 +75,148 @@ struct WatchedFile {
 	std::string mPath;
 	al_sec mModified;
 	WatcherList mWatchers;
+	bool mNative;	// changes are reported by the OS, so no need to poll
 };
 
 typedef std::map<std::string, WatchedFile > WatcherMap;
 
-WatcherMap gWatchedFiles;
+// never destroyed, so that static FileWatchers can be destroyed in any order
+static WatcherMap& watchedFiles() {
+	static WatcherMap * files = new WatcherMap;
+	return *files;
+}
+
 al_sec gPollPeriod;
 
+#ifdef AL_FILEWATCHER_INOTIFY
+
+// Watches the directories of files with inotify, so that files replaced by
+// renaming, as many editors save them, are seen too. Its descriptor is
+// watched by the main loop, so changes are handled as they happen.
+class Inotify : public Main::FDHandler {
+public:
+
+	static Inotify& get() {
+		static Inotify * singleton = new Inotify;
+		return *singleton;
+	}
+
+	bool valid() const { return mFD >= 0; }
+
+	// watch directory of a file; returns false if it cannot be watched
+	bool add(const std::string& filepath) {
+		if (!valid()) return false;
+		std::string dir = File::directory(filepath);
+		int wd = inotify_add_watch(mFD, dir.c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB | IN_ONLYDIR);
+		if (wd < 0) return false;
+		size_t pos = filepath.find_last_of(AL_FILE_DELIMITER);
+		std::string name = pos == std::string::npos ? filepath : filepath.substr(pos+1);
+		std::vector<std::string>& paths = mDirs[wd][name];
+		for (unsigned i=0; i<paths.size(); i++) {
+			if (paths[i] == filepath) return true;
+		}
+		paths.push_back(filepath);
+		return true;
+	}
+
+	// read all pending events, then test each changed file once
+	void update() {
+		if (!valid()) return;
+		std::set<std::string> changed;
+		bool overflow = false;
+		char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+		for (;;) {
+			ssize_t len = read(mFD, buf, sizeof(buf));
+			if (len <= 0) break;
+			for (char * p = buf; p < buf + len; ) {
+				const struct inotify_event * ev = (const struct inotify_event *)p;
+				p += sizeof(struct inotify_event) + ev->len;
+				if (ev->mask & IN_Q_OVERFLOW) {
+					overflow = true;
+					continue;
+				}
+				DirMap::iterator dir = mDirs.find(ev->wd);
+				if (dir == mDirs.end()) continue;
+				if (ev->mask & IN_IGNORED) {
+					// directory is gone; poll its files from now on
+					NameMap::iterator it = dir->second.begin();
+					for (; it != dir->second.end(); it++) {
+						for (unsigned i=0; i<it->second.size(); i++) {
+							watchedFiles()[it->second[i]].mNative = false;
+						}
+					}
+					mDirs.erase(dir);
+				}
+				else if (ev->len) {
+					NameMap::iterator it = dir->second.find(ev->name);
+					if (it != dir->second.end()) {
+						changed.insert(it->second.begin(), it->second.end());
+					}
+				}
+			}
+		}
+
+		// events were lost, so any file may have changed
+		if (overflow) {
+			for (WatcherMap::iterator it = watchedFiles().begin(); it != watchedFiles().end(); it++) {
+				if (it->second.mNative) changed.insert(it->first);
+			}
+		}
+
+		// watchers may watch more files, so notify only after reading events
+		for (std::set<std::string>::iterator it = changed.begin(); it != changed.end(); it++) {
+			watchedFiles()[*it].test();
+		}
+	}
+
+	virtual void onReadable(int /*fd*/) { update(); }
+
+private:
+	typedef std::map<std::string, std::vector<std::string> > NameMap;	// file name -> watched paths
+	typedef std::map<int, NameMap> DirMap;									// watch descriptor -> files
+
+	int mFD;
+	DirMap mDirs;
+
+	Inotify() : mFD(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+		if (valid()) Main::get().watch(mFD, *this);
+	}
+};
+
+static bool nativeWatch(const std::string& filepath) { return Inotify::get().add(filepath); }
+static void nativeUpdate() { Inotify::get().update(); }
+static bool nativeValid() { return Inotify::get().valid(); }
+
+#else
+
+static bool nativeWatch(const std::string& filepath) { return false; }
+static void nativeUpdate() {}
+static bool nativeValid() { return false; }
+
+#endif
+
+
+bool FileWatcher::native() {
+	return nativeValid();
+}
+
 void FileWatcher::poll() {
-	// check each file:
-	WatcherMap::iterator it = gWatchedFiles.begin();
-	while (it != gWatchedFiles.end()) {
-		it->second.test(this);
+	nativeUpdate();
+	// check each file not reported by the OS:
+	WatcherMap::iterator it = watchedFiles().begin();
+	while (it != watchedFiles().end()) {
+		if (!it->second.mNative) it->second.test(this);
 		it++;
 	}
 }
 
 void FileWatcher::pollAll() {
-	// check each file:
-	WatcherMap::iterator it = gWatchedFiles.begin();
-	while (it != gWatchedFiles.end()) {
-		it->second.test();
+	nativeUpdate();
+	// check each file not reported by the OS:
+	WatcherMap::iterator it = watchedFiles().begin();
+	while (it != watchedFiles().end()) {
+		if (!it->second.mNative) it->second.test();
 		it++;
 	}
 }
@@ -118,8 +246,8 @@ void FileWatcher::autoPoll(al_sec t) {
 
 FileWatcher::~FileWatcher(){
 	// check each file:
-	WatcherMap::iterator it = gWatchedFiles.begin();
-	while (it != gWatchedFiles.end()) {
+	WatcherMap::iterator it = watchedFiles().begin();
+	while (it != watchedFiles().end()) {
 		it->second.remove(this);
 		it++;
 	}
@@ -127,9 +255,10 @@ FileWatcher::~FileWatcher(){
 
 void FileWatcher::watch(std::string filepath, bool immediate) {
 	// find or create:
-	WatchedFile& wf = gWatchedFiles[filepath];
+	WatchedFile& wf = watchedFiles()[filepath];
 	wf.mPath = filepath;
 	wf.add(this);
+	if (!wf.mNative) wf.mNative = nativeWatch(filepath);
 	if (immediate) wf.test();
 }
 
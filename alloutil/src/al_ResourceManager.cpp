@@ -3,6 +3,16 @@
 
 using namespace al;
 
+ResourceManager::ResourceManager()
+:	mWatcher(this), mChanged(false)
+{}
+
+void ResourceManager::Watcher::onFileWatch(File& file) {
+	FileMap::iterator it = mRM->mFileMap.begin();
+	for (; it != mRM->mFileMap.end(); it++) {
+		if (it->second.path == file.path()) mRM->read(it->first);
+	}
+}
 
 std::string ResourceManager::find(std::string filename) {
 	FilePath fp = paths.find(filename);
@@ -41,6 +51,7 @@ bool ResourceManager::read(std::string filename) {
 	FileInfo& info = mFileMap[filename];
 	if (info.path == "") {
 		info.path = find(filename);
+		if (info.path != "") mWatcher.watch(info.path, false);
 	}
 	if (info.path != "" && File::exists(info.path)) {
 		al_sec modified = File::modified(info.path);
@@ -51,6 +62,7 @@ bool ResourceManager::read(std::string filename) {
 			info.data = f.readAll();
 			info.loaded = true;
 			f.close();
+			mChanged = true;
 			return true;
 		}
 	}
@@ -58,10 +70,13 @@ bool ResourceManager::read(std::string filename) {
 }
 
 bool ResourceManager::poll() {
-	bool changed = 0;
+	// reloads changed files through Watcher::onFileWatch
+	mWatcher.poll();
+	// look again for files that could not be found
 	for (FileMap::iterator it=mFileMap.begin(); it!=mFileMap.end(); it++) {
-		std::string name = it->first;
-		changed = read(name) || changed;
+		if (it->second.path == "") read(it->first);
 	}
+	bool changed = mChanged;
+	mChanged = false;
 	return changed;
 }
@@ -0,0 +1,135 @@
+
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <string>
+
+#include "alloutil/al_FileWatcher.hpp"
+#include "allocore/system/al_Time.hpp"
+
+using namespace al;
+
+// Counts notifications and keeps the last contents read
+struct Counter : public FileWatcher {
+	int count;
+	std::string data;
+	Counter() : count(0) {}
+	virtual void onFileWatch(File& file) {
+		++count;
+		data = file.readAll();
+	}
+};
+
+static const std::string dir = "fileWatcherTestDir" AL_FILE_DELIMITER_STR;
+static const std::string path = dir + "watched.txt";
+
+// Modification times may be as coarse as a scheduler tick
+static void tick()
+{
+	al_sleep(0.02);
+}
+
+static void rewriteInPlace(const std::string& data)
+{
+	tick();
+	File::write(path, data);
+}
+
+static void rewriteByRename(const std::string& data)
+{
+	tick();
+	std::string tmp = dir + "watched.tmp";
+	File::write(tmp, data);
+	rename(tmp.c_str(), path.c_str());
+}
+
+void ut_in_place(void)
+{
+	Counter w;
+	w.watch(path);
+	assert(w.count == 1);
+	assert(w.data == "0");
+
+	FileWatcher::pollAll();
+	assert(w.count == 1);
+
+	// Several writes before a poll give one notification
+	rewriteInPlace("1");
+	rewriteInPlace("2");
+	FileWatcher::pollAll();
+	assert(w.count == 2);
+	assert(w.data == "2");
+
+	FileWatcher::pollAll();
+	assert(w.count == 2);
+}
+
+void ut_rename(void)
+{
+	Counter w;
+	w.watch(path, false);
+
+	rewriteByRename("3");
+	FileWatcher::pollAll();
+	assert(w.count == 1);
+	assert(w.data == "3");
+
+	// So do mixed in-place and renaming writes
+	rewriteByRename("4");
+	rewriteInPlace("5");
+	rewriteByRename("6");
+	FileWatcher::pollAll();
+	assert(w.count == 2);
+	assert(w.data == "6");
+
+	FileWatcher::pollAll();
+	assert(w.count == 2);
+}
+
+void ut_poll_fallback(void)
+{
+	Counter w;
+	w.watch(path, false);
+
+	// Once the directory is replaced, the OS no longer reports changes to
+	// the file and it is polled
+	remove(path.c_str());
+	Dir::remove(dir);
+	FileWatcher::pollAll();
+	assert(w.count == 0);
+	Dir::make(dir);
+	rewriteInPlace("7");
+	FileWatcher::pollAll();
+	assert(w.count == 1);
+	assert(w.data == "7");
+
+	FileWatcher::pollAll();
+	assert(w.count == 1);
+
+	rewriteInPlace("8");
+	rewriteByRename("9");
+	FileWatcher::pollAll();
+	assert(w.count == 2);
+	assert(w.data == "9");
+}
+
+
+#define RUNTEST(Name)\
+	printf("%s ", #Name);\
+	ut_##Name();\
+	for(size_t i=0; i<32-strlen(#Name); ++i) printf(".");\
+	printf(" pass\n")
+
+int main(int argc, char *argv[])
+{
+	Dir::make(dir);
+	File::write(path, "0");
+
+	RUNTEST(in_place);
+	RUNTEST(rename);
+	RUNTEST(poll_fallback);
+
+	remove(path.c_str());
+	Dir::remove(dir);
+	return 0;
+}